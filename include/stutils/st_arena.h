@@ -0,0 +1,174 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _ST_ARENA_H_
+#define _ST_ARENA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include <stutils/st_macro.h>
+
+/*
+ * Bump-pointer arena.
+ *
+ * Memory is carved from large chunks by moving a pointer forward, and is
+ * never freed one block at a time. st_arena_rewind gives back everything
+ * allocated after a st_arena_mark, st_arena_reset everything at once;
+ * chunks given back are kept for reuse until st_arena_destroy, so a
+ * per-request arena costs no malloc once it has warmed up.
+ */
+
+/* alignment of st_arena_alloc and st_arena_realloc. */
+#define ST_ARENA_ALIGNMENT    16
+
+/* default size of chunks. */
+#define ST_ARENA_CHUNK_SIZE   (1024 * 1024)
+
+/* flags of st_arena_create. */
+#define ST_ARENA_HUGE_PAGE    0x1 /* back chunks with huge pages if possible. */
+
+typedef struct _st_arena_chunk_t
+{
+    struct _st_arena_chunk_t *prev; /* chunk allocated before this one. */
+    size_t cap;  /* bytes usable after the header. */
+    size_t used;
+    size_t map_len; /* length of the mapping if mmapped, 0 otherwise. */
+} st_arena_chunk_t;
+
+typedef struct _st_arena_t
+{
+    st_arena_chunk_t *chunk; /* the chunk allocated from. */
+    st_arena_chunk_t *spare; /* chunks given back, reused first. */
+    size_t chunk_size;
+    int flags;
+
+    void *last; /* latest allocation, st_arena_realloc grows it in place. */
+} st_arena_t;
+
+/* a position in an arena, see st_arena_mark. */
+typedef struct _st_arena_mark_t
+{
+    st_arena_chunk_t *chunk;
+    size_t used;
+} st_arena_mark_t;
+
+/*
+ * Create an arena.
+ *
+ * @param[in] chunk_size size of chunks, 0 for ST_ARENA_CHUNK_SIZE.
+ *                       Larger allocations get a chunk of their own.
+ * @param[in] flags bitwise or of ST_ARENA_* flags.
+ * @return the arena, NULL if any error.
+ */
+st_arena_t* st_arena_create(size_t chunk_size, int flags);
+
+#define safe_st_arena_destroy(ptr) do {\
+    if((ptr) != NULL) {\
+        st_arena_destroy(ptr);\
+        safe_free(ptr);\
+        (ptr) = NULL;\
+    }\
+    } while(0)
+/*
+ * Destroy an arena, releasing all its memory.
+ *
+ * @param[in] arena the arena.
+ */
+void st_arena_destroy(st_arena_t *arena);
+
+/*
+ * Allocate a block aligned to ST_ARENA_ALIGNMENT.
+ *
+ * @param[in] arena the arena.
+ * @param[in] size size of bytes for alloc.
+ * @return pointer to the block, NULL if any error.
+ */
+void* st_arena_alloc(st_arena_t *arena, size_t size);
+
+/*
+ * Allocate an aligned block.
+ *
+ * @param[in] arena the arena.
+ * @param[in] size size of bytes for alloc.
+ * @param[in] alignment size of alignment. Must be power of 2.
+ * @return pointer to the block, NULL if any error.
+ */
+void* st_arena_aligned_alloc(st_arena_t *arena, size_t size,
+        size_t alignment);
+
+/*
+ * Resize a block. The latest block of the arena is resized in place if
+ * its chunk has room, any other block is copied to a new one.
+ *
+ * @param[in] arena the arena.
+ * @param[in] ptr block from st_arena_alloc or st_arena_realloc,
+ *                NULL for a new block.
+ * @param[in] old_size current size of ptr.
+ * @param[in] size new size of block.
+ * @return pointer to the block, NULL if any error.
+ */
+void* st_arena_realloc(st_arena_t *arena, void *ptr, size_t old_size,
+        size_t size);
+
+/*
+ * Get the current position of an arena.
+ *
+ * @param[in] arena the arena.
+ * @return the position, for st_arena_rewind, a zeroed mark if any error.
+ */
+st_arena_mark_t st_arena_mark(st_arena_t *arena);
+
+/*
+ * Give back all blocks allocated after a position.
+ *
+ * @param[in] arena the arena.
+ * @param[in] mark position from st_arena_mark, not rewound past already.
+ * @return non-zero value if any error.
+ */
+int st_arena_rewind(st_arena_t *arena, st_arena_mark_t mark);
+
+/*
+ * Give back all blocks of an arena.
+ *
+ * @param[in] arena the arena.
+ */
+void st_arena_reset(st_arena_t *arena);
+
+/*
+ * Get number of bytes allocated from an arena, padding included.
+ *
+ * @param[in] arena the arena.
+ * @return number of bytes.
+ */
+size_t st_arena_used(st_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _ST_DICT_ACC_H_
+#define _ST_DICT_ACC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <stutils/st_macro.h>
+#include "st_dict.h"
+
+/*
+ * Counting accumulator over st_dict.
+ *
+ * Every thread updates its own st_dict, so no lock is taken while
+ * counting. st_dict_acc_merge folds all of them with st_dict_merge.
+ * When spill is set, a thread dict whose tables grow past spill_bytes
+ * is saved into spill_dir and started afresh; spilled dicts are mapped
+ * read-only at merge time, so the partial counts need not fit in RAM.
+ *
+ * All thread dicts must hash alike to be merged, so st_dict_hash_auto
+ * is resolved to st_dict_hash_murmur, its hash before sampling, when
+ * the accumulator is created.
+ */
+
+typedef struct _st_dict_acc_local_t {
+    st_dict_t *dict;
+    char **spill_files;
+    int spill_num;
+} st_dict_acc_local_t;
+
+typedef struct _st_dict_acc_t {
+    st_dict_acc_local_t *locals;
+    int num_thread;
+
+    st_dict_id_t hash_num;
+    st_dict_id_t realloc_node_num;
+    st_dict_hash_fun_t hash_func;
+    st_dict_update_func_t update_func;
+    st_dict_merge_func_t merge_func;
+
+    size_t spill_bytes;
+    char spill_dir[MAX_DIR_LEN];
+} st_dict_acc_t;
+
+/*
+ * Create an accumulator.
+ *
+ * @param[in] num_thread number of updating threads.
+ * @param[in] hash_num, realloc_node_num, hash_func see st_dict_create,
+ *            used for every thread dict and the merged dict.
+ * @param[in] update_func passed to st_dict_update.
+ * @param[in] merge_func fold the count of one node into another.
+ * @return the accumulator, NULL if any error.
+ */
+st_dict_acc_t* st_dict_acc_create(int num_thread, st_dict_id_t hash_num,
+        st_dict_id_t realloc_node_num, st_dict_hash_fun_t hash_func,
+        st_dict_update_func_t update_func, st_dict_merge_func_t merge_func);
+
+#define safe_st_dict_acc_destroy(ptr) do {\
+    if((ptr) != NULL) {\
+        st_dict_acc_destroy(ptr);\
+        safe_free(ptr);\
+        (ptr) = NULL;\
+    }\
+    } while(0)
+/* removes the spill files not merged yet. */
+void st_dict_acc_destroy(st_dict_acc_t *acc);
+
+/*
+ * Spill thread dicts to disk.
+ *
+ * @param[in] acc the accumulator.
+ * @param[in] spill_bytes spill a thread dict once its bucket array and
+ *                        node pool take more than this many bytes,
+ *                        0 to disable.
+ * @param[in] spill_dir directory for the spill files.
+ * @return non-zero value if any error.
+ */
+int st_dict_acc_set_spill(st_dict_acc_t *acc, size_t spill_bytes,
+        const char *spill_dir);
+
+/*
+ * Update a node in the dict of thread tid, see st_dict_update.
+ * Different tids can be used concurrently without any lock.
+ *
+ * @param[in] acc the accumulator.
+ * @param[in] tid index of the calling thread, [0, num_thread).
+ * @param[in] pnode the node.
+ * @return non-zero value if any error.
+ */
+int st_dict_acc_update(st_dict_acc_t *acc, int tid, st_dict_node_t *pnode);
+
+/*
+ * Merge all thread dicts and spill files into one dict.
+ *
+ * The accumulator is emptied and can be reused afterwards. On error it
+ * is left as it was.
+ *
+ * @param[in] acc the accumulator.
+ * @param[in] num_thread number of merging threads.
+ * @return the merged dict, NULL if any error.
+ */
+st_dict_t* st_dict_acc_merge(st_dict_acc_t *acc, int num_thread);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
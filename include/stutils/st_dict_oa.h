@@ -0,0 +1,103 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _ST_DICT_OA_H_
+#define _ST_DICT_OA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <stutils/st_macro.h>
+#include "st_dict.h"
+
+/*
+ * Open addressing variant of st_dict.
+ *
+ * Slots are organised in groups of ST_DICT_OA_GROUP. Every slot has one
+ * control byte, which is either ST_DICT_OA_EMPTY or the low 7 bits of the
+ * hash of the key stored in it. A probe compares the control bytes of a
+ * whole group at once (with SSE2 when available), so only slots whose tag
+ * matches are touched.
+ *
+ * Keys and payloads are the same as st_dict: (sign1, sign2) with
+ * sign1 == sign2 == 0 reserved, and the uint1/float1 union as value.
+ * The next field of st_dict_node_t is not used.
+ */
+
+#define ST_DICT_OA_GROUP   16
+#define ST_DICT_OA_EMPTY   0x80
+
+typedef struct _st_dict_oa_t
+{
+    uint8_t            *ctrl;
+    st_dict_node_t     *slots;
+    st_dict_id_t       capacity;
+    st_dict_id_t       group_mask;
+
+    st_dict_id_t       node_num;
+    st_dict_id_t       max_node_num;
+
+    st_dict_node_eq_fun_t node_eq_func;
+} st_dict_oa_t;
+
+/*
+ * Create an open addressing dict.
+ *
+ * @param[in] node_num expected number of nodes, the table grows when
+ *                     it is exceeded.
+ * @param[in] node_eq_func equal function, NULL to compare sign1 and sign2.
+ * @return the dict, NULL if any error.
+ */
+st_dict_oa_t* st_dict_oa_create(st_dict_id_t node_num,
+    st_dict_node_eq_fun_t node_eq_func);
+
+#define safe_st_dict_oa_destroy(ptr) do {\
+    if((ptr) != NULL) {\
+        st_dict_oa_destroy(ptr);\
+        safe_free(ptr);\
+        (ptr) = NULL;\
+    }\
+    } while(0)
+void st_dict_oa_destroy(st_dict_oa_t *wd);
+
+int st_dict_oa_add(st_dict_oa_t *wd, st_dict_node_t *pnode, void *node_eq_arg);
+int st_dict_oa_add_no_seek(st_dict_oa_t *wd, st_dict_node_t *pnode);
+int st_dict_oa_seek(st_dict_oa_t *wd, st_dict_node_t *pnode,
+        void *node_eq_arg);
+
+int st_dict_oa_update(st_dict_oa_t *wd, st_dict_node_t *pnode,
+        void *node_eq_arg, st_dict_update_func_t update_data);
+
+int st_dict_oa_traverse(st_dict_oa_t *wd, st_dict_trav_func_t trav,
+        void *args);
+int st_dict_oa_clear(st_dict_oa_t *wd, st_dict_trav_func_t trav, void *args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
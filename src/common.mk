@@ -11,16 +11,19 @@ COMPILE_bin.c = $(CC) $(DEPFLAGS) $(CFLAGS) $(CPPFLAGS) -o $@ $< -l$(PROJECT) $(
 COMPILE_bin.cc = $(CC) $(DEPFLAGS) $(CXXFLAGS) $(CPPFLAGS) -o $@ $< -L$(OUTLIB_DIR) -l$(PROJECT) $(LDFLAGS)
 COMPILE_test_bin.c = $(CC) $(DEPFLAGS) $(CFLAGS) $(CPPFLAGS) -UNDEBUG -o $@ $<  -L$(OUTLIB_DIR) -l$(PROJECT) $(LDFLAGS)
 COMPILE_test_bin.cc = $(CC) $(DEPFLAGS) $(CXXFLAGS) $(CPPFLAGS) -UNDEBUG -o $@ $< -L$(OUTLIB_DIR) -l$(PROJECT) $(LDFLAGS)
+COMPILE_bench_bin.c = $(CC) $(DEPFLAGS) $(CFLAGS) $(CPPFLAGS) -o $@ $<  -L$(OUTLIB_DIR) -l$(PROJECT) $(LDFLAGS)
 ifdef STATIC_LINK
 COMPILE_bin.c += -L$(OBJ_DIR) -Wl,-rpath,'$$ORIGIN/../lib'
 COMPILE_bin.cc += -L$(OBJ_DIR) -Wl,-rpath,'$$ORIGIN/../lib'
 COMPILE_test_bin.c += -L$(OBJ_DIR)
 COMPILE_test_bin.cc += -L$(OBJ_DIR)
+COMPILE_bench_bin.c += -L$(OBJ_DIR)
 else
 COMPILE_bin.c += -L$(OUTLIB_DIR) -Wl,-rpath,$(abspath $(OUTLIB_DIR)) -Wl,-rpath,'$$ORIGIN/../lib'
 COMPILE_bin.cc += -L$(OUTLIB_DIR) -Wl,-rpath,$(abspath $(OUTLIB_DIR)) -Wl,-rpath,'$$ORIGIN/../lib'
 COMPILE_test_bin.c += -L$(OUTLIB_DIR) -Wl,-rpath,$(abspath $(OUTLIB_DIR))
 COMPILE_test_bin.cc += -L$(OUTLIB_DIR) -Wl,-rpath,$(abspath $(OUTLIB_DIR))
+COMPILE_bench_bin.c += -L$(OUTLIB_DIR) -Wl,-rpath,$(abspath $(OUTLIB_DIR))
 endif
 
 ifdef STATIC_LINK
@@ -44,7 +47,7 @@ endif
 OUT_INCS = $(addprefix $(OUTINC_DIR)/$(PROJECT)/,$(INCS))
 
 .PHONY: $(PREFIX)all $(PREFIX)inc $(PREFIX)rev
-.PHONY: $(PREFIX)test $(PREFIX)val-test
+.PHONY: $(PREFIX)test $(PREFIX)val-test $(PREFIX)bench
 .PHONY: $(PREFIX)clean $(PREFIX)clean-bin
 
 $(PREFIX)all: $(PREFIX)inc $(TARGET_LIB) $(TARGET_BINS)
@@ -160,6 +163,29 @@ $(PREFIX)val-test: $(TARGET_VAL_TESTS)
      done; \
      exit $$result
 
+TARGET_BENCHES = $(addprefix $(OBJ_DIR)/,$(BENCHES))
+
+$(TARGET_BENCHES) : $(OUT_REV) $(TARGET_LIB)
+$(TARGET_BENCHES) : $(OBJ_DIR)/% : %.c $(DEP_DIR)/%.d
+	@mkdir -p "$(dir $@)"
+	@mkdir -p "$(dir $(DEP_DIR)/$*.d)"
+	$(COMPILE_bench_bin.c)
+	$(POSTCOMPILE)
+
+-include $(patsubst %,$(DEP_DIR)/%.d,$(basename $(BENCHES)))
+
+$(PREFIX)bench: $(TARGET_BENCHES)
+	@result=0; \
+     for x in $(TARGET_BENCHES); do \
+       echo "Running $$x ..."; \
+       ./$$x; \
+       if [ $$? -ne 0 ]; then \
+         echo "... FAIL $$x"; \
+         result=1; \
+       fi; \
+     done; \
+     exit $$result
+
 ifdef BINS
 
 $(PREFIX)clean-bin:
@@ -176,8 +202,8 @@ endif
 ifdef TESTS
 
 $(PREFIX)clean-test:
-	rm -f $(TARGET_TESTS)
-	rm -rf $(addsuffix .dSYM,$(TARGET_TESTS))
+	rm -f $(TARGET_TESTS) $(TARGET_BENCHES)
+	rm -rf $(addsuffix .dSYM,$(TARGET_TESTS) $(TARGET_BENCHES))
 
 else
 
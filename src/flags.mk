@@ -11,6 +11,7 @@ CFLAGS += -Wall -pipe -g -m64
 CFLAGS += -march=native -mtune=native -O3
 CFLAGS += -I. -I$(OUTINC_DIR)
 CFLAGS += -DNDEBUG
+#CFLAGS += -D_ST_DICT_STATS_
 #CFLAGS += -pg
 #LDFLAGS += -pg
 ifeq ($(shell uname -s),Darwin)
@@ -23,30 +23,166 @@
  */
 
 #include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sched.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "st_utils.h"
+#include "st_io.h"
 #include "st_alphabet.h"
 #include "st_log.h"
 
 #define SYM_NUM "symbols"
 
+/* smallest capacity of labels, and of buckets in index_dict. */
+#define ST_ALPHABET_MIN_LABEL_NUM 16
+/* index_dict doubles its buckets above this load factor. */
+#define ST_ALPHABET_MAX_LOAD_FACTOR 1.0
 
-void get_sign(const char *psrc, int slen, st_dict_sign_t *sign1, st_dict_sign_t *sign2)
+/* initial bytes of arena reserved per label in st_alphabet_create. */
+#define ST_ALPHABET_AVG_LABEL_LEN 8
+
+#define ST_ALPHABET_MAGIC   0x42414c53
+/*
+ * version 2: signatures from get_sign with MurmurHash64A. index_dict of
+ * older files is rebuilt on load.
+ * version 3: page aligned sections, see st_alphabet_save_bin.
+ */
+#define ST_ALPHABET_VERSION      3
+#define ST_ALPHABET_SIGN_VERSION 2
+#define ST_ALPHABET_MMAP_VERSION 3
+
+#define ST_ALPHABET_ALIGN 4096
+
+typedef struct _st_alphabet_header_t
 {
-    *sign1=0;
-    *sign2=0;
-    if( slen <= 4 ) {
-        memcpy(sign1,psrc,slen);
-    } else {
-        if(slen<=8)
-        {
-            memcpy(sign1,psrc,4);
-            memcpy(sign2,psrc+4,slen-4);
-        }
-        else
-        {
-            *sign1 = MurmurHash2 ( psrc, slen / 2, 1 );
-            *sign2 = MurmurHash2 ( psrc + slen / 2, slen - slen / 2, 2 );
-        }
+    uint32_t magic;
+    uint32_t version;
+    int32_t label_num;
+    int32_t aux_num;
+    uint64_t label_buf_len;
+
+    /* since version 3, relative to the start of the header. */
+    uint64_t labels_offset;
+    uint64_t label_buf_offset;
+    uint64_t is_aux_offset;
+    uint64_t dict_offset;
+} st_alphabet_header_t;
+
+/* bytes of the header in files of version 1 and 2. */
+#define ST_ALPHABET_HEADER_V1_SIZE offsetof(st_alphabet_header_t, labels_offset)
+
+/* label record of files written before the string arena. */
+#define ST_ALPHABET_LEGACY_SYM_LEN 256
+typedef struct _st_alphabet_legacy_label_t
+{
+    char label[ST_ALPHABET_LEGACY_SYM_LEN];
+    int symid;
+} st_alphabet_legacy_label_t;
+
+
+/*
+ * Labels of at most ST_ALPHABET_INLINE_LEN bytes are their own signature,
+ * so two of them with equal signs and lengths are equal. Longer labels
+ * take both signs from one MurmurHash64A pass.
+ */
+#define ST_ALPHABET_INLINE_LEN 8
+#define ST_ALPHABET_SIGN_SEED  0x5f3759df
+
+static inline void get_sign(const char *psrc, size_t slen,
+        st_dict_sign_t *sign1, st_dict_sign_t *sign2)
+{
+    uint64_t key = 0;
+
+    if(slen <= ST_ALPHABET_INLINE_LEN)
+    {
+        memcpy(&key, psrc, slen);
+    }
+    else
+    {
+        key = MurmurHash64A(psrc, (int)slen, ST_ALPHABET_SIGN_SEED);
+    }
+
+    *sign1 = (st_dict_sign_t)(key & 0xFFFFFFFF);
+    *sign2 = (st_dict_sign_t)(key >> 32);
+}
+
+/* realloc a block of labels, label_buf or is_aux. */
+static void* st_alphabet_realloc_mem(st_alphabet_t *alphabet, void *ptr,
+        size_t old_size, size_t size)
+{
+    if(alphabet->mem_arena != NULL)
+    {
+        return st_arena_realloc(alphabet->mem_arena, ptr, old_size, size);
+    }
+
+    return realloc(ptr, size);
+}
+
+/* free a block of labels, label_buf or is_aux. */
+static void st_alphabet_free_mem(st_alphabet_t *alphabet, void *ptr)
+{
+    /* memory of mem_arena goes with mem_arena. */
+    if(alphabet->mem_arena == NULL)
+    {
+        free(ptr);
+    }
+}
+
+/* whether alphabet has to destroy its trie, it may be shared. */
+static bool st_alphabet_trie_owned(st_alphabet_t *alphabet)
+{
+    if(alphabet->trie == NULL)
+    {
+        return false;
+    }
+    if(alphabet->shared != NULL && alphabet->trie == alphabet->shared->trie)
+    {
+        return false;
+    }
+    if(alphabet->base != NULL && alphabet->trie == alphabet->base->trie)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static void st_alphabet_drop_trie(st_alphabet_t *alphabet)
+{
+    if(st_alphabet_trie_owned(alphabet))
+    {
+        safe_st_datrie_destroy(alphabet->trie);
+    }
+    alphabet->trie = NULL;
+}
+
+/* let go of the shared storage, whose fields alphabet still points to. */
+static void st_alphabet_release_shared(st_alphabet_t *alphabet)
+{
+    st_alphabet_t *shared = alphabet->shared;
+
+    if(shared == NULL)
+    {
+        return;
+    }
+
+    if(alphabet->trie == shared->trie)
+    {
+        alphabet->trie = NULL;
+    }
+    alphabet->shared = NULL;
+    if(__atomic_sub_fetch(&shared->ref, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        safe_st_alphabet_destroy(shared);
     }
 }
 
@@ -56,17 +192,53 @@ void st_alphabet_destroy(st_alphabet_t *alphabet)
         return;
     }
 
-    if(alphabet->labels) {
-        safe_free(alphabet->labels);
+    if(alphabet->shared != NULL) {
+        /* the storage belongs to shared. */
+        alphabet->labels = NULL;
+        alphabet->label_buf = NULL;
+        alphabet->is_aux = NULL;
+        alphabet->index_dict = NULL;
+        alphabet->map_addr = NULL;
+        alphabet->map_len = 0;
+        st_alphabet_release_shared(alphabet);
     }
 
-    if(alphabet->is_aux) {
-        safe_free(alphabet->is_aux);
+    if(alphabet->map_addr != NULL) {
+        (void)munmap(alphabet->map_addr, alphabet->map_len);
+        alphabet->map_addr = NULL;
+        alphabet->map_len = 0;
+        alphabet->labels = NULL;
+        alphabet->label_buf = NULL;
+        alphabet->is_aux = NULL;
     }
 
+    st_alphabet_free_mem(alphabet, alphabet->labels);
+    alphabet->labels = NULL;
+
+    st_alphabet_free_mem(alphabet, alphabet->label_buf);
+    alphabet->label_buf = NULL;
+    alphabet->label_buf_len = 0;
+    alphabet->label_buf_cap = 0;
+
+    st_alphabet_free_mem(alphabet, alphabet->is_aux);
+    alphabet->is_aux = NULL;
+
     if(alphabet->index_dict) {
         safe_st_dict_destroy(alphabet->index_dict);
     }
+
+    safe_free(alphabet->conc_slots);
+    alphabet->conc_mask = 0;
+
+    st_alphabet_drop_trie(alphabet);
+
+    if(alphabet->base != NULL) {
+        if(__atomic_sub_fetch(&alphabet->base->ref, 1, __ATOMIC_ACQ_REL) == 0) {
+            safe_st_alphabet_destroy(alphabet->base);
+        }
+        alphabet->base = NULL;
+        alphabet->base_num = 0;
+    }
 }
 
 static st_alphabet_t* st_alphabet_alloc()
@@ -81,17 +253,115 @@ static st_alphabet_t* st_alphabet_alloc()
     }
 
     alphabet->labels = NULL;
+    alphabet->label_buf = NULL;
+    alphabet->label_buf_len = 0;
+    alphabet->label_buf_cap = 0;
     alphabet->is_aux = NULL;
+    alphabet->max_label_num = 0;
     alphabet->label_num = 0;
     alphabet->aux_num = 0;
     alphabet->index_dict = NULL;
+    alphabet->map_addr = NULL;
+    alphabet->map_len = 0;
+    alphabet->unk_id = -1;
+    alphabet->conc_slots = NULL;
+    alphabet->conc_mask = 0;
+    alphabet->conc_base = 0;
+    alphabet->trie = NULL;
+    alphabet->base = NULL;
+    alphabet->base_num = 0;
+    alphabet->ref = 0;
+    alphabet->shared = NULL;
+    alphabet->mem_arena = NULL;
+
+    return alphabet;
+}
+
+static int st_alphabet_reserve_buf(st_alphabet_t *alphabet, size_t len)
+{
+    char *buf;
+    size_t cap;
+
+    if(alphabet->label_buf_len + len <= alphabet->label_buf_cap)
+    {
+        return 0;
+    }
+
+    cap = alphabet->label_buf_cap;
+    if(cap < MAX_LINE_LEN)
+    {
+        cap = MAX_LINE_LEN;
+    }
+    while(cap < alphabet->label_buf_len + len)
+    {
+        cap *= 2;
+    }
+
+    buf = (char *)st_alphabet_realloc_mem(alphabet, alphabet->label_buf,
+            alphabet->label_buf_len, cap);
+    if(buf == NULL)
+    {
+        ST_WARNING("Failed to realloc label_buf[%zu].", cap);
+        return -1;
+    }
+    alphabet->label_buf = buf;
+    alphabet->label_buf_cap = cap;
+
+    return 0;
+}
+
+/* copy label to the end of arena and point labels[id] to it, id is
+ * counted from base_num. */
+static int st_alphabet_store_label(st_alphabet_t *alphabet, int id,
+        const char *label, size_t len)
+{
+    st_label_t *l;
+
+    if(len > UINT32_MAX)
+    {
+        ST_WARNING("Too long label[%zu].", len);
+        return -1;
+    }
+
+    if(st_alphabet_reserve_buf(alphabet, len + 1) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_reserve_buf.");
+        return -1;
+    }
+
+    l = alphabet->labels + id;
+    l->offset = alphabet->label_buf_len;
+    l->len = (uint32_t)len;
+    l->symid = alphabet->base_num + id;
+
+    memcpy(alphabet->label_buf + alphabet->label_buf_len, label, len);
+    alphabet->label_buf[alphabet->label_buf_len + len] = '\0';
+    alphabet->label_buf_len += len + 1;
+
+    return 0;
+}
+
+/* the alphabet in the base chain storing label id. */
+static inline st_alphabet_t* st_alphabet_owner(st_alphabet_t *alphabet,
+        int id)
+{
+    while(id < alphabet->base_num)
+    {
+        alphabet = alphabet->base;
+    }
 
     return alphabet;
 }
 
+static inline st_label_t* st_alphabet_label(st_alphabet_t *owner, int id)
+{
+    return owner->labels + (id - owner->base_num);
+}
+
 typedef struct _index_dict_eq_args_t_ {
     st_alphabet_t *alphabet;
     const char *label;
+    size_t len;
 } index_dict_eq_args_t;
 
 static bool index_dict_node_eq(st_dict_node_t *node1,
@@ -99,344 +369,2677 @@ static bool index_dict_node_eq(st_dict_node_t *node1,
 {
     index_dict_eq_args_t *arg;
     st_alphabet_t *alphabet;
+    st_label_t *l;
 
     if (node1->sign1 != node2->sign1 || node1->sign2 != node2->sign2) {
         return false;
     }
 
+    /* called without args by st_dict internals, e.g. on rehash. */
+    if (args == NULL) {
+        return true;
+    }
+
     arg = (index_dict_eq_args_t *)args;
     alphabet = arg->alphabet;
 
-    if (alphabet == NULL) {
-        ST_WARNING("alphabet == NULL.");
+    if (node1->uint1 >= alphabet->label_num) {
+        ST_WARNING("node->uint1 overflow[%u/%u].", node1->uint1, alphabet->label_num);
         return false;
     }
 
-    if (node1->uint1 >= alphabet->label_num) {
-        ST_WARNING("node->uint1 overflow[%u/%u].", node1->uint1, alphabet->label_num);
+    l = alphabet->labels + node1->uint1;
+    if (l->len != arg->len) {
         return false;
     }
 
-    return (strncmp(alphabet->labels[node1->uint1].label, arg->label, MAX_SYM_LEN) == 0);
+    if (arg->len <= ST_ALPHABET_INLINE_LEN) {
+        return true;
+    }
+
+    return (memcmp(alphabet->label_buf + l->offset, arg->label,
+                arg->len) == 0);
 }
 
-st_alphabet_t* st_alphabet_create(int max_label_num)
+/*
+ * hash_num for an index_dict of label_num labels. st_dict_create rounds
+ * hash_num down to a power of two, so ask for just under twice as many
+ * to keep the load factor of a full index within 1.
+ */
+static st_dict_id_t st_alphabet_index_hash_num(int label_num)
 {
-    st_alphabet_t *alphabet = NULL;
-    int i;
-
-    ST_CHECK_PARAM(max_label_num <= 0, NULL);
+    return 2 * (st_dict_id_t)max(label_num, 1) - 1;
+}
 
-    alphabet = st_alphabet_alloc();
-    if(alphabet == NULL)
+/*
+ * Let index_dict follow the labels: buckets double once the load factor
+ * is reached, and the node pool grows by max_label_num nodes, which
+ * doubles with the labels in st_alphabet_grow. A rehash left by loading
+ * is finished here, so that a loaded alphabet is only read by seeks.
+ */
+static int st_alphabet_index_growable(st_alphabet_t *alphabet)
+{
+    if(st_dict_set_rehash(alphabet->index_dict,
+                ST_ALPHABET_MAX_LOAD_FACTOR, 0) < 0)
     {
-        ST_WARNING("Failed to alphabet_alloc.");
-        goto ERR;
+        ST_WARNING("Failed to st_dict_set_rehash.");
+        return -1;
     }
+    if(st_dict_rehash_finish(alphabet->index_dict) < 0)
+    {
+        ST_WARNING("Failed to st_dict_rehash_finish.");
+        return -1;
+    }
+    alphabet->index_dict->realloc_node_num = max(alphabet->max_label_num,
+            ST_ALPHABET_MIN_LABEL_NUM);
 
-    alphabet->max_label_num = max_label_num;
-    alphabet->labels = (st_label_t *)
-        malloc(max_label_num * sizeof(st_label_t));
-    if(alphabet->labels == NULL)
+    return 0;
+}
+
+static int st_alphabet_create_index(st_alphabet_t *alphabet)
+{
+    safe_st_dict_destroy(alphabet->index_dict);
+    if((alphabet->index_dict = st_dict_create(st_alphabet_index_hash_num(
+        max(alphabet->max_label_num, ST_ALPHABET_MIN_LABEL_NUM)),
+        ST_DICT_REALLOC_NUM, st_dict_hash_murmur, index_dict_node_eq,
+        false)) == NULL)
     {
-        ST_WARNING("Failed to allocate memory for labels.");
-        goto ERR;
+        ST_WARNING("Failed to alloc index_dict");
+        return -1;
     }
 
-    for(i = 0; i < max_label_num; i++)
+    return st_alphabet_index_growable(alphabet);
+}
+
+/* reset the entries [from, to) of labels and is_aux. */
+static void st_alphabet_clear_labels(st_alphabet_t *alphabet, int from,
+        int to)
+{
+    int i;
+
+    for(i = from; i < to; i++)
     {
+        alphabet->labels[i].offset = 0;
+        alphabet->labels[i].len = 0;
         alphabet->labels[i].symid = -1;
-        alphabet->labels[i].label[0] = 0;
+        alphabet->is_aux[i] = false;
     }
+}
+
+/*
+ * Set the capacity of labels and is_aux to max_label_num. New entries
+ * are reset only if clear is set, otherwise the caller fills each one
+ * before use.
+ */
+static int st_alphabet_resize(st_alphabet_t *alphabet, int max_label_num,
+        bool clear)
+{
+    st_label_t *labels;
+    bool *is_aux;
 
-    if((alphabet->index_dict = st_dict_create(max_label_num,
-        ST_DICT_REALLOC_NUM, NULL, index_dict_node_eq, false)) == NULL)
+    labels = (st_label_t *)st_alphabet_realloc_mem(alphabet,
+            alphabet->labels, alphabet->max_label_num * sizeof(st_label_t),
+            max_label_num * sizeof(st_label_t));
+    if(labels == NULL)
     {
-        ST_WARNING("Failed to alloc index_dict");
-        goto ERR;
+        ST_WARNING("Failed to realloc labels[%d].", max_label_num);
+        return -1;
     }
+    alphabet->labels = labels;
 
-    alphabet->is_aux = (bool *) malloc(max_label_num * sizeof(bool));
-    if(alphabet->is_aux == NULL)
+    is_aux = (bool *)st_alphabet_realloc_mem(alphabet, alphabet->is_aux,
+            alphabet->max_label_num * sizeof(bool),
+            max_label_num * sizeof(bool));
+    if(is_aux == NULL)
     {
-        ST_WARNING("Failed to allocate memory for is_aux.");
-        goto ERR;
+        ST_WARNING("Failed to realloc is_aux[%d].", max_label_num);
+        return -1;
     }
-    memset(alphabet->is_aux, 0, max_label_num * sizeof(bool));
+    alphabet->is_aux = is_aux;
 
-    return alphabet;
+    if(clear)
+    {
+        st_alphabet_clear_labels(alphabet, alphabet->max_label_num,
+                max_label_num);
+    }
+    alphabet->max_label_num = max_label_num;
+    alphabet->index_dict->realloc_node_num = max_label_num;
 
-ERR:
-    safe_st_alphabet_destroy(alphabet);
-    return NULL;
+    return 0;
 }
 
-int st_alphabet_add_label(st_alphabet_t *alphabet, const char *label_)
+/* double the capacity of labels and is_aux. */
+static int st_alphabet_grow(st_alphabet_t *alphabet)
+{
+    if(alphabet->max_label_num >= INT_MAX / 2)
+    {
+        ST_WARNING("label overflow[%d]", alphabet->max_label_num);
+        return -1;
+    }
+
+    return st_alphabet_resize(alphabet, max(alphabet->max_label_num * 2,
+            ST_ALPHABET_MIN_LABEL_NUM), true);
+}
+
+/* add all labels into a new index_dict. */
+static int st_alphabet_build_index(st_alphabet_t *alphabet)
 {
     st_dict_node_t snode;
-    int ret = 0;
+    st_label_t *l;
+    int i;
 
-    if((ret = st_alphabet_get_index(alphabet, label_)) >= 0)
+    if(st_alphabet_create_index(alphabet) < 0)
     {
-        return ret;
+        ST_WARNING("Failed to st_alphabet_create_index.");
+        return -1;
     }
 
-    if(alphabet->max_label_num <= alphabet->label_num)
+    for(i = 0; i < alphabet->label_num; i++)
     {
-        ST_WARNING("label overflow[%d/%d]", alphabet->label_num,
-                alphabet->max_label_num);
-        return -1;
+        l = alphabet->labels + i;
+        get_sign(alphabet->label_buf + l->offset, l->len,
+                &snode.sign1, &snode.sign2);
+        snode.uint1 = i;
+        if(st_dict_add_no_seek(alphabet->index_dict, &snode) < 0)
+        {
+            ST_WARNING("Failed to add label[%d] into dict", i);
+            return -1;
+        }
     }
 
-    alphabet->labels[alphabet->label_num].symid = alphabet->label_num;
-    strncpy(alphabet->labels[alphabet->label_num].label, label_, MAX_SYM_LEN);
-    alphabet->labels[alphabet->label_num].label[MAX_SYM_LEN - 1] = 0;
+    return 0;
+}
 
-    get_sign((char *)label_, strlen(label_), &snode.sign1, &snode.sign2);
-    snode.uint1 = alphabet->label_num;
+/*
+ * Copy on write: before alphabet is modified, the storage it shares with
+ * its dups becomes its base, and alphabet starts afresh as an empty
+ * overlay on it, as the dups did. Ids do not change and nothing is
+ * copied.
+ */
+static int st_alphabet_own_storage(st_alphabet_t *alphabet)
+{
+    st_alphabet_t *overlay;
+    st_alphabet_t *shared;
 
-    if(st_dict_add_no_seek(alphabet->index_dict, &snode) < 0)
+    if(alphabet->shared == NULL)
     {
-        ST_WARNING("Failed to add label[%s] into dict", label_);
+        return 0;
+    }
+    shared = alphabet->shared;
+
+    overlay = st_alphabet_create_in(0, alphabet->mem_arena);
+    if(overlay == NULL)
+    {
+        ST_WARNING("Failed to st_alphabet_create_in.");
         return -1;
     }
 
-    if(label_[0] == '#')
+    /* the reference to shared is taken over as the one to the base. */
+    overlay->base = shared;
+    overlay->base_num = shared->base_num + shared->label_num;
+    overlay->unk_id = alphabet->unk_id;
+    overlay->trie = alphabet->trie;
+    if(!st_alphabet_trie_owned(alphabet))
     {
-        alphabet->is_aux[alphabet->label_num] = true;
-        alphabet->aux_num++;
+        overlay->trie = shared->trie;
     }
 
-    alphabet->label_num++;
-    return alphabet->label_num - 1;
+    /* shared holds a reference to the base of alphabet of its own. */
+    if(alphabet->base != NULL)
+    {
+        (void)__atomic_sub_fetch(&alphabet->base->ref, 1, __ATOMIC_ACQ_REL);
+    }
+
+    *alphabet = *overlay;
+    safe_free(overlay);
+
+    return 0;
 }
 
-int st_alphabet_get_label_num(st_alphabet_t *alphabet)
+/*
+ * Concurrent mode.
+ *
+ * A slot of conc_slots keeps a tag taken from the hash of its label in
+ * the high 32 bits and the id in the low 32 bits, 0 being an empty slot.
+ * An adder claims an empty slot by CAS to ST_ALPHABET_SLOT_PENDING, takes
+ * arena space and an id by fetch-add, writes the label and publishes the
+ * id into the slot with a release store. Only the claimer of a slot takes
+ * an id, the other adders of the label wait for it and return the same.
+ */
+#define ST_ALPHABET_SLOT_PENDING 0xFFFFFFFFU
+/* the claimer of the slot ran out of space, the label is not added. */
+#define ST_ALPHABET_SLOT_DEAD    0xFFFFFFFEU
+
+/* default capacity of labels in concurrent mode. */
+#define ST_ALPHABET_CONC_LABEL_NUM (1 << 20)
+/* default arena bytes per label in concurrent mode. */
+#define ST_ALPHABET_CONC_LABEL_LEN 32
+/* spins on a pending slot before yielding the cpu. */
+#define ST_ALPHABET_CONC_SPIN 64
+
+static inline uint64_t conc_hash(const char *label, size_t len)
 {
-    ST_CHECK_PARAM(alphabet == NULL, -1);
+    st_dict_sign_t sign1;
+    st_dict_sign_t sign2;
+    uint64_t h;
+
+    get_sign(label, len, &sign1, &sign2);
+    h = ((uint64_t)sign2 << 32) | sign1;
 
-    return alphabet->label_num;
+    /* finalizer of MurmurHash3, short labels are their own signs. */
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
 }
 
-char *st_alphabet_get_label(st_alphabet_t *alphabet, int index)
+/* never 0, so a claimed slot is never empty. */
+static inline uint32_t conc_tag(uint64_t h)
 {
-    ST_CHECK_PARAM_EX(alphabet == NULL || index < 0
-        || index > alphabet->label_num, NULL, "%d/%d", index,
-        alphabet->label_num);
-
-    return alphabet->labels[index].label;
+    return (uint32_t)(h >> 32) | 1;
 }
 
-int st_alphabet_get_index(st_alphabet_t *alphabet, const char *label)
+static inline bool conc_label_eq(st_alphabet_t *alphabet, uint32_t id,
+        const char *label, size_t len)
 {
-    index_dict_eq_args_t arg;
-    st_dict_node_t snode;
+    st_label_t *l = alphabet->labels + id;
 
-    ST_CHECK_PARAM(alphabet == NULL || label == NULL, -1);
+    return l->len == len
+        && memcmp(alphabet->label_buf + l->offset, label, len) == 0;
+}
 
-    arg.alphabet = alphabet;
-    arg.label = label;
-    get_sign((char *)label, strlen(label), &snode.sign1, &snode.sign2);
-    if(st_dict_seek(alphabet->index_dict, &snode, &arg) < 0)
+static int st_alphabet_conc_seek(st_alphabet_t *alphabet,
+        const char *label, size_t len)
+{
+    uint64_t h;
+    uint64_t i;
+    uint64_t n;
+    uint64_t slot;
+    uint32_t tag;
+    uint32_t state;
+
+    h = conc_hash(label, len);
+    tag = conc_tag(h);
+    for(n = 0, i = h & alphabet->conc_mask; n <= alphabet->conc_mask;
+            n++, i = (i + 1) & alphabet->conc_mask)
     {
-        return -1;
+        slot = __atomic_load_n(alphabet->conc_slots + i, __ATOMIC_ACQUIRE);
+        if(slot == 0)
+        {
+            return -1;
+        }
+        if((uint32_t)(slot >> 32) != tag)
+        {
+            continue;
+        }
+
+        /* a pending label is not added yet. */
+        state = (uint32_t)slot;
+        if(state < ST_ALPHABET_SLOT_DEAD
+                && conc_label_eq(alphabet, state, label, len))
+        {
+            return (int)state;
+        }
     }
 
-    return (int)snode.uint1;
+    return -1;
 }
 
-int st_alphabet_save_bin(st_alphabet_t *alphabet, FILE *fp)
+/* store label under a new id, then publish the id into the claimed slot. */
+static int st_alphabet_conc_publish(st_alphabet_t *alphabet,
+        uint64_t *slot, uint32_t tag, const char *label, size_t len)
 {
-    int ret = 0;
+    st_label_t *l;
+    size_t offset;
+    uint32_t state;
+    int id;
+
+    state = ST_ALPHABET_SLOT_DEAD;
+    if(len > UINT32_MAX)
+    {
+        ST_WARNING("Too long label[%zu].", len);
+        goto PUBLISH;
+    }
+
+    offset = __atomic_fetch_add(&alphabet->label_buf_len, len + 1,
+            __ATOMIC_RELAXED);
+    if(offset + len + 1 > alphabet->label_buf_cap)
+    {
+        ST_WARNING("label_buf full[%zu].", alphabet->label_buf_cap);
+        if(offset < alphabet->label_buf_cap)
+        {
+            /* label_buf_len is cut back to here when stopping. */
+            memset(alphabet->label_buf + offset, 0,
+                    alphabet->label_buf_cap - offset);
+        }
+        goto PUBLISH;
+    }
+
+    id = __atomic_fetch_add(&alphabet->label_num, 1, __ATOMIC_RELAXED);
+    if(id >= alphabet->max_label_num)
+    {
+        ST_WARNING("labels full[%d].", alphabet->max_label_num);
+        /* the space is kept in label_buf, so it is saved as zeros. */
+        memset(alphabet->label_buf + offset, 0, len + 1);
+        goto PUBLISH;
+    }
+
+    memcpy(alphabet->label_buf + offset, label, len);
+    alphabet->label_buf[offset + len] = '\0';
+
+    l = alphabet->labels + id;
+    l->offset = offset;
+    l->len = (uint32_t)len;
+    l->symid = alphabet->base_num + id;
+
+    /* entries past the labels at start are not reset, see conc_start. */
+    alphabet->is_aux[id] = (label[0] == '#');
+    if(alphabet->is_aux[id])
+    {
+        (void)__atomic_fetch_add(&alphabet->aux_num, 1, __ATOMIC_RELAXED);
+    }
+    state = (uint32_t)id;
+
+PUBLISH:
+    __atomic_store_n(slot, ((uint64_t)tag << 32) | state, __ATOMIC_RELEASE);
+
+    return state == ST_ALPHABET_SLOT_DEAD ? -1 : (int)state;
+}
+
+static int st_alphabet_conc_add(st_alphabet_t *alphabet,
+        const char *label, size_t len)
+{
+    uint64_t h;
+    uint64_t i;
+    uint64_t n;
+    uint64_t slot;
+    uint32_t tag;
+    uint32_t state;
+    int spin;
+
+    h = conc_hash(label, len);
+    tag = conc_tag(h);
+    spin = 0;
+    for(n = 0, i = h & alphabet->conc_mask; n <= alphabet->conc_mask; )
+    {
+        slot = __atomic_load_n(alphabet->conc_slots + i, __ATOMIC_ACQUIRE);
+        if(slot == 0)
+        {
+            if(__atomic_compare_exchange_n(alphabet->conc_slots + i, &slot,
+                        ((uint64_t)tag << 32) | ST_ALPHABET_SLOT_PENDING,
+                        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                return st_alphabet_conc_publish(alphabet,
+                        alphabet->conc_slots + i, tag, label, len);
+            }
+            /* lost the slot, slot holds what the winner wrote. */
+        }
+
+        if((uint32_t)(slot >> 32) == tag)
+        {
+            state = (uint32_t)slot;
+            if(state == ST_ALPHABET_SLOT_PENDING)
+            {
+                if(++spin >= ST_ALPHABET_CONC_SPIN)
+                {
+                    sched_yield();
+                    spin = 0;
+                }
+                continue;
+            }
+            if(state != ST_ALPHABET_SLOT_DEAD
+                    && conc_label_eq(alphabet, state, label, len))
+            {
+                return (int)state;
+            }
+        }
+
+        n++;
+        i = (i + 1) & alphabet->conc_mask;
+    }
+
+    ST_WARNING("conc_slots full[%lu].",
+            (unsigned long)(alphabet->conc_mask + 1));
+    return -1;
+}
+
+static int st_alphabet_conc_start(st_alphabet_t *alphabet,
+        int max_label_num, size_t max_buf_len)
+{
+    st_label_t *l;
+    uint64_t slot_num;
+    uint64_t h;
+    uint64_t i;
+    int id;
+
+    if(alphabet->map_addr != NULL)
+    {
+        ST_WARNING("Can not add labels to a mapped alphabet.");
+        return -1;
+    }
+    if(st_alphabet_own_storage(alphabet) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_own_storage.");
+        return -1;
+    }
+
+    if(max_label_num == 0)
+    {
+        max_label_num = max(alphabet->label_num * 2,
+                ST_ALPHABET_CONC_LABEL_NUM);
+    }
+    max_label_num = max(max_label_num, alphabet->label_num);
+    if(max_buf_len == 0)
+    {
+        max_buf_len = alphabet->label_buf_len
+            + (size_t)(max_label_num - alphabet->label_num)
+            * ST_ALPHABET_CONC_LABEL_LEN;
+    }
+
+    /*
+     * New entries are not reset, st_alphabet_conc_publish fills each one
+     * as its id is handed out. So the capacity is not written up front,
+     * and the part never used is given back by st_alphabet_conc_stop.
+     */
+    if(max_label_num != alphabet->max_label_num)
+    {
+        if(st_alphabet_resize(alphabet, max_label_num, false) < 0)
+        {
+            ST_WARNING("Failed to st_alphabet_resize.");
+            return -1;
+        }
+    }
+    if(max_buf_len > alphabet->label_buf_len)
+    {
+        if(st_alphabet_reserve_buf(alphabet,
+                    max_buf_len - alphabet->label_buf_len) < 0)
+        {
+            ST_WARNING("Failed to st_alphabet_reserve_buf.");
+            return -1;
+        }
+    }
+
+    /* load factor at most 0.5. */
+    slot_num = ST_ALPHABET_MIN_LABEL_NUM;
+    while(slot_num < (uint64_t)alphabet->max_label_num * 2)
+    {
+        slot_num *= 2;
+    }
+    alphabet->conc_slots = (uint64_t *)calloc(slot_num, sizeof(uint64_t));
+    if(alphabet->conc_slots == NULL)
+    {
+        ST_WARNING("Failed to alloc conc_slots[%lu].",
+                (unsigned long)slot_num);
+        return -1;
+    }
+    alphabet->conc_mask = slot_num - 1;
+
+    for(id = 0; id < alphabet->label_num; id++)
+    {
+        l = alphabet->labels + id;
+        h = conc_hash(alphabet->label_buf + l->offset, l->len);
+        i = h & alphabet->conc_mask;
+        while(alphabet->conc_slots[i] != 0)
+        {
+            i = (i + 1) & alphabet->conc_mask;
+        }
+        alphabet->conc_slots[i] = ((uint64_t)conc_tag(h) << 32) | id;
+    }
+    alphabet->conc_base = alphabet->label_num;
+
+    return 0;
+}
+
+/*
+ * Give back the capacity left over by concurrent adds. The entries past
+ * label_num were never reset, so the ones kept are reset here. Memory of
+ * mem_arena is not given back, so it is left as it is.
+ */
+static int st_alphabet_conc_trim(st_alphabet_t *alphabet)
+{
+    char *buf;
+    size_t cap;
+    int max_label_num;
+
+    max_label_num = alphabet->max_label_num;
+    if(alphabet->mem_arena == NULL)
+    {
+        max_label_num = min(max_label_num,
+                max(alphabet->label_num, ST_ALPHABET_MIN_LABEL_NUM));
+    }
+    if(max_label_num < alphabet->max_label_num)
+    {
+        if(st_alphabet_resize(alphabet, max_label_num, false) < 0)
+        {
+            ST_WARNING("Failed to st_alphabet_resize.");
+            return -1;
+        }
+    }
+    st_alphabet_clear_labels(alphabet, alphabet->label_num, max_label_num);
+
+    cap = max(alphabet->label_buf_len, MAX_LINE_LEN);
+    if(alphabet->mem_arena == NULL && cap < alphabet->label_buf_cap)
+    {
+        buf = (char *)st_alphabet_realloc_mem(alphabet, alphabet->label_buf,
+                alphabet->label_buf_len, cap);
+        if(buf == NULL)
+        {
+            ST_WARNING("Failed to realloc label_buf[%zu].", cap);
+            return -1;
+        }
+        alphabet->label_buf = buf;
+        alphabet->label_buf_cap = cap;
+    }
+
+    return 0;
+}
+
+static int st_alphabet_conc_stop(st_alphabet_t *alphabet)
+{
+    st_dict_node_t snode;
+    st_label_t *l;
+    int i;
+
+    if(alphabet->conc_slots == NULL)
+    {
+        return 0;
+    }
+
+    /* counters pass the capacity when adds run out of space. */
+    alphabet->label_num = min(alphabet->label_num, alphabet->max_label_num);
+    alphabet->label_buf_len = min(alphabet->label_buf_len,
+            alphabet->label_buf_cap);
+    safe_free(alphabet->conc_slots);
+    alphabet->conc_mask = 0;
+
+    for(i = alphabet->conc_base; i < alphabet->label_num; i++)
+    {
+        l = alphabet->labels + i;
+        get_sign(alphabet->label_buf + l->offset, l->len,
+                &snode.sign1, &snode.sign2);
+        snode.uint1 = i;
+        if(st_dict_add_no_seek(alphabet->index_dict, &snode) < 0)
+        {
+            ST_WARNING("Failed to add label[%d] into dict", i);
+            return -1;
+        }
+    }
+    alphabet->conc_base = 0;
+
+    if(st_alphabet_conc_trim(alphabet) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_conc_trim.");
+        return -1;
+    }
+
+    return 0;
+}
+
+int st_alphabet_set_concurrent(st_alphabet_t *alphabet, bool concurrent,
+        int max_label_num, size_t max_buf_len)
+{
+    ST_CHECK_PARAM(alphabet == NULL || max_label_num < 0, -1);
+
+    if(!concurrent)
+    {
+        return st_alphabet_conc_stop(alphabet);
+    }
+
+    if(alphabet->conc_slots != NULL)
+    {
+        return 0;
+    }
+
+    st_alphabet_drop_trie(alphabet);
+    if(st_alphabet_conc_start(alphabet, max_label_num, max_buf_len) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_conc_start.");
+        safe_free(alphabet->conc_slots);
+        alphabet->conc_mask = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* look label up in the own labels of alphabet, not in its base. */
+static int st_alphabet_seek_own(st_alphabet_t *alphabet,
+        const char *label, size_t len)
+{
+    index_dict_eq_args_t arg;
+    st_dict_node_t snode;
+
+    if(alphabet->conc_slots != NULL)
+    {
+        return st_alphabet_conc_seek(alphabet, label, len);
+    }
+
+    if(alphabet->label_num == 0)
+    {
+        return -1;
+    }
+
+    arg.alphabet = alphabet;
+    arg.label = label;
+    arg.len = len;
+    get_sign(label, len, &snode.sign1, &snode.sign2);
+    if(st_dict_seek(alphabet->index_dict, &snode, &arg) < 0)
+    {
+        return -1;
+    }
+
+    return (int)snode.uint1;
+}
+
+static int st_alphabet_get_index_len(st_alphabet_t *alphabet,
+        const char *label, size_t len)
+{
+    int id;
+
+    for(; alphabet != NULL; alphabet = alphabet->base)
+    {
+        if((id = st_alphabet_seek_own(alphabet, label, len)) >= 0)
+        {
+            return alphabet->base_num + id;
+        }
+    }
+
+    return -1;
+}
+
+st_alphabet_t* st_alphabet_create(int max_label_num)
+{
+    return st_alphabet_create_in(max_label_num, NULL);
+}
+
+st_alphabet_t* st_alphabet_create_in(int max_label_num, st_arena_t *mem_arena)
+{
+    st_alphabet_t *alphabet = NULL;
+    int i;
+
+    ST_CHECK_PARAM(max_label_num < 0, NULL);
+
+    alphabet = st_alphabet_alloc();
+    if(alphabet == NULL)
+    {
+        ST_WARNING("Failed to alphabet_alloc.");
+        goto ERR;
+    }
+    alphabet->mem_arena = mem_arena;
+
+    max_label_num = max(max_label_num, ST_ALPHABET_MIN_LABEL_NUM);
+    alphabet->max_label_num = max_label_num;
+    alphabet->labels = (st_label_t *)st_alphabet_realloc_mem(alphabet,
+            NULL, 0, max_label_num * sizeof(st_label_t));
+    if(alphabet->labels == NULL)
+    {
+        ST_WARNING("Failed to allocate memory for labels.");
+        goto ERR;
+    }
+
+    for(i = 0; i < max_label_num; i++)
+    {
+        alphabet->labels[i].offset = 0;
+        alphabet->labels[i].len = 0;
+        alphabet->labels[i].symid = -1;
+    }
+
+    if(st_alphabet_reserve_buf(alphabet,
+                (size_t)max_label_num * ST_ALPHABET_AVG_LABEL_LEN) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_reserve_buf.");
+        goto ERR;
+    }
+
+    if(st_alphabet_create_index(alphabet) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_create_index.");
+        goto ERR;
+    }
+
+    alphabet->is_aux = (bool *)st_alphabet_realloc_mem(alphabet, NULL, 0,
+            max_label_num * sizeof(bool));
+    if(alphabet->is_aux == NULL)
+    {
+        ST_WARNING("Failed to allocate memory for is_aux.");
+        goto ERR;
+    }
+    memset(alphabet->is_aux, 0, max_label_num * sizeof(bool));
+
+    return alphabet;
+
+ERR:
+    safe_st_alphabet_destroy(alphabet);
+    return NULL;
+}
+
+int st_alphabet_add_label(st_alphabet_t *alphabet, const char *label_)
+{
+    st_dict_node_t snode;
+    size_t len;
+    int ret = 0;
+
+    ST_CHECK_PARAM(alphabet == NULL || label_ == NULL, -1);
+
+    len = strlen(label_);
+    if(alphabet->conc_slots != NULL)
+    {
+        /* the base is frozen, so it is read without lock as well. */
+        if(alphabet->base != NULL && (ret = st_alphabet_get_index_len(
+                        alphabet->base, label_, len)) >= 0)
+        {
+            return ret;
+        }
+        if((ret = st_alphabet_conc_add(alphabet, label_, len)) < 0)
+        {
+            return -1;
+        }
+        return alphabet->base_num + ret;
+    }
+
+    if((ret = st_alphabet_get_index_len(alphabet, label_, len)) >= 0)
+    {
+        return ret;
+    }
+
+    if(alphabet->map_addr != NULL)
+    {
+        ST_WARNING("Can not add label[%s] to a mapped alphabet.", label_);
+        return -1;
+    }
+
+    if(st_alphabet_own_storage(alphabet) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_own_storage.");
+        return -1;
+    }
+
+    /* the trie does not know the new label. */
+    st_alphabet_drop_trie(alphabet);
+
+    if(alphabet->max_label_num <= alphabet->label_num)
+    {
+        if(st_alphabet_grow(alphabet) < 0)
+        {
+            ST_WARNING("Failed to st_alphabet_grow.");
+            return -1;
+        }
+    }
+
+    if(st_alphabet_store_label(alphabet, alphabet->label_num,
+                label_, len) < 0)
+    {
+        ST_WARNING("Failed to store label[%s]", label_);
+        return -1;
+    }
+
+    get_sign(label_, len, &snode.sign1, &snode.sign2);
+    snode.uint1 = alphabet->label_num;
+
+    if(st_dict_add_no_seek(alphabet->index_dict, &snode) < 0)
+    {
+        ST_WARNING("Failed to add label[%s] into dict", label_);
+        return -1;
+    }
+
+    if(label_[0] == '#')
+    {
+        alphabet->is_aux[alphabet->label_num] = true;
+        alphabet->aux_num++;
+    }
+
+    alphabet->label_num++;
+    return alphabet->base_num + alphabet->label_num - 1;
+}
+
+int st_alphabet_get_label_num(st_alphabet_t *alphabet)
+{
+    ST_CHECK_PARAM(alphabet == NULL, -1);
+
+    /* label_num is bumped without lock in concurrent mode. */
+    return alphabet->base_num + min(__atomic_load_n(&alphabet->label_num,
+                __ATOMIC_RELAXED), alphabet->max_label_num);
+}
+
+char *st_alphabet_get_label(st_alphabet_t *alphabet, int index)
+{
+    ST_CHECK_PARAM_EX(alphabet == NULL || index < 0
+        || index >= st_alphabet_get_label_num(alphabet), NULL, "%d/%d",
+        index, st_alphabet_get_label_num(alphabet));
+
+    alphabet = st_alphabet_owner(alphabet, index);
+
+    return alphabet->label_buf + st_alphabet_label(alphabet, index)->offset;
+}
+
+int st_alphabet_get_index(st_alphabet_t *alphabet, const char *label)
+{
+    ST_CHECK_PARAM(alphabet == NULL || label == NULL, -1);
+
+    return st_alphabet_get_index_len(alphabet, label, strlen(label));
+}
+
+int st_alphabet_set_unk_id(st_alphabet_t *alphabet, int unk_id)
+{
+    ST_CHECK_PARAM(alphabet == NULL, -1);
+
+    alphabet->unk_id = unk_id;
+
+    return 0;
+}
+
+int st_alphabet_build_trie(st_alphabet_t *alphabet)
+{
+    const char **keys = NULL;
+    size_t *lens = NULL;
+    int *ids = NULL;
+    st_alphabet_t *owner;
+    st_label_t *l;
+    int n;
+    int m;
+    int i;
+
+    ST_CHECK_PARAM(alphabet == NULL, -1);
+
+    if(alphabet->conc_slots != NULL)
+    {
+        ST_WARNING("Can not build trie in concurrent mode.");
+        return -1;
+    }
+
+    n = st_alphabet_get_label_num(alphabet);
+    keys = (const char **)malloc(sizeof(const char *) * max(n, 1));
+    lens = (size_t *)malloc(sizeof(size_t) * max(n, 1));
+    ids = (int *)malloc(sizeof(int) * max(n, 1));
+    if(keys == NULL || lens == NULL || ids == NULL)
+    {
+        ST_WARNING("Failed to alloc memory.");
+        goto ERR;
+    }
+
+    /* a label loaded under several ids is found by its indexed one. */
+    m = 0;
+    for(i = 0; i < n; i++)
+    {
+        owner = st_alphabet_owner(alphabet, i);
+        l = st_alphabet_label(owner, i);
+        keys[m] = owner->label_buf + l->offset;
+        if(st_alphabet_get_index(alphabet, keys[m]) != i)
+        {
+            continue;
+        }
+        lens[m] = l->len;
+        ids[m] = i;
+        m++;
+    }
+
+    st_alphabet_drop_trie(alphabet);
+    alphabet->trie = st_datrie_build(keys, lens, ids, m);
+    if(alphabet->trie == NULL)
+    {
+        ST_WARNING("Failed to st_datrie_build.");
+        goto ERR;
+    }
+
+    safe_free(keys);
+    safe_free(lens);
+    safe_free(ids);
+    return 0;
+
+ERR:
+    safe_free(keys);
+    safe_free(lens);
+    safe_free(ids);
+    return -1;
+}
+
+int st_alphabet_longest_match(st_alphabet_t *alphabet, const char *str,
+        size_t len, size_t *match_len)
+{
+    ST_CHECK_PARAM(alphabet == NULL || str == NULL, -1);
+
+    if(alphabet->trie == NULL)
+    {
+        ST_WARNING("No trie, call st_alphabet_build_trie first.");
+        return -1;
+    }
+
+    return st_datrie_longest_prefix(alphabet->trie, str, len, match_len);
+}
+
+int st_alphabet_prefix_matches(st_alphabet_t *alphabet, const char *str,
+        size_t len, int *ids, size_t *match_lens, int cap)
+{
+    ST_CHECK_PARAM(alphabet == NULL || str == NULL, -1);
+
+    if(alphabet->trie == NULL)
+    {
+        ST_WARNING("No trie, call st_alphabet_build_trie first.");
+        return -1;
+    }
+
+    return st_datrie_common_prefix(alphabet->trie, str, len, ids,
+            match_lens, cap);
+}
+
+/* a standalone alphabet with the labels of alphabet and its bases. */
+static st_alphabet_t* st_alphabet_flatten(st_alphabet_t *alphabet)
+{
+    st_alphabet_t *flat = NULL;
+    st_alphabet_t *owner;
+    st_label_t *l;
+    int num;
+    int i;
+
+    num = st_alphabet_get_label_num(alphabet);
+    flat = st_alphabet_create(num);
+    if(flat == NULL)
+    {
+        ST_WARNING("Failed to st_alphabet_create.");
+        return NULL;
+    }
+
+    for(i = 0; i < num; i++)
+    {
+        owner = st_alphabet_owner(alphabet, i);
+        l = st_alphabet_label(owner, i);
+        if(st_alphabet_store_label(flat, i, owner->label_buf + l->offset,
+                    l->len) < 0)
+        {
+            ST_WARNING("Failed to store label[%d]", i);
+            goto ERR;
+        }
+        flat->is_aux[i] = owner->is_aux[i - owner->base_num];
+        if(flat->is_aux[i])
+        {
+            flat->aux_num++;
+        }
+    }
+    flat->label_num = num;
+    flat->unk_id = alphabet->unk_id;
+
+    if(st_alphabet_build_index(flat) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_build_index.");
+        goto ERR;
+    }
+
+    return flat;
+
+ERR:
+    safe_st_alphabet_destroy(flat);
+    return NULL;
+}
+
+/* give alphabet its own copy of all labels and leave its base. */
+static int st_alphabet_unshare(st_alphabet_t *alphabet)
+{
+    st_alphabet_t *flat;
+
+    flat = st_alphabet_flatten(alphabet);
+    if(flat == NULL)
+    {
+        ST_WARNING("Failed to st_alphabet_flatten.");
+        return -1;
+    }
+
+    /* ids do not change. */
+    if(st_alphabet_trie_owned(alphabet))
+    {
+        flat->trie = alphabet->trie;
+        alphabet->trie = NULL;
+    }
+
+    st_alphabet_destroy(alphabet);
+    *alphabet = *flat;
+    safe_free(flat);
+
+    return 0;
+}
+
+typedef struct _count_cmp_args_t_ {
+    const uint64_t *counts;
+} count_cmp_args_t;
+
+/* descending count, then ascending id. */
+static int count_cmp(const void *elem1, const void *elem2, void *args)
+{
+    const uint64_t *counts = ((count_cmp_args_t *)args)->counts;
+    int id1 = *(const int *)elem1;
+    int id2 = *(const int *)elem2;
+
+    if(counts[id1] != counts[id2])
+    {
+        return counts[id1] > counts[id2] ? -1 : 1;
+    }
+
+    return id1 < id2 ? -1 : (id1 > id2 ? 1 : 0);
+}
+
+int st_alphabet_sort_by_count(st_alphabet_t *alphabet,
+        const uint64_t *counts, int *old2new)
+{
+    count_cmp_args_t args;
+    st_alphabet_t sorted;
+    st_label_t *labels = NULL;
+    char *label_buf = NULL;
+    bool *is_aux = NULL;
+    int *order = NULL;
+    st_label_t *l;
+    size_t offset;
+    int i;
+
+    ST_CHECK_PARAM(alphabet == NULL || counts == NULL, -1);
+
+    if(alphabet->map_addr != NULL || alphabet->conc_slots != NULL)
+    {
+        ST_WARNING("Can not sort a mapped or concurrent alphabet.");
+        return -1;
+    }
+
+    /* renumbering needs a private copy of all labels. */
+    if((alphabet->base != NULL || alphabet->shared != NULL)
+            && st_alphabet_unshare(alphabet) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_unshare.");
+        return -1;
+    }
+
+    order = (int *)malloc(sizeof(int) * max(alphabet->label_num, 1));
+    labels = (st_label_t *)st_alphabet_realloc_mem(alphabet, NULL, 0,
+            sizeof(st_label_t) * alphabet->max_label_num);
+    label_buf = (char *)st_alphabet_realloc_mem(alphabet, NULL, 0,
+            max(alphabet->label_buf_cap, 1));
+    is_aux = (bool *)st_alphabet_realloc_mem(alphabet, NULL, 0,
+            sizeof(bool) * alphabet->max_label_num);
+    if(order == NULL || labels == NULL || label_buf == NULL
+            || is_aux == NULL)
+    {
+        ST_WARNING("Failed to alloc memory.");
+        goto ERR;
+    }
+
+    for(i = 0; i < alphabet->label_num; i++)
+    {
+        order[i] = i;
+    }
+    args.counts = counts;
+    st_qsort(order, alphabet->label_num, sizeof(int), count_cmp, &args);
+
+    /* labels of small ids also go first in the arena. */
+    offset = 0;
+    for(i = 0; i < alphabet->label_num; i++)
+    {
+        l = alphabet->labels + order[i];
+        memcpy(label_buf + offset, alphabet->label_buf + l->offset,
+                l->len + 1);
+        labels[i].offset = offset;
+        labels[i].len = l->len;
+        labels[i].symid = i;
+        is_aux[i] = alphabet->is_aux[order[i]];
+        offset += l->len + 1;
+    }
+    for(; i < alphabet->max_label_num; i++)
+    {
+        labels[i].offset = 0;
+        labels[i].len = 0;
+        labels[i].symid = -1;
+        is_aux[i] = false;
+    }
+
+    /*
+     * Index the new order in a view of alphabet first, so that a failure
+     * leaves alphabet as it was. Nodes of frequent labels are allocated
+     * first as well.
+     */
+    sorted = *alphabet;
+    sorted.labels = labels;
+    sorted.label_buf = label_buf;
+    sorted.label_buf_len = offset;
+    sorted.is_aux = is_aux;
+    sorted.index_dict = NULL;
+    if(st_alphabet_build_index(&sorted) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_build_index.");
+        safe_st_dict_destroy(sorted.index_dict);
+        goto ERR;
+    }
+
+    if(alphabet->unk_id >= 0 && alphabet->unk_id < alphabet->label_num)
+    {
+        for(i = 0; i < alphabet->label_num; i++)
+        {
+            if(order[i] == alphabet->unk_id)
+            {
+                alphabet->unk_id = i;
+                break;
+            }
+        }
+    }
+
+    if(old2new != NULL)
+    {
+        for(i = 0; i < alphabet->label_num; i++)
+        {
+            old2new[order[i]] = i;
+        }
+    }
+
+    st_alphabet_free_mem(alphabet, alphabet->labels);
+    alphabet->labels = labels;
+    st_alphabet_free_mem(alphabet, alphabet->label_buf);
+    alphabet->label_buf = label_buf;
+    alphabet->label_buf_len = offset;
+    st_alphabet_free_mem(alphabet, alphabet->is_aux);
+    alphabet->is_aux = is_aux;
+    safe_st_dict_destroy(alphabet->index_dict);
+    alphabet->index_dict = sorted.index_dict;
+    safe_free(order);
+    st_alphabet_drop_trie(alphabet);
+
+    return 0;
+
+ERR:
+    safe_free(order);
+    st_alphabet_free_mem(alphabet, labels);
+    st_alphabet_free_mem(alphabet, label_buf);
+    st_alphabet_free_mem(alphabet, is_aux);
+    return -1;
+}
+
+/* tokens looked up with one st_dict_seek_batch call. */
+#define ST_ALPHABET_LINE_BATCH 64
+
+static inline bool is_token_sep(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/*
+ * Find the first byte at or after p that is a separator (sep == true) or
+ * a token byte (sep == false), separators being the ones of
+ * get_next_token. Stops at the NUL either way.
+ *
+ * The SSE2 version reads aligned 16-byte blocks, which never cross a
+ * page, so bytes around the string may be read but are masked off.
+ */
+__attribute__((no_sanitize_address))
+static inline const char* scan_line(const char *p, bool sep)
+{
+#ifdef __SSE2__
+    const __m128i *block;
+    __m128i group;
+    __m128i m_sep;
+    unsigned int mask;
+    unsigned int nul;
+
+    block = (const __m128i *)((uintptr_t)p & ~(uintptr_t)15);
+    mask = ~0U << ((uintptr_t)p & 15);
+    for(;;)
+    {
+        group = _mm_load_si128(block);
+        m_sep = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(group, _mm_set1_epi8(' ')),
+                    _mm_cmpeq_epi8(group, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_cmpeq_epi8(group, _mm_set1_epi8('\r')),
+                    _mm_cmpeq_epi8(group, _mm_set1_epi8('\n'))));
+        nul = (unsigned int)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(group, _mm_setzero_si128()));
+        if(sep)
+        {
+            mask &= (unsigned int)_mm_movemask_epi8(m_sep) | nul;
+        }
+        else
+        {
+            mask &= ~(unsigned int)_mm_movemask_epi8(m_sep) & 0xFFFF;
+        }
+        if(mask != 0)
+        {
+            return (const char *)block + __builtin_ctz(mask);
+        }
+        block++;
+        mask = ~0U;
+    }
+#else
+    while(*p != '\0' && is_token_sep(*p) != sep)
+    {
+        p++;
+    }
+
+    return p;
+#endif
+}
+
+/*
+ * resolve n tokens, hashed into nodes, into ids. Tokens missing from the
+ * own labels are resolved by the base in one more batch, tokens missing
+ * from the whole chain get unk_id.
+ */
+static int st_alphabet_resolve_batch(st_alphabet_t *alphabet,
+        st_dict_node_t *nodes, const char **toks, size_t *lens,
+        int n, int *ids, int unk_id)
+{
+    unsigned char found[(ST_ALPHABET_LINE_BATCH + 7) / 8];
+    st_dict_node_t miss_nodes[ST_ALPHABET_LINE_BATCH];
+    const char *miss_toks[ST_ALPHABET_LINE_BATCH];
+    size_t miss_lens[ST_ALPHABET_LINE_BATCH];
+    int miss_ids[ST_ALPHABET_LINE_BATCH];
+    int miss_pos[ST_ALPHABET_LINE_BATCH];
+    st_label_t *l;
+    int m;
+    int i;
+
+    /* an empty overlay, as left by st_alphabet_dup. */
+    if(alphabet->label_num == 0 && alphabet->base != NULL)
+    {
+        return st_alphabet_resolve_batch(alphabet->base, nodes, toks, lens,
+                n, ids, unk_id);
+    }
+
+    if(alphabet->label_num == 0)
+    {
+        memset(found, 0, sizeof(found));
+    }
+    else if(st_dict_seek_batch(alphabet->index_dict, nodes, n, found) < 0)
+    {
+        ST_WARNING("Failed to st_dict_seek_batch.");
+        return -1;
+    }
+
+    m = 0;
+    for(i = 0; i < n; i++)
+    {
+        if(!(found[i / 8] & (1 << (i % 8))))
+        {
+            if(alphabet->base == NULL)
+            {
+                ids[i] = unk_id;
+                continue;
+            }
+            miss_nodes[m] = nodes[i];
+            miss_toks[m] = toks[i];
+            miss_lens[m] = lens[i];
+            miss_pos[m] = i;
+            m++;
+            continue;
+        }
+
+        /* seek_batch matches signs only, check the label itself. */
+        l = alphabet->labels + nodes[i].uint1;
+        if(l->len == lens[i] && (lens[i] <= ST_ALPHABET_INLINE_LEN
+                    || memcmp(alphabet->label_buf + l->offset, toks[i],
+                        lens[i]) == 0))
+        {
+            ids[i] = alphabet->base_num + (int)nodes[i].uint1;
+            continue;
+        }
+
+        ids[i] = st_alphabet_get_index_len(alphabet, toks[i], lens[i]);
+        if(ids[i] < 0)
+        {
+            ids[i] = unk_id;
+        }
+    }
+
+    if(m > 0)
+    {
+        if(st_alphabet_resolve_batch(alphabet->base, miss_nodes, miss_toks,
+                    miss_lens, m, miss_ids, unk_id) < 0)
+        {
+            ST_WARNING("Failed to st_alphabet_resolve_batch.");
+            return -1;
+        }
+        for(i = 0; i < m; i++)
+        {
+            ids[miss_pos[i]] = miss_ids[i];
+        }
+    }
+
+    return 0;
+}
+
+int st_alphabet_line_to_ids(st_alphabet_t *alphabet, const char *line,
+        int *ids, int cap)
+{
+    st_dict_node_t nodes[ST_ALPHABET_LINE_BATCH];
+    const char *toks[ST_ALPHABET_LINE_BATCH];
+    size_t lens[ST_ALPHABET_LINE_BATCH];
+    const char *p;
+    const char *end;
+    int num;
+    int n;
+
+    ST_CHECK_PARAM(alphabet == NULL || line == NULL || cap < 0
+            || (cap > 0 && ids == NULL), -1);
+
+    num = 0;
+    n = 0;
+    p = scan_line(line, false);
+    while(*p != '\0')
+    {
+        end = scan_line(p, true);
+        if(num < cap && alphabet->conc_slots != NULL)
+        {
+            ids[num] = st_alphabet_get_index_len(alphabet, p, end - p);
+            if(ids[num] < 0)
+            {
+                ids[num] = alphabet->unk_id;
+            }
+        }
+        else if(num < cap)
+        {
+            toks[n] = p;
+            lens[n] = end - p;
+            get_sign(p, lens[n], &nodes[n].sign1, &nodes[n].sign2);
+            n++;
+            if(n >= ST_ALPHABET_LINE_BATCH)
+            {
+                if(st_alphabet_resolve_batch(alphabet, nodes, toks, lens,
+                            n, ids + num - n + 1, alphabet->unk_id) < 0)
+                {
+                    ST_WARNING("Failed to st_alphabet_resolve_batch.");
+                    return -1;
+                }
+                n = 0;
+            }
+        }
+        num++;
+        p = scan_line(end, false);
+    }
+
+    if(n > 0)
+    {
+        if(st_alphabet_resolve_batch(alphabet, nodes, toks, lens, n,
+                    ids + min(num, cap) - n, alphabet->unk_id) < 0)
+        {
+            ST_WARNING("Failed to st_alphabet_resolve_batch.");
+            return -1;
+        }
+    }
+
+    return num;
+}
+
+static inline uint64_t st_alphabet_align(uint64_t off)
+{
+    return (off + ST_ALPHABET_ALIGN - 1) & ~((uint64_t)ST_ALPHABET_ALIGN - 1);
+}
+
+static int st_alphabet_write_pad(FILE *fp, size_t n)
+{
+    char buf[256];
+    size_t sz;
+
+    memset(buf, 0, sizeof(buf));
+    while(n > 0)
+    {
+        sz = min(n, sizeof(buf));
+        if(fwrite(buf, 1, sz, fp) != sz)
+        {
+            return -1;
+        }
+        n -= sz;
+    }
+
+    return 0;
+}
+
+static int st_alphabet_skip(FILE *fp, size_t n)
+{
+    char buf[256];
+    size_t sz;
+
+    while(n > 0)
+    {
+        sz = min(n, sizeof(buf));
+        if(fread(buf, 1, sz, fp) != sz)
+        {
+            return -1;
+        }
+        n -= sz;
+    }
+
+    return 0;
+}
+
+/*
+ * Binary layout:
+ *
+ *   st_alphabet_header_t
+ *   padding to ST_ALPHABET_ALIGN
+ *   labels[label_num]
+ *   padding to ST_ALPHABET_ALIGN
+ *   label_buf[label_buf_len]
+ *   padding to ST_ALPHABET_ALIGN
+ *   is_aux[label_num]
+ *   padding to ST_ALPHABET_ALIGN
+ *   index_dict, by st_dict_save
+ *
+ * As in st_dict_save, padding is computed against the file position, so
+ * every section is page aligned whenever the stream is seekable, and
+ * st_alphabet_mmap serves them from the file as they are.
+ */
+int st_alphabet_save_bin(st_alphabet_t *alphabet, FILE *fp)
+{
+    st_alphabet_header_t header;
+    long pos;
+    int ret = 0;
+
+    ST_CHECK_PARAM(alphabet == NULL || fp == NULL, -1);
+
+    if (alphabet->conc_slots != NULL) {
+        ST_WARNING("Can not save alphabet in concurrent mode.");
+        return -1;
+    }
+
+    if (alphabet->base != NULL) {
+        st_alphabet_t *flat = st_alphabet_flatten(alphabet);
+
+        if (flat == NULL) {
+            ST_WARNING("Failed to st_alphabet_flatten.");
+            return -1;
+        }
+        ret = st_alphabet_save_bin(flat, fp);
+        safe_st_alphabet_destroy(flat);
+        return ret;
+    }
+
+    pos = ftell(fp);
+    if(pos < 0)
+    {
+        pos = 0;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = ST_ALPHABET_MAGIC;
+    header.version = ST_ALPHABET_VERSION;
+    header.label_num = alphabet->label_num;
+    header.aux_num = alphabet->aux_num;
+    header.label_buf_len = alphabet->label_buf_len;
+    header.labels_offset = st_alphabet_align(pos + sizeof(header)) - pos;
+    header.label_buf_offset = st_alphabet_align(pos + header.labels_offset
+            + sizeof(st_label_t) * (uint64_t)alphabet->label_num) - pos;
+    header.is_aux_offset = st_alphabet_align(pos + header.label_buf_offset
+            + alphabet->label_buf_len) - pos;
+    header.dict_offset = st_alphabet_align(pos + header.is_aux_offset
+            + sizeof(bool) * (uint64_t)alphabet->label_num) - pos;
+
+    if(fwrite(&header, sizeof(header), 1, fp) != 1) {
+        ST_WARNING("Failed to write header");
+        return -1;
+    }
+
+    if(st_alphabet_write_pad(fp, header.labels_offset - sizeof(header)) < 0) {
+        ST_WARNING("Failed to write padding");
+        return -1;
+    }
+
+    ret = fwrite(alphabet->labels, sizeof(st_label_t),
+        alphabet->label_num, fp);
+    if(ret != alphabet->label_num) {
+        ST_WARNING("Failed to write labels");
+        return -1;
+    }
+
+    if(st_alphabet_write_pad(fp, header.label_buf_offset
+                - header.labels_offset
+                - sizeof(st_label_t) * alphabet->label_num) < 0) {
+        ST_WARNING("Failed to write padding");
+        return -1;
+    }
+
+    if(fwrite(alphabet->label_buf, sizeof(char), alphabet->label_buf_len,
+                fp) != alphabet->label_buf_len) {
+        ST_WARNING("Failed to write label_buf");
+        return -1;
+    }
+
+    if(st_alphabet_write_pad(fp, header.is_aux_offset
+                - header.label_buf_offset - alphabet->label_buf_len) < 0) {
+        ST_WARNING("Failed to write padding");
+        return -1;
+    }
+
+    ret = fwrite(alphabet->is_aux, sizeof(bool), alphabet->label_num, fp);
+    if(ret != alphabet->label_num) {
+        ST_WARNING("Failed to write is_aux");
+        return -1;
+    }
+
+    if(st_alphabet_write_pad(fp, header.dict_offset - header.is_aux_offset
+                - sizeof(bool) * alphabet->label_num) < 0) {
+        ST_WARNING("Failed to write padding");
+        return -1;
+    }
+
+    if(st_dict_save(alphabet->index_dict, fp) < 0) {
+        ST_WARNING("Failed to save index_dict");
+        return -1;
+    }
+
+    return 0;
+}
+
+int st_alphabet_save_txt(st_alphabet_t *alphabet, FILE *fp)
+{
+    st_alphabet_t *owner;
+    st_label_t *l;
+    int num;
+    int i;
+
+    ST_CHECK_PARAM(alphabet == NULL || fp == NULL, -1);
+
+    num = st_alphabet_get_label_num(alphabet);
+    if (fprintf(fp, SYM_NUM " = %d\n", num) < 0) {
+        ST_WARNING("Failed to fprintf header.");
+        return -1;
+    }
+    for(i = 0; i < num; i++) {
+        owner = st_alphabet_owner(alphabet, i);
+        l = st_alphabet_label(owner, i);
+        if(l->symid != -1) {
+            if (fprintf(fp, "%s\t%d\n", owner->label_buf + l->offset,
+                        l->symid) < 0) {
+                ST_WARNING("Failed to fprintf sym[%d]", i);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Split a "<label> <id>" line in [line, end). Same as
+ * sscanf(line, "%s %d"), except the label is not copied and has no
+ * length limit, and negative ids are rejected.
+ */
+static int parse_sym_line(const char *line, const char *end,
+        const char **sym, size_t *len, int *id)
+{
+    const char *p;
+    bool neg = false;
+    long l = 0;
+
+    p = line;
+    while(p < end && isspace((unsigned char)*p))
+    {
+        p++;
+    }
+    if(p >= end)
+    {
+        return -1;
+    }
+
+    *sym = p;
+    while(p < end && !isspace((unsigned char)*p))
+    {
+        p++;
+    }
+    *len = p - *sym;
+
+    while(p < end && isspace((unsigned char)*p))
+    {
+        p++;
+    }
+    if(p < end && (*p == '+' || *p == '-'))
+    {
+        neg = (*p == '-');
+        p++;
+    }
+    if(p >= end || !isdigit((unsigned char)*p))
+    {
+        return -1;
+    }
+    while(p < end && isdigit((unsigned char)*p))
+    {
+        l = l * 10 + (*p - '0');
+        if(l > INT_MAX)
+        {
+            return -1;
+        }
+        p++;
+    }
+    if(neg && l != 0)
+    {
+        return -1;
+    }
+    *id = (int)l;
+
+    return 0;
+}
+
+/* parse the "symbols = N" header. */
+static int parse_sym_header(const char *line)
+{
+    const char *pstr;
+
+    pstr = strchr(line, '=');
+    if(pstr == NULL || strncmp(line, SYM_NUM, strlen(SYM_NUM)) != 0)
+    {
+        ST_WARNING("Wrong esym format: no symbols num.");
+        return -1;
+    }
+
+    return atoi(pstr + 1);
+}
+
+int st_alphabet_load_txt(st_alphabet_t *alphabet, FILE *fp)
+{
+    char *line = NULL;
+    size_t line_sz = 0;
+    index_dict_eq_args_t arg;
+    st_dict_node_t snode;
+    const char *syms;
+    size_t len;
+    int id;
+    int i;
+
+    int label_num;
+
+    ST_CHECK_PARAM(alphabet == NULL || fp == NULL, -1);
+
+    if(st_fgets(&line, &line_sz, fp, NULL) == NULL)
+    {
+        ST_WARNING("Empty file.");
+        goto ERR;
+    }
+    label_num = parse_sym_header(line);
+    if(label_num <= 0)
+    {
+        ST_WARNING("Wrong esym format: wrong symbols num[%d].", label_num);
+        goto ERR;
+    }
+
+    alphabet->labels = (st_label_t *)malloc(label_num * sizeof(st_label_t));
+    if(alphabet->labels == NULL)
+    {
+        ST_WARNING("Failed to allocate memory for labels.");
+        goto ERR;
+    }
+
+    alphabet->is_aux = (bool *)malloc(label_num * sizeof(bool));
+    if(alphabet->is_aux == NULL)
+    {
+        ST_WARNING("Failed to allocate memory for is_aux.");
+        goto ERR;
+    }
+
+    for(i = 0; i < label_num; i++)
+    {
+        alphabet->labels[i].offset = 0;
+        alphabet->labels[i].len = 0;
+        alphabet->labels[i].symid = -1;
+        alphabet->is_aux[i] = false;
+    }
+    alphabet->max_label_num = label_num;
+    alphabet->label_num = label_num;
+    alphabet->aux_num = 0;
+
+    if(st_alphabet_create_index(alphabet) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_create_index.");
+        goto ERR;
+    }
+
+    i = 0;
+    while(st_fgets(&line, &line_sz, fp, NULL))
+    {
+        if(parse_sym_line(line, line + strlen(line), &syms, &len, &id) < 0)
+        {
+            continue;
+        }
+
+        if(id >= label_num)
+        {
+            ST_WARNING("Wrong id[%d]>=label_num[%d].", id, label_num);
+            goto ERR;
+        }
+
+        if(alphabet->labels[id].symid != -1)
+        {
+            ST_WARNING("Replicated symbol [%d:%.*s].", id, (int)len, syms);
+            goto ERR;
+        }
+
+        if(st_alphabet_store_label(alphabet, id, syms, len) < 0)
+        {
+            ST_WARNING("Failed to store symbol [%d:%.*s].",
+                    id, (int)len, syms);
+            goto ERR;
+        }
+
+        get_sign(syms, len, &snode.sign1, &snode.sign2);
+        snode.uint1 = (uint)id;
+        arg.alphabet = alphabet;
+        arg.label = syms;
+        arg.len = len;
+        st_dict_add(alphabet->index_dict, &snode, &arg);
+
+        if(syms[0] == '#')
+        {
+            alphabet->is_aux[id] = true;
+            alphabet->aux_num++;
+        }
+
+        i++;
+        if (i >= label_num) {
+            break;
+        }
+    }
+
+    for(i = 0; i < label_num; i++)
+    {
+        if(alphabet->labels[i].symid == -1)
+        {
+            ST_WARNING("Empty symbol for id[%d]", i);
+            goto ERR;
+        }
+    }
+
+    safe_free(line);
+    return 0;
+
+ERR:
+    safe_free(line);
+    return -1;
+}
+
+st_alphabet_t* st_alphabet_load_from_txt(FILE *fp)
+{
+    st_alphabet_t *alphabet;
+
+    ST_CHECK_PARAM(fp == NULL, NULL);
+
+    if((alphabet = st_alphabet_alloc()) == NULL)
+    {
+        ST_WARNING("Failed to st_alphabet_alloc.");
+        return NULL;
+    }
+
+    if(st_alphabet_load_txt(alphabet, fp) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_load_txt_fp.");
+        goto ERR;
+
+    }
+
+    return alphabet;
+ERR:
+    safe_st_alphabet_destroy(alphabet);
+    return NULL;
+}
+
+typedef struct _txt_sym_t {
+    const char *sym;
+    size_t len;
+    int id;
+} txt_sym_t;
+
+typedef struct _txt_chunk_t {
+    const char *start;
+    const char *end;
+
+    txt_sym_t *syms;
+    size_t sym_num;
+    size_t sym_cap;
+    size_t first;   /* index of syms[0] among all symbols of the file. */
+    size_t use_num; /* symbols kept, the loader stops at label_num. */
+
+    int aux_num;
+    int ret;
+} txt_chunk_t;
+
+typedef struct _txt_loader_t {
+    st_alphabet_t *alphabet;
+    txt_chunk_t *chunks;
+    st_dict_node_t *nodes;
+} txt_loader_t;
+
+typedef struct _txt_thread_arg_t {
+    txt_loader_t *loader;
+    int tid;
+} txt_thread_arg_t;
+
+static int txt_run_threads(void *(*func)(void *), txt_loader_t *loader,
+        int num_thread)
+{
+    pthread_t *pts = NULL;
+    txt_thread_arg_t *targs = NULL;
+    int n;
+    int i;
+
+    pts = (pthread_t *)malloc(sizeof(pthread_t) * num_thread);
+    targs = (txt_thread_arg_t *)malloc(sizeof(txt_thread_arg_t)
+            * num_thread);
+    if(pts == NULL || targs == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for threads.");
+        goto ERR;
+    }
+
+    for(n = 0; n < num_thread; n++)
+    {
+        targs[n].loader = loader;
+        targs[n].tid = n;
+        if(pthread_create(pts + n, NULL, func, targs + n) != 0)
+        {
+            ST_WARNING("Failed to pthread_create.");
+            for(i = 0; i < n; i++)
+            {
+                (void)pthread_join(pts[i], NULL);
+            }
+            goto ERR;
+        }
+    }
+
+    for(i = 0; i < num_thread; i++)
+    {
+        (void)pthread_join(pts[i], NULL);
+    }
+
+    safe_free(pts);
+    safe_free(targs);
+    return 0;
+
+ERR:
+    safe_free(pts);
+    safe_free(targs);
+    return -1;
+}
+
+/* pass 1: split lines of a chunk into label/id pairs. */
+static void* txt_parse_worker(void *arg)
+{
+    txt_thread_arg_t *targ = (txt_thread_arg_t *)arg;
+    txt_chunk_t *chunk = targ->loader->chunks + targ->tid;
+    txt_sym_t *syms;
+    const char *p;
+    const char *eol;
+    txt_sym_t sym;
+
+    p = chunk->start;
+    while(p < chunk->end)
+    {
+        eol = memchr(p, '\n', chunk->end - p);
+        if(eol == NULL)
+        {
+            eol = chunk->end;
+        }
+
+        if(parse_sym_line(p, eol, &sym.sym, &sym.len, &sym.id) == 0)
+        {
+            if(chunk->sym_num >= chunk->sym_cap)
+            {
+                chunk->sym_cap = max(chunk->sym_cap * 2, 1024);
+                syms = (txt_sym_t *)realloc(chunk->syms,
+                        chunk->sym_cap * sizeof(txt_sym_t));
+                if(syms == NULL)
+                {
+                    ST_WARNING("Failed to realloc syms.");
+                    chunk->ret = -1;
+                    return NULL;
+                }
+                chunk->syms = syms;
+            }
+            chunk->syms[chunk->sym_num++] = sym;
+        }
+
+        p = eol + 1;
+    }
+
+    return NULL;
+}
+
+/* pass 2: fill arena, is_aux and index nodes of the kept symbols. */
+static void* txt_fill_worker(void *arg)
+{
+    txt_thread_arg_t *targ = (txt_thread_arg_t *)arg;
+    txt_loader_t *loader = targ->loader;
+    txt_chunk_t *chunk = loader->chunks + targ->tid;
+    st_alphabet_t *alphabet = loader->alphabet;
+    st_dict_node_t *node;
+    txt_sym_t *sym;
+    char *dst;
+    size_t i;
+
+    for(i = 0; i < chunk->use_num; i++)
+    {
+        sym = chunk->syms + i;
+        dst = alphabet->label_buf + alphabet->labels[sym->id].offset;
+        memcpy(dst, sym->sym, sym->len);
+        dst[sym->len] = '\0';
+
+        node = loader->nodes + chunk->first + i;
+        get_sign(sym->sym, sym->len, &node->sign1, &node->sign2);
+        node->uint1 = sym->id;
+
+        if(sym->sym[0] == '#')
+        {
+            alphabet->is_aux[sym->id] = true;
+            chunk->aux_num++;
+        }
+    }
+
+    return NULL;
+}
+
+/* nodes of one bucket compared for duplicates, more give up. */
+#define TXT_DUP_CHAIN_LEN 16
+
+typedef struct _txt_dup_args_t {
+    st_alphabet_t *alphabet;
+    st_dict_id_t bucket;
+    st_dict_node_t *chain[TXT_DUP_CHAIN_LEN];
+    int chain_len;
+    bool dup;
+} txt_dup_args_t;
+
+/*
+ * pass 3: look for equal labels in every bucket. Nodes of a bucket are
+ * visited one after another, so only the current bucket is kept.
+ */
+static int txt_dup_trav(st_dict_node_t *node, void *args)
+{
+    txt_dup_args_t *dargs = (txt_dup_args_t *)args;
+    st_alphabet_t *alphabet = dargs->alphabet;
+    st_dict_t *wd = alphabet->index_dict;
+    st_label_t *l1;
+    st_label_t *l2;
+    st_dict_id_t bucket;
+    int i;
 
-    ST_CHECK_PARAM(alphabet == NULL || fp == NULL, -1);
+    if(dargs->dup)
+    {
+        return 0;
+    }
+
+    bucket = wd->hash_func(wd, node);
+    if(dargs->chain_len == 0 || bucket != dargs->bucket)
+    {
+        dargs->bucket = bucket;
+        dargs->chain_len = 0;
+    }
+
+    l1 = alphabet->labels + node->uint1;
+    for(i = 0; i < dargs->chain_len; i++)
+    {
+        l2 = alphabet->labels + dargs->chain[i]->uint1;
+        if(node->sign1 == dargs->chain[i]->sign1
+                && node->sign2 == dargs->chain[i]->sign2
+                && l1->len == l2->len
+                && memcmp(alphabet->label_buf + l1->offset,
+                    alphabet->label_buf + l2->offset, l1->len) == 0)
+        {
+            dargs->dup = true;
+            return 0;
+        }
+    }
+
+    if(dargs->chain_len >= TXT_DUP_CHAIN_LEN)
+    {
+        /* too long to check, let the caller rebuild serially. */
+        dargs->dup = true;
+        return 0;
+    }
+    dargs->chain[dargs->chain_len++] = node;
+
+    return 0;
+}
+
+/*
+ * Rebuild index_dict one label at a time in file order, so that the
+ * first of duplicated labels wins, as in st_alphabet_load_txt.
+ */
+static int txt_build_index_serial(txt_loader_t *loader, int num_thread)
+{
+    st_alphabet_t *alphabet = loader->alphabet;
+    index_dict_eq_args_t arg;
+    st_dict_node_t snode;
+    txt_chunk_t *chunk;
+    size_t i;
+    int t;
+
+    if(st_alphabet_create_index(alphabet) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_create_index.");
+        return -1;
+    }
+
+    arg.alphabet = alphabet;
+    for(t = 0; t < num_thread; t++)
+    {
+        chunk = loader->chunks + t;
+        for(i = 0; i < chunk->use_num; i++)
+        {
+            snode = loader->nodes[chunk->first + i];
+            arg.label = chunk->syms[i].sym;
+            arg.len = chunk->syms[i].len;
+            st_dict_add(alphabet->index_dict, &snode, &arg);
+        }
+    }
+
+    return 0;
+}
+
+static int st_alphabet_load_txt_mmap(st_alphabet_t *alphabet,
+        const char *data, size_t size, int num_thread)
+{
+    txt_loader_t loader;
+    txt_chunk_t *chunk;
+    txt_dup_args_t *dup_args = NULL;
+    void **dup_argv = NULL;
+    const char *body;
+    const char *p;
+    char *header = NULL;
+    size_t total;
+    size_t off;
+    size_t i;
+    int label_num;
+    int id;
+    int t;
+
+    memset(&loader, 0, sizeof(loader));
+    loader.alphabet = alphabet;
+
+    p = memchr(data, '\n', size);
+    body = (p == NULL) ? data + size : p + 1;
+    if(body == data)
+    {
+        ST_WARNING("Empty file.");
+        goto ERR;
+    }
+    header = (char *)malloc(body - data + 1);
+    if(header == NULL)
+    {
+        ST_WARNING("Failed to malloc header.");
+        goto ERR;
+    }
+    memcpy(header, data, body - data);
+    header[body - data] = '\0';
+
+    label_num = parse_sym_header(header);
+    if(label_num <= 0)
+    {
+        ST_WARNING("Wrong esym format: wrong symbols num[%d].", label_num);
+        goto ERR;
+    }
+
+    loader.chunks = (txt_chunk_t *)calloc(num_thread, sizeof(txt_chunk_t));
+    if(loader.chunks == NULL)
+    {
+        ST_WARNING("Failed to alloc chunks.");
+        goto ERR;
+    }
+    p = body;
+    for(t = 0; t < num_thread; t++)
+    {
+        chunk = loader.chunks + t;
+        chunk->start = p;
+        if(t == num_thread - 1)
+        {
+            p = data + size;
+        }
+        else
+        {
+            p = body + (data + size - body) * (t + 1) / num_thread;
+            if(p < chunk->start)
+            {
+                p = chunk->start;
+            }
+            if(p > data && p[-1] != '\n')
+            {
+                p = memchr(p, '\n', data + size - p);
+                p = (p == NULL) ? data + size : p + 1;
+            }
+        }
+        chunk->end = p;
+    }
+
+    if(txt_run_threads(txt_parse_worker, &loader, num_thread) < 0)
+    {
+        ST_WARNING("Failed to run parse threads.");
+        goto ERR;
+    }
+
+    alphabet->labels = (st_label_t *)malloc(label_num * sizeof(st_label_t));
+    alphabet->is_aux = (bool *)calloc(label_num, sizeof(bool));
+    if(alphabet->labels == NULL || alphabet->is_aux == NULL)
+    {
+        ST_WARNING("Failed to allocate memory for labels.");
+        goto ERR;
+    }
+    for(i = 0; i < label_num; i++)
+    {
+        alphabet->labels[i].offset = 0;
+        alphabet->labels[i].len = 0;
+        alphabet->labels[i].symid = -1;
+    }
+    alphabet->max_label_num = label_num;
+    alphabet->label_num = label_num;
+    alphabet->aux_num = 0;
+
+    /* keep the first label_num symbols, and lay them out in file order. */
+    total = 0;
+    off = 0;
+    for(t = 0; t < num_thread; t++)
+    {
+        chunk = loader.chunks + t;
+        if(chunk->ret < 0)
+        {
+            ST_WARNING("Failed to parse chunk[%d].", t);
+            goto ERR;
+        }
+
+        chunk->first = total;
+        for(i = 0; i < chunk->sym_num && total < label_num; i++, total++)
+        {
+            id = chunk->syms[i].id;
+            if(id >= label_num)
+            {
+                ST_WARNING("Wrong id[%d]>=label_num[%d].", id, label_num);
+                goto ERR;
+            }
+            if(alphabet->labels[id].symid != -1)
+            {
+                ST_WARNING("Replicated symbol [%d:%.*s].", id,
+                        (int)chunk->syms[i].len, chunk->syms[i].sym);
+                goto ERR;
+            }
+            if(chunk->syms[i].len > UINT32_MAX)
+            {
+                ST_WARNING("Too long label[%zu].", chunk->syms[i].len);
+                goto ERR;
+            }
+            alphabet->labels[id].offset = off;
+            alphabet->labels[id].len = (uint32_t)chunk->syms[i].len;
+            alphabet->labels[id].symid = id;
+            off += chunk->syms[i].len + 1;
+        }
+        chunk->use_num = i;
+    }
+
+    for(i = 0; i < label_num; i++)
+    {
+        if(alphabet->labels[i].symid == -1)
+        {
+            ST_WARNING("Empty symbol for id[%zu]", i);
+            goto ERR;
+        }
+    }
+
+    if(st_alphabet_reserve_buf(alphabet, off) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_reserve_buf.");
+        goto ERR;
+    }
+    alphabet->label_buf_len = off;
+
+    loader.nodes = (st_dict_node_t *)malloc(label_num
+            * sizeof(st_dict_node_t));
+    if(loader.nodes == NULL)
+    {
+        ST_WARNING("Failed to alloc nodes.");
+        goto ERR;
+    }
+
+    if(txt_run_threads(txt_fill_worker, &loader, num_thread) < 0)
+    {
+        ST_WARNING("Failed to run fill threads.");
+        goto ERR;
+    }
+    for(t = 0; t < num_thread; t++)
+    {
+        alphabet->aux_num += loader.chunks[t].aux_num;
+    }
+
+    /* growable only after the bulk add, which is serial with rehash on. */
+    if((alphabet->index_dict = st_dict_create(
+        st_alphabet_index_hash_num(label_num), ST_DICT_REALLOC_NUM,
+        st_dict_hash_murmur, index_dict_node_eq, false)) == NULL)
+    {
+        ST_WARNING("Failed to alloc index_dict");
+        goto ERR;
+    }
+    if(st_dict_add_bulk(alphabet->index_dict, loader.nodes, label_num,
+                num_thread) < 0)
+    {
+        ST_WARNING("Failed to st_dict_add_bulk.");
+        goto ERR;
+    }
+
+    dup_args = (txt_dup_args_t *)calloc(num_thread, sizeof(txt_dup_args_t));
+    dup_argv = (void **)malloc(num_thread * sizeof(void *));
+    if(dup_args == NULL || dup_argv == NULL)
+    {
+        ST_WARNING("Failed to alloc dup_args.");
+        goto ERR;
+    }
+    for(t = 0; t < num_thread; t++)
+    {
+        dup_args[t].alphabet = alphabet;
+        dup_argv[t] = dup_args + t;
+    }
+    if(st_dict_traverse_parallel(alphabet->index_dict, txt_dup_trav,
+                dup_argv, num_thread) < 0)
+    {
+        ST_WARNING("Failed to st_dict_traverse_parallel.");
+        goto ERR;
+    }
+    for(t = 0; t < num_thread; t++)
+    {
+        if(dup_args[t].dup)
+        {
+            if(txt_build_index_serial(&loader, num_thread) < 0)
+            {
+                ST_WARNING("Failed to txt_build_index_serial.");
+                goto ERR;
+            }
+            break;
+        }
+    }
+
+    if(st_alphabet_index_growable(alphabet) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_index_growable.");
+        goto ERR;
+    }
+
+    for(t = 0; t < num_thread; t++)
+    {
+        safe_free(loader.chunks[t].syms);
+    }
+    safe_free(loader.chunks);
+    safe_free(loader.nodes);
+    safe_free(dup_args);
+    safe_free(dup_argv);
+    safe_free(header);
+    return 0;
+
+ERR:
+    if(loader.chunks != NULL)
+    {
+        for(t = 0; t < num_thread; t++)
+        {
+            safe_free(loader.chunks[t].syms);
+        }
+    }
+    safe_free(loader.chunks);
+    safe_free(loader.nodes);
+    safe_free(dup_args);
+    safe_free(dup_argv);
+    safe_free(header);
+    return -1;
+}
+
+st_alphabet_t* st_alphabet_load_from_txt_file(const char *fname,
+        int num_thread)
+{
+    st_alphabet_t *alphabet = NULL;
+    struct stat st;
+    void *data = MAP_FAILED;
+    int fd = -1;
+
+    ST_CHECK_PARAM(fname == NULL || num_thread <= 0, NULL);
+
+    fd = open(fname, O_RDONLY);
+    if(fd < 0)
+    {
+        ST_WARNING("Failed to open[%s]: %m.", fname);
+        goto ERR;
+    }
+    if(fstat(fd, &st) < 0)
+    {
+        ST_WARNING("Failed to fstat[%s]: %m.", fname);
+        goto ERR;
+    }
+    if(st.st_size == 0)
+    {
+        ST_WARNING("Empty file.");
+        goto ERR;
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED)
+    {
+        ST_WARNING("Failed to mmap[%s]: %m.", fname);
+        goto ERR;
+    }
+    (void)madvise(data, st.st_size, MADV_WILLNEED);
+
+    if((alphabet = st_alphabet_alloc()) == NULL)
+    {
+        ST_WARNING("Failed to st_alphabet_alloc.");
+        goto ERR;
+    }
+
+    if(st_alphabet_load_txt_mmap(alphabet, (const char *)data,
+                st.st_size, num_thread) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_load_txt_mmap[%s].", fname);
+        goto ERR;
+    }
+
+    (void)munmap(data, st.st_size);
+    safe_close(fd);
+    return alphabet;
+
+ERR:
+    if(data != MAP_FAILED)
+    {
+        (void)munmap(data, st.st_size);
+    }
+    if(fd >= 0)
+    {
+        safe_close(fd);
+    }
+    safe_st_alphabet_destroy(alphabet);
+    return NULL;
+}
 
-    ret = fwrite(&alphabet->label_num, sizeof(int), 1, fp);
-    if(ret != 1) {
-        ST_WARNING("Failed to write label_num");
+static int st_alphabet_alloc_arrays(st_alphabet_t *alphabet)
+{
+    alphabet->max_label_num = alphabet->label_num;
+
+    alphabet->labels = (st_label_t *)
+        malloc(sizeof(st_label_t)*alphabet->label_num);
+    if(alphabet->labels == NULL)
+    {
+        ST_WARNING("Failed to malloc labels. [%d]", alphabet->label_num);
         return -1;
     }
 
-    ret = fwrite(&alphabet->aux_num, sizeof(int), 1, fp);
-    if(ret != 1) {
-        ST_WARNING("Failed to write aux_num");
+    alphabet->is_aux = (bool *)malloc(sizeof(bool)*alphabet->label_num);
+    if(alphabet->is_aux == NULL)
+    {
+        ST_WARNING("Failed to malloc is_aux.");
         return -1;
     }
 
-    ret = fwrite(alphabet->labels, sizeof(st_label_t),
-        alphabet->label_num, fp);
-    if(ret != alphabet->label_num) {
-        ST_WARNING("Failed to write labels");
+    return 0;
+}
+
+static int st_alphabet_load_bin_legacy(st_alphabet_t *alphabet, FILE *fp)
+{
+    st_alphabet_legacy_label_t old;
+    int ret = 0;
+    int i;
+
+    ret = fread(&alphabet->aux_num, sizeof(int), 1, fp);
+    if(ret != 1)
+    {
+        ST_WARNING("Failed to read aux_num");
         return -1;
     }
 
-    ret = fwrite(alphabet->is_aux, sizeof(bool), alphabet->label_num, fp);
-    if(ret != alphabet->label_num) {
-        ST_WARNING("Failed to write is_aux");
+    if(st_alphabet_alloc_arrays(alphabet) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_alloc_arrays.");
+        return -1;
+    }
+
+    for(i = 0; i < alphabet->label_num; i++)
+    {
+        if(fread(&old, sizeof(old), 1, fp) != 1)
+        {
+            ST_WARNING("Failed to read labels");
+            return -1;
+        }
+        old.label[ST_ALPHABET_LEGACY_SYM_LEN - 1] = '\0';
+
+        if(st_alphabet_store_label(alphabet, i, old.label,
+                    strlen(old.label)) < 0)
+        {
+            ST_WARNING("Failed to store label[%d].", i);
+            return -1;
+        }
+        alphabet->labels[i].symid = old.symid;
+    }
+
+    ret = fread(alphabet->is_aux, sizeof(bool), alphabet->label_num, fp);
+    if(ret != alphabet->label_num)
+    {
+        ST_WARNING("Failed to read is_aux");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* check a header, and fill offsets of files older than version 3. */
+static int st_alphabet_check_header(st_alphabet_header_t *header)
+{
+    if(header->version > ST_ALPHABET_VERSION)
+    {
+        ST_WARNING("Too high version[%u], expect[%u]", header->version,
+                ST_ALPHABET_VERSION);
+        return -1;
+    }
+
+    if(header->label_num < 0 || header->aux_num < 0
+            || header->aux_num > header->label_num)
+    {
+        ST_WARNING("Corrupted header: label_num[%d], aux_num[%d]",
+                header->label_num, header->aux_num);
         return -1;
     }
 
-    if(st_dict_save(alphabet->index_dict, fp) < 0) {
-        ST_WARNING("Failed to save index_dict");
+    if(header->version < 3)
+    {
+        header->labels_offset = ST_ALPHABET_HEADER_V1_SIZE;
+        header->label_buf_offset = header->labels_offset
+            + sizeof(st_label_t) * (uint64_t)header->label_num;
+        header->is_aux_offset = header->label_buf_offset
+            + header->label_buf_len;
+        header->dict_offset = header->is_aux_offset
+            + sizeof(bool) * (uint64_t)header->label_num;
+    }
+
+    if(header->labels_offset < ST_ALPHABET_HEADER_V1_SIZE
+            || header->label_buf_offset < header->labels_offset
+                + sizeof(st_label_t) * (uint64_t)header->label_num
+            || header->is_aux_offset < header->label_buf_offset
+                + header->label_buf_len
+            || header->dict_offset < header->is_aux_offset
+                + sizeof(bool) * (uint64_t)header->label_num)
+    {
+        ST_WARNING("Corrupted header: overlapped sections.");
         return -1;
     }
 
     return 0;
 }
 
-int st_alphabet_save_txt(st_alphabet_t *alphabet, FILE *fp)
+/* every label lies inside label_buf and ends with a NUL. */
+static int st_alphabet_check_labels(st_alphabet_t *alphabet)
 {
-    st_label_t *labels;
+    st_label_t *l;
     int i;
 
-    ST_CHECK_PARAM(alphabet == NULL || fp == NULL, -1);
-
-    if (fprintf(fp, SYM_NUM " = %d\n", alphabet->label_num) < 0) {
-        ST_WARNING("Failed to fprintf header.");
-        return -1;
-    }
-    labels = alphabet->labels;
-    for(i = 0; i < alphabet->label_num; i++) {
-        if(labels[i].symid != -1) {
-            if (fprintf(fp, "%s\t%d\n", labels[i].label,
-                        labels[i].symid) < 0) {
-                ST_WARNING("Failed to fprintf sym[%d]", i);
-                return -1;
-            }
+    for(i = 0; i < alphabet->label_num; i++)
+    {
+        l = alphabet->labels + i;
+        if(l->offset >= alphabet->label_buf_len
+                || l->len >= alphabet->label_buf_len - l->offset
+                || alphabet->label_buf[l->offset + l->len] != '\0')
+        {
+            ST_WARNING("Corrupted label[%d].", i);
+            return -1;
         }
     }
 
     return 0;
 }
 
-int st_alphabet_load_txt(st_alphabet_t *alphabet, FILE *fp)
+static int st_alphabet_load_bin_arena(st_alphabet_t *alphabet, FILE *fp,
+        uint32_t *version)
 {
-    char line[MAX_LINE_LEN];
-    char syms[MAX_SYM_LEN] ;
-    st_dict_node_t snode;
-    char *pstr = NULL;
-    int id;
-    int i;
+    st_alphabet_header_t header;
+    size_t pos;
+    int ret = 0;
 
-    st_label_t *labels;
-    bool *is_aux;
-    st_dict_t *index_dict = NULL;
-    int label_num;
-    int aux_num = 0;
+    memset(&header, 0, sizeof(header));
+    header.magic = ST_ALPHABET_MAGIC;
+    if(fread(&header.version, ST_ALPHABET_HEADER_V1_SIZE - sizeof(uint32_t),
+                1, fp) != 1)
+    {
+        ST_WARNING("Failed to read header");
+        return -1;
+    }
+    pos = ST_ALPHABET_HEADER_V1_SIZE;
+    if(header.version >= 3)
+    {
+        if(fread(&header.labels_offset,
+                    sizeof(header) - ST_ALPHABET_HEADER_V1_SIZE, 1, fp) != 1)
+        {
+            ST_WARNING("Failed to read header");
+            return -1;
+        }
+        pos = sizeof(header);
+    }
 
-    ST_CHECK_PARAM(alphabet == NULL || fp == NULL, -1);
+    if(st_alphabet_check_header(&header) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_check_header.");
+        return -1;
+    }
+    *version = header.version;
 
-    if(fgets(line, MAX_LINE_LEN, fp) == NULL)
+    alphabet->label_num = header.label_num;
+    alphabet->aux_num = header.aux_num;
+    if(st_alphabet_alloc_arrays(alphabet) < 0)
     {
-        ST_WARNING("Empty file.");
-        goto ERR;
+        ST_WARNING("Failed to st_alphabet_alloc_arrays.");
+        return -1;
     }
-    pstr = strchr(line, '=');
-    if(pstr == NULL || strncmp(line, SYM_NUM, strlen(SYM_NUM)) != 0)
+
+    if(st_alphabet_skip(fp, header.labels_offset - pos) < 0)
     {
-        ST_WARNING("Wrong esym format: no symbols num.");
-        goto ERR;
+        ST_WARNING("Failed to skip padding");
+        return -1;
     }
-    label_num = atoi(pstr+1);
-    if(label_num <= 0)
+    ret = fread(alphabet->labels, sizeof(st_label_t),
+        alphabet->label_num, fp);
+    if(ret != alphabet->label_num)
     {
-        ST_WARNING("Wrong esym format: wrong symbols num[%d].", label_num);
-        goto ERR;
+        ST_WARNING("Failed to read labels");
+        return -1;
     }
+    pos = header.labels_offset + sizeof(st_label_t) * alphabet->label_num;
 
-    labels = (st_label_t *)malloc(label_num * sizeof(st_label_t));
-    if(labels == NULL)
+    if(st_alphabet_skip(fp, header.label_buf_offset - pos) < 0)
     {
-        ST_WARNING("Failed to allocate memory for labels.");
-        goto ERR;
+        ST_WARNING("Failed to skip padding");
+        return -1;
     }
+    if(header.label_buf_len > 0)
+    {
+        if(st_alphabet_reserve_buf(alphabet, header.label_buf_len) < 0)
+        {
+            ST_WARNING("Failed to st_alphabet_reserve_buf.");
+            return -1;
+        }
+        if(fread(alphabet->label_buf, sizeof(char), header.label_buf_len,
+                    fp) != header.label_buf_len)
+        {
+            ST_WARNING("Failed to read label_buf");
+            return -1;
+        }
+        alphabet->label_buf_len = header.label_buf_len;
+    }
+    pos = header.label_buf_offset + header.label_buf_len;
 
-    is_aux = (bool *)malloc(label_num * sizeof(bool));
-    if(is_aux == NULL)
+    if(st_alphabet_check_labels(alphabet) < 0)
     {
-        ST_WARNING("Failed to allocate memory for is_aux.");
-        goto ERR;
+        ST_WARNING("Failed to st_alphabet_check_labels.");
+        return -1;
     }
 
-    for(i = 0; i < label_num; i++)
+    if(st_alphabet_skip(fp, header.is_aux_offset - pos) < 0)
     {
-        labels[i].symid = -1;
-        labels[i].label[0] = 0;
-        is_aux[i] = false;
+        ST_WARNING("Failed to skip padding");
+        return -1;
+    }
+    ret = fread(alphabet->is_aux, sizeof(bool), alphabet->label_num, fp);
+    if(ret != alphabet->label_num)
+    {
+        ST_WARNING("Failed to read is_aux");
+        return -1;
     }
+    pos = header.is_aux_offset + sizeof(bool) * alphabet->label_num;
 
-    if((index_dict = st_dict_create(label_num,
-        ST_DICT_REALLOC_NUM, NULL, NULL, false)) == NULL)
+    if(st_alphabet_skip(fp, header.dict_offset - pos) < 0)
     {
-        ST_WARNING("Failed to alloc index_dict");
-        goto ERR;
+        ST_WARNING("Failed to skip padding");
+        return -1;
     }
 
-    i = 0;
-    while(fgets(line, MAX_LINE_LEN, fp))
+    return 0;
+}
+
+static int st_alphabet_load_bin(st_alphabet_t *alphabet, FILE *fp)
+{
+    uint32_t first;
+    uint32_t version = 0;
+
+    ST_CHECK_PARAM(alphabet == NULL || fp == NULL, -1);
+
+    if(fread(&first, sizeof(uint32_t), 1, fp) != 1)
     {
-        if(sscanf(line, "%s %d", syms, &id) != 2)
-        {
-            continue;
-        }
+        ST_WARNING("Failed to read magic num");
+        return -1;
+    }
 
-        if(id >= label_num)
+    if(first == ST_ALPHABET_MAGIC)
+    {
+        if(st_alphabet_load_bin_arena(alphabet, fp, &version) < 0)
         {
-            ST_WARNING("Wrong id[%d]>=label_num[%d].", id, label_num);
-            goto ERR;
+            ST_WARNING("Failed to st_alphabet_load_bin_arena.");
+            return -1;
         }
-
-        if(labels[id].symid != -1)
+    }
+    else
+    {
+        alphabet->label_num = (int)first;
+        if(st_alphabet_load_bin_legacy(alphabet, fp) < 0)
         {
-            ST_WARNING("Replicated symbol [%d:%s].", id, syms);
-            goto ERR;
+            ST_WARNING("Failed to st_alphabet_load_bin_legacy.");
+            return -1;
         }
+    }
 
-        strncpy(labels[id].label, syms, MAX_SYM_LEN);
-        labels[id].label[MAX_SYM_LEN - 1] = 0;
-        labels[id].symid = id;
-
-        get_sign(labels[id].label, strlen(labels[id].label),
-                &snode.sign1, &snode.sign2);
-        snode.uint1 = (uint)id;
-        st_dict_add(index_dict, &snode, NULL);
+    if((alphabet->index_dict = st_dict_load_from_bin(fp)) == NULL)
+    {
+        ST_WARNING("Failed to load index_dict");
+        return -1;
+    }
 
-        if(syms[0] == '#')
+    if(version < ST_ALPHABET_SIGN_VERSION)
+    {
+        /* signs of older files come from another get_sign. */
+        if(st_alphabet_build_index(alphabet) < 0)
         {
-            is_aux[id] = true;
-            aux_num++;
-        }
-
-        i++;
-        if (i >= label_num) {
-            break;
+            ST_WARNING("Failed to st_alphabet_build_index.");
+            return -1;
         }
     }
-
-    for(i = 0; i < label_num; i++)
+    else
     {
-        if(labels[i].symid == -1)
+        alphabet->index_dict->node_eq_func = index_dict_node_eq;
+        if(st_alphabet_index_growable(alphabet) < 0)
         {
-            ST_WARNING("Empty symbol for id[%d]", i);
-            goto ERR;
+            ST_WARNING("Failed to st_alphabet_index_growable.");
+            return -1;
         }
     }
 
-    alphabet->labels = labels;
-    alphabet->is_aux = is_aux;
-    alphabet->max_label_num = label_num;
-    alphabet->label_num = label_num;
-    alphabet->aux_num = aux_num;
-    alphabet->index_dict = index_dict;
-
     return 0;
-
-ERR:
-    safe_st_dict_destroy(index_dict);
-    return -1;
 }
 
-st_alphabet_t* st_alphabet_load_from_txt(FILE *fp)
+st_alphabet_t* st_alphabet_load_from_bin(FILE *fp)
 {
     st_alphabet_t *alphabet;
 
@@ -448,9 +3051,9 @@ st_alphabet_t* st_alphabet_load_from_txt(FILE *fp)
         return NULL;
     }
 
-    if(st_alphabet_load_txt(alphabet, fp) < 0)
+    if(st_alphabet_load_bin(alphabet, fp) < 0)
     {
-        ST_WARNING("Failed to st_alphabet_load_txt_fp.");
+        ST_WARNING("Failed to st_alphabet_load_bin_fp.");
         goto ERR;
 
     }
@@ -461,129 +3064,204 @@ ERR:
     return NULL;
 }
 
-static int st_alphabet_load_bin(st_alphabet_t *alphabet, FILE *fp)
+st_alphabet_t* st_alphabet_mmap(int fd, off_t offset)
 {
-    int ret = 0;
-
-    ST_CHECK_PARAM(alphabet == NULL || fp == NULL, -1);
-
-    ret = fread(&alphabet->label_num, sizeof(int), 1, fp);
-    if(ret != 1)
+    st_alphabet_t *alphabet = NULL;
+    st_alphabet_header_t header;
+    struct stat st;
+    void *addr;
+    char *base;
+    size_t len;
+    off_t start;
+    long page_size;
+
+    ST_CHECK_PARAM(fd < 0 || offset < 0, NULL);
+
+    memset(&header, 0, sizeof(header));
+    if(pread(fd, &header, ST_ALPHABET_HEADER_V1_SIZE, offset)
+            != ST_ALPHABET_HEADER_V1_SIZE)
     {
-        ST_WARNING("Failed to read label_num");
-        return -1;
+        ST_WARNING("Failed to read header");
+        return NULL;
     }
-    alphabet->max_label_num = alphabet->label_num;
-
-    ret = fread(&alphabet->aux_num, sizeof(int), 1, fp);
-    if(ret != 1)
+    if(header.magic != ST_ALPHABET_MAGIC
+            || header.version < ST_ALPHABET_MMAP_VERSION)
     {
-        ST_WARNING("Failed to read aux_num");
-        return -1;
+        ST_WARNING("Can not map alphabet of version[%u], "
+                "use st_alphabet_load_from_bin.",
+                header.magic == ST_ALPHABET_MAGIC ? header.version : 0);
+        return NULL;
     }
-
-    alphabet->labels = (st_label_t *)
-        malloc(sizeof(st_label_t)*alphabet->label_num);
-    if(alphabet->labels == NULL)
+    if(pread(fd, &header, sizeof(header), offset) != sizeof(header))
     {
-        ST_WARNING("Failed to malloc labels. [%d]", alphabet->label_num);
-        return -1;
+        ST_WARNING("Failed to read header");
+        return NULL;
+    }
+    if(st_alphabet_check_header(&header) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_check_header.");
+        return NULL;
     }
 
-    alphabet->is_aux = (bool *)malloc(sizeof(bool)*alphabet->label_num);
-    if(alphabet->is_aux == NULL)
+    if(fstat(fd, &st) != 0)
     {
-        ST_WARNING("Failed to malloc is_aux.");
-        return -1;
+        ST_WARNING("Failed to fstat[%m].");
+        return NULL;
+    }
+    if((uint64_t)st.st_size < offset + header.dict_offset)
+    {
+        ST_WARNING("File truncated[%zu/%zu].", (size_t)st.st_size,
+                (size_t)(offset + header.dict_offset));
+        return NULL;
     }
 
-    ret = fread(alphabet->labels, sizeof(st_label_t),
-        alphabet->label_num, fp);
-    if(ret != alphabet->label_num)
+    page_size = sysconf(_SC_PAGESIZE);
+    start = offset & ~((off_t)page_size - 1);
+    len = (size_t)(offset - start + header.dict_offset);
+
+    addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, start);
+    if(addr == MAP_FAILED)
     {
-        ST_WARNING("Failed to read labels");
-        return -1;
+        ST_WARNING("Failed to mmap[%m].");
+        return NULL;
     }
 
-    ret = fread(alphabet->is_aux, sizeof(bool), alphabet->label_num, fp);
-    if(ret != alphabet->label_num)
+    if((alphabet = st_alphabet_alloc()) == NULL)
     {
-        ST_WARNING("Failed to read is_aux");
-        return -1;
+        ST_WARNING("Failed to st_alphabet_alloc.");
+        munmap(addr, len);
+        return NULL;
+    }
+    alphabet->map_addr = addr;
+    alphabet->map_len = len;
+
+    base = (char *)addr + (offset - start);
+    alphabet->labels = (st_label_t *)(base + header.labels_offset);
+    alphabet->label_buf = base + header.label_buf_offset;
+    alphabet->is_aux = (bool *)(base + header.is_aux_offset);
+    alphabet->label_num = header.label_num;
+    alphabet->max_label_num = header.label_num;
+    alphabet->aux_num = header.aux_num;
+    alphabet->label_buf_len = header.label_buf_len;
+    alphabet->label_buf_cap = header.label_buf_len;
+
+    if(st_alphabet_check_labels(alphabet) < 0)
+    {
+        ST_WARNING("Failed to st_alphabet_check_labels.");
+        goto ERR;
     }
 
-    if((alphabet->index_dict = st_dict_load_from_bin(fp)) == NULL)
+    alphabet->index_dict = st_dict_mmap(fd, offset + header.dict_offset);
+    if(alphabet->index_dict == NULL)
     {
-        ST_WARNING("Failed to load index_dict");
-        return -1;
+        ST_WARNING("Failed to st_dict_mmap.");
+        goto ERR;
     }
+    alphabet->index_dict->node_eq_func = index_dict_node_eq;
 
-    return 0;
+    return alphabet;
+
+ERR:
+    safe_st_alphabet_destroy(alphabet);
+    return NULL;
 }
 
-st_alphabet_t* st_alphabet_load_from_bin(FILE *fp)
+st_alphabet_t* st_alphabet_open_readonly(const char *filename)
 {
     st_alphabet_t *alphabet;
+    int fd;
 
-    ST_CHECK_PARAM(fp == NULL, NULL);
+    ST_CHECK_PARAM(filename == NULL, NULL);
 
-    if((alphabet = st_alphabet_alloc()) == NULL)
+    fd = open(filename, O_RDONLY);
+    if(fd < 0)
     {
-        ST_WARNING("Failed to st_alphabet_alloc.");
+        ST_WARNING("Failed to open[%s]: %m.", filename);
         return NULL;
     }
 
-    if(st_alphabet_load_bin(alphabet, fp) < 0)
+    alphabet = st_alphabet_mmap(fd, 0);
+    if(alphabet == NULL)
     {
-        ST_WARNING("Failed to st_alphabet_load_bin_fp.");
-        goto ERR;
-
+        ST_WARNING("Failed to st_alphabet_mmap[%s].", filename);
     }
+    safe_close(fd);
 
     return alphabet;
-ERR:
-    safe_st_alphabet_destroy(alphabet);
-    return NULL;
+}
+
+/*
+ * The storage of a as a frozen alphabet, to be shared by dups of a as
+ * their base. a keeps pointing to the same storage, without owning it,
+ * until it is modified, see st_alphabet_own_storage.
+ */
+static st_alphabet_t* st_alphabet_share(st_alphabet_t *a)
+{
+    st_alphabet_t *shared;
+
+    if (a->shared != NULL) {
+        /* a trie built after sharing holds for the shared labels too. */
+        if (a->shared->trie == NULL && st_alphabet_trie_owned(a)) {
+            a->shared->trie = a->trie;
+        }
+        return a->shared;
+    }
+
+    shared = st_alphabet_alloc();
+    if (shared == NULL) {
+        ST_WARNING("Failed to st_alphabet_alloc.");
+        return NULL;
+    }
+    *shared = *a;
+    shared->unk_id = -1;
+    shared->ref = 1;
+    if (shared->base != NULL) {
+        (void)__atomic_add_fetch(&shared->base->ref, 1, __ATOMIC_RELAXED);
+    }
+    a->shared = shared;
+
+    return shared;
 }
 
 st_alphabet_t* st_alphabet_dup(st_alphabet_t *a)
 {
     st_alphabet_t *alphabet = NULL;
+    st_alphabet_t *base;
 
     ST_CHECK_PARAM(a == NULL, NULL);
 
-    alphabet = st_alphabet_alloc();
-    if(alphabet == NULL) {
-        ST_WARNING("Failed to alphabet_alloc.");
-        goto ERR;
+    if (a->conc_slots != NULL) {
+        ST_WARNING("Can not dup alphabet in concurrent mode.");
+        return NULL;
     }
 
-    alphabet->max_label_num = a->max_label_num;
-    alphabet->label_num = a->label_num;
-    alphabet->aux_num = a->aux_num;
-
-    alphabet->labels = (st_label_t *)
-        malloc(a->max_label_num * sizeof(st_label_t));
-    if(alphabet->labels == NULL) {
-        ST_WARNING("Failed to allocate memory for labels.");
-        goto ERR;
+    /* an empty overlay on a base shares that base right away. */
+    if (a->base != NULL && a->label_num == 0 && !st_alphabet_trie_owned(a)) {
+        base = a->base;
+    } else {
+        base = st_alphabet_share(a);
+        if (base == NULL) {
+            ST_WARNING("Failed to st_alphabet_share.");
+            return NULL;
+        }
     }
 
-    memcpy(alphabet->labels, a->labels,
-            sizeof(st_label_t)*a->max_label_num);
-
-    alphabet->index_dict = st_dict_dup(a->index_dict);
-    if (alphabet->index_dict == NULL) {
-        ST_WARNING("Failed to st_dict_dup.");
-        goto ERR;
+    alphabet = st_alphabet_alloc();
+    if(alphabet == NULL) {
+        ST_WARNING("Failed to alphabet_alloc.");
+        return NULL;
     }
 
-    alphabet->is_aux = (bool *) malloc(a->max_label_num * sizeof(bool));
-    if(alphabet->is_aux == NULL) {
-        ST_WARNING("Failed to allocate memory for is_aux.");
+    alphabet->base = base;
+    (void)__atomic_add_fetch(&base->ref, 1, __ATOMIC_RELAXED);
+    alphabet->base_num = base->base_num + base->label_num;
+    alphabet->unk_id = a->unk_id;
+    alphabet->trie = base->trie;
+
+    if (st_alphabet_create_index(alphabet) < 0) {
+        ST_WARNING("Failed to st_alphabet_create_index.");
         goto ERR;
     }
-    memcpy(alphabet->is_aux, a->is_aux, a->max_label_num*sizeof(bool));
 
     return alphabet;
 
@@ -591,3 +3269,30 @@ ERR:
     safe_st_alphabet_destroy(alphabet);
     return NULL;
 }
+
+bool st_alphabet_is_aux(st_alphabet_t *alphabet, int id)
+{
+    st_alphabet_t *owner;
+
+    ST_CHECK_PARAM(alphabet == NULL || id < 0
+            || id >= st_alphabet_get_label_num(alphabet), false);
+
+    owner = st_alphabet_owner(alphabet, id);
+
+    return owner->is_aux[id - owner->base_num];
+}
+
+int st_alphabet_get_aux_num(st_alphabet_t *alphabet)
+{
+    int num = 0;
+
+    ST_CHECK_PARAM(alphabet == NULL, -1);
+
+    /* aux_num is bumped without lock in concurrent mode. */
+    for(; alphabet != NULL; alphabet = alphabet->base)
+    {
+        num += __atomic_load_n(&alphabet->aux_num, __ATOMIC_RELAXED);
+    }
+
+    return num;
+}
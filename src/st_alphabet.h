@@ -29,15 +29,27 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+#include <sys/types.h>
+
 #include <stutils/st_macro.h>
 #include "st_dict.h"
+#include "st_datrie.h"
+#include "st_arena.h"
 
-#define MAX_SYM_LEN         256
-
+/*
+ * Labels live one after another, NUL-terminated, in a single string arena
+ * (label_buf). Every id keeps the offset and length of its label in the
+ * arena, so a short label costs its own length plus one st_label_t.
+ *
+ * st_label_t has a fixed width on every platform, because the labels
+ * array and the arena are written to binary files as they are.
+ */
 typedef struct _st_label_t
 {
-    char label[MAX_SYM_LEN];
-    int symid;
+    uint64_t offset; /* offset of the label in label_buf. */
+    uint32_t len;    /* length of the label, excluding the NUL. */
+    int32_t symid;
 } st_label_t;
 
 typedef struct _st_alphabet_t
@@ -46,23 +58,193 @@ typedef struct _st_alphabet_t
     int max_label_num;
     int label_num;
 
+    char *label_buf;
+    size_t label_buf_len;
+    size_t label_buf_cap;
+
     bool *is_aux;
     int aux_num;
 
     st_dict_t *index_dict;
+
+    int unk_id; /* id of unknown tokens in st_alphabet_line_to_ids. */
+
+    /* index of concurrent mode, see st_alphabet_set_concurrent. */
+    uint64_t *conc_slots;
+    uint64_t conc_mask;
+    int conc_base; /* label_num when concurrent mode was turned on. */
+
+    /* optional prefix index, see st_alphabet_build_trie. */
+    st_datrie_t *trie;
+
+    /*
+     * Labels with ids below base_num belong to base, a frozen alphabet
+     * shared by dups, see st_alphabet_dup. The fields above then hold
+     * only labels added afterwards, under ids from base_num on.
+     */
+    struct _st_alphabet_t *base;
+    int base_num;
+    int ref; /* number of alphabets using this one as base. */
+
+    /*
+     * If not NULL, labels, label_buf, is_aux, index_dict and trie are
+     * owned by shared, the base of the dups of this alphabet. Before
+     * this alphabet is modified, shared becomes its base as well.
+     */
+    struct _st_alphabet_t *shared;
+
+    /* labels, label_buf and is_aux live here if not NULL. */
+    st_arena_t *mem_arena;
+
+    /* labels, label_buf and is_aux live here if mapped from a file. */
+    void *map_addr;
+    size_t map_len;
 } st_alphabet_t;
 
 st_alphabet_t* st_alphabet_load_from_txt(FILE *esym_fp);
 st_alphabet_t* st_alphabet_load_from_bin(FILE *fp);
 
+/*
+ * Load a txt symbol file with several threads.
+ *
+ * The file is mmapped and split at line boundaries, one part per thread.
+ * Threads parse their lines, then fill the arena and hash the labels;
+ * index_dict is built with st_dict_add_bulk. The alphabet is the same
+ * as st_alphabet_load_from_txt gives for the file.
+ *
+ * @param[in] fname path of the file.
+ * @param[in] num_thread number of threads.
+ * @return the alphabet, NULL if any error.
+ */
+st_alphabet_t* st_alphabet_load_from_txt_file(const char *fname,
+        int num_thread);
+
 int st_alphabet_save_bin(st_alphabet_t *alphabet, FILE *fp);
+
+/*
+ * Map an alphabet saved by st_alphabet_save_bin into memory.
+ *
+ * Labels, the arena, is_aux and index_dict are served straight from a
+ * read-only shared mapping of the file, so every process mapping the
+ * same file shares one copy in the page cache. The returned alphabet
+ * supports lookups only, st_alphabet_dup gives a writable copy.
+ *
+ * @param[in] fd file descriptor, can be closed after return.
+ * @param[in] offset file offset where st_alphabet_save_bin started writing.
+ * @return the alphabet, NULL if any error.
+ */
+st_alphabet_t* st_alphabet_mmap(int fd, off_t offset);
+
+/*
+ * Map a file containing a single alphabet saved by st_alphabet_save_bin.
+ *
+ * @param[in] filename the file.
+ * @return the alphabet, NULL if any error.
+ */
+st_alphabet_t* st_alphabet_open_readonly(const char *filename);
 int st_alphabet_save_txt(st_alphabet_t *alphabet, FILE *fp);
 
 int st_alphabet_get_label_num(st_alphabet_t *alphabet);
 
+/*
+ * Get label of an id.
+ *
+ * The label points into the arena of the alphabet. The arena is one
+ * block, moved by realloc as it grows, so the label is only valid until
+ * the alphabet changes: a label is added, concurrent mode is turned on
+ * or off, or st_alphabet_sort_by_count renumbers it. Within concurrent
+ * mode the arena stays in place. Labels shared with dups, see
+ * st_alphabet_dup, are never moved. Copy the label to keep it longer.
+ *
+ * @param[in] alphabet the alphabet.
+ * @param[in] index id of the label.
+ * @return the NUL-terminated label, NULL if any error.
+ */
 char *st_alphabet_get_label(st_alphabet_t *alphabet, int index);
 int st_alphabet_get_index(st_alphabet_t *alphabet, const char *label);
 
+/*
+ * Set the id reported for unknown tokens by st_alphabet_line_to_ids.
+ *
+ * @param[in] alphabet the alphabet.
+ * @param[in] unk_id the id, -1 by default.
+ * @return non-zero value if any error.
+ */
+int st_alphabet_set_unk_id(st_alphabet_t *alphabet, int unk_id);
+
+/*
+ * Build a double-array trie of all labels, for prefix queries.
+ *
+ * A label loaded under several ids maps to the id st_alphabet_get_index
+ * gives. Adding a new label or renumbering drops the trie, call this
+ * again before further prefix queries. The trie is not written by
+ * st_alphabet_save_bin, so it has to be built again after loading or
+ * mapping an alphabet.
+ *
+ * @param[in] alphabet the alphabet, not concurrent.
+ * @return non-zero value if any error.
+ */
+int st_alphabet_build_trie(st_alphabet_t *alphabet);
+
+/*
+ * Find the longest label that is a prefix of str, with the trie.
+ *
+ * Segmentation of text without separators takes the longest match at
+ * every position, see st_datrie_longest_prefix.
+ *
+ * @param[in] alphabet the alphabet, with a trie.
+ * @param[in] str the input.
+ * @param[in] len bytes of str to match against.
+ * @param[out] match_len length of the label found, may be NULL.
+ * @return id of the label, -1 if none found or any error.
+ */
+int st_alphabet_longest_match(st_alphabet_t *alphabet, const char *str,
+        size_t len, size_t *match_len);
+
+/*
+ * Find all labels that are prefixes of str, shortest first, with the
+ * trie. See st_datrie_common_prefix.
+ *
+ * @return number of labels found, which may exceed cap, -1 if any error.
+ */
+int st_alphabet_prefix_matches(st_alphabet_t *alphabet, const char *str,
+        size_t len, int *ids, size_t *match_lens, int cap);
+
+/*
+ * Renumber labels by descending count.
+ *
+ * The most frequent label gets id 0, ties keep their old order. Labels,
+ * the arena and index_dict are rebuilt in the new order, so frequent
+ * labels sit together at the front of each. unk_id follows its label.
+ *
+ * @param[in] alphabet the alphabet, neither mapped nor concurrent.
+ * @param[in] counts count of every old id, label_num entries.
+ * @param[out] old2new new id of every old id, label_num entries, for
+ *                     remapping arrays indexed by id. May be NULL.
+ * @return non-zero value if any error.
+ */
+int st_alphabet_sort_by_count(st_alphabet_t *alphabet,
+        const uint64_t *counts, int *old2new);
+
+/*
+ * Look up every token of a line.
+ *
+ * Tokens are split on the separators of get_next_token, found with
+ * SSE2 when available, and hashed in place without copying. The dict
+ * buckets of up to 64 tokens are prefetched together with
+ * st_dict_seek_batch before they are resolved. Unknown tokens get the
+ * id set by st_alphabet_set_unk_id.
+ *
+ * @param[in] alphabet the alphabet.
+ * @param[in] line the NUL-terminated line.
+ * @param[out] ids ids of the first cap tokens.
+ * @param[in] cap capacity of ids.
+ * @return number of tokens in line, which may exceed cap,
+ *         -1 if any error.
+ */
+int st_alphabet_line_to_ids(st_alphabet_t *alphabet, const char *line,
+        int *ids, int cap);
+
 #define safe_st_alphabet_destroy(ptr) do {\
     if((ptr) != NULL) {\
         st_alphabet_destroy(ptr);\
@@ -73,11 +255,102 @@ int st_alphabet_get_index(st_alphabet_t *alphabet, const char *label);
 
 void st_alphabet_destroy(st_alphabet_t *alphabet);
 
+/*
+ * Create an empty alphabet.
+ *
+ * Storage grows geometrically as labels are added, so max_label_num is
+ * only the initial capacity.
+ *
+ * @param[in] max_label_num expected number of labels, 0 if unknown.
+ * @return the alphabet, NULL if any error.
+ */
 st_alphabet_t* st_alphabet_create(int max_label_num);
+
+/*
+ * Create an alphabet whose labels, arena of label strings and is_aux
+ * flags are allocated from a st_arena_t, growing in it as labels are
+ * added.
+ *
+ * The alphabet itself and its index are still malloced and released by
+ * safe_st_alphabet_destroy, which leaves mem_arena alone. mem_arena must
+ * not be reset or rewound before the alphabet and its dups are destroyed.
+ *
+ * @param[in] max_label_num initial capacity as st_alphabet_create.
+ * @param[in] mem_arena the st_arena_t, NULL for the heap as
+ *                      st_alphabet_create.
+ * @return the alphabet, NULL if any error.
+ */
+st_alphabet_t* st_alphabet_create_in(int max_label_num,
+        st_arena_t *mem_arena);
 int st_alphabet_add_label(st_alphabet_t *alphabet, const char *label_);
 
+/*
+ * Let several threads add and look up labels at the same time.
+ *
+ * In concurrent mode, st_alphabet_add_label, st_alphabet_get_index,
+ * st_alphabet_get_label and st_alphabet_line_to_ids take no lock and may
+ * run in any number of threads. A new label claims a slot of an open
+ * addressing index with CAS, takes its id and arena space by fetch-add,
+ * and publishes the id into the slot once the label is written, so every
+ * distinct label gets exactly one id. Adds of one label wait for the
+ * thread that claimed its slot, lookups never wait.
+ *
+ * Storage does not move in this mode, so labels and the arena are sized
+ * to max_label_num and max_buf_len when the mode is turned on, and adds
+ * fail once either is used up. st_alphabet_get_label_num may count ids
+ * whose labels are still being written. st_alphabet_save_bin and
+ * st_alphabet_dup are not available in this mode.
+ *
+ * Turning the mode off adds the new labels into index_dict.
+ *
+ * @param[in] alphabet the alphabet, must not be used by other threads
+ *                     during this call.
+ * @param[in] concurrent true to turn on the mode, false to turn off.
+ * @param[in] max_label_num capacity of labels, 0 for a default.
+ * @param[in] max_buf_len capacity of the arena in bytes, 0 for a default.
+ * @return non-zero value if any error.
+ */
+int st_alphabet_set_concurrent(st_alphabet_t *alphabet, bool concurrent,
+        int max_label_num, size_t max_buf_len);
+
+/*
+ * Duplicate an alphabet without copying its labels.
+ *
+ * The storage of a becomes a reference counted base of the copy, and
+ * the fields of a are left as they are. Labels the copy adds go to its
+ * own small overlay, which lookups check before the base; before its
+ * first change, a becomes such an overlay on the same base, with no
+ * label copied. Neither a nor the copy sees labels added by the other,
+ * and ids agree on the shared labels. The base is freed with the last
+ * alphabet using it. The copy shares the trie of a, if any.
+ *
+ * The fields labels, is_aux and aux_num of a copy, and of a once
+ * changed, only cover the overlay, use st_alphabet_get_label,
+ * st_alphabet_is_aux and st_alphabet_get_aux_num instead.
+ *
+ * @param[in] a the alphabet, not concurrent. Other threads may read a
+ *              during this call, but not modify it.
+ * @return the copy, NULL if any error.
+ */
 st_alphabet_t* st_alphabet_dup(st_alphabet_t *a);
 
+/*
+ * Whether label id is an aux label, i.e. starting with '#'.
+ *
+ * @param[in] alphabet the alphabet.
+ * @param[in] id the label id.
+ * @return true if aux, false otherwise or if any error.
+ */
+bool st_alphabet_is_aux(st_alphabet_t *alphabet, int id);
+
+/*
+ * Number of aux labels, including those of the base of a dup.
+ *
+ * @param[in] alphabet the alphabet.
+ * @return the number, -1 if any error.
+ */
+int st_alphabet_get_aux_num(st_alphabet_t *alphabet);
+
 #ifdef __cplusplus
 }
 #endif
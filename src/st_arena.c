@@ -0,0 +1,353 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include <stutils/st_macro.h>
+#include "st_log.h"
+#include "st_mem.h"
+#include "st_arena.h"
+
+/* chunk headers take whole cache lines, so blocks start on one. */
+#define ARENA_CHUNK_ALIGN   64
+#define ARENA_HDR_LEN       ((sizeof(st_arena_chunk_t) \
+            + ARENA_CHUNK_ALIGN - 1) & ~(size_t)(ARENA_CHUNK_ALIGN - 1))
+
+#define ARENA_HUGE_PAGE_LEN (2 * 1024 * 1024)
+
+#define chunk_data(chunk) ((char *)(chunk) + ARENA_HDR_LEN)
+
+/* capacity of a chunk holding at least need bytes. */
+static size_t arena_chunk_cap(st_arena_t *arena, size_t need)
+{
+    size_t len;
+
+    need = max(need, arena->chunk_size);
+    if (!(arena->flags & ST_ARENA_HUGE_PAGE)) {
+        return need;
+    }
+
+    len = (ARENA_HDR_LEN + need + ARENA_HUGE_PAGE_LEN - 1)
+        & ~(size_t)(ARENA_HUGE_PAGE_LEN - 1);
+    return len - ARENA_HDR_LEN;
+}
+
+/*
+ * mmap len bytes aligned to a huge page, so that the kernel can back
+ * them with huge pages. Reserved huge pages are tried first, then
+ * transparent ones.
+ */
+static void* arena_map_huge(size_t len)
+{
+    char *addr;
+    size_t head;
+    size_t tail;
+
+#ifdef MAP_HUGETLB
+    addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (addr != MAP_FAILED) {
+        return addr;
+    }
+#endif
+
+    addr = mmap(NULL, len + ARENA_HUGE_PAGE_LEN, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    head = (ARENA_HUGE_PAGE_LEN - ((uintptr_t)addr & (ARENA_HUGE_PAGE_LEN - 1)))
+        & (ARENA_HUGE_PAGE_LEN - 1);
+    tail = ARENA_HUGE_PAGE_LEN - head;
+    if (head > 0) {
+        (void)munmap(addr, head);
+    }
+    if (tail > 0) {
+        (void)munmap(addr + head + len, tail);
+    }
+    addr += head;
+
+#ifdef MADV_HUGEPAGE
+    (void)madvise(addr, len, MADV_HUGEPAGE);
+#endif
+
+    return addr;
+}
+
+static void arena_free_chunk(st_arena_chunk_t *chunk)
+{
+    if (chunk->map_len > 0) {
+        (void)munmap(chunk, chunk->map_len);
+    } else {
+        st_aligned_free(chunk);
+    }
+}
+
+static st_arena_chunk_t* arena_new_chunk(st_arena_t *arena, size_t need)
+{
+    st_arena_chunk_t *chunk = NULL;
+    size_t cap;
+
+    if (arena->spare != NULL && arena->spare->cap >= need) {
+        chunk = arena->spare;
+        arena->spare = chunk->prev;
+    } else {
+        if (need > SIZE_MAX - ARENA_HDR_LEN - ARENA_HUGE_PAGE_LEN) {
+            ST_WARNING("Too large block[%zu].", need);
+            return NULL;
+        }
+
+        cap = arena_chunk_cap(arena, need);
+        if (arena->flags & ST_ARENA_HUGE_PAGE) {
+            chunk = (st_arena_chunk_t *)arena_map_huge(ARENA_HDR_LEN + cap);
+            if (chunk != NULL) {
+                chunk->map_len = ARENA_HDR_LEN + cap;
+            }
+        }
+        if (chunk == NULL) {
+            chunk = (st_arena_chunk_t *)st_aligned_malloc(
+                    ARENA_HDR_LEN + cap, ARENA_CHUNK_ALIGN);
+            if (chunk == NULL) {
+                ST_WARNING("Failed to st_aligned_malloc chunk[%zu].", cap);
+                return NULL;
+            }
+            chunk->map_len = 0;
+        }
+        chunk->cap = cap;
+    }
+
+    chunk->used = 0;
+    chunk->prev = arena->chunk;
+    arena->chunk = chunk;
+
+    return chunk;
+}
+
+/* chunks of a large block are freed, the others kept for reuse. */
+static void arena_give_back(st_arena_t *arena, st_arena_chunk_t *chunk)
+{
+    if (chunk->cap > arena_chunk_cap(arena, arena->chunk_size)) {
+        arena_free_chunk(chunk);
+        return;
+    }
+
+    chunk->prev = arena->spare;
+    arena->spare = chunk;
+}
+
+st_arena_t* st_arena_create(size_t chunk_size, int flags)
+{
+    st_arena_t *arena = NULL;
+
+    arena = (st_arena_t *)malloc(sizeof(st_arena_t));
+    if (arena == NULL) {
+        ST_WARNING("Failed to malloc arena.");
+        return NULL;
+    }
+    memset(arena, 0, sizeof(st_arena_t));
+
+    arena->chunk_size = chunk_size > 0 ? chunk_size : ST_ARENA_CHUNK_SIZE;
+    arena->flags = flags;
+
+    return arena;
+}
+
+void st_arena_destroy(st_arena_t *arena)
+{
+    st_arena_chunk_t *chunk;
+
+    if (arena == NULL) {
+        return;
+    }
+
+    while (arena->chunk != NULL) {
+        chunk = arena->chunk;
+        arena->chunk = chunk->prev;
+        arena_free_chunk(chunk);
+    }
+
+    while (arena->spare != NULL) {
+        chunk = arena->spare;
+        arena->spare = chunk->prev;
+        arena_free_chunk(chunk);
+    }
+
+    arena->last = NULL;
+}
+
+void* st_arena_aligned_alloc(st_arena_t *arena, size_t size,
+        size_t alignment)
+{
+    st_arena_chunk_t *chunk;
+    uintptr_t start;
+    uintptr_t p;
+
+    ST_CHECK_PARAM(arena == NULL, NULL);
+
+    if (!is_power_of_two(alignment)) {
+        ST_WARNING("alignment[%zu] is not power of 2.", alignment);
+        return NULL;
+    }
+
+    chunk = arena->chunk;
+    if (chunk != NULL) {
+        start = (uintptr_t)chunk_data(chunk);
+        p = (start + chunk->used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        if (p - start <= chunk->cap && size <= chunk->cap - (p - start)) {
+            chunk->used = p - start + size;
+            arena->last = (void *)p;
+            return (void *)p;
+        }
+    }
+
+    if (size > SIZE_MAX - alignment) {
+        ST_WARNING("Too large block[%zu].", size);
+        return NULL;
+    }
+
+    chunk = arena_new_chunk(arena, size + alignment - 1);
+    if (chunk == NULL) {
+        ST_WARNING("Failed to arena_new_chunk.");
+        return NULL;
+    }
+
+    start = (uintptr_t)chunk_data(chunk);
+    p = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    chunk->used = p - start + size;
+    arena->last = (void *)p;
+
+    return (void *)p;
+}
+
+void* st_arena_alloc(st_arena_t *arena, size_t size)
+{
+    return st_arena_aligned_alloc(arena, size, ST_ARENA_ALIGNMENT);
+}
+
+void* st_arena_realloc(st_arena_t *arena, void *ptr, size_t old_size,
+        size_t size)
+{
+    st_arena_chunk_t *chunk;
+    size_t offset;
+    void *p;
+
+    ST_CHECK_PARAM(arena == NULL, NULL);
+
+    if (ptr != NULL && ptr == arena->last) {
+        chunk = arena->chunk;
+        offset = (char *)ptr - chunk_data(chunk);
+        if (size <= chunk->cap - offset) {
+            chunk->used = offset + size;
+            return ptr;
+        }
+    }
+
+    p = st_arena_alloc(arena, size);
+    if (p == NULL) {
+        ST_WARNING("Failed to st_arena_alloc.");
+        return NULL;
+    }
+
+    if (ptr != NULL) {
+        memcpy(p, ptr, min(old_size, size));
+    }
+
+    return p;
+}
+
+st_arena_mark_t st_arena_mark(st_arena_t *arena)
+{
+    st_arena_mark_t mark;
+
+    memset(&mark, 0, sizeof(mark));
+    ST_CHECK_PARAM(arena == NULL, mark);
+
+    mark.chunk = arena->chunk;
+    mark.used = arena->chunk != NULL ? arena->chunk->used : 0;
+
+    return mark;
+}
+
+int st_arena_rewind(st_arena_t *arena, st_arena_mark_t mark)
+{
+    st_arena_chunk_t *chunk;
+
+    ST_CHECK_PARAM(arena == NULL, -1);
+
+    for (chunk = arena->chunk; chunk != mark.chunk; chunk = chunk->prev) {
+        if (chunk == NULL) {
+            ST_WARNING("Mark not in arena.");
+            return -1;
+        }
+    }
+    if (chunk != NULL && mark.used > chunk->used) {
+        ST_WARNING("Mark after the current position.");
+        return -1;
+    }
+
+    while (arena->chunk != mark.chunk) {
+        chunk = arena->chunk;
+        arena->chunk = chunk->prev;
+        arena_give_back(arena, chunk);
+    }
+    if (arena->chunk != NULL) {
+        arena->chunk->used = mark.used;
+    }
+    arena->last = NULL;
+
+    return 0;
+}
+
+void st_arena_reset(st_arena_t *arena)
+{
+    st_arena_mark_t mark;
+
+    if (arena == NULL) {
+        return;
+    }
+
+    mark.chunk = NULL;
+    mark.used = 0;
+    (void)st_arena_rewind(arena, mark);
+}
+
+size_t st_arena_used(st_arena_t *arena)
+{
+    st_arena_chunk_t *chunk;
+    size_t used = 0;
+
+    if (arena == NULL) {
+        return 0;
+    }
+
+    for (chunk = arena->chunk; chunk != NULL; chunk = chunk->prev) {
+        used += chunk->used;
+    }
+
+    return used;
+}
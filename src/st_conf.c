@@ -33,11 +33,22 @@
 #define SEC_NUM     10
 #define PARAM_NUM    100
 
+static void* conf_realloc(st_arena_t *arena, void *ptr, size_t old_size,
+        size_t size)
+{
+    if (arena != NULL) {
+        return st_arena_realloc(arena, ptr, old_size, size);
+    }
+
+    return realloc(ptr, size);
+}
+
 static int resize_sec(st_conf_section_t *sec)
 {
     if (sec->param_num >= sec->param_cap) {
         sec->param_cap += PARAM_NUM;
-        sec->param = (st_conf_param_t *) realloc(sec->param,
+        sec->param = (st_conf_param_t *) conf_realloc(sec->mem_arena, sec->param,
+                    sec->param_num * sizeof(st_conf_param_t),
                     sec->param_cap * sizeof(st_conf_param_t));
         if (sec->param == NULL) {
             ST_WARNING("Failed to realloc param for sec.");
@@ -49,7 +60,9 @@ static int resize_sec(st_conf_section_t *sec)
 
     if (sec->def_param_num >= sec->def_param_cap) {
         sec->def_param_cap += PARAM_NUM;
-        sec->def_param = (st_conf_param_t *) realloc(sec->def_param,
+        sec->def_param = (st_conf_param_t *) conf_realloc(sec->mem_arena,
+                    sec->def_param,
+                    sec->def_param_num * sizeof(st_conf_param_t),
                     sec->def_param_cap * sizeof(st_conf_param_t));
         if (sec->def_param == NULL) {
             ST_WARNING("Failed to realloc def_param for sec.");
@@ -76,7 +89,8 @@ st_conf_section_t* st_conf_new_sec(st_conf_t *conf, const char *name)
 
     if (conf->sec_num >= conf->sec_cap) {
         conf->sec_cap += SEC_NUM;
-        conf->secs = (st_conf_section_t *) realloc(conf->secs,
+        conf->secs = (st_conf_section_t *) conf_realloc(conf->mem_arena, conf->secs,
+                    conf->sec_num * sizeof(st_conf_section_t),
                     conf->sec_cap * sizeof(st_conf_section_t));
         if (conf->secs == NULL) {
             ST_WARNING("Failed to realloc secs.");
@@ -87,6 +101,7 @@ st_conf_section_t* st_conf_new_sec(st_conf_t *conf, const char *name)
     }
 
     strncpy(conf->secs[conf->sec_num].name, name, MAX_ST_CONF_LEN);
+    conf->secs[conf->sec_num].mem_arena = conf->mem_arena;
     if (resize_sec(conf->secs + conf->sec_num) < 0) {
         ST_WARNING("Failed to resize_sec.");
         goto ERR;
@@ -256,6 +271,11 @@ st_conf_section_t* st_conf_def_sec(st_conf_t *conf)
 }
 
 st_conf_t* st_conf_create()
+{
+    return st_conf_create_in(NULL);
+}
+
+st_conf_t* st_conf_create_in(st_arena_t *mem_arena)
 {
     st_conf_t *pconf = NULL;
 
@@ -265,6 +285,7 @@ st_conf_t* st_conf_create()
         goto ERR;
     }
     memset(pconf, 0, sizeof(st_conf_t));
+    pconf->mem_arena = mem_arena;
 
     if (st_conf_new_sec(pconf, DEF_SEC_NAME) == NULL) {
         ST_WARNING("Failed to st_conf_new_sec.");
@@ -787,24 +808,25 @@ void st_conf_destroy(st_conf_t * pconf)
     int i;
     if (pconf != NULL) {
         for (i = 0; i < pconf->sec_num; i++) {
-            if (pconf->secs[i].param != NULL) {
+            /* memory of mem_arena goes with mem_arena. */
+            if (pconf->secs[i].param != NULL && pconf->mem_arena == NULL) {
                 free(pconf->secs[i].param);
-                pconf->secs[i].param = NULL;
             }
+            pconf->secs[i].param = NULL;
             pconf->secs[i].param_cap = 0;
             pconf->secs[i].param_num = 0;
 
-            if (pconf->secs[i].def_param != NULL) {
+            if (pconf->secs[i].def_param != NULL && pconf->mem_arena == NULL) {
                 free(pconf->secs[i].def_param);
-                pconf->secs[i].def_param = NULL;
             }
+            pconf->secs[i].def_param = NULL;
             pconf->secs[i].def_param_cap = 0;
             pconf->secs[i].def_param_num = 0;
         }
-        if (pconf->secs != NULL) {
+        if (pconf->secs != NULL && pconf->mem_arena == NULL) {
             free(pconf->secs);
-            pconf->secs = NULL;
         }
+        pconf->secs = NULL;
         pconf->sec_cap = 0;
         pconf->sec_num = 0;
     }
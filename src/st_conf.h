@@ -30,6 +30,7 @@ extern "C" {
 #endif
 
 #include <stutils/st_macro.h>
+#include "st_arena.h"
 
 #define MAX_ST_CONF_LEN        256
 #define MAX_ST_CONF_LINE_LEN   1024
@@ -56,6 +57,8 @@ typedef struct _st_conf_section_t_
     int def_param_cap;
 
     int comment_out;
+
+    st_arena_t *mem_arena; /* params live here if not NULL. */
 } st_conf_section_t;
 
 typedef struct _st_conf_t_
@@ -63,10 +66,24 @@ typedef struct _st_conf_t_
 	st_conf_section_t *secs;
 	int sec_num;
     int sec_cap;
+
+    st_arena_t *mem_arena; /* secs and params live here if not NULL. */
 } st_conf_t;
 
 st_conf_t* st_conf_create();
 
+/*
+ * Create a conf whose sections and params are allocated from an arena.
+ *
+ * The conf itself is still malloced and released by safe_st_conf_destroy,
+ * which leaves mem_arena alone. mem_arena must not be reset or rewound
+ * before the conf is destroyed.
+ *
+ * @param[in] mem_arena the arena, NULL for the heap as st_conf_create.
+ * @return the conf, NULL if any error.
+ */
+st_conf_t* st_conf_create_in(st_arena_t *mem_arena);
+
 int st_conf_load(st_conf_t *st_conf, const char *conf_file);
 
 #define safe_st_conf_destroy(ptr) do {\
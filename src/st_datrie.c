@@ -0,0 +1,677 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <stutils/st_macro.h>
+#include "st_log.h"
+#include "st_utils.h"
+#include "st_datrie.h"
+
+#define DATRIE_MAGIC       0x45495244
+#define DATRIE_VERSION     1
+
+#define DATRIE_ALIGN       4096
+
+/* check of a unit not used by any node, and of the root. */
+#define DATRIE_FREE        (-1)
+#define DATRIE_ROOT_CHECK  (-2)
+
+/*
+ * The search for a base starts at the first free unit. Once the units
+ * passed over by a search are this full, later searches start after
+ * them, which keeps building linear at a small cost in density.
+ */
+#define DATRIE_DENSITY     0.95
+
+typedef struct _datrie_header_t
+{
+    uint32_t     magic;
+    uint32_t     version;
+    uint64_t     unit_num;
+    uint64_t     units_offset; /* relative to the start of the header. */
+} datrie_header_t;
+
+typedef struct _datrie_key_t
+{
+    const char   *key;
+    size_t       len;
+    int          value;
+} datrie_key_t;
+
+/* a node whose children are the keys in [lo, hi), sharing depth bytes. */
+typedef struct _datrie_task_t
+{
+    uint32_t     node;
+    size_t       depth;
+    int          lo;
+    int          hi;
+} datrie_task_t;
+
+typedef struct _datrie_builder_t
+{
+    st_datrie_unit_t *units;
+    size_t           cap;
+    uint32_t         num;
+    uint32_t         next_check;
+
+    datrie_key_t     *keys;
+
+    datrie_task_t    *tasks;
+    size_t           task_num;
+    size_t           task_cap;
+} datrie_builder_t;
+
+/* the unit following node s by byte c, or false if there is none. */
+static inline bool datrie_next(st_datrie_t *dt, uint32_t *s, unsigned char c)
+{
+    uint32_t t;
+
+    t = (uint32_t)dt->units[*s].base + c + 1;
+    if (t >= dt->unit_num || dt->units[t].check != (int32_t)*s) {
+        return false;
+    }
+    *s = t;
+
+    return true;
+}
+
+/* value of the key ending at node s, -1 if no key ends there. */
+static inline int datrie_value(st_datrie_t *dt, uint32_t s)
+{
+    uint32_t t;
+
+    t = (uint32_t)dt->units[s].base;
+    if (t >= dt->unit_num || dt->units[t].check != (int32_t)s) {
+        return -1;
+    }
+
+    return dt->units[t].base >= 0 ? dt->units[t].base : -1;
+}
+
+void st_datrie_destroy(st_datrie_t *dt)
+{
+    if (dt == NULL) {
+        return;
+    }
+
+    if (dt->map_addr != NULL) {
+        (void)munmap(dt->map_addr, dt->map_len);
+        dt->map_addr = NULL;
+        dt->map_len = 0;
+        dt->units = NULL;
+    }
+    safe_free(dt->units);
+    dt->unit_num = 0;
+}
+
+static st_datrie_t* st_datrie_alloc()
+{
+    st_datrie_t *dt = NULL;
+
+    dt = (st_datrie_t *)malloc(sizeof(st_datrie_t));
+    if (dt == NULL) {
+        ST_WARNING("Failed to alloc mem for st_datrie.");
+        return NULL;
+    }
+    memset(dt, 0, sizeof(st_datrie_t));
+
+    return dt;
+}
+
+static int datrie_key_cmp(const void *elem1, const void *elem2, void *args)
+{
+    const datrie_key_t *k1 = (const datrie_key_t *)elem1;
+    const datrie_key_t *k2 = (const datrie_key_t *)elem2;
+    int ret;
+
+    ret = memcmp(k1->key, k2->key, min(k1->len, k2->len));
+    if (ret != 0) {
+        return ret;
+    }
+
+    return k1->len < k2->len ? -1 : (k1->len > k2->len ? 1 : 0);
+}
+
+/* 0 for the end of key, byte + 1 otherwise. */
+static inline int datrie_code(datrie_key_t *k, size_t depth)
+{
+    return k->len == depth ? 0 : (unsigned char)k->key[depth] + 1;
+}
+
+/* make units [0, n) available. */
+static int datrie_reserve(datrie_builder_t *b, size_t n)
+{
+    st_datrie_unit_t *units;
+    size_t cap;
+    size_t i;
+
+    if (n <= b->cap) {
+        return 0;
+    }
+
+    if (n > INT32_MAX) {
+        ST_WARNING("Too many units[%zu].", n);
+        return -1;
+    }
+
+    cap = max(b->cap, 256);
+    while (cap < n) {
+        cap *= 2;
+    }
+    cap = min(cap, (size_t)INT32_MAX);
+
+    units = (st_datrie_unit_t *)realloc(b->units,
+            sizeof(st_datrie_unit_t) * cap);
+    if (units == NULL) {
+        ST_WARNING("Failed to realloc units[%zu].", cap);
+        return -1;
+    }
+    for (i = b->cap; i < cap; i++) {
+        units[i].base = 0;
+        units[i].check = DATRIE_FREE;
+    }
+    b->units = units;
+    b->cap = cap;
+
+    return 0;
+}
+
+static int datrie_push(datrie_builder_t *b, uint32_t node, size_t depth,
+        int lo, int hi)
+{
+    datrie_task_t *tasks;
+    size_t cap;
+
+    if (b->task_num >= b->task_cap) {
+        cap = max(b->task_cap * 2, 256);
+        tasks = (datrie_task_t *)realloc(b->tasks,
+                sizeof(datrie_task_t) * cap);
+        if (tasks == NULL) {
+            ST_WARNING("Failed to realloc tasks[%zu].", cap);
+            return -1;
+        }
+        b->tasks = tasks;
+        b->task_cap = cap;
+    }
+
+    b->tasks[b->task_num].node = node;
+    b->tasks[b->task_num].depth = depth;
+    b->tasks[b->task_num].lo = lo;
+    b->tasks[b->task_num].hi = hi;
+    b->task_num++;
+
+    return 0;
+}
+
+/* find a base placing every code on a free unit. */
+static int datrie_find_base(datrie_builder_t *b, int *codes, int ncode,
+        uint32_t *base)
+{
+    size_t start;
+    size_t pos;
+    size_t first_free;
+    size_t nonfree;
+    size_t bs;
+    int k;
+
+    start = max((size_t)codes[0] + 1, (size_t)b->next_check);
+    first_free = 0;
+    nonfree = 0;
+    for (pos = start; ; pos++) {
+        if (datrie_reserve(b, pos + 1) < 0) {
+            return -1;
+        }
+        if (b->units[pos].check != DATRIE_FREE) {
+            nonfree++;
+            continue;
+        }
+        if (first_free == 0) {
+            first_free = pos;
+        }
+
+        bs = pos - codes[0];
+        if (datrie_reserve(b, bs + codes[ncode - 1] + 1) < 0) {
+            return -1;
+        }
+        for (k = 1; k < ncode; k++) {
+            if (b->units[bs + codes[k]].check != DATRIE_FREE) {
+                break;
+            }
+        }
+        if (k >= ncode) {
+            break;
+        }
+    }
+
+    /* units before first_free were all passed over as used. */
+    if (nonfree >= DATRIE_DENSITY * (pos - first_free + 1)) {
+        b->next_check = (uint32_t)pos;
+    } else if (start == b->next_check) {
+        b->next_check = (uint32_t)first_free;
+    }
+
+    *base = (uint32_t)bs;
+
+    return 0;
+}
+
+static int datrie_build_node(datrie_builder_t *b, datrie_task_t task)
+{
+    int codes[UCHAR_MAX + 2];
+    int starts[UCHAR_MAX + 3];
+    uint32_t base;
+    uint32_t t;
+    int ncode;
+    int c;
+    int i;
+
+    ncode = 0;
+    for (i = task.lo; i < task.hi; i++) {
+        c = datrie_code(b->keys + i, task.depth);
+        if (ncode == 0 || codes[ncode - 1] != c) {
+            codes[ncode] = c;
+            starts[ncode] = i;
+            ncode++;
+        } else if (c == 0) {
+            ST_WARNING("Duplicated key[%.*s].", (int)b->keys[i].len,
+                    b->keys[i].key);
+            return -1;
+        }
+    }
+    starts[ncode] = task.hi;
+
+    if (datrie_find_base(b, codes, ncode, &base) < 0) {
+        ST_WARNING("Failed to datrie_find_base.");
+        return -1;
+    }
+
+    b->units[task.node].base = (int32_t)base;
+    for (i = 0; i < ncode; i++) {
+        t = base + codes[i];
+        b->units[t].check = (int32_t)task.node;
+        b->num = max(b->num, t + 1);
+        if (codes[i] == 0) {
+            b->units[t].base = b->keys[starts[i]].value;
+        } else if (datrie_push(b, t, task.depth + 1, starts[i],
+                    starts[i + 1]) < 0) {
+            ST_WARNING("Failed to datrie_push.");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+st_datrie_t* st_datrie_build(const char **keys, const size_t *lens,
+        const int *values, int num)
+{
+    st_datrie_t *dt = NULL;
+    datrie_builder_t b;
+    size_t head;
+    int i;
+
+    ST_CHECK_PARAM(num < 0 || (num > 0 && (keys == NULL || lens == NULL
+                    || values == NULL)), NULL);
+
+    memset(&b, 0, sizeof(b));
+
+    b.keys = (datrie_key_t *)malloc(sizeof(datrie_key_t) * max(num, 1));
+    if (b.keys == NULL) {
+        ST_WARNING("Failed to alloc mem for keys.");
+        goto ERR;
+    }
+    for (i = 0; i < num; i++) {
+        if (values[i] < 0) {
+            ST_WARNING("Negative value[%d] of key[%d].", values[i], i);
+            goto ERR;
+        }
+        b.keys[i].key = keys[i];
+        b.keys[i].len = lens[i];
+        b.keys[i].value = values[i];
+    }
+    st_qsort(b.keys, num, sizeof(datrie_key_t), datrie_key_cmp, NULL);
+
+    if (datrie_reserve(&b, 1) < 0) {
+        ST_WARNING("Failed to datrie_reserve.");
+        goto ERR;
+    }
+    b.units[0].check = DATRIE_ROOT_CHECK;
+    b.num = 1;
+    b.next_check = 1;
+
+    /* breadth first, so the top levels of the trie stay close. */
+    if (num > 0 && datrie_push(&b, 0, 0, 0, num) < 0) {
+        ST_WARNING("Failed to datrie_push.");
+        goto ERR;
+    }
+    /* tasks may move as children are pushed, build from a copy. */
+    for (head = 0; head < b.task_num; head++) {
+        if (datrie_build_node(&b, b.tasks[head]) < 0) {
+            ST_WARNING("Failed to datrie_build_node.");
+            goto ERR;
+        }
+    }
+
+    dt = st_datrie_alloc();
+    if (dt == NULL) {
+        ST_WARNING("Failed to st_datrie_alloc.");
+        goto ERR;
+    }
+    dt->units = (st_datrie_unit_t *)realloc(b.units,
+            sizeof(st_datrie_unit_t) * b.num);
+    if (dt->units == NULL) {
+        ST_WARNING("Failed to realloc units.");
+        goto ERR;
+    }
+    b.units = NULL;
+    dt->unit_num = b.num;
+
+    safe_free(b.keys);
+    safe_free(b.tasks);
+
+    return dt;
+
+ERR:
+    safe_free(b.units);
+    safe_free(b.keys);
+    safe_free(b.tasks);
+    safe_st_datrie_destroy(dt);
+    return NULL;
+}
+
+int st_datrie_seek(st_datrie_t *dt, const char *key, size_t len)
+{
+    uint32_t s;
+    size_t i;
+
+    ST_CHECK_PARAM(dt == NULL || key == NULL, -1);
+
+    s = 0;
+    for (i = 0; i < len; i++) {
+        if (!datrie_next(dt, &s, (unsigned char)key[i])) {
+            return -1;
+        }
+    }
+
+    return datrie_value(dt, s);
+}
+
+int st_datrie_longest_prefix(st_datrie_t *dt, const char *str, size_t len,
+        size_t *match_len)
+{
+    uint32_t s;
+    size_t i;
+    int value;
+    int ret;
+
+    ST_CHECK_PARAM(dt == NULL || str == NULL, -1);
+
+    s = 0;
+    ret = datrie_value(dt, s);
+    if (ret >= 0 && match_len != NULL) {
+        *match_len = 0;
+    }
+    for (i = 0; i < len; i++) {
+        if (!datrie_next(dt, &s, (unsigned char)str[i])) {
+            break;
+        }
+        value = datrie_value(dt, s);
+        if (value >= 0) {
+            ret = value;
+            if (match_len != NULL) {
+                *match_len = i + 1;
+            }
+        }
+    }
+
+    return ret;
+}
+
+int st_datrie_common_prefix(st_datrie_t *dt, const char *str, size_t len,
+        int *values, size_t *match_lens, int cap)
+{
+    uint32_t s;
+    size_t i;
+    int value;
+    int n;
+
+    ST_CHECK_PARAM(dt == NULL || str == NULL || cap < 0
+            || (cap > 0 && values == NULL), -1);
+
+    n = 0;
+    s = 0;
+    for (i = 0; ; i++) {
+        value = datrie_value(dt, s);
+        if (value >= 0) {
+            if (n < cap) {
+                values[n] = value;
+                if (match_lens != NULL) {
+                    match_lens[n] = i;
+                }
+            }
+            n++;
+        }
+        if (i >= len || !datrie_next(dt, &s, (unsigned char)str[i])) {
+            break;
+        }
+    }
+
+    return n;
+}
+
+static inline uint64_t datrie_align(uint64_t off)
+{
+    return (off + DATRIE_ALIGN - 1) & ~((uint64_t)DATRIE_ALIGN - 1);
+}
+
+static int datrie_check_header(datrie_header_t *header)
+{
+    if (header->magic != DATRIE_MAGIC) {
+        ST_WARNING("Magic num not match.");
+        return -1;
+    }
+
+    if (header->version > DATRIE_VERSION) {
+        ST_WARNING("Too high version[%u/%u].", header->version,
+                DATRIE_VERSION);
+        return -1;
+    }
+
+    if (header->unit_num == 0 || header->unit_num > INT32_MAX
+            || header->units_offset < sizeof(datrie_header_t)) {
+        ST_WARNING("Corrupted header.");
+        return -1;
+    }
+
+    return 0;
+}
+
+int st_datrie_save(st_datrie_t *dt, FILE *fp)
+{
+    datrie_header_t header;
+    char pad[256];
+    size_t n;
+    size_t sz;
+    long pos;
+
+    ST_CHECK_PARAM(dt == NULL || fp == NULL, -1);
+
+    pos = ftell(fp);
+    if (pos < 0) {
+        pos = 0;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = DATRIE_MAGIC;
+    header.version = DATRIE_VERSION;
+    header.unit_num = dt->unit_num;
+    header.units_offset = datrie_align(pos + sizeof(header)) - pos;
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        ST_WARNING("Failed to write header.");
+        return -1;
+    }
+
+    memset(pad, 0, sizeof(pad));
+    n = header.units_offset - sizeof(header);
+    while (n > 0) {
+        sz = min(n, sizeof(pad));
+        if (fwrite(pad, 1, sz, fp) != sz) {
+            ST_WARNING("Failed to write padding.");
+            return -1;
+        }
+        n -= sz;
+    }
+
+    if (fwrite(dt->units, sizeof(st_datrie_unit_t), dt->unit_num, fp)
+            != dt->unit_num) {
+        ST_WARNING("Failed to write units.");
+        return -1;
+    }
+
+    fflush(fp);
+
+    return 0;
+}
+
+st_datrie_t* st_datrie_load_from_bin(FILE *fp)
+{
+    st_datrie_t *dt = NULL;
+    datrie_header_t header;
+    char pad[256];
+    size_t n;
+    size_t sz;
+
+    ST_CHECK_PARAM(fp == NULL, NULL);
+
+    if (fread(&header, sizeof(header), 1, fp) != 1) {
+        ST_WARNING("Failed to read header.");
+        return NULL;
+    }
+    if (datrie_check_header(&header) < 0) {
+        ST_WARNING("Failed to datrie_check_header.");
+        return NULL;
+    }
+
+    n = header.units_offset - sizeof(header);
+    while (n > 0) {
+        sz = min(n, sizeof(pad));
+        if (fread(pad, 1, sz, fp) != sz) {
+            ST_WARNING("Failed to read padding.");
+            return NULL;
+        }
+        n -= sz;
+    }
+
+    dt = st_datrie_alloc();
+    if (dt == NULL) {
+        ST_WARNING("Failed to st_datrie_alloc.");
+        return NULL;
+    }
+    dt->unit_num = (uint32_t)header.unit_num;
+    dt->units = (st_datrie_unit_t *)malloc(sizeof(st_datrie_unit_t)
+            * dt->unit_num);
+    if (dt->units == NULL) {
+        ST_WARNING("Failed to alloc mem for units.");
+        goto ERR;
+    }
+
+    if (fread(dt->units, sizeof(st_datrie_unit_t), dt->unit_num, fp)
+            != dt->unit_num) {
+        ST_WARNING("Failed to read units.");
+        goto ERR;
+    }
+
+    return dt;
+
+ERR:
+    safe_st_datrie_destroy(dt);
+    return NULL;
+}
+
+st_datrie_t* st_datrie_mmap(int fd, off_t offset)
+{
+    st_datrie_t *dt = NULL;
+    datrie_header_t header;
+    struct stat st;
+    void *addr;
+    size_t len;
+    uint64_t size;
+    off_t start;
+    long page_size;
+
+    ST_CHECK_PARAM(fd < 0 || offset < 0, NULL);
+
+    if (pread(fd, &header, sizeof(header), offset) != sizeof(header)) {
+        ST_WARNING("Failed to read header.");
+        return NULL;
+    }
+    if (datrie_check_header(&header) < 0) {
+        ST_WARNING("Failed to datrie_check_header.");
+        return NULL;
+    }
+    size = header.units_offset
+        + sizeof(st_datrie_unit_t) * header.unit_num;
+
+    if (fstat(fd, &st) != 0) {
+        ST_WARNING("Failed to fstat[%m].");
+        return NULL;
+    }
+    if ((uint64_t)st.st_size < offset + size) {
+        ST_WARNING("File truncated[%zu/%zu].", (size_t)st.st_size,
+                (size_t)(offset + size));
+        return NULL;
+    }
+
+    page_size = sysconf(_SC_PAGESIZE);
+    start = offset & ~((off_t)page_size - 1);
+    len = (size_t)(offset - start + size);
+
+    addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, start);
+    if (addr == MAP_FAILED) {
+        ST_WARNING("Failed to mmap[%m].");
+        return NULL;
+    }
+
+    dt = st_datrie_alloc();
+    if (dt == NULL) {
+        ST_WARNING("Failed to st_datrie_alloc.");
+        munmap(addr, len);
+        return NULL;
+    }
+    dt->map_addr = addr;
+    dt->map_len = len;
+    dt->units = (st_datrie_unit_t *)((char *)addr + (offset - start)
+            + header.units_offset);
+    dt->unit_num = (uint32_t)header.unit_num;
+
+    return dt;
+}
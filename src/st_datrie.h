@@ -0,0 +1,143 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _ST_DATRIE_H_
+#define _ST_DATRIE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include <stutils/st_macro.h>
+
+/*
+ * Immutable double-array trie over byte strings.
+ *
+ * Every node s is a unit holding a base and a check. The child of s by
+ * byte c is unit t = base[s] + c + 1 if check[t] == s, and unit
+ * base[s] is the terminal of s if its check is s, the base of a
+ * terminal being the value of the key ending at s. A byte of input
+ * costs one bounds check and one unit read, so walking a string yields
+ * every key that is a prefix of it in a single pass.
+ *
+ * Keys are raw bytes, so UTF-8 or GBK keys match only on whole
+ * characters of the input.
+ */
+
+typedef struct _st_datrie_unit_t
+{
+    int32_t base;
+    int32_t check;
+} st_datrie_unit_t;
+
+typedef struct _st_datrie_t
+{
+    st_datrie_unit_t *units;
+    uint32_t         unit_num;
+
+    /* units live here if mapped from a file. */
+    void             *map_addr;
+    size_t           map_len;
+} st_datrie_t;
+
+/*
+ * Build a trie from keys.
+ *
+ * @param[in] keys the keys, need not be sorted or NUL-terminated.
+ * @param[in] lens length of every key.
+ * @param[in] values value of every key, non-negative.
+ * @param[in] num number of keys, keys must be distinct.
+ * @return the trie, NULL if any error.
+ */
+st_datrie_t* st_datrie_build(const char **keys, const size_t *lens,
+        const int *values, int num);
+
+#define safe_st_datrie_destroy(ptr) do {\
+    if((ptr) != NULL) {\
+        st_datrie_destroy(ptr);\
+        safe_free(ptr);\
+        (ptr) = NULL;\
+    }\
+    } while(0)
+void st_datrie_destroy(st_datrie_t *dt);
+
+/*
+ * Exact lookup.
+ *
+ * @return value of key, -1 if not found.
+ */
+int st_datrie_seek(st_datrie_t *dt, const char *key, size_t len);
+
+/*
+ * Find the longest key that is a prefix of str.
+ *
+ * @param[in] dt the trie.
+ * @param[in] str the input.
+ * @param[in] len bytes of str to match against.
+ * @param[out] match_len length of the key found, may be NULL.
+ * @return value of the key, -1 if no key is a prefix of str.
+ */
+int st_datrie_longest_prefix(st_datrie_t *dt, const char *str, size_t len,
+        size_t *match_len);
+
+/*
+ * Find all keys that are prefixes of str, shortest first.
+ *
+ * @param[in] dt the trie.
+ * @param[in] str the input.
+ * @param[in] len bytes of str to match against.
+ * @param[out] values values of the first cap keys found.
+ * @param[out] match_lens lengths of the first cap keys found, may be NULL.
+ * @param[in] cap capacity of values and match_lens.
+ * @return number of keys found, which may exceed cap, -1 if any error.
+ */
+int st_datrie_common_prefix(st_datrie_t *dt, const char *str, size_t len,
+        int *values, size_t *match_lens, int cap);
+
+/*
+ * Units are written after a header, starting at a page boundary of the
+ * file whenever fp is seekable, so st_datrie_mmap can use them in place.
+ */
+int st_datrie_save(st_datrie_t *dt, FILE *fp);
+st_datrie_t* st_datrie_load_from_bin(FILE *fp);
+
+/*
+ * Map a trie saved by st_datrie_save into memory, read only.
+ *
+ * @param[in] fd file descriptor, can be closed after return.
+ * @param[in] offset file offset where st_datrie_save started writing.
+ * @return the trie, NULL if any error.
+ */
+st_datrie_t* st_datrie_mmap(int fd, off_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,12 +22,406 @@
  * SOFTWARE.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* memfd_create */
+#endif
+
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sched.h>
+
 #include <stutils/st_macro.h>
 #include "st_utils.h"
 #include "st_log.h"
+#include "st_mem.h"
 #include "st_dict.h"
+#include "st_dict_inl.h"
+
+#define ST_DICT_MAGIC   0x54434453
+#define ST_DICT_VERSION 2
+#define ST_DICT_ALIGN   4096
+
+#ifdef _ST_DICT_STATS_
+#define ST_DICT_COUNT(wd, field, n) \
+    (void)__atomic_fetch_add(&(wd)->counter.field, (n), __ATOMIC_RELAXED)
+#else
+#define ST_DICT_COUNT(wd, field, n)
+#endif
+
+/* lookups in flight in st_dict_seek_batch. */
+#define ST_DICT_SEEK_BATCH 16
+
+#define ST_DICT_HASH_ID_UNKNOWN ((uint32_t)-1)
+
+/* header of version 1, with 32-bit ids. */
+typedef struct _st_dict_header_v1_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t hash_num;
+    uint32_t realloc_node_num;
+    uint32_t cur_index;
+    uint32_t node_num;
+    uint32_t addr_mask;
+    uint32_t free_index;
+    uint32_t hash_id;
+    float    max_load_factor;
+    uint32_t rehash_step;
+    uint32_t reserved;
+    uint64_t first_level_offset;
+    uint64_t node_pool_offset;
+    uint64_t size;
+} st_dict_header_v1_t;
+
+/* header of version 2, with 64-bit ids. */
+typedef struct _st_dict_header_v2_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t hash_id;
+    float    max_load_factor;
+    uint64_t hash_num;
+    uint64_t realloc_node_num;
+    uint64_t cur_index;
+    uint64_t node_num;
+    uint64_t addr_mask;
+    uint64_t free_index;
+    uint64_t rehash_step;
+    uint64_t first_level_offset;
+    uint64_t node_pool_offset;
+    uint64_t size;
+} st_dict_header_v2_t;
+
+typedef union _st_dict_header_buf_t
+{
+    uint32_t            head[2]; /* magic and version. */
+    st_dict_header_v1_t v1;
+    st_dict_header_v2_t v2;
+} st_dict_header_buf_t;
+
+/* nodes as stored by version 1 and 2. */
+typedef struct _st_dict_node_v1_t
+{
+    uint32_t sign1;
+    uint32_t sign2;
+    uint32_t value;
+    uint32_t next;
+} st_dict_node_v1_t;
+
+typedef struct _st_dict_node_v2_t
+{
+    uint32_t sign1;
+    uint32_t sign2;
+    uint32_t value;
+    uint32_t reserved;
+    uint64_t next;
+} st_dict_node_v2_t;
+
+/* a header of any version, ids widened to 64 bits. */
+typedef struct _st_dict_header_t
+{
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t node_size;
+    uint32_t hash_id;
+    float    max_load_factor;
+    uint64_t hash_num;
+    uint64_t realloc_node_num;
+    uint64_t cur_index;
+    uint64_t node_num;
+    uint64_t addr_mask;
+    uint64_t free_index; /* UINT64_MAX if none. */
+    uint64_t rehash_step;
+    uint64_t first_level_offset;
+    uint64_t node_pool_offset;
+    uint64_t size;
+} st_dict_header_t;
+
+/* nodes are written to and read from files in chunks of this size. */
+#define ST_DICT_IO_NODES 4096
+
+/* whether ptr lives in the file mapping of wd, and must not be freed. */
+static inline bool st_dict_mapped(st_dict_t *wd, void *ptr)
+{
+    return wd->map_addr != NULL && (char *)ptr >= (char *)wd->map_addr
+        && (char *)ptr < (char *)wd->map_addr + wd->map_len;
+}
+
+static inline int st_dict_check_writable(st_dict_t *wd)
+{
+    if(wd->readonly)
+    {
+        ST_WARNING("st_dict is read-only.");
+        return -1;
+    }
+
+    /* called before every change, snapshots must copy afresh. */
+    wd->map_dirty = true;
+
+    return 0;
+}
+
+/* release the mapping of wd once none of its arrays lives in it. */
+static void st_dict_unmap_unused(st_dict_t *wd)
+{
+    if(wd->map_addr == NULL || st_dict_mapped(wd, wd->first_level_node)
+            || st_dict_mapped(wd, wd->node_pool)
+            || st_dict_mapped(wd, wd->old_first_level_node))
+    {
+        return;
+    }
+
+    munmap(wd->map_addr, wd->map_len);
+    close(wd->map_fd);
+    wd->map_addr = NULL;
+    wd->map_len = 0;
+    wd->map_fd = -1;
+}
+
+/* whether ptr is the reservation node_pool grows in. */
+static inline bool st_dict_reserved(st_dict_t *wd, void *ptr)
+{
+    return wd->pool_addr != NULL && ptr == wd->pool_addr;
+}
+
+/* nodes node_pool may grow to. */
+static inline st_dict_id_t st_dict_pool_cap(st_dict_t *wd)
+{
+    if(st_dict_reserved(wd, wd->node_pool))
+    {
+        return (st_dict_id_t)(wd->pool_len / sizeof(st_dict_node_t));
+    }
+
+    /* ids stop below ST_DICT_BAD_NODE. */
+    return ST_DICT_BAD_NODE;
+}
+
+static void st_dict_unreserve(st_dict_t *wd)
+{
+    munmap(wd->pool_addr, wd->pool_len);
+    if(wd->pool_fd >= 0)
+    {
+        close(wd->pool_fd);
+    }
+    wd->pool_addr = NULL;
+    wd->pool_len = 0;
+    wd->pool_fd = -1;
+}
+
+/*
+ * free an array of wd, which is kept if it lives in the mapping, and
+ * unmapped if it is the reservation.
+ */
+static void st_dict_free_array(st_dict_t *wd, void *ptr)
+{
+    if(ptr == NULL || st_dict_mapped(wd, ptr))
+    {
+        return;
+    }
+
+    if(st_dict_reserved(wd, ptr))
+    {
+        st_dict_unreserve(wd);
+        return;
+    }
+
+    free(ptr);
+}
+
+/*
+ * realloc for node_pool, which may live in the mapping, or grow in
+ * place in the reservation.
+ */
+static st_dict_node_t* st_dict_realloc_pool(st_dict_t *wd,
+        st_dict_id_t max_pool_num)
+{
+    st_dict_node_t *node_pool;
+
+    if(st_dict_reserved(wd, wd->node_pool))
+    {
+        if(max_pool_num > st_dict_pool_cap(wd))
+        {
+            ST_WARNING("Reservation of node_pool is full[%lu].",
+                    (unsigned long)st_dict_pool_cap(wd));
+            return NULL;
+        }
+        return wd->node_pool;
+    }
+
+    if(!st_dict_mapped(wd, wd->node_pool))
+    {
+        return (st_dict_node_t *)realloc(wd->node_pool,
+                max_pool_num*sizeof(st_dict_node_t));
+    }
+
+    node_pool = (st_dict_node_t *)malloc(
+            max_pool_num*sizeof(st_dict_node_t));
+    if(node_pool == NULL)
+    {
+        return NULL;
+    }
+    memcpy(node_pool, wd->node_pool,
+            min(wd->max_pool_num, max_pool_num)*sizeof(st_dict_node_t));
+
+    return node_pool;
+}
+
+/*
+ * Concurrent mode.
+ *
+ * Readers announce themselves in one of two counters, selected by the
+ * parity of epoch, and spread over cache-line sized slots to keep them
+ * from bouncing between cores. To retire a node_pool, the writer flips
+ * the epoch and waits for the counters of the previous parity to drain.
+ */
+#define ST_DICT_READER_SLOTS 64
+#define ST_DICT_CACHE_LINE   64
+
+typedef struct _st_dict_reader_slot_t
+{
+    long active[2];
+    char pad[ST_DICT_CACHE_LINE - 2 * sizeof(long)];
+} st_dict_reader_slot_t;
+
+typedef struct _st_dict_sync_t
+{
+    st_dict_reader_slot_t readers[ST_DICT_READER_SLOTS];
+    unsigned long epoch;
+    pthread_mutex_t write_lock;
+} st_dict_sync_t;
+
+/* sign1 and sign2 as one word, so that a head is published at once. */
+typedef uint64_t __attribute__((may_alias)) st_dict_sign_pair_t;
+
+static unsigned int st_dict_reader_next = 0;
+static __thread int st_dict_reader_slot = -1;
+
+static inline st_dict_reader_slot_t* st_dict_reader(st_dict_sync_t *sync)
+{
+    if(st_dict_reader_slot < 0)
+    {
+        st_dict_reader_slot = __atomic_fetch_add(&st_dict_reader_next, 1,
+                __ATOMIC_RELAXED) % ST_DICT_READER_SLOTS;
+    }
+
+    return sync->readers + st_dict_reader_slot;
+}
+
+/* Returns the parity to pass to st_dict_read_exit. */
+static inline int st_dict_read_enter(st_dict_t *wd)
+{
+    st_dict_reader_slot_t *reader;
+    unsigned long epoch;
+    int parity;
+
+    if(wd->sync == NULL)
+    {
+        return 0;
+    }
+
+    reader = st_dict_reader(wd->sync);
+    while(true)
+    {
+        epoch = __atomic_load_n(&wd->sync->epoch, __ATOMIC_SEQ_CST);
+        parity = (int)(epoch & 1);
+        __atomic_fetch_add(&reader->active[parity], 1, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&wd->sync->epoch, __ATOMIC_SEQ_CST) == epoch)
+        {
+            return parity;
+        }
+        __atomic_fetch_sub(&reader->active[parity], 1, __ATOMIC_RELEASE);
+    }
+}
+
+static inline void st_dict_read_exit(st_dict_t *wd, int parity)
+{
+    if(wd->sync == NULL)
+    {
+        return;
+    }
+
+    __atomic_fetch_sub(&st_dict_reader(wd->sync)->active[parity], 1,
+            __ATOMIC_RELEASE);
+}
+
+/* Wait for all readers entered before the call. Holds write_lock. */
+static void st_dict_synchronize(st_dict_sync_t *sync)
+{
+    unsigned long epoch;
+    int parity;
+    int i;
+
+    epoch = __atomic_load_n(&sync->epoch, __ATOMIC_RELAXED);
+    parity = (int)(epoch & 1);
+    __atomic_store_n(&sync->epoch, epoch + 1, __ATOMIC_SEQ_CST);
+
+    for(i = 0; i < ST_DICT_READER_SLOTS; i++)
+    {
+        while(__atomic_load_n(&sync->readers[i].active[parity],
+                    __ATOMIC_SEQ_CST) != 0)
+        {
+            sched_yield();
+        }
+    }
+}
+
+static inline void st_dict_write_lock(st_dict_t *wd)
+{
+    if(wd != NULL && wd->sync != NULL)
+    {
+        (void)pthread_mutex_lock(&wd->sync->write_lock);
+    }
+}
+
+static inline void st_dict_write_unlock(st_dict_t *wd)
+{
+    if(wd != NULL && wd->sync != NULL)
+    {
+        (void)pthread_mutex_unlock(&wd->sync->write_lock);
+    }
+}
+
+static inline bool st_dict_node_empty(st_dict_node_t *node)
+{
+    return __atomic_load_n((st_dict_sign_pair_t *)node,
+            __ATOMIC_ACQUIRE) == 0;
+}
+
+/* Writes the signs last, so readers never see a half-filled head. */
+static inline void st_dict_publish_head(st_dict_node_t *work,
+        st_dict_node_t *pnode)
+{
+    st_dict_node_t node;
+
+    work->uint1 = pnode->uint1;
+    work->next = ST_DICT_BAD_NODE;
+
+    node.sign1 = pnode->sign1;
+    node.sign2 = pnode->sign2;
+    __atomic_store_n((st_dict_sign_pair_t *)work,
+            *(st_dict_sign_pair_t *)&node, __ATOMIC_RELEASE);
+}
+
+static inline st_dict_id_t st_dict_load_next(st_dict_node_t *node)
+{
+    return __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+}
+
+static inline st_dict_node_t* st_dict_load_pool(st_dict_t *wd)
+{
+    return __atomic_load_n(&wd->node_pool, __ATOMIC_ACQUIRE);
+}
+
+static inline st_dict_id_t st_dict_load_cur_index(st_dict_t *wd)
+{
+    return __atomic_load_n(&wd->cur_index, __ATOMIC_RELAXED);
+}
+
 
 void st_dict_destroy(st_dict_t *wd)
 {
@@ -35,17 +429,32 @@ void st_dict_destroy(st_dict_t *wd)
         return;
     }
 
-    if(wd->first_level_node) {
+    if(wd->first_level_node && !st_dict_mapped(wd, wd->first_level_node)) {
         safe_free(wd->first_level_node);
     }
+    wd->first_level_node = NULL;
+
+    st_dict_free_array(wd, wd->node_pool);
+    wd->node_pool = NULL;
 
-    if(wd->node_pool) {
-        safe_free(wd->node_pool);
-    }
-    
     if(wd->clear_nodes) {
         safe_free(wd->clear_nodes);
     }
+
+    if(wd->old_first_level_node
+            && !st_dict_mapped(wd, wd->old_first_level_node)) {
+        safe_free(wd->old_first_level_node);
+    }
+    wd->old_first_level_node = NULL;
+
+    if(wd->map_addr != NULL) {
+        munmap(wd->map_addr, wd->map_len);
+        close(wd->map_fd);
+        wd->map_addr = NULL;
+        wd->map_len = 0;
+    }
+
+    (void)st_dict_set_concurrent(wd, false);
 }
 
 st_dict_id_t st_dict_hash_simple(st_dict_t *wd, st_dict_node_t *pnode)
@@ -63,12 +472,109 @@ st_dict_id_t st_dict_hash_sign1(st_dict_t *wd, st_dict_node_t *pnode)
     return (pnode->sign1 & wd->addr_mask);
 }
 
+static inline uint64_t st_dict_sign64(st_dict_node_t *pnode)
+{
+    return (((uint64_t)pnode->sign1) << 32) | pnode->sign2;
+}
+
+st_dict_id_t st_dict_hash_murmur(st_dict_t *wd, st_dict_node_t *pnode)
+{
+    return ((st_dict_id_t)st_dict_fmix64(pnode->sign1, pnode->sign2))
+        & wd->addr_mask;
+}
+
+st_dict_id_t st_dict_hash_wy(st_dict_t *wd, st_dict_node_t *pnode)
+{
+    __uint128_t r;
+
+    /* wymix of the two signs with the wyhash secrets. */
+    r = (__uint128_t)(pnode->sign1 ^ 0xa0761d6478bd642fULL)
+        * (pnode->sign2 ^ 0xe7037ed1a0b428dbULL);
+
+    return ((st_dict_id_t)((uint64_t)r ^ (uint64_t)(r >> 64)))
+        & wd->addr_mask;
+}
+
+st_dict_id_t st_dict_hash_xxh3(st_dict_t *wd, st_dict_node_t *pnode)
+{
+    uint64_t h;
+
+    /* rrmxmx, the avalanche of XXH3 for 8 bytes inputs. */
+    h = st_dict_sign64(pnode);
+    h ^= ((h << 49) | (h >> 15)) ^ ((h << 24) | (h >> 40));
+    h *= 0x9fb21c651e98df25ULL;
+    h ^= (h >> 35) + 8;
+    h *= 0x9fb21c651e98df25ULL;
+    h ^= h >> 28;
+
+    return ((st_dict_id_t)h) & wd->addr_mask;
+}
+
+st_dict_id_t st_dict_hash_auto(st_dict_t *wd, st_dict_node_t *pnode)
+{
+    return st_dict_hash_murmur(wd, pnode);
+}
+
 bool st_dict_node_equal(st_dict_node_t *node1, st_dict_node_t *node2,
     void *arg )
 {
     return ((node1->sign1 == node2->sign1) && (node1->sign2 == node2->sign2));
 }
 
+static st_dict_hash_fun_t st_dict_hash_funcs[] = {
+    st_dict_hash_simple,
+    st_dict_hash_sign1l16,
+    st_dict_hash_sign1,
+    st_dict_hash_murmur,
+    st_dict_hash_wy,
+    st_dict_hash_xxh3,
+};
+
+#define ST_DICT_HASH_FUNC_NUM \
+    (sizeof(st_dict_hash_funcs) / sizeof(st_dict_hash_funcs[0]))
+
+static uint32_t st_dict_hash_id(st_dict_hash_fun_t hash_func)
+{
+    uint32_t i;
+
+    for(i = 0; i < ST_DICT_HASH_FUNC_NUM; i++)
+    {
+        if(st_dict_hash_funcs[i] == hash_func)
+        {
+            return i;
+        }
+    }
+
+    return ST_DICT_HASH_ID_UNKNOWN;
+}
+
+static st_dict_hash_fun_t st_dict_hash_by_id(uint32_t hash_id)
+{
+    if(hash_id >= ST_DICT_HASH_FUNC_NUM)
+    {
+        ST_WARNING("Unknown hash function[%u], use st_dict_hash_simple. "
+                "Reset hash_func if a custom one was used.", hash_id);
+        return st_dict_hash_simple;
+    }
+
+    return st_dict_hash_funcs[hash_id];
+}
+
+/* highest_bit_mask(num, false) for ids of either size. */
+static inline st_dict_id_t st_dict_mask(st_dict_id_t num)
+{
+    st_dict_id_t mask;
+
+    mask = num >> 1;
+    mask |= mask >> 1;
+    mask |= mask >> 2;
+    mask |= mask >> 4;
+    mask |= mask >> 8;
+    mask |= mask >> 16;
+
+    return mask;
+}
+
 static st_dict_t* st_dict_alloc()
 {
     st_dict_t *wd;
@@ -80,6 +586,8 @@ static st_dict_t* st_dict_alloc()
         return NULL;
     }
     memset(wd, 0, sizeof(st_dict_t));
+    wd->free_index = ST_DICT_BAD_NODE;
+    wd->rehash_step = ST_DICT_REHASH_STEP;
 
     return wd;
 }
@@ -101,8 +609,15 @@ st_dict_t* st_dict_create(st_dict_id_t hash_num,
         return NULL;
     }
     bzero(wd, sizeof(st_dict_t));
+    wd->free_index = ST_DICT_BAD_NODE;
+    wd->rehash_step = ST_DICT_REHASH_STEP;
     wd->realloc_node_num = realloc_node_num;
-    if(hash_func)
+    if(hash_func == st_dict_hash_auto)
+    {
+        wd->hash_func = st_dict_hash_murmur;
+        wd->hash_sample_num = ST_DICT_HASH_SAMPLE_NUM;
+    }
+    else if(hash_func)
     {
         wd->hash_func = hash_func;
     }
@@ -119,12 +634,12 @@ st_dict_t* st_dict_create(st_dict_id_t hash_num,
         wd->node_eq_func = st_dict_node_equal;
     }
 
-    wd->addr_mask = highest_bit_mask(hash_num, false);
+    wd->addr_mask = st_dict_mask(hash_num);
     wd->hash_num = wd->addr_mask + 1;
     //ST_DEBUG("num=%d(0x%x), mask=0x%x, num=%d(0x%x)", hash_num, hash_num,
         //wd->addr_mask, wd->hash_num, wd->hash_num);
     wd->first_level_node = (st_dict_node_t *)
-        malloc(sizeof(st_dict_node_t) * wd->hash_num);
+        calloc(wd->hash_num, sizeof(st_dict_node_t));
     if(wd->first_level_node == NULL)
     {
         ST_WARNING("Failed to alloc mem for first_level_node.");
@@ -132,7 +647,7 @@ st_dict_t* st_dict_create(st_dict_id_t hash_num,
     }
 
     wd->node_pool = (st_dict_node_t *)
-        malloc(sizeof(st_dict_node_t)*wd->hash_num);
+        calloc(wd->hash_num, sizeof(st_dict_node_t));
     if(wd->node_pool == NULL)
     {
         ST_WARNING("Failed to alloc mem for node_pool.");
@@ -174,521 +689,3117 @@ FAILED:
     return NULL;
 }
 
-static st_dict_id_t st_dict_add_in(st_dict_t *wd, st_dict_node_t *pnode)
+int st_dict_reserve_pool(st_dict_t *wd, st_dict_id_t max_pool_num, int fd)
 {
-    st_dict_node_t *node;
+    st_dict_node_t *node_pool;
+    void *addr;
+    size_t len;
+    int pool_fd = -1;
 
-    if(wd->cur_index >= wd->max_pool_num)
-    {
-        wd->node_pool = (st_dict_node_t *)realloc(wd->node_pool,
-            (wd->max_pool_num + wd->realloc_node_num)*sizeof(st_dict_node_t));
-        if(wd->node_pool == NULL)
-        {
-            ST_WARNING("Realloc node_pool failed.");
-            return ST_DICT_BAD_NODE;
-        }
-        bzero(wd->node_pool + wd->max_pool_num, wd->realloc_node_num*sizeof(st_dict_node_t));
+    ST_CHECK_PARAM(wd == NULL || max_pool_num < wd->max_pool_num, -1);
 
-        wd->max_pool_num += wd->realloc_node_num;
+    if(st_dict_check_writable(wd) < 0)
+    {
+        return -1;
     }
-    node = &wd->node_pool[wd->cur_index];
-    node->sign1 = pnode->sign1;
-    node->sign2 = pnode->sign2;
-    node->uint1 = pnode->uint1;
-    node->next = ST_DICT_BAD_NODE;
-
-    return wd->cur_index++;
-}
-
-int st_dict_add(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg)
-{
-    st_dict_id_t hash_key;
-    st_dict_id_t ret;
-    st_dict_node_t *work;
 
-    ST_CHECK_PARAM(pnode == NULL 
-            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
-
-    if(st_dict_seek(wd, pnode, node_eq_arg)== 0)
+    if(wd->sync != NULL)
     {
-        ST_WARNING("node already exists");
+        ST_WARNING("Can not reserve node_pool in concurrent mode.");
         return -1;
     }
 
-    hash_key = wd->hash_func(wd, pnode);
-    work = wd->first_level_node + hash_key;
-    if(work->sign1 == 0 && work->sign2 == 0)
+    if(wd->pool_addr != NULL)
     {
-        work->sign1 = pnode->sign1;
-        work->sign2 = pnode->sign2;
-        work->uint1 = pnode->uint1;
-        work->next = ST_DICT_BAD_NODE;
+        ST_WARNING("node_pool is already reserved.");
+        return -1;
+    }
 
-        if(wd->clear_nodes != NULL)
+    len = sizeof(st_dict_node_t) * (size_t)max(max_pool_num, 1);
+    if(fd >= 0)
+    {
+        pool_fd = dup(fd);
+        if(pool_fd < 0)
+        {
+            ST_WARNING("Failed to dup fd[%m].");
+            return -1;
+        }
+        if(ftruncate(pool_fd, len) != 0)
         {
-            wd->clear_nodes[wd->clear_node_num++] = hash_key;
+            ST_WARNING("Failed to ftruncate[%m].");
+            close(pool_fd);
+            return -1;
         }
+        addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_NORESERVE, pool_fd, 0);
     }
     else
     {
-        ret = st_dict_add_in(wd, pnode);
-        if(ret == ST_DICT_BAD_NODE)
+        addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    if(addr == MAP_FAILED)
+    {
+        ST_WARNING("Failed to mmap[%m].");
+        if(pool_fd >= 0)
         {
-            ST_WARNING("Failed to add in node");
-            return -1;
+            close(pool_fd);
         }
-        wd->node_pool[ret].next = work->next;
-        work->next = ret;
+        return -1;
     }
-    wd->node_num++;
+    /* chains are walked at random, readahead would only evict them. */
+    (void)madvise(addr, len, MADV_RANDOM);
+    memcpy(addr, wd->node_pool, sizeof(st_dict_node_t) * wd->max_pool_num);
+
+    node_pool = wd->node_pool;
+    wd->node_pool = (st_dict_node_t *)addr;
+    wd->pool_addr = addr;
+    wd->pool_len = len;
+    wd->pool_fd = pool_fd;
+    st_dict_free_array(wd, node_pool);
+    st_dict_unmap_unused(wd);
 
     return 0;
 }
 
-int st_dict_add_no_seek(st_dict_t *wd, st_dict_node_t *pnode)
+static int st_dict_grow_pool(st_dict_t *wd)
 {
-    st_dict_id_t hash_key;
-    st_dict_id_t ret;
-    st_dict_node_t *work;
+    st_dict_node_t *node_pool;
+    st_dict_node_t *old_pool;
+    st_dict_id_t max_pool_num;
 
-    ST_CHECK_PARAM(pnode == NULL 
-            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+    max_pool_num = wd->max_pool_num + wd->realloc_node_num;
+    if(max_pool_num < wd->max_pool_num
+            || max_pool_num > st_dict_pool_cap(wd))
+    {
+        max_pool_num = st_dict_pool_cap(wd);
+    }
+    if(max_pool_num <= wd->max_pool_num)
+    {
+        ST_WARNING("node_pool is full[%lu].",
+                (unsigned long)wd->max_pool_num);
+        return -1;
+    }
 
-    hash_key = wd->hash_func(wd, pnode);
-    work = wd->first_level_node + hash_key;
-    if(work->sign1 == 0 && work->sign2 == 0)
+    if(st_dict_reserved(wd, wd->node_pool))
     {
-        work->sign1 = pnode->sign1;
-        work->sign2 = pnode->sign2;
-        work->uint1 = pnode->uint1;
-        work->next = ST_DICT_BAD_NODE;
-        if(wd->clear_nodes != NULL)
+        /* grows in place, so readers keep walking the same pool. */
+    }
+    else if(wd->sync == NULL)
+    {
+        node_pool = st_dict_realloc_pool(wd, max_pool_num);
+        if(node_pool == NULL)
         {
-            wd->clear_nodes[wd->clear_node_num++] = hash_key;
+            ST_WARNING("Realloc node_pool failed.");
+            return -1;
         }
+        wd->node_pool = node_pool;
+        st_dict_unmap_unused(wd);
     }
     else
     {
-        ret = st_dict_add_in(wd, pnode);
-        if(ret == ST_DICT_BAD_NODE)
+        /* readers may still walk the old pool, free it after they left. */
+        node_pool = (st_dict_node_t *)malloc(
+                max_pool_num*sizeof(st_dict_node_t));
+        if(node_pool == NULL)
         {
-            ST_WARNING("Failed to add in node");
+            ST_WARNING("Failed to alloc mem for node_pool.");
             return -1;
         }
-        wd->node_pool[ret].next = work->next;
-        work->next = ret;
+        memcpy(node_pool, wd->node_pool,
+                wd->max_pool_num*sizeof(st_dict_node_t));
+
+        old_pool = wd->node_pool;
+        __atomic_store_n(&wd->node_pool, node_pool, __ATOMIC_RELEASE);
+        st_dict_synchronize(wd->sync);
+        st_dict_free_array(wd, old_pool);
+        st_dict_unmap_unused(wd);
     }
-    wd->node_num++;
+    bzero(wd->node_pool + wd->max_pool_num,
+            (max_pool_num - wd->max_pool_num)*sizeof(st_dict_node_t));
+    wd->max_pool_num = max_pool_num;
 
     return 0;
 }
 
-int st_dict_seek(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg)
+static st_dict_id_t st_dict_add_in(st_dict_t *wd, st_dict_node_t *pnode)
 {
-    st_dict_id_t hash_key;
-    st_dict_node_t *work;
-
-    ST_CHECK_PARAM(pnode == NULL 
-            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+    st_dict_node_t *node;
+    st_dict_id_t id;
 
-    hash_key = wd->hash_func(wd, pnode);
-    work = wd->first_level_node + hash_key;
-    if(work->sign1 == 0 && work->sign2 == 0)
+    if(wd->free_index != ST_DICT_BAD_NODE)
     {
-        return -1;
-    }
+        id = wd->free_index;
+        node = &wd->node_pool[id];
+        wd->free_index = node->next;
 
-    if(wd->node_eq_func(work, pnode, node_eq_arg))
-    {
-        pnode->uint1 = work->uint1;
-        return 0;
+        node->sign1 = pnode->sign1;
+        node->sign2 = pnode->sign2;
+        node->uint1 = pnode->uint1;
+        node->next = ST_DICT_BAD_NODE;
+
+        return id;
     }
 
-    while(work->next != ST_DICT_BAD_NODE)
+    if(wd->cur_index >= wd->max_pool_num)
     {
-        if(work->next >= wd->cur_index)
-        {
-            ST_WARNING("illegal next[%u/%u]", work->next, wd->cur_index);
-            return -1;
-        }
-        work = wd->node_pool + work->next;
-        if(wd->node_eq_func(work, pnode, node_eq_arg))
+        if(st_dict_grow_pool(wd) < 0)
         {
-            pnode->uint1 = work->uint1;
-            return 0;
+            ST_WARNING("Failed to st_dict_grow_pool.");
+            return ST_DICT_BAD_NODE;
         }
     }
-    
-    return -1;
+    id = wd->cur_index;
+    node = &wd->node_pool[id];
+    node->sign1 = pnode->sign1;
+    node->sign2 = pnode->sign2;
+    node->uint1 = pnode->uint1;
+    node->next = ST_DICT_BAD_NODE;
+
+    /* read without lock by st_dict_seek in concurrent mode. */
+    __atomic_store_n(&wd->cur_index, id + 1, __ATOMIC_RELAXED);
+
+    return id;
 }
 
-int st_dict_save(st_dict_t *wd, FILE *fp)
+static void st_dict_free_node(st_dict_t *wd, st_dict_id_t id)
 {
-    size_t ret = 0;
+    st_dict_node_t *node;
 
-    ST_CHECK_PARAM(wd == NULL || fp == NULL, -1);
+    node = &wd->node_pool[id];
+    node->sign1 = 0;
+    node->sign2 = 0;
+    node->uint1 = 0;
+    node->next = wd->free_index;
+    wd->free_index = id;
+}
 
-    ret = fwrite(&wd->hash_num, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+/*
+ * Returns the first level node holding pnode. While rehashing, buckets
+ * not yet migrated are still served from old_first_level_node.
+ */
+static inline st_dict_node_t* st_dict_bucket(st_dict_t *wd,
+        st_dict_node_t *pnode, st_dict_id_t *hash_key)
+{
+    st_dict_id_t key;
+    st_dict_id_t old_key;
+
+    key = wd->hash_func(wd, pnode);
+    if(wd->old_first_level_node != NULL)
     {
-        ST_WARNING("Failed to write hash_num");
-        return -1;
+        old_key = key & (wd->old_hash_num - 1);
+        if(old_key >= wd->rehash_index)
+        {
+            if(hash_key != NULL)
+            {
+                *hash_key = ST_DICT_BAD_NODE;
+            }
+            return wd->old_first_level_node + old_key;
+        }
     }
 
-    ret = fwrite(&wd->realloc_node_num, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+    if(hash_key != NULL)
     {
-        ST_WARNING("Failed to write realloc_node_num");
-        return -1;
+        *hash_key = key;
     }
+    return wd->first_level_node + key;
+}
 
-    ret = fwrite(&wd->cur_index, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+/*
+ * st_dict_remove may empty a head that is still listed in clear_nodes,
+ * so entries can repeat once the head is filled again. When the list is
+ * full, rebuild it from the heads in use.
+ */
+static void st_dict_rebuild_clear_nodes(st_dict_t *wd)
+{
+    st_dict_id_t i;
+
+    wd->clear_node_num = 0;
+    for(i = 0; i < wd->hash_num; i++)
     {
-        ST_WARNING("Failed to write cur_index");
-        return -1;
+        if(!st_dict_node_empty(wd->first_level_node + i))
+        {
+            wd->clear_nodes[wd->clear_node_num++] = i;
+        }
     }
+}
 
-    ret = fwrite(&wd->max_pool_num, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+/*
+ * List the head first_level_node[hash_key] in clear_nodes. The head must
+ * already be filled, so that a rebuild also lists it.
+ */
+static void st_dict_list_head(st_dict_t *wd, st_dict_id_t hash_key)
+{
+    if(wd->clear_nodes == NULL)
     {
-        ST_WARNING("Failed to write max_pool_num");
-        return -1;
+        return;
     }
 
-    ret = fwrite(&wd->node_num, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+    if(wd->clear_node_num >= wd->hash_num)
     {
-        ST_WARNING("Failed to write node_num");
-        return -1;
+        st_dict_rebuild_clear_nodes(wd);
+        return;
     }
+    wd->clear_nodes[wd->clear_node_num++] = hash_key;
+}
 
-    ret = fwrite(&wd->addr_mask, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+/*
+ * Put pnode into the bucket work. hash_key is the index of work in
+ * first_level_node, or ST_DICT_BAD_NODE if work is an old bucket.
+ */
+static int st_dict_insert(st_dict_t *wd, st_dict_node_t *work,
+        st_dict_id_t hash_key, st_dict_node_t *pnode)
+{
+    st_dict_id_t ret;
+
+    if(work->sign1 == 0 && work->sign2 == 0)
     {
-        ST_WARNING("Failed to write addr_mask");
-        return -1;
+        st_dict_publish_head(work, pnode);
+
+        if(hash_key != ST_DICT_BAD_NODE)
+        {
+            st_dict_list_head(wd, hash_key);
+        }
+    }
+    else
+    {
+        ret = st_dict_add_in(wd, pnode);
+        if(ret == ST_DICT_BAD_NODE)
+        {
+            ST_WARNING("Failed to add in node");
+            return -1;
+        }
+        wd->node_pool[ret].next = work->next;
+        __atomic_store_n(&work->next, ret, __ATOMIC_RELEASE);
     }
 
-    ret = fwrite(wd->first_level_node, sizeof(st_dict_node_t),
-        wd->hash_num, fp);
-    if(ret != (size_t)wd->hash_num)
+    return 0;
+}
+
+/* Move node_pool[id] into the new table, reusing the slot if possible. */
+static int st_dict_migrate_node(st_dict_t *wd, st_dict_id_t id)
+{
+    st_dict_node_t *node;
+    st_dict_node_t *work;
+    st_dict_id_t hash_key;
+
+    node = wd->node_pool + id;
+    hash_key = wd->hash_func(wd, node);
+    work = wd->first_level_node + hash_key;
+    if(work->sign1 == 0 && work->sign2 == 0)
     {
-        ST_WARNING("Failed to write first_level_node");
-        return -1;
+        work->sign1 = node->sign1;
+        work->sign2 = node->sign2;
+        work->uint1 = node->uint1;
+        work->next = ST_DICT_BAD_NODE;
+        st_dict_list_head(wd, hash_key);
+        st_dict_free_node(wd, id);
     }
-    
-    ret = fwrite(wd->node_pool, sizeof(st_dict_node_t),
-        wd->max_pool_num, fp);
-    if(ret != (size_t)wd->max_pool_num)
+    else
     {
-        ST_WARNING("Failed to write node_pool");
-        return -1;
+        node->next = work->next;
+        work->next = id;
     }
-    
-    fflush(fp);
 
     return 0;
 }
 
-int st_dict_load(st_dict_t *wd, FILE *fp)
+static int st_dict_migrate_bucket(st_dict_t *wd, st_dict_id_t old_key)
 {
-    size_t ret = 0;
-
-    ST_CHECK_PARAM(wd == NULL || fp == NULL, -1);
+    st_dict_node_t *head;
+    st_dict_node_t *work;
+    st_dict_id_t did;
+    st_dict_id_t next;
+    st_dict_id_t hash_key;
 
-    ret = fread(&wd->hash_num, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+    head = wd->old_first_level_node + old_key;
+    if(head->sign1 == 0 && head->sign2 == 0)
     {
-        ST_WARNING("Failed to read hash_num");
-        return -1;
+        return 0;
     }
 
-    ret = fread(&wd->realloc_node_num, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+    did = head->next;
+    while(did != ST_DICT_BAD_NODE)
     {
-        ST_WARNING("Failed to read realloc_node_num");
-        return -1;
+        if(did >= wd->cur_index)
+        {
+            ST_WARNING("illegal next[%lu/%lu]", (unsigned long)did,
+                    (unsigned long)wd->cur_index);
+            return -1;
+        }
+        next = wd->node_pool[did].next;
+        if(st_dict_migrate_node(wd, did) < 0)
+        {
+            ST_WARNING("Failed to st_dict_migrate_node.");
+            return -1;
+        }
+        did = next;
     }
+    head->next = ST_DICT_BAD_NODE;
 
-    ret = fread(&wd->cur_index, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+    hash_key = wd->hash_func(wd, head);
+    work = wd->first_level_node + hash_key;
+    if(st_dict_insert(wd, work, hash_key, head) < 0)
     {
-        ST_WARNING("Failed to read cur_index");
+        ST_WARNING("Failed to st_dict_insert.");
         return -1;
     }
+    head->sign1 = 0;
+    head->sign2 = 0;
+    head->uint1 = 0;
 
-    ret = fread(&wd->max_pool_num, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+    return 0;
+}
+
+static int st_dict_rehash_step(st_dict_t *wd, st_dict_id_t step)
+{
+    while(step > 0 && wd->rehash_index < wd->old_hash_num)
     {
-        ST_WARNING("Failed to read max_pool_num");
-        return -1;
+        if(st_dict_migrate_bucket(wd, wd->rehash_index) < 0)
+        {
+            ST_WARNING("Failed to st_dict_migrate_bucket[%lu].",
+                    (unsigned long)wd->rehash_index);
+            return -1;
+        }
+        wd->rehash_index++;
+        step--;
     }
 
-    ret = fread(&wd->node_num, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+    if(wd->rehash_index >= wd->old_hash_num)
     {
-        ST_WARNING("Failed to read node_num");
-        return -1;
+        st_dict_free_array(wd, wd->old_first_level_node);
+        wd->old_first_level_node = NULL;
+        st_dict_unmap_unused(wd);
+        wd->old_hash_num = 0;
+        wd->rehash_index = 0;
     }
 
-    ret = fread(&wd->addr_mask, sizeof(st_dict_id_t), 1, fp);
-    if(ret != 1)
+    return 0;
+}
+
+int st_dict_rehash_finish(st_dict_t *wd)
+{
+    ST_CHECK_PARAM(wd == NULL, -1);
+
+    if(wd->old_first_level_node == NULL)
     {
-        ST_WARNING("Failed to read addr_mask");
-        return -1;
+        return 0;
     }
 
-    wd->first_level_node = (st_dict_node_t *)
-        malloc(sizeof(st_dict_node_t)*wd->hash_num);
-    if(wd->first_level_node == NULL)
+    return st_dict_rehash_step(wd, wd->old_hash_num);
+}
+
+static int st_dict_rehash_start(st_dict_t *wd)
+{
+    st_dict_node_t *first_level_node = NULL;
+    st_dict_id_t *clear_nodes = NULL;
+    st_dict_id_t hash_num;
+    st_dict_id_t i;
+
+    if(wd->hash_num > ST_DICT_BAD_NODE / 2)
     {
-        ST_WARNING("Failed to alloc first_level_node.");
-        return -1;
+        return 0;
     }
 
-    wd->node_pool = (st_dict_node_t *)
-        malloc(sizeof(st_dict_node_t)*wd->max_pool_num);
-    if(wd->node_pool == NULL)
+    if(wd->old_first_level_node != NULL)
     {
-        ST_WARNING("Failed to alloc node_pool.");
-        return -1;
+        if(st_dict_rehash_finish(wd) < 0)
+        {
+            ST_WARNING("Failed to st_dict_rehash_finish.");
+            return -1;
+        }
     }
 
-    ret = fread(wd->first_level_node, sizeof(st_dict_node_t),
-        wd->hash_num, fp);
-    if(ret != wd->hash_num)
+    hash_num = wd->hash_num * 2;
+    first_level_node = (st_dict_node_t *)
+        calloc(hash_num, sizeof(st_dict_node_t));
+    if(first_level_node == NULL)
     {
-        ST_WARNING("Failed to read first_level_node");
-        return -1;
+        ST_WARNING("Failed to alloc mem for first_level_node.");
+        goto ERR;
     }
-    
-    ret = fread(wd->node_pool, sizeof(st_dict_node_t),
-        wd->max_pool_num, fp);
-    if(ret != wd->max_pool_num)
+    for(i = 0; i < hash_num; i++)
     {
-        ST_WARNING("Failed to read node_pool");
-        return -1;
+        first_level_node[i].sign1 = 0;
+        first_level_node[i].sign2 = 0;
+        first_level_node[i].uint1 = 0;
+        first_level_node[i].next = ST_DICT_BAD_NODE;
     }
-    
+
+    if(wd->clear_nodes != NULL)
+    {
+        /* refilled while buckets are migrated into the new table. */
+        clear_nodes = (st_dict_id_t *)malloc(sizeof(st_dict_id_t)*hash_num);
+        if(clear_nodes == NULL)
+        {
+            ST_WARNING("Failed to alloc mem for clear_nodes.");
+            goto ERR;
+        }
+        safe_free(wd->clear_nodes);
+        wd->clear_nodes = clear_nodes;
+        wd->clear_node_num = 0;
+    }
+
+    wd->old_first_level_node = wd->first_level_node;
+    wd->old_hash_num = wd->hash_num;
+    wd->rehash_index = 0;
+
+    wd->first_level_node = first_level_node;
+    wd->hash_num = hash_num;
+    wd->addr_mask = hash_num - 1;
+
     return 0;
+
+ERR:
+    safe_free(first_level_node);
+    return -1;
 }
 
-st_dict_t* st_dict_load_from_bin(FILE *fp)
+/* Probes needed to seek each of nodes once, if hashed by hash_func. */
+static uint64_t st_dict_hash_score(st_dict_t *wd, st_dict_node_t *nodes,
+        st_dict_id_t n, st_dict_hash_fun_t hash_func, st_dict_id_t *counts)
 {
-    st_dict_t *wd;
-
-    ST_CHECK_PARAM(fp == NULL, NULL);
+    uint64_t score;
+    st_dict_id_t key;
+    st_dict_id_t i;
 
-    if((wd = st_dict_alloc()) == NULL)
-    {
-        ST_WARNING("Failed to st_dict_alloc.");
-        return NULL;
-    }
+    memset(counts, 0, sizeof(st_dict_id_t) * wd->hash_num);
 
-    if(st_dict_load(wd, fp) < 0)
+    score = 0;
+    for(i = 0; i < n; i++)
     {
-        ST_WARNING("Failed to st_alphabet_load_txt_fp.");
-        goto ERR;
-        
+        key = hash_func(wd, nodes + i);
+        counts[key]++;
+        score += counts[key];
     }
 
-    wd->hash_func = st_dict_hash_simple;
-    wd->node_eq_func = st_dict_node_equal;
-
-    return wd;
-ERR:
-    safe_st_dict_destroy(wd);
-    return NULL;
+    return score;
 }
 
-int st_dict_traverse(st_dict_t *wd, st_dict_trav_func_t trav, void *args)
+/*
+ * Pick the registered hash function with the shortest chains on the
+ * nodes added so far, and rebuild the table if it is not the current.
+ */
+static int st_dict_hash_select(st_dict_t *wd)
 {
+    st_dict_node_t *nodes = NULL;
+    st_dict_id_t *counts = NULL;
     st_dict_node_t *work;
-    st_dict_node_t *first_level_node;
-    st_dict_node_t *node_pool;
-    st_dict_id_t id;
+    st_dict_hash_fun_t best;
+    uint64_t best_score;
+    uint64_t score;
+    st_dict_id_t hash_key;
     st_dict_id_t did;
+    st_dict_id_t n;
+    st_dict_id_t i;
 
-    ST_CHECK_PARAM(wd == NULL, -1);
+    wd->hash_sample_num = 0;
 
-    first_level_node = wd->first_level_node;
-    node_pool = wd->node_pool;
+    if(st_dict_rehash_finish(wd) < 0)
+    {
+        ST_WARNING("Failed to st_dict_rehash_finish.");
+        return -1;
+    }
 
-    for(id = 0; id < wd->hash_num; id++) {
-        work = first_level_node + id;
+    nodes = (st_dict_node_t *)malloc(sizeof(st_dict_node_t)
+            * max(wd->node_num, 1));
+    counts = (st_dict_id_t *)malloc(sizeof(st_dict_id_t) * wd->hash_num);
+    if(nodes == NULL || counts == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for sampling.");
+        goto ERR;
+    }
 
-        if (work->sign1 == 0 && work->sign2 == 0) {
+    n = 0;
+    for(i = 0; i < wd->hash_num; i++)
+    {
+        work = wd->first_level_node + i;
+        if(work->sign1 == 0 && work->sign2 == 0)
+        {
             continue;
         }
+        while(true)
+        {
+            if(n >= wd->node_num)
+            {
+                ST_WARNING("node_num mismatch.");
+                goto ERR;
+            }
+            nodes[n++] = *work;
+            did = work->next;
+            if(did == ST_DICT_BAD_NODE)
+            {
+                break;
+            }
+            if(did >= wd->cur_index)
+            {
+                ST_WARNING("illegal next");
+                goto ERR;
+            }
+            work = wd->node_pool + did;
+        }
+    }
+
+    best = wd->hash_func;
+    best_score = st_dict_hash_score(wd, nodes, n, best, counts);
+    for(i = 0; i < ST_DICT_HASH_FUNC_NUM; i++)
+    {
+        score = st_dict_hash_score(wd, nodes, n, st_dict_hash_funcs[i],
+                counts);
+        if(score < best_score)
+        {
+            best = st_dict_hash_funcs[i];
+            best_score = score;
+        }
+    }
+    safe_free(counts);
+
+    if(best != wd->hash_func)
+    {
+        for(i = 0; i < wd->hash_num; i++)
+        {
+            wd->first_level_node[i].sign1 = 0;
+            wd->first_level_node[i].sign2 = 0;
+            wd->first_level_node[i].uint1 = 0;
+            wd->first_level_node[i].next = ST_DICT_BAD_NODE;
+        }
+        wd->cur_index = 0;
+        wd->free_index = ST_DICT_BAD_NODE;
+        wd->clear_node_num = 0;
+        wd->node_num = 0;
+        wd->hash_func = best;
+
+        for(i = 0; i < n; i++)
+        {
+            work = st_dict_bucket(wd, nodes + i, &hash_key);
+            if(st_dict_insert(wd, work, hash_key, nodes + i) < 0)
+            {
+                ST_WARNING("Failed to st_dict_insert.");
+                goto ERR;
+            }
+            wd->node_num++;
+        }
+    }
+    safe_free(nodes);
+
+    return 0;
+
+ERR:
+    safe_free(nodes);
+    safe_free(counts);
+    return -1;
+}
+
+static inline int st_dict_hash_sample_check(st_dict_t *wd)
+{
+    if(wd->hash_sample_num == 0 || wd->node_num < wd->hash_sample_num)
+    {
+        return 0;
+    }
+
+    return st_dict_hash_select(wd);
+}
+
+int st_dict_set_hash_sample(st_dict_t *wd, st_dict_id_t sample_num)
+{
+    ST_CHECK_PARAM(wd == NULL, -1);
+
+    if(st_dict_check_writable(wd) < 0)
+    {
+        return -1;
+    }
+
+    if(wd->sync != NULL && sample_num > 0)
+    {
+        ST_WARNING("Can not sample hash functions in concurrent mode.");
+        return -1;
+    }
+
+    wd->hash_sample_num = sample_num;
+
+    return st_dict_hash_sample_check(wd);
+}
+
+/*
+ * Pick the hash function once enough nodes are sampled, do one rehash
+ * step, and start a new rehash if the table is too full.
+ */
+static int st_dict_rehash_check(st_dict_t *wd)
+{
+    if(st_dict_hash_sample_check(wd) < 0)
+    {
+        ST_WARNING("Failed to st_dict_hash_sample_check.");
+        return -1;
+    }
+
+    if(wd->old_first_level_node != NULL)
+    {
+        if(st_dict_rehash_step(wd, wd->rehash_step) < 0)
+        {
+            ST_WARNING("Failed to st_dict_rehash_step.");
+            return -1;
+        }
+    }
+
+    if(wd->max_load_factor > 0 && wd->old_first_level_node == NULL
+            && wd->node_num > wd->max_load_factor * wd->hash_num)
+    {
+        if(st_dict_rehash_start(wd) < 0)
+        {
+            ST_WARNING("Failed to st_dict_rehash_start.");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int st_dict_set_rehash(st_dict_t *wd, float max_load_factor,
+        st_dict_id_t rehash_step)
+{
+    ST_CHECK_PARAM(wd == NULL || max_load_factor < 0, -1);
+
+    if(st_dict_check_writable(wd) < 0)
+    {
+        return -1;
+    }
+
+    if(wd->sync != NULL && max_load_factor > 0)
+    {
+        ST_WARNING("Can not rehash in concurrent mode.");
+        return -1;
+    }
+
+    wd->max_load_factor = max_load_factor;
+    if(rehash_step == 0)
+    {
+        wd->rehash_step = ST_DICT_REHASH_STEP;
+    }
+    else
+    {
+        wd->rehash_step = rehash_step;
+    }
+
+    return 0;
+}
+
+int st_dict_set_concurrent(st_dict_t *wd, bool concurrent)
+{
+    st_dict_sync_t *sync;
+
+    ST_CHECK_PARAM(wd == NULL, -1);
+
+    if(!concurrent)
+    {
+        if(wd->sync != NULL)
+        {
+            (void)pthread_mutex_destroy(&wd->sync->write_lock);
+            safe_st_aligned_free(wd->sync);
+        }
+        return 0;
+    }
+
+    if(wd->sync != NULL)
+    {
+        return 0;
+    }
+
+    if(st_dict_check_writable(wd) < 0)
+    {
+        return -1;
+    }
+
+    if(wd->hash_sample_num > 0)
+    {
+        if(st_dict_hash_select(wd) < 0)
+        {
+            ST_WARNING("Failed to st_dict_hash_select.");
+            return -1;
+        }
+    }
+
+    if(st_dict_rehash_finish(wd) < 0)
+    {
+        ST_WARNING("Failed to st_dict_rehash_finish.");
+        return -1;
+    }
+    wd->max_load_factor = 0;
+
+    sync = (st_dict_sync_t *)st_aligned_malloc(sizeof(st_dict_sync_t),
+            ST_DICT_CACHE_LINE);
+    if(sync == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for sync.");
+        return -1;
+    }
+    memset(sync, 0, sizeof(st_dict_sync_t));
+    if(pthread_mutex_init(&sync->write_lock, NULL) != 0)
+    {
+        ST_WARNING("Failed to pthread_mutex_init.");
+        safe_st_aligned_free(sync);
+        return -1;
+    }
+
+    wd->sync = sync;
+
+    return 0;
+}
+
+static int st_dict_add_locked(st_dict_t *wd, st_dict_node_t *pnode,
+        void *node_eq_arg)
+{
+    st_dict_id_t hash_key;
+    st_dict_node_t *work;
+
+    if(st_dict_check_writable(wd) < 0)
+    {
+        return -1;
+    }
+
+    if(st_dict_rehash_check(wd) < 0)
+    {
+        ST_WARNING("Failed to st_dict_rehash_check.");
+        return -1;
+    }
+
+    if(st_dict_seek(wd, pnode, node_eq_arg)== 0)
+    {
+        ST_WARNING("node already exists");
+        return -1;
+    }
+
+    work = st_dict_bucket(wd, pnode, &hash_key);
+    if(st_dict_insert(wd, work, hash_key, pnode) < 0)
+    {
+        ST_WARNING("Failed to st_dict_insert.");
+        return -1;
+    }
+    wd->node_num++;
+
+    return 0;
+}
+
+int st_dict_add(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg)
+{
+    int ret;
+
+    ST_CHECK_PARAM(pnode == NULL
+            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+
+    st_dict_write_lock(wd);
+    ret = st_dict_add_locked(wd, pnode, node_eq_arg);
+    st_dict_write_unlock(wd);
+
+    return ret;
+}
+
+static int st_dict_add_no_seek_locked(st_dict_t *wd, st_dict_node_t *pnode)
+{
+    st_dict_id_t hash_key;
+    st_dict_node_t *work;
+
+    if(st_dict_check_writable(wd) < 0)
+    {
+        return -1;
+    }
+
+    if(st_dict_rehash_check(wd) < 0)
+    {
+        ST_WARNING("Failed to st_dict_rehash_check.");
+        return -1;
+    }
+
+    work = st_dict_bucket(wd, pnode, &hash_key);
+    if(st_dict_insert(wd, work, hash_key, pnode) < 0)
+    {
+        ST_WARNING("Failed to st_dict_insert.");
+        return -1;
+    }
+    wd->node_num++;
+
+    return 0;
+}
+
+int st_dict_add_no_seek(st_dict_t *wd, st_dict_node_t *pnode)
+{
+    int ret;
+
+    ST_CHECK_PARAM(pnode == NULL
+            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+
+    st_dict_write_lock(wd);
+    ret = st_dict_add_no_seek_locked(wd, pnode);
+    st_dict_write_unlock(wd);
+
+    return ret;
+}
+
+/*
+ * Parallel bulk build.
+ *
+ * Nodes are partitioned by contiguous bucket ranges, one range per
+ * thread, keeping their input order. Heads are filled per range, pool
+ * ids are assigned per input chunk after a prefix sum, and the chains
+ * are linked per range again, so the dict ends up exactly as a serial
+ * loop of st_dict_add_no_seek would leave it.
+ */
+typedef enum _st_dict_bulk_phase_t {
+    ST_DICT_BULK_HASH = 0,
+    ST_DICT_BULK_SCATTER,
+    ST_DICT_BULK_HEAD,
+    ST_DICT_BULK_COUNT,
+    ST_DICT_BULK_PLACE,
+    ST_DICT_BULK_LINK,
+} st_dict_bulk_phase_t;
+
+typedef struct _st_dict_bulk_t {
+    st_dict_t *wd;
+    st_dict_node_t *nodes;
+    st_dict_id_t n;
+    int num_thread;
+    st_dict_bulk_phase_t phase;
+    bool fill_clear_nodes;
+
+    st_dict_id_t range_size; /* buckets per range. */
+    st_dict_id_t *hashes;
+    st_dict_id_t *order; /* positions of nodes, grouped by range. */
+    st_dict_id_t *ids; /* pool id of nodes, ST_DICT_BAD_NODE for heads. */
+    st_dict_id_t *counts; /* [chunk][range] of nodes, then offsets. */
+    st_dict_id_t *range_begin;
+    st_dict_id_t *head_base; /* per chunk. */
+    st_dict_id_t *chain_base; /* per chunk. */
+    int *err;
+} st_dict_bulk_t;
+
+typedef struct _st_dict_thread_arg_t {
+    void *ctx;
+    int tid;
+} st_dict_thread_arg_t;
+
+static int st_dict_run_threads(void *(*func)(void *), void *ctx,
+        int num_thread)
+{
+    pthread_t *pts = NULL;
+    st_dict_thread_arg_t *targs = NULL;
+    int n;
+    int i;
+
+    pts = (pthread_t *)malloc(sizeof(pthread_t) * num_thread);
+    targs = (st_dict_thread_arg_t *)malloc(sizeof(st_dict_thread_arg_t)
+            * num_thread);
+    if(pts == NULL || targs == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for threads.");
+        goto ERR;
+    }
+
+    for(n = 0; n < num_thread; n++)
+    {
+        targs[n].ctx = ctx;
+        targs[n].tid = n;
+        if(pthread_create(pts + n, NULL, func, targs + n) != 0)
+        {
+            ST_WARNING("Failed to pthread_create.");
+            for(i = 0; i < n; i++)
+            {
+                (void)pthread_join(pts[i], NULL);
+            }
+            goto ERR;
+        }
+    }
+
+    for(i = 0; i < num_thread; i++)
+    {
+        (void)pthread_join(pts[i], NULL);
+    }
+
+    safe_free(pts);
+    safe_free(targs);
+    return 0;
+
+ERR:
+    safe_free(pts);
+    safe_free(targs);
+    return -1;
+}
+
+static void* st_dict_bulk_worker(void *arg)
+{
+    st_dict_thread_arg_t *targ = (st_dict_thread_arg_t *)arg;
+    st_dict_bulk_t *bulk = (st_dict_bulk_t *)targ->ctx;
+    st_dict_t *wd = bulk->wd;
+    st_dict_node_t *work;
+    st_dict_node_t *node;
+    st_dict_id_t *counts;
+    st_dict_id_t start;
+    st_dict_id_t end;
+    st_dict_id_t pos;
+    st_dict_id_t hb;
+    st_dict_id_t cb;
+    st_dict_id_t k;
+    int t = targ->tid;
+
+    /* input chunk of this thread, for phases running by chunk. */
+    start = (st_dict_id_t)((uint64_t)bulk->n * t / bulk->num_thread);
+    end = (st_dict_id_t)((uint64_t)bulk->n * (t + 1) / bulk->num_thread);
+    counts = bulk->counts + t * bulk->num_thread;
+
+    switch(bulk->phase)
+    {
+        case ST_DICT_BULK_HASH:
+            for(pos = start; pos < end; pos++)
+            {
+                node = bulk->nodes + pos;
+                if(node->sign1 == 0 && node->sign2 == 0)
+                {
+                    bulk->err[t] = 1;
+                    break;
+                }
+                bulk->hashes[pos] = wd->hash_func(wd, node);
+                counts[bulk->hashes[pos] / bulk->range_size]++;
+            }
+            break;
+
+        case ST_DICT_BULK_SCATTER:
+            for(pos = start; pos < end; pos++)
+            {
+                bulk->order[counts[bulk->hashes[pos]
+                    / bulk->range_size]++] = pos;
+            }
+            break;
+
+        case ST_DICT_BULK_HEAD:
+            for(k = bulk->range_begin[t]; k < bulk->range_begin[t + 1]; k++)
+            {
+                pos = bulk->order[k];
+                work = wd->first_level_node + bulk->hashes[pos];
+                if(work->sign1 == 0 && work->sign2 == 0)
+                {
+                    st_dict_publish_head(work, bulk->nodes + pos);
+                    bulk->ids[pos] = ST_DICT_BAD_NODE;
+                }
+                else
+                {
+                    bulk->ids[pos] = 0;
+                }
+            }
+            break;
+
+        case ST_DICT_BULK_COUNT:
+            hb = 0;
+            for(pos = start; pos < end; pos++)
+            {
+                if(bulk->ids[pos] == ST_DICT_BAD_NODE)
+                {
+                    hb++;
+                }
+            }
+            bulk->head_base[t] = hb;
+            bulk->chain_base[t] = (end - start) - hb;
+            break;
+
+        case ST_DICT_BULK_PLACE:
+            hb = bulk->head_base[t];
+            cb = bulk->chain_base[t];
+            for(pos = start; pos < end; pos++)
+            {
+                if(bulk->ids[pos] == ST_DICT_BAD_NODE)
+                {
+                    if(bulk->fill_clear_nodes)
+                    {
+                        wd->clear_nodes[hb++] = bulk->hashes[pos];
+                    }
+                    continue;
+                }
+                node = wd->node_pool + cb;
+                node->sign1 = bulk->nodes[pos].sign1;
+                node->sign2 = bulk->nodes[pos].sign2;
+                node->uint1 = bulk->nodes[pos].uint1;
+                node->next = ST_DICT_BAD_NODE;
+                bulk->ids[pos] = cb++;
+            }
+            break;
+
+        case ST_DICT_BULK_LINK:
+            for(k = bulk->range_begin[t]; k < bulk->range_begin[t + 1]; k++)
+            {
+                pos = bulk->order[k];
+                if(bulk->ids[pos] == ST_DICT_BAD_NODE)
+                {
+                    continue;
+                }
+                work = wd->first_level_node + bulk->hashes[pos];
+                wd->node_pool[bulk->ids[pos]].next = work->next;
+                work->next = bulk->ids[pos];
+            }
+            break;
+    }
+
+    return NULL;
+}
+
+static int st_dict_bulk_run(st_dict_bulk_t *bulk, st_dict_bulk_phase_t phase)
+{
+    bulk->phase = phase;
+    return st_dict_run_threads(st_dict_bulk_worker, bulk, bulk->num_thread);
+}
+
+static int st_dict_add_bulk_parallel(st_dict_t *wd, st_dict_node_t *nodes,
+        st_dict_id_t n, int num_thread)
+{
+    st_dict_bulk_t bulk;
+    st_dict_node_t *node_pool;
+    st_dict_id_t max_pool_num;
+    st_dict_id_t num_head;
+    st_dict_id_t num_chain;
+    st_dict_id_t acc;
+    st_dict_id_t tmp;
+    int r;
+    int t;
+
+    memset(&bulk, 0, sizeof(bulk));
+    bulk.wd = wd;
+    bulk.nodes = nodes;
+    bulk.n = n;
+    bulk.num_thread = num_thread;
+    bulk.range_size = (wd->hash_num + num_thread - 1) / num_thread;
+
+    bulk.hashes = (st_dict_id_t *)malloc(sizeof(st_dict_id_t) * n);
+    bulk.order = (st_dict_id_t *)malloc(sizeof(st_dict_id_t) * n);
+    bulk.ids = (st_dict_id_t *)malloc(sizeof(st_dict_id_t) * n);
+    bulk.counts = (st_dict_id_t *)calloc(num_thread * num_thread,
+            sizeof(st_dict_id_t));
+    bulk.range_begin = (st_dict_id_t *)malloc(sizeof(st_dict_id_t)
+            * (num_thread + 1));
+    bulk.head_base = (st_dict_id_t *)malloc(sizeof(st_dict_id_t)
+            * num_thread);
+    bulk.chain_base = (st_dict_id_t *)malloc(sizeof(st_dict_id_t)
+            * num_thread);
+    bulk.err = (int *)calloc(num_thread, sizeof(int));
+    if(bulk.hashes == NULL || bulk.order == NULL || bulk.ids == NULL
+            || bulk.counts == NULL || bulk.range_begin == NULL
+            || bulk.head_base == NULL || bulk.chain_base == NULL
+            || bulk.err == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for bulk.");
+        goto ERR;
+    }
+
+    if(st_dict_bulk_run(&bulk, ST_DICT_BULK_HASH) < 0)
+    {
+        ST_WARNING("Failed to st_dict_bulk_run.");
+        goto ERR;
+    }
+    for(t = 0; t < num_thread; t++)
+    {
+        if(bulk.err[t])
+        {
+            ST_WARNING("Node with zero signs.");
+            goto ERR;
+        }
+    }
+
+    /* offsets of every (chunk, range) in order, ranges first. */
+    acc = 0;
+    for(r = 0; r < num_thread; r++)
+    {
+        bulk.range_begin[r] = acc;
+        for(t = 0; t < num_thread; t++)
+        {
+            tmp = bulk.counts[t * num_thread + r];
+            bulk.counts[t * num_thread + r] = acc;
+            acc += tmp;
+        }
+    }
+    bulk.range_begin[num_thread] = acc;
+
+    if(st_dict_bulk_run(&bulk, ST_DICT_BULK_SCATTER) < 0
+            || st_dict_bulk_run(&bulk, ST_DICT_BULK_HEAD) < 0
+            || st_dict_bulk_run(&bulk, ST_DICT_BULK_COUNT) < 0)
+    {
+        ST_WARNING("Failed to st_dict_bulk_run.");
+        goto ERR;
+    }
+
+    num_head = 0;
+    num_chain = 0;
+    for(t = 0; t < num_thread; t++)
+    {
+        tmp = bulk.head_base[t];
+        bulk.head_base[t] = wd->clear_node_num + num_head;
+        num_head += tmp;
+
+        tmp = bulk.chain_base[t];
+        bulk.chain_base[t] = wd->cur_index + num_chain;
+        num_chain += tmp;
+    }
+
+    if(wd->clear_nodes != NULL)
+    {
+        if(wd->clear_node_num + num_head > wd->hash_num)
+        {
+            /* new heads are already in first_level_node. */
+            st_dict_rebuild_clear_nodes(wd);
+        }
+        else
+        {
+            bulk.fill_clear_nodes = true;
+        }
+    }
+
+    /* grow as the serial path would, by steps of realloc_node_num. */
+    max_pool_num = wd->max_pool_num;
+    while(max_pool_num < wd->cur_index + num_chain)
+    {
+        if(wd->realloc_node_num == 0)
+        {
+            max_pool_num = wd->cur_index + num_chain;
+            break;
+        }
+        max_pool_num += wd->realloc_node_num;
+    }
+    if(max_pool_num > wd->max_pool_num)
+    {
+        node_pool = st_dict_realloc_pool(wd, max_pool_num);
+        if(node_pool == NULL)
+        {
+            ST_WARNING("Realloc node_pool failed.");
+            goto ERR;
+        }
+        bzero(node_pool + wd->max_pool_num,
+                sizeof(st_dict_node_t) * (max_pool_num - wd->max_pool_num));
+        wd->node_pool = node_pool;
+        wd->max_pool_num = max_pool_num;
+        st_dict_unmap_unused(wd);
+    }
+
+    if(st_dict_bulk_run(&bulk, ST_DICT_BULK_PLACE) < 0
+            || st_dict_bulk_run(&bulk, ST_DICT_BULK_LINK) < 0)
+    {
+        ST_WARNING("Failed to st_dict_bulk_run.");
+        goto ERR;
+    }
+
+    if(bulk.fill_clear_nodes)
+    {
+        wd->clear_node_num += num_head;
+    }
+    wd->cur_index += num_chain;
+    wd->node_num += n;
+
+    safe_free(bulk.hashes);
+    safe_free(bulk.order);
+    safe_free(bulk.ids);
+    safe_free(bulk.counts);
+    safe_free(bulk.range_begin);
+    safe_free(bulk.head_base);
+    safe_free(bulk.chain_base);
+    safe_free(bulk.err);
+    return 0;
+
+ERR:
+    safe_free(bulk.hashes);
+    safe_free(bulk.order);
+    safe_free(bulk.ids);
+    safe_free(bulk.counts);
+    safe_free(bulk.range_begin);
+    safe_free(bulk.head_base);
+    safe_free(bulk.chain_base);
+    safe_free(bulk.err);
+    return -1;
+}
+
+int st_dict_add_bulk(st_dict_t *wd, st_dict_node_t *nodes, st_dict_id_t n,
+        int num_thread)
+{
+    st_dict_id_t i;
+
+    ST_CHECK_PARAM(wd == NULL || (n > 0 && nodes == NULL), -1);
+
+    if(st_dict_check_writable(wd) < 0)
+    {
+        return -1;
+    }
+
+    /* cases where the serial path reorders nodes, or readers run. */
+    if(num_thread > 1 && n >= (st_dict_id_t)num_thread
+            && wd->free_index == ST_DICT_BAD_NODE
+            && wd->old_first_level_node == NULL
+            && wd->max_load_factor == 0 && wd->hash_sample_num == 0
+            && wd->sync == NULL)
+    {
+        return st_dict_add_bulk_parallel(wd, nodes, n, num_thread);
+    }
+
+    for(i = 0; i < n; i++)
+    {
+        if(st_dict_add_no_seek(wd, nodes + i) < 0)
+        {
+            ST_WARNING("Failed to st_dict_add_no_seek.");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Look pnode up in the bucket work.
+ * Lock free in concurrent mode, see st_dict_read_enter.
+ */
+static int st_dict_seek_in(st_dict_t *wd, st_dict_node_t *work,
+        st_dict_node_t *pnode, void *node_eq_arg)
+{
+    st_dict_id_t next;
+
+    ST_DICT_COUNT(wd, seek_num, 1);
+
+    if(st_dict_node_empty(work))
+    {
+        return -1;
+    }
+
+    ST_DICT_COUNT(wd, probe_num, 1);
+    if(wd->node_eq_func(work, pnode, node_eq_arg))
+    {
+        pnode->uint1 = __atomic_load_n(&work->uint1, __ATOMIC_RELAXED);
+        ST_DICT_COUNT(wd, hit_num, 1);
+        return 0;
+    }
+
+    while((next = st_dict_load_next(work)) != ST_DICT_BAD_NODE)
+    {
+        if(next >= st_dict_load_cur_index(wd))
+        {
+            ST_WARNING("illegal next[%lu/%lu]", (unsigned long)next,
+                    (unsigned long)wd->cur_index);
+            return -1;
+        }
+        /* reload the pool, it could have grown before next was linked. */
+        work = st_dict_load_pool(wd) + next;
+        ST_DICT_COUNT(wd, probe_num, 1);
+        if(wd->node_eq_func(work, pnode, node_eq_arg))
+        {
+            pnode->uint1 = __atomic_load_n(&work->uint1, __ATOMIC_RELAXED);
+            ST_DICT_COUNT(wd, hit_num, 1);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+int st_dict_seek(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg)
+{
+    int parity;
+    int ret;
+
+    ST_CHECK_PARAM(pnode == NULL
+            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+
+    parity = st_dict_read_enter(wd);
+    ret = st_dict_seek_in(wd, st_dict_bucket(wd, pnode, NULL),
+            pnode, node_eq_arg);
+    st_dict_read_exit(wd, parity);
+
+    return ret;
+}
+
+int st_dict_seek_batch(st_dict_t *wd, st_dict_node_t *nodes, int n,
+        unsigned char *found_mask)
+{
+    st_dict_node_t *buckets[ST_DICT_SEEK_BATCH];
+    st_dict_node_t *work;
+    st_dict_node_t *node_pool;
+    st_dict_id_t next;
+    int parity;
+    int found;
+    int start;
+    int num;
+    int i;
+
+    ST_CHECK_PARAM(wd == NULL || n < 0 || (n > 0 && nodes == NULL)
+            || found_mask == NULL, -1);
+
+    memset(found_mask, 0, (n + 7) / 8);
+
+    found = 0;
+    parity = st_dict_read_enter(wd);
+    for(start = 0; start < n; start += ST_DICT_SEEK_BATCH)
+    {
+        num = min(n - start, ST_DICT_SEEK_BATCH);
+
+        for(i = 0; i < num; i++)
+        {
+            buckets[i] = st_dict_bucket(wd, nodes + start + i, NULL);
+            __builtin_prefetch(buckets[i], 0, 1);
+        }
+
+        /* heads are in cache by now, fetch the first chain nodes. */
+        node_pool = st_dict_load_pool(wd);
+        for(i = 0; i < num; i++)
+        {
+            work = buckets[i];
+            if(st_dict_node_empty(work)
+                    || wd->node_eq_func(work, nodes + start + i, NULL))
+            {
+                continue;
+            }
+            next = st_dict_load_next(work);
+            if(next != ST_DICT_BAD_NODE)
+            {
+                __builtin_prefetch(node_pool + next, 0, 1);
+            }
+        }
+
+        for(i = 0; i < num; i++)
+        {
+            if(nodes[start + i].sign1 == 0 && nodes[start + i].sign2 == 0)
+            {
+                continue;
+            }
+            if(st_dict_seek_in(wd, buckets[i], nodes + start + i, NULL) == 0)
+            {
+                found_mask[(start + i) / 8] |= 1 << ((start + i) % 8);
+                found++;
+            }
+        }
+    }
+    st_dict_read_exit(wd, parity);
+
+    return found;
+}
+
+static inline uint64_t st_dict_align(uint64_t off)
+{
+    return (off + ST_DICT_ALIGN - 1) & ~((uint64_t)ST_DICT_ALIGN - 1);
+}
+
+static int st_dict_write_pad(FILE *fp, size_t n)
+{
+    char buf[256];
+    size_t sz;
+
+    memset(buf, 0, sizeof(buf));
+    while(n > 0)
+    {
+        sz = min(n, sizeof(buf));
+        if(fwrite(buf, 1, sz, fp) != sz)
+        {
+            return -1;
+        }
+        n -= sz;
+    }
+
+    return 0;
+}
+
+static int st_dict_skip(FILE *fp, size_t n)
+{
+    char buf[256];
+    size_t sz;
+
+    while(n > 0)
+    {
+        sz = min(n, sizeof(buf));
+        if(fread(buf, 1, sz, fp) != sz)
+        {
+            return -1;
+        }
+        n -= sz;
+    }
+
+    return 0;
+}
+
+/*
+ * Binary layout:
+ *
+ *   st_dict_header_v1_t or st_dict_header_v2_t
+ *   padding to ST_DICT_ALIGN
+ *   first_level_node[hash_num]
+ *   padding to ST_DICT_ALIGN
+ *   node_pool[cur_index]
+ *
+ * Version 1 stores ids in 32 bits and nodes as st_dict_node_v1_t,
+ * version 2 in 64 bits and nodes as st_dict_node_v2_t. Each matches
+ * st_dict_node_t of the build with the same id size, so such files are
+ * mapped as they are; files of the other size are converted on load.
+ *
+ * Offsets in the header are relative to the start of the header. The
+ * padding is computed against the file position, so that both arrays are
+ * page aligned in the file whenever the stream is seekable.
+ */
+
+/* write n nodes with node_size bytes each. */
+static int st_dict_write_nodes(FILE *fp, st_dict_node_t *nodes,
+        st_dict_id_t n, uint32_t node_size)
+{
+    st_dict_node_v1_t *v1;
+    st_dict_node_v2_t *v2;
+    void *buf;
+    st_dict_id_t i;
+    st_dict_id_t j;
+    st_dict_id_t m;
+
+    if(node_size == sizeof(st_dict_node_t))
+    {
+        if(fwrite(nodes, node_size, n, fp) != (size_t)n)
+        {
+            return -1;
+        }
+        return 0;
+    }
+
+    buf = calloc(ST_DICT_IO_NODES, node_size);
+    if(buf == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for buf.");
+        return -1;
+    }
+    v1 = (st_dict_node_v1_t *)buf;
+    v2 = (st_dict_node_v2_t *)buf;
+
+    for(i = 0; i < n; i += m)
+    {
+        m = min(n - i, ST_DICT_IO_NODES);
+        for(j = 0; j < m; j++)
+        {
+            if(node_size == sizeof(st_dict_node_v1_t))
+            {
+                v1[j].sign1 = nodes[i + j].sign1;
+                v1[j].sign2 = nodes[i + j].sign2;
+                v1[j].value = nodes[i + j].uint1;
+                v1[j].next = nodes[i + j].next == ST_DICT_BAD_NODE
+                    ? UINT32_MAX : (uint32_t)nodes[i + j].next;
+            }
+            else
+            {
+                v2[j].sign1 = nodes[i + j].sign1;
+                v2[j].sign2 = nodes[i + j].sign2;
+                v2[j].value = nodes[i + j].uint1;
+                v2[j].next = nodes[i + j].next == ST_DICT_BAD_NODE
+                    ? UINT64_MAX : (uint64_t)nodes[i + j].next;
+            }
+        }
+        if(fwrite(buf, node_size, m, fp) != (size_t)m)
+        {
+            safe_free(buf);
+            return -1;
+        }
+    }
+
+    safe_free(buf);
+    return 0;
+}
+
+/* read n nodes stored with node_size bytes each. */
+static int st_dict_read_nodes(FILE *fp, st_dict_node_t *nodes,
+        st_dict_id_t n, uint32_t node_size)
+{
+    st_dict_node_v1_t *v1;
+    st_dict_node_v2_t *v2;
+    void *buf;
+    st_dict_id_t i;
+    st_dict_id_t j;
+    st_dict_id_t m;
+    uint64_t next;
+
+    if(node_size == sizeof(st_dict_node_t))
+    {
+        if(fread(nodes, node_size, n, fp) != (size_t)n)
+        {
+            return -1;
+        }
+        return 0;
+    }
+
+    buf = malloc(ST_DICT_IO_NODES * (size_t)node_size);
+    if(buf == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for buf.");
+        return -1;
+    }
+    v1 = (st_dict_node_v1_t *)buf;
+    v2 = (st_dict_node_v2_t *)buf;
+
+    for(i = 0; i < n; i += m)
+    {
+        m = min(n - i, ST_DICT_IO_NODES);
+        if(fread(buf, node_size, m, fp) != (size_t)m)
+        {
+            goto ERR;
+        }
+        for(j = 0; j < m; j++)
+        {
+            if(node_size == sizeof(st_dict_node_v1_t))
+            {
+                nodes[i + j].sign1 = v1[j].sign1;
+                nodes[i + j].sign2 = v1[j].sign2;
+                nodes[i + j].uint1 = v1[j].value;
+                next = v1[j].next == UINT32_MAX ? UINT64_MAX : v1[j].next;
+            }
+            else
+            {
+                nodes[i + j].sign1 = v2[j].sign1;
+                nodes[i + j].sign2 = v2[j].sign2;
+                nodes[i + j].uint1 = v2[j].value;
+                next = v2[j].next;
+            }
+            if(next != UINT64_MAX && next >= ST_DICT_BAD_NODE)
+            {
+                ST_WARNING("next[%llu] overflows st_dict_id_t.",
+                        (unsigned long long)next);
+                goto ERR;
+            }
+            nodes[i + j].next = (st_dict_id_t)next;
+        }
+    }
+
+    safe_free(buf);
+    return 0;
+
+ERR:
+    safe_free(buf);
+    return -1;
+}
+
+static int st_dict_save_locked(st_dict_t *wd, FILE *fp, size_t id_size)
+{
+    st_dict_header_buf_t header;
+    uint64_t header_size;
+    uint64_t node_size;
+    uint64_t first_level_offset;
+    uint64_t node_pool_offset;
+    long pos;
+
+    if(st_dict_rehash_finish(wd) < 0)
+    {
+        ST_WARNING("Failed to st_dict_rehash_finish.");
+        return -1;
+    }
+
+    if(id_size == sizeof(uint32_t))
+    {
+        if((uint64_t)wd->hash_num >= UINT32_MAX
+                || (uint64_t)wd->cur_index >= UINT32_MAX
+                || (uint64_t)wd->realloc_node_num >= UINT32_MAX
+                || (uint64_t)wd->rehash_step >= UINT32_MAX)
+        {
+            ST_WARNING("Too many nodes for 32-bit ids.");
+            return -1;
+        }
+        header_size = sizeof(st_dict_header_v1_t);
+        node_size = sizeof(st_dict_node_v1_t);
+    }
+    else
+    {
+        header_size = sizeof(st_dict_header_v2_t);
+        node_size = sizeof(st_dict_node_v2_t);
+    }
+
+    pos = ftell(fp);
+    if(pos < 0)
+    {
+        pos = 0;
+    }
+
+    first_level_offset = st_dict_align(pos + header_size) - pos;
+    node_pool_offset = st_dict_align(pos + first_level_offset
+            + node_size * (uint64_t)wd->hash_num) - pos;
+
+    memset(&header, 0, sizeof(header));
+    if(id_size == sizeof(uint32_t))
+    {
+        header.v1.magic = ST_DICT_MAGIC;
+        header.v1.version = 1;
+        header.v1.hash_num = wd->hash_num;
+        header.v1.realloc_node_num = wd->realloc_node_num;
+        header.v1.cur_index = wd->cur_index;
+        header.v1.node_num = wd->node_num;
+        header.v1.addr_mask = wd->addr_mask;
+        header.v1.free_index = wd->free_index == ST_DICT_BAD_NODE
+            ? UINT32_MAX : (uint32_t)wd->free_index;
+        header.v1.hash_id = st_dict_hash_id(wd->hash_func);
+        header.v1.max_load_factor = wd->max_load_factor;
+        header.v1.rehash_step = wd->rehash_step;
+        header.v1.first_level_offset = first_level_offset;
+        header.v1.node_pool_offset = node_pool_offset;
+        header.v1.size = node_pool_offset
+            + node_size * (uint64_t)wd->cur_index;
+    }
+    else
+    {
+        header.v2.magic = ST_DICT_MAGIC;
+        header.v2.version = 2;
+        header.v2.hash_id = st_dict_hash_id(wd->hash_func);
+        header.v2.max_load_factor = wd->max_load_factor;
+        header.v2.hash_num = wd->hash_num;
+        header.v2.realloc_node_num = wd->realloc_node_num;
+        header.v2.cur_index = wd->cur_index;
+        header.v2.node_num = wd->node_num;
+        header.v2.addr_mask = wd->addr_mask;
+        header.v2.free_index = wd->free_index == ST_DICT_BAD_NODE
+            ? UINT64_MAX : (uint64_t)wd->free_index;
+        header.v2.rehash_step = wd->rehash_step;
+        header.v2.first_level_offset = first_level_offset;
+        header.v2.node_pool_offset = node_pool_offset;
+        header.v2.size = node_pool_offset
+            + node_size * (uint64_t)wd->cur_index;
+    }
+
+    if(fwrite(&header, header_size, 1, fp) != 1)
+    {
+        ST_WARNING("Failed to write header");
+        return -1;
+    }
+
+    if(st_dict_write_pad(fp, first_level_offset - header_size) < 0)
+    {
+        ST_WARNING("Failed to write padding");
+        return -1;
+    }
+
+    if(st_dict_write_nodes(fp, wd->first_level_node, wd->hash_num,
+                node_size) < 0)
+    {
+        ST_WARNING("Failed to write first_level_node");
+        return -1;
+    }
+
+    if(st_dict_write_pad(fp, node_pool_offset - first_level_offset
+                - node_size * (uint64_t)wd->hash_num) < 0)
+    {
+        ST_WARNING("Failed to write padding");
+        return -1;
+    }
+
+    if(st_dict_write_nodes(fp, wd->node_pool, wd->cur_index,
+                node_size) < 0)
+    {
+        ST_WARNING("Failed to write node_pool");
+        return -1;
+    }
+
+    fflush(fp);
+
+    return 0;
+}
+
+int st_dict_save(st_dict_t *wd, FILE *fp)
+{
+    return st_dict_save_as(wd, fp, sizeof(st_dict_id_t));
+}
+
+int st_dict_save_as(st_dict_t *wd, FILE *fp, size_t id_size)
+{
+    int ret;
+
+    ST_CHECK_PARAM(wd == NULL || fp == NULL
+            || (id_size != sizeof(uint32_t) && id_size != sizeof(uint64_t)),
+            -1);
+
+    st_dict_write_lock(wd);
+    ret = st_dict_save_locked(wd, fp, id_size);
+    st_dict_write_unlock(wd);
+
+    return ret;
+}
+
+/* bytes of the header of version, 0 if unknown. */
+static size_t st_dict_header_size(uint32_t version)
+{
+    switch(version)
+    {
+        case 1:
+            return sizeof(st_dict_header_v1_t);
+        case 2:
+            return sizeof(st_dict_header_v2_t);
+        default:
+            return 0;
+    }
+}
+
+static int st_dict_check_version(st_dict_header_buf_t *buf)
+{
+    if(buf->head[0] != ST_DICT_MAGIC)
+    {
+        ST_WARNING("Magic num not match.");
+        return -1;
+    }
+
+    if(buf->head[1] > ST_DICT_VERSION)
+    {
+        ST_WARNING("Too high version[%u/%u].", buf->head[1],
+                ST_DICT_VERSION);
+        return -1;
+    }
+
+    if(st_dict_header_size(buf->head[1]) == 0)
+    {
+        ST_WARNING("Unknown version[%u].", buf->head[1]);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void st_dict_decode_header(st_dict_header_buf_t *buf,
+        st_dict_header_t *header)
+{
+    st_dict_header_v1_t *v1 = &buf->v1;
+    st_dict_header_v2_t *v2 = &buf->v2;
+
+    memset(header, 0, sizeof(st_dict_header_t));
+    header->version = buf->head[1];
+    header->header_size = st_dict_header_size(header->version);
+    if(header->version == 1)
+    {
+        header->node_size = sizeof(st_dict_node_v1_t);
+        header->hash_id = v1->hash_id;
+        header->max_load_factor = v1->max_load_factor;
+        header->hash_num = v1->hash_num;
+        header->realloc_node_num = v1->realloc_node_num;
+        header->cur_index = v1->cur_index;
+        header->node_num = v1->node_num;
+        header->addr_mask = v1->addr_mask;
+        header->free_index = v1->free_index == UINT32_MAX
+            ? UINT64_MAX : v1->free_index;
+        header->rehash_step = v1->rehash_step;
+        header->first_level_offset = v1->first_level_offset;
+        header->node_pool_offset = v1->node_pool_offset;
+        header->size = v1->size;
+    }
+    else
+    {
+        header->node_size = sizeof(st_dict_node_v2_t);
+        header->hash_id = v2->hash_id;
+        header->max_load_factor = v2->max_load_factor;
+        header->hash_num = v2->hash_num;
+        header->realloc_node_num = v2->realloc_node_num;
+        header->cur_index = v2->cur_index;
+        header->node_num = v2->node_num;
+        header->addr_mask = v2->addr_mask;
+        header->free_index = v2->free_index;
+        header->rehash_step = v2->rehash_step;
+        header->first_level_offset = v2->first_level_offset;
+        header->node_pool_offset = v2->node_pool_offset;
+        header->size = v2->size;
+    }
+}
+
+static int st_dict_check_header(st_dict_header_t *header)
+{
+    if(!is_power_of_two(header->hash_num)
+            || header->addr_mask != header->hash_num - 1
+            || (header->free_index != UINT64_MAX
+                && header->free_index >= header->cur_index)
+            || header->first_level_offset < header->header_size
+            || header->node_pool_offset < header->first_level_offset
+                + header->node_size * header->hash_num
+            || header->size != header->node_pool_offset
+                + header->node_size * header->cur_index)
+    {
+        ST_WARNING("Corrupted header.");
+        return -1;
+    }
+
+    if(header->hash_num >= ST_DICT_BAD_NODE
+            || header->cur_index >= ST_DICT_BAD_NODE
+            || header->realloc_node_num >= ST_DICT_BAD_NODE
+            || header->rehash_step >= ST_DICT_BAD_NODE)
+    {
+        ST_WARNING("Too many nodes for 32-bit ids.");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void st_dict_set_header(st_dict_t *wd, st_dict_header_t *header)
+{
+    wd->hash_num = header->hash_num;
+    wd->realloc_node_num = header->realloc_node_num;
+    wd->cur_index = header->cur_index;
+    wd->max_pool_num = header->cur_index;
+    wd->node_num = header->node_num;
+    wd->addr_mask = header->addr_mask;
+    /* UINT64_MAX narrows to ST_DICT_BAD_NODE. */
+    wd->free_index = (st_dict_id_t)header->free_index;
+    wd->hash_func = st_dict_hash_by_id(header->hash_id);
+    wd->node_eq_func = st_dict_node_equal;
+    wd->max_load_factor = header->max_load_factor;
+    wd->rehash_step = header->rehash_step;
+    if(wd->rehash_step == 0)
+    {
+        wd->rehash_step = ST_DICT_REHASH_STEP;
+    }
+}
+
+static int st_dict_load_versioned(st_dict_t *wd, FILE *fp)
+{
+    st_dict_header_buf_t buf;
+    st_dict_header_t header;
+
+    buf.head[0] = ST_DICT_MAGIC;
+    if(fread(&buf.head[1], sizeof(uint32_t), 1, fp) != 1)
+    {
+        ST_WARNING("Failed to read version");
+        return -1;
+    }
+    if(st_dict_check_version(&buf) < 0)
+    {
+        ST_WARNING("Failed to st_dict_check_version.");
+        return -1;
+    }
+    if(fread((char *)&buf + 2 * sizeof(uint32_t),
+                st_dict_header_size(buf.head[1]) - 2 * sizeof(uint32_t),
+                1, fp) != 1)
+    {
+        ST_WARNING("Failed to read header");
+        return -1;
+    }
+
+    st_dict_decode_header(&buf, &header);
+    if(st_dict_check_header(&header) < 0)
+    {
+        ST_WARNING("Failed to st_dict_check_header.");
+        return -1;
+    }
+
+    st_dict_set_header(wd, &header);
+    if(wd->max_pool_num == 0)
+    {
+        wd->max_pool_num = 1;
+    }
+
+    wd->first_level_node = (st_dict_node_t *)
+        calloc(wd->hash_num, sizeof(st_dict_node_t));
+    if(wd->first_level_node == NULL)
+    {
+        ST_WARNING("Failed to alloc first_level_node.");
+        return -1;
+    }
+
+    wd->node_pool = (st_dict_node_t *)
+        calloc(wd->max_pool_num, sizeof(st_dict_node_t));
+    if(wd->node_pool == NULL)
+    {
+        ST_WARNING("Failed to alloc node_pool.");
+        return -1;
+    }
+
+    if(st_dict_skip(fp, header.first_level_offset - header.header_size) < 0)
+    {
+        ST_WARNING("Failed to skip padding");
+        return -1;
+    }
+
+    if(st_dict_read_nodes(fp, wd->first_level_node, wd->hash_num,
+                header.node_size) < 0)
+    {
+        ST_WARNING("Failed to read first_level_node");
+        return -1;
+    }
+
+    if(st_dict_skip(fp, header.node_pool_offset - header.first_level_offset
+                - header.node_size * header.hash_num) < 0)
+    {
+        ST_WARNING("Failed to skip padding");
+        return -1;
+    }
+
+    if(st_dict_read_nodes(fp, wd->node_pool, wd->cur_index,
+                header.node_size) < 0)
+    {
+        ST_WARNING("Failed to read node_pool");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* format used before the versioned layout, beginning with hash_num,
+ * with 32-bit ids. */
+static int st_dict_load_legacy(st_dict_t *wd, FILE *fp)
+{
+    size_t ret = 0;
+    uint32_t val;
+
+    ret = fread(&val, sizeof(uint32_t), 1, fp);
+    if(ret != 1)
+    {
+        ST_WARNING("Failed to read realloc_node_num");
+        return -1;
+    }
+    wd->realloc_node_num = val;
+
+    ret = fread(&val, sizeof(uint32_t), 1, fp);
+    if(ret != 1)
+    {
+        ST_WARNING("Failed to read cur_index");
+        return -1;
+    }
+    wd->cur_index = val;
+
+    ret = fread(&val, sizeof(uint32_t), 1, fp);
+    if(ret != 1)
+    {
+        ST_WARNING("Failed to read max_pool_num");
+        return -1;
+    }
+    wd->max_pool_num = val;
+
+    ret = fread(&val, sizeof(uint32_t), 1, fp);
+    if(ret != 1)
+    {
+        ST_WARNING("Failed to read node_num");
+        return -1;
+    }
+    wd->node_num = val;
+
+    ret = fread(&val, sizeof(uint32_t), 1, fp);
+    if(ret != 1)
+    {
+        ST_WARNING("Failed to read addr_mask");
+        return -1;
+    }
+    wd->addr_mask = val;
+
+    wd->first_level_node = (st_dict_node_t *)
+        calloc(wd->hash_num, sizeof(st_dict_node_t));
+    if(wd->first_level_node == NULL)
+    {
+        ST_WARNING("Failed to alloc first_level_node.");
+        return -1;
+    }
+
+    wd->node_pool = (st_dict_node_t *)
+        calloc(wd->max_pool_num, sizeof(st_dict_node_t));
+    if(wd->node_pool == NULL)
+    {
+        ST_WARNING("Failed to alloc node_pool.");
+        return -1;
+    }
+
+    if(st_dict_read_nodes(fp, wd->first_level_node, wd->hash_num,
+                sizeof(st_dict_node_v1_t)) < 0)
+    {
+        ST_WARNING("Failed to read first_level_node");
+        return -1;
+    }
+
+    if(st_dict_read_nodes(fp, wd->node_pool, wd->max_pool_num,
+                sizeof(st_dict_node_v1_t)) < 0)
+    {
+        ST_WARNING("Failed to read node_pool");
+        return -1;
+    }
+
+    wd->hash_func = st_dict_hash_simple;
+    wd->node_eq_func = st_dict_node_equal;
+
+    return 0;
+}
+
+int st_dict_load(st_dict_t *wd, FILE *fp)
+{
+    uint32_t first;
+
+    ST_CHECK_PARAM(wd == NULL || fp == NULL, -1);
+
+    if(fread(&first, sizeof(uint32_t), 1, fp) != 1)
+    {
+        ST_WARNING("Failed to read magic num");
+        return -1;
+    }
+
+    if(first == ST_DICT_MAGIC)
+    {
+        return st_dict_load_versioned(wd, fp);
+    }
+
+    wd->hash_num = first;
+    return st_dict_load_legacy(wd, fp);
+}
+
+st_dict_t* st_dict_load_from_bin(FILE *fp)
+{
+    st_dict_t *wd;
+
+    ST_CHECK_PARAM(fp == NULL, NULL);
+
+    if((wd = st_dict_alloc()) == NULL)
+    {
+        ST_WARNING("Failed to st_dict_alloc.");
+        return NULL;
+    }
+
+    if(st_dict_load(wd, fp) < 0)
+    {
+        ST_WARNING("Failed to st_dict_load.");
+        goto ERR;
+
+    }
+
+    return wd;
+ERR:
+    safe_st_dict_destroy(wd);
+    return NULL;
+}
+
+st_dict_t* st_dict_mmap(int fd, off_t offset)
+{
+    st_dict_t *wd = NULL;
+    st_dict_header_buf_t buf;
+    st_dict_header_t header;
+    struct stat st;
+    void *addr;
+    char *base;
+    size_t len;
+    off_t start;
+    long page_size;
+
+    ST_CHECK_PARAM(fd < 0 || offset < 0, NULL);
+
+    if(pread(fd, buf.head, sizeof(buf.head), offset) != sizeof(buf.head))
+    {
+        ST_WARNING("Failed to read header");
+        return NULL;
+    }
+    if(st_dict_check_version(&buf) < 0)
+    {
+        ST_WARNING("Failed to st_dict_check_version.");
+        return NULL;
+    }
+    len = st_dict_header_size(buf.head[1]);
+    if(pread(fd, &buf, len, offset) != (ssize_t)len)
+    {
+        ST_WARNING("Failed to read header");
+        return NULL;
+    }
+
+    st_dict_decode_header(&buf, &header);
+    if(st_dict_check_header(&header) < 0)
+    {
+        ST_WARNING("Failed to st_dict_check_header.");
+        return NULL;
+    }
+
+    if(header.node_size != sizeof(st_dict_node_t))
+    {
+        ST_WARNING("Can not map nodes of %u bytes, "
+                "use st_dict_load_from_bin.", header.node_size);
+        return NULL;
+    }
+
+    if(fstat(fd, &st) != 0)
+    {
+        ST_WARNING("Failed to fstat[%m].");
+        return NULL;
+    }
+    if((uint64_t)st.st_size < offset + header.size)
+    {
+        ST_WARNING("File truncated[%zu/%zu].", (size_t)st.st_size,
+                (size_t)(offset + header.size));
+        return NULL;
+    }
+
+    page_size = sysconf(_SC_PAGESIZE);
+    start = offset & ~((off_t)page_size - 1);
+    len = (size_t)(offset - start + header.size);
+
+    addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, start);
+    if(addr == MAP_FAILED)
+    {
+        ST_WARNING("Failed to mmap[%m].");
+        return NULL;
+    }
+
+    if((wd = st_dict_alloc()) == NULL)
+    {
+        ST_WARNING("Failed to st_dict_alloc.");
+        munmap(addr, len);
+        return NULL;
+    }
+    wd->map_fd = dup(fd);
+    if(wd->map_fd < 0)
+    {
+        ST_WARNING("Failed to dup fd[%m].");
+        munmap(addr, len);
+        safe_free(wd);
+        return NULL;
+    }
+    wd->map_addr = addr;
+    wd->map_len = len;
+    wd->map_offset = start;
+    wd->readonly = true;
+
+    st_dict_set_header(wd, &header);
+    base = (char *)addr + (offset - start);
+    wd->first_level_node = (st_dict_node_t *)
+        (base + header.first_level_offset);
+    wd->node_pool = (st_dict_node_t *)(base + header.node_pool_offset);
+
+    /* growing would touch the read-only mapping. */
+    wd->max_load_factor = 0;
+
+    return wd;
+}
+
+st_dict_t* st_dict_open_readonly(const char *filename)
+{
+    st_dict_t *wd;
+    int fd;
+
+    ST_CHECK_PARAM(filename == NULL, NULL);
+
+    fd = open(filename, O_RDONLY);
+    if(fd < 0)
+    {
+        ST_WARNING("Failed to open[%s]: %m.", filename);
+        return NULL;
+    }
+
+    wd = st_dict_mmap(fd, 0);
+    if(wd == NULL)
+    {
+        ST_WARNING("Failed to st_dict_mmap[%s].", filename);
+    }
+    safe_close(fd);
+
+    return wd;
+}
+
+static int st_dict_traverse_range(st_dict_t *wd,
+        st_dict_node_t *first_level_node, st_dict_id_t start,
+        st_dict_id_t end, st_dict_trav_func_t trav, void *args)
+{
+    st_dict_node_t *work;
+    st_dict_id_t id;
+    st_dict_id_t did;
+
+    for(id = start; id < end; id++) {
+        work = first_level_node + id;
+
+        if (st_dict_node_empty(work)) {
+            continue;
+        }
+
+        if(trav != NULL && trav(work, args) < 0) {
+            ST_WARNING("Failed to trav.");
+            return -1;
+        }
+
+        did = st_dict_load_next(work);
+        while(did != ST_DICT_BAD_NODE) {
+            if(did >= st_dict_load_cur_index(wd)) {
+                ST_WARNING("illegal next");
+                return -1;
+            }
+
+            work = st_dict_load_pool(wd) + did;
+            did = st_dict_load_next(work);
+
+            assert(work->sign1 != 0 || work->sign2 != 0);
+
+            if(trav != NULL && trav(work, args) < 0) {
+                ST_WARNING("Failed to trav.");
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int st_dict_traverse(st_dict_t *wd, st_dict_trav_func_t trav, void *args)
+{
+    int parity;
+    int ret;
+
+    ST_CHECK_PARAM(wd == NULL, -1);
+
+    /* trav may change nodes, unless they are mapped read-only. */
+    if(wd->sync == NULL && !wd->readonly) {
+        wd->map_dirty = true;
+    }
+
+    if(wd->old_first_level_node != NULL) {
+        if(st_dict_traverse_range(wd, wd->old_first_level_node,
+                    wd->rehash_index, wd->old_hash_num, trav, args) < 0) {
+            ST_WARNING("Failed to st_dict_traverse_range.");
+            return -1;
+        }
+    }
+
+    parity = st_dict_read_enter(wd);
+    ret = st_dict_traverse_range(wd, wd->first_level_node,
+            0, wd->hash_num, trav, args);
+    st_dict_read_exit(wd, parity);
+
+    return ret;
+}
+
+typedef struct _st_dict_trav_par_t {
+    st_dict_t *wd;
+    st_dict_trav_func_t trav;
+    void **args;
+    int num_thread;
+    int *err;
+} st_dict_trav_par_t;
+
+/*
+ * Thread t visits slice t of the buckets in st_dict_traverse order: the
+ * old buckets not yet migrated, then the new ones.
+ */
+static void* st_dict_traverse_worker(void *arg)
+{
+    st_dict_thread_arg_t *targ = (st_dict_thread_arg_t *)arg;
+    st_dict_trav_par_t *tp = (st_dict_trav_par_t *)targ->ctx;
+    st_dict_t *wd = tp->wd;
+    uint64_t old_num;
+    uint64_t total;
+    uint64_t start;
+    uint64_t end;
+    int t = targ->tid;
+    int parity;
+
+    old_num = 0;
+    if(wd->old_first_level_node != NULL)
+    {
+        old_num = wd->old_hash_num - wd->rehash_index;
+    }
+    total = old_num + wd->hash_num;
+    start = total * t / tp->num_thread;
+    end = total * (t + 1) / tp->num_thread;
+
+    parity = st_dict_read_enter(wd);
+    if(start < old_num)
+    {
+        if(st_dict_traverse_range(wd, wd->old_first_level_node,
+                    wd->rehash_index + start,
+                    wd->rehash_index + min(end, old_num),
+                    tp->trav, tp->args[t]) < 0)
+        {
+            tp->err[t] = 1;
+        }
+    }
+    if(end > old_num && tp->err[t] == 0)
+    {
+        if(st_dict_traverse_range(wd, wd->first_level_node,
+                    max(start, old_num) - old_num, end - old_num,
+                    tp->trav, tp->args[t]) < 0)
+        {
+            tp->err[t] = 1;
+        }
+    }
+    st_dict_read_exit(wd, parity);
+
+    return NULL;
+}
+
+int st_dict_traverse_parallel(st_dict_t *wd, st_dict_trav_func_t trav,
+        void **args, int num_thread)
+{
+    st_dict_trav_par_t tp;
+    int ret;
+    int t;
+
+    ST_CHECK_PARAM(wd == NULL || args == NULL || num_thread <= 0, -1);
+
+    /* trav may change nodes, unless they are mapped read-only. */
+    if(wd->sync == NULL && !wd->readonly)
+    {
+        wd->map_dirty = true;
+    }
+
+    tp.wd = wd;
+    tp.trav = trav;
+    tp.args = args;
+    tp.num_thread = num_thread;
+    tp.err = (int *)calloc(num_thread, sizeof(int));
+    if(tp.err == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for err.");
+        return -1;
+    }
+
+    ret = st_dict_run_threads(st_dict_traverse_worker, &tp, num_thread);
+    if(ret < 0)
+    {
+        ST_WARNING("Failed to st_dict_run_threads.");
+    }
+    for(t = 0; t < num_thread; t++)
+    {
+        if(tp.err[t])
+        {
+            ST_WARNING("Failed to st_dict_traverse_range.");
+            ret = -1;
+            break;
+        }
+    }
+    safe_free(tp.err);
+
+    return ret;
+}
+
+typedef struct _st_dict_merge_t {
+    st_dict_t **srcs;
+    int n;
+    st_dict_merge_func_t merge_func;
+    int num_thread;
+    st_dict_id_t hash_num;
+
+    st_dict_t **parts; /* merged nodes of every bucket slice. */
+    st_dict_node_t *nodes;
+    st_dict_id_t *bases; /* offset of every part in nodes. */
+    int *err;
+} st_dict_merge_t;
+
+typedef struct _st_dict_merge_arg_t {
+    st_dict_t *part;
+    st_dict_merge_func_t merge_func;
+} st_dict_merge_arg_t;
+
+/* Merge node into the part dict, add it if not there yet. */
+static int st_dict_merge_trav(st_dict_node_t *node, void *args)
+{
+    st_dict_merge_arg_t *ma = (st_dict_merge_arg_t *)args;
+    st_dict_t *part = ma->part;
+    st_dict_node_t *head;
+    st_dict_node_t *work;
+    st_dict_id_t hash_key;
+
+    head = st_dict_bucket(part, node, &hash_key);
+    if(!st_dict_node_empty(head))
+    {
+        work = head;
+        while(true)
+        {
+            if(part->node_eq_func(work, node, NULL))
+            {
+                return ma->merge_func(work, node);
+            }
+            if(work->next == ST_DICT_BAD_NODE)
+            {
+                break;
+            }
+            work = part->node_pool + work->next;
+        }
+    }
+
+    if(st_dict_insert(part, head, hash_key, node) < 0)
+    {
+        ST_WARNING("Failed to st_dict_insert.");
+        return -1;
+    }
+    part->node_num++;
+
+    return 0;
+}
+
+static int st_dict_collect_trav(st_dict_node_t *node, void *args)
+{
+    st_dict_node_t **pos = (st_dict_node_t **)args;
+
+    **pos = *node;
+    (*pos)++;
+
+    return 0;
+}
+
+static void* st_dict_merge_worker(void *arg)
+{
+    st_dict_thread_arg_t *targ = (st_dict_thread_arg_t *)arg;
+    st_dict_merge_t *mg = (st_dict_merge_t *)targ->ctx;
+    st_dict_merge_arg_t ma;
+    st_dict_node_t *pos;
+    st_dict_id_t start;
+    st_dict_id_t end;
+    int t = targ->tid;
+    int i;
+
+    if(mg->nodes != NULL)
+    {
+        pos = mg->nodes + mg->bases[t];
+        if(st_dict_traverse(mg->parts[t], st_dict_collect_trav, &pos) < 0)
+        {
+            mg->err[t] = 1;
+        }
+        return NULL;
+    }
 
-        if(trav != NULL && trav(work, args) < 0) {
+    start = (st_dict_id_t)((uint64_t)mg->hash_num * t / mg->num_thread);
+    end = (st_dict_id_t)((uint64_t)mg->hash_num * (t + 1) / mg->num_thread);
+
+    ma.part = mg->parts[t];
+    ma.merge_func = mg->merge_func;
+    for(i = 0; i < mg->n; i++)
+    {
+        if(st_dict_traverse_range(mg->srcs[i], mg->srcs[i]->first_level_node,
+                    start, end, st_dict_merge_trav, &ma) < 0)
+        {
+            mg->err[t] = 1;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+st_dict_t* st_dict_merge(st_dict_t **srcs, int n,
+        st_dict_merge_func_t merge_func, int num_thread)
+{
+    st_dict_merge_t mg;
+    st_dict_t *dict = NULL;
+    st_dict_id_t total;
+    int i;
+    int t;
+
+    ST_CHECK_PARAM(srcs == NULL || n <= 0 || merge_func == NULL
+            || num_thread <= 0, NULL);
+
+    for(i = 0; i < n; i++)
+    {
+        if(srcs[i]->hash_num != srcs[0]->hash_num
+                || srcs[i]->hash_func != srcs[0]->hash_func)
+        {
+            ST_WARNING("hash_num or hash_func of srcs[%d] not match.", i);
+            return NULL;
+        }
+        if(srcs[i]->old_first_level_node != NULL)
+        {
+            ST_WARNING("srcs[%d] is in the middle of rehash.", i);
+            return NULL;
+        }
+    }
+
+    memset(&mg, 0, sizeof(mg));
+    mg.srcs = srcs;
+    mg.n = n;
+    mg.merge_func = merge_func;
+    mg.num_thread = num_thread;
+    mg.hash_num = srcs[0]->hash_num;
+
+    mg.parts = (st_dict_t **)calloc(num_thread, sizeof(st_dict_t *));
+    mg.bases = (st_dict_id_t *)malloc(sizeof(st_dict_id_t) * num_thread);
+    mg.err = (int *)calloc(num_thread, sizeof(int));
+    if(mg.parts == NULL || mg.bases == NULL || mg.err == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for merge.");
+        goto ERR;
+    }
+    for(t = 0; t < num_thread; t++)
+    {
+        mg.parts[t] = st_dict_create(max(mg.hash_num / num_thread, 1),
+                max(srcs[0]->realloc_node_num, 1), NULL,
+                srcs[0]->node_eq_func, false);
+        if(mg.parts[t] == NULL)
+        {
+            ST_WARNING("Failed to st_dict_create.");
+            goto ERR;
+        }
+    }
+
+    /* every thread merges one bucket slice of all srcs. */
+    if(st_dict_run_threads(st_dict_merge_worker, &mg, num_thread) < 0)
+    {
+        ST_WARNING("Failed to st_dict_run_threads.");
+        goto ERR;
+    }
+
+    total = 0;
+    for(t = 0; t < num_thread; t++)
+    {
+        if(mg.err[t])
+        {
+            ST_WARNING("Failed to merge.");
+            goto ERR;
+        }
+        mg.bases[t] = total;
+        total += mg.parts[t]->node_num;
+    }
+
+    mg.nodes = (st_dict_node_t *)malloc(sizeof(st_dict_node_t)
+            * max(total, 1));
+    if(mg.nodes == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for nodes.");
+        goto ERR;
+    }
+    if(st_dict_run_threads(st_dict_merge_worker, &mg, num_thread) < 0)
+    {
+        ST_WARNING("Failed to st_dict_run_threads.");
+        goto ERR;
+    }
+    for(t = 0; t < num_thread; t++)
+    {
+        if(mg.err[t])
+        {
+            ST_WARNING("Failed to collect.");
+            goto ERR;
+        }
+        safe_st_dict_destroy(mg.parts[t]);
+    }
+
+    dict = st_dict_create(mg.hash_num, srcs[0]->realloc_node_num,
+            srcs[0]->hash_func, srcs[0]->node_eq_func, false);
+    if(dict == NULL)
+    {
+        ST_WARNING("Failed to st_dict_create.");
+        goto ERR;
+    }
+    if(st_dict_add_bulk(dict, mg.nodes, total, num_thread) < 0)
+    {
+        ST_WARNING("Failed to st_dict_add_bulk.");
+        goto ERR;
+    }
+
+    safe_free(mg.nodes);
+    safe_free(mg.parts);
+    safe_free(mg.bases);
+    safe_free(mg.err);
+
+    return dict;
+
+ERR:
+    if(mg.parts != NULL)
+    {
+        for(t = 0; t < num_thread; t++)
+        {
+            safe_st_dict_destroy(mg.parts[t]);
+        }
+    }
+    safe_free(mg.nodes);
+    safe_free(mg.parts);
+    safe_free(mg.bases);
+    safe_free(mg.err);
+    safe_st_dict_destroy(dict);
+    return NULL;
+}
+
+static void st_dict_stats_range(st_dict_t *wd,
+        st_dict_node_t *first_level_node, st_dict_id_t start,
+        st_dict_id_t end, st_dict_stats_t *stats)
+{
+    st_dict_id_t id;
+    st_dict_id_t did;
+    st_dict_id_t len;
+
+    for(id = start; id < end; id++)
+    {
+        len = 0;
+        if(first_level_node[id].sign1 != 0 || first_level_node[id].sign2 != 0)
+        {
+            len = 1;
+            did = first_level_node[id].next;
+            while(did != ST_DICT_BAD_NODE && did < wd->cur_index)
+            {
+                len++;
+                did = wd->node_pool[did].next;
+            }
+        }
+
+        if(len == 0)
+        {
+            stats->empty_num++;
+        }
+        if(len > stats->max_chain_len)
+        {
+            stats->max_chain_len = len;
+        }
+        stats->chain_hist[min(len, ST_DICT_STATS_MAX_CHAIN)]++;
+    }
+}
+
+int st_dict_stats(st_dict_t *wd, st_dict_stats_t *stats)
+{
+    st_dict_id_t bucket_num;
+    st_dict_id_t did;
+
+    ST_CHECK_PARAM(wd == NULL || stats == NULL, -1);
+
+    memset(stats, 0, sizeof(st_dict_stats_t));
+
+    stats->hash_num = wd->hash_num;
+    stats->node_num = wd->node_num;
+    bucket_num = wd->hash_num;
+    if(wd->old_first_level_node != NULL)
+    {
+        st_dict_stats_range(wd, wd->old_first_level_node,
+                wd->rehash_index, wd->old_hash_num, stats);
+        bucket_num += wd->old_hash_num - wd->rehash_index;
+    }
+    st_dict_stats_range(wd, wd->first_level_node, 0, wd->hash_num, stats);
+
+    stats->load_factor = (float)wd->node_num / wd->hash_num;
+    stats->empty_ratio = (float)stats->empty_num / bucket_num;
+    if(stats->empty_num < bucket_num)
+    {
+        stats->avg_chain_len = (float)wd->node_num
+            / (bucket_num - stats->empty_num);
+    }
+
+    stats->cur_index = wd->cur_index;
+    stats->max_pool_num = wd->max_pool_num;
+    did = wd->free_index;
+    while(did != ST_DICT_BAD_NODE && did < wd->cur_index
+            && stats->free_num < wd->cur_index)
+    {
+        stats->free_num++;
+        did = wd->node_pool[did].next;
+    }
+    if(wd->max_pool_num > 0)
+    {
+        stats->pool_util = (float)(wd->cur_index - stats->free_num)
+            / wd->max_pool_num;
+    }
+
+    stats->bytes = sizeof(st_dict_t)
+        + sizeof(st_dict_node_t) * ((size_t)wd->hash_num + wd->max_pool_num);
+    if(wd->clear_nodes != NULL)
+    {
+        stats->bytes += sizeof(st_dict_id_t) * (size_t)wd->hash_num;
+    }
+    if(wd->old_first_level_node != NULL)
+    {
+        stats->bytes += sizeof(st_dict_node_t) * (size_t)wd->old_hash_num;
+    }
+    if(wd->sync != NULL)
+    {
+        stats->bytes += sizeof(st_dict_sync_t);
+    }
+
+    stats->counter = wd->counter;
+    if(stats->counter.seek_num > 0)
+    {
+        stats->hit_ratio = (float)stats->counter.hit_num
+            / stats->counter.seek_num;
+        stats->probes_per_seek = (float)stats->counter.probe_num
+            / stats->counter.seek_num;
+    }
+
+    return 0;
+}
+
+int st_dict_stats_print(st_dict_stats_t *stats, FILE *fp)
+{
+    int i;
+
+    ST_CHECK_PARAM(stats == NULL || fp == NULL, -1);
+
+    fprintf(fp, "hash_num: %lu, node_num: %lu, load_factor: %.3f\n",
+            (unsigned long)stats->hash_num, (unsigned long)stats->node_num,
+            stats->load_factor);
+    fprintf(fp, "empty buckets: %lu (%.2f%%), max chain: %lu, "
+            "avg chain: %.3f\n", (unsigned long)stats->empty_num,
+            stats->empty_ratio * 100, (unsigned long)stats->max_chain_len,
+            stats->avg_chain_len);
+    fprintf(fp, "chain length histogram:\n");
+    for(i = 0; i <= ST_DICT_STATS_MAX_CHAIN; i++)
+    {
+        if(stats->chain_hist[i] == 0)
+        {
+            continue;
+        }
+        fprintf(fp, "  %s%d: %lu\n", i == ST_DICT_STATS_MAX_CHAIN ? ">=" : "",
+                i, (unsigned long)stats->chain_hist[i]);
+    }
+    fprintf(fp, "pool: %lu/%lu used, %lu free, util: %.2f%%\n",
+            (unsigned long)stats->cur_index,
+            (unsigned long)stats->max_pool_num,
+            (unsigned long)stats->free_num, stats->pool_util * 100);
+    fprintf(fp, "bytes: %zu\n", stats->bytes);
+    if(stats->counter.seek_num > 0)
+    {
+        fprintf(fp, "seeks: %lu, hit ratio: %.2f%%, probes per seek: %.3f\n",
+                stats->counter.seek_num, stats->hit_ratio * 100,
+                stats->probes_per_seek);
+    }
+
+    return 0;
+}
+
+static int st_dict_clear_locked(st_dict_t *wd, st_dict_trav_func_t trav,
+        void *args)
+{
+    st_dict_node_t *work;
+    st_dict_node_t *first_level_node;
+    st_dict_node_t *node_pool;
+    st_dict_id_t   *clear_nodes;
+    st_dict_id_t id;
+    st_dict_id_t did;
+    st_dict_id_t next;
+    st_dict_id_t clear_node_num;
+
+    if(st_dict_check_writable(wd) < 0)
+    {
+        return -1;
+    }
+
+    if(st_dict_rehash_finish(wd) < 0)
+    {
+        ST_WARNING("Failed to st_dict_rehash_finish.");
+        return -1;
+    }
+
+    first_level_node = wd->first_level_node;
+    node_pool = wd->node_pool;
+    clear_nodes = wd->clear_nodes;
+    clear_node_num = wd->clear_node_num;
+
+    for(id = 0; id < clear_node_num; id++)
+    {
+        work = first_level_node + clear_nodes[id];
+
+        /* emptied by st_dict_remove, or listed twice. */
+        if(work->sign1 == 0 && work->sign2 == 0)
+        {
+            continue;
+        }
+
+        if(trav != NULL && trav(work, args) < 0)
+        {
             ST_WARNING("Failed to trav.");
             return -1;
         }
+        wd->node_num--;
 
+        work->sign1 = 0;
+        work->sign2 = 0;
+        work->uint1 = 0;
         did = work->next;
-        while(did != ST_DICT_BAD_NODE) {
-            if(did >= wd->cur_index) {
+        work->next = ST_DICT_BAD_NODE;
+        while(did != ST_DICT_BAD_NODE)
+        {
+            if(did >= wd->cur_index)
+            {
                 ST_WARNING("illegal next");
                 return -1;
             }
 
             work = node_pool + did;
-            did = work->next;
 
-            assert(work->sign1 != 0 && work->sign2 != 0);
+            assert(work->sign1 != 0 || work->sign2 != 0);
+
+            if(trav != NULL && trav(work, args) < 0)
+            {
+                ST_WARNING("Failed to trav.");
+                return -1;
+            }
+
+            wd->node_num--;
+            next = work->next;
+            st_dict_free_node(wd, did);
+            did = next;
+        }
+    }
+
+    wd->clear_node_num = 0;
+
+    return 0;
+}
+
+int st_dict_clear(st_dict_t *wd, st_dict_trav_func_t trav, void *args)
+{
+    int ret;
+
+    ST_CHECK_PARAM(wd == NULL || wd->clear_nodes == NULL, -1);
+
+    st_dict_write_lock(wd);
+    ret = st_dict_clear_locked(wd, trav, args);
+    st_dict_write_unlock(wd);
+
+    return ret;
+}
+
+/*
+ * Run update_data on a node. In concurrent mode it runs on a copy, and
+ * the value is stored atomically, since readers load it without lock.
+ */
+static int st_dict_update_node(st_dict_t *wd, st_dict_node_t *work,
+        float data, st_dict_update_func_t update_data)
+{
+    st_dict_node_t node;
+
+    if(wd->sync == NULL)
+    {
+        return update_data(work, data);
+    }
+
+    node = *work;
+    if(update_data(&node, data) < 0)
+    {
+        return -1;
+    }
+    __atomic_store_n(&work->uint1, node.uint1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+static int st_dict_update_locked(st_dict_t *wd, st_dict_node_t *pnode,
+        void *node_eq_arg, st_dict_update_func_t update_data)
+{
+    st_dict_id_t hash_key;
+    st_dict_node_t *head;
+    st_dict_node_t *work;
+
+    if(st_dict_check_writable(wd) < 0)
+    {
+        return -1;
+    }
+
+    if(st_dict_rehash_check(wd) < 0)
+    {
+        ST_WARNING("Failed to st_dict_rehash_check.");
+        return -1;
+    }
+
+    head = st_dict_bucket(wd, pnode, &hash_key);
+    work = head;
+    if(wd->node_eq_func(work, pnode, node_eq_arg))
+    {
+        if(st_dict_update_node(wd, work, pnode->float1, update_data) < 0)
+        {
+            ST_WARNING("Failed to update_data.");
+            return -1;
+        }
+        return 0;
+    }
+
+    while(work->next != ST_DICT_BAD_NODE)
+    {
+        if(work->next >= wd->cur_index)
+        {
+            ST_WARNING("illegal next");
+            return -1;
+        }
+        work = wd->node_pool + work->next;
+        if(wd->node_eq_func(work, pnode, node_eq_arg))
+        {
+            if(st_dict_update_node(wd, work, pnode->float1,
+                        update_data) < 0)
+            {
+                ST_WARNING("Failed to update_data.");
+                return -1;
+            }
+            return 0;
+        }
+    }
+
+    if(st_dict_insert(wd, head, hash_key, pnode) < 0)
+    {
+        ST_WARNING("Failed to st_dict_insert.");
+        return -1;
+    }
+    wd->node_num++;
+    return 0;
+}
+
+int st_dict_update(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg,
+        st_dict_update_func_t update_data)
+{
+    int ret;
 
-            if(trav != NULL && trav(work, args) < 0) {
-                ST_WARNING("Failed to trav.");
-                return -1;
-            }
-        }
-    }
+    ST_CHECK_PARAM(pnode == NULL 
+            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
 
-    return 0;
+    st_dict_write_lock(wd);
+    ret = st_dict_update_locked(wd, pnode, node_eq_arg, update_data);
+    st_dict_write_unlock(wd);
+
+    return ret;
 }
 
-int st_dict_clear(st_dict_t *wd, st_dict_trav_func_t trav, void *args)
+static int st_dict_remove_locked(st_dict_t *wd, st_dict_node_t *pnode,
+        void *node_eq_arg)
 {
+    st_dict_node_t *head;
+    st_dict_node_t *prev;
     st_dict_node_t *work;
-    st_dict_node_t *first_level_node;
-    st_dict_node_t *node_pool;
-    st_dict_id_t   *clear_nodes;
-    st_dict_id_t id;
     st_dict_id_t did;
-    st_dict_id_t clear_node_num;
 
-    ST_CHECK_PARAM(wd == NULL || wd->clear_nodes == NULL, -1);
+    if(st_dict_check_writable(wd) < 0)
+    {
+        return -1;
+    }
 
-    first_level_node = wd->first_level_node;
-    node_pool = wd->node_pool;
-    clear_nodes = wd->clear_nodes;
-    clear_node_num = wd->clear_node_num;
+    if(wd->sync != NULL)
+    {
+        ST_WARNING("Can not remove in concurrent mode.");
+        return -1;
+    }
 
-    for(id = 0; id < clear_node_num; id++)
+    if(st_dict_rehash_check(wd) < 0)
     {
-        work = first_level_node + clear_nodes[id];
+        ST_WARNING("Failed to st_dict_rehash_check.");
+        return -1;
+    }
+
+    head = st_dict_bucket(wd, pnode, NULL);
+    if(head->sign1 == 0 && head->sign2 == 0)
+    {
+        return -1;
+    }
 
-        assert(work->sign1 != 0 || work->sign2 != 0);
+    if(wd->node_eq_func(head, pnode, node_eq_arg))
+    {
+        pnode->uint1 = head->uint1;
 
-        if(trav != NULL && trav(work, args) < 0)
+        did = head->next;
+        if(did == ST_DICT_BAD_NODE)
         {
-            ST_WARNING("Failed to trav.");
-            return -1;
+            head->sign1 = 0;
+            head->sign2 = 0;
+            head->uint1 = 0;
         }
-        wd->node_num--;
-
-        work->sign1 = 0;
-        work->sign2 = 0;
-        work->uint1 = 0;
-        did = work->next;
-        while(did != ST_DICT_BAD_NODE)
+        else
         {
-            if(did >= wd->cur_index)
-            {
-                ST_WARNING("illegal next");
-                return -1;
-            }
-
-            work = node_pool + did;
-            did = work->next;
+            /* pull the first chain node into the head. */
+            work = wd->node_pool + did;
+            head->sign1 = work->sign1;
+            head->sign2 = work->sign2;
+            head->uint1 = work->uint1;
+            head->next = work->next;
+            st_dict_free_node(wd, did);
+        }
+        wd->node_num--;
 
-            assert(work->sign1 != 0 && work->sign2 != 0);
+        return 0;
+    }
 
-            if(trav != NULL && trav(work, args) < 0)
-            {
-                ST_WARNING("Failed to trav.");
-                return -1;
-            }
+    prev = head;
+    while((did = prev->next) != ST_DICT_BAD_NODE)
+    {
+        if(did >= wd->cur_index)
+        {
+            ST_WARNING("illegal next");
+            return -1;
+        }
 
+        work = wd->node_pool + did;
+        if(wd->node_eq_func(work, pnode, node_eq_arg))
+        {
+            pnode->uint1 = work->uint1;
+            prev->next = work->next;
+            st_dict_free_node(wd, did);
             wd->node_num--;
-            work->sign1 = 0;
-            work->sign2 = 0;
-            work->uint1 = 0;
-            work->next = ST_DICT_BAD_NODE;
+
+            return 0;
         }
+        prev = work;
     }
 
-    wd->clear_node_num = 0;
+    return -1;
+}
 
-    return 0;
+int st_dict_remove(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg)
+{
+    int ret;
+
+    ST_CHECK_PARAM(wd == NULL || pnode == NULL
+            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+
+    st_dict_write_lock(wd);
+    ret = st_dict_remove_locked(wd, pnode, node_eq_arg);
+    st_dict_write_unlock(wd);
+
+    return ret;
 }
 
-int st_dict_update(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg,
-        st_dict_update_func_t update_data)
+int st_dict_compact(st_dict_t *wd)
 {
-    st_dict_id_t hash_key;
-    st_dict_id_t ret;
+    st_dict_node_t *node_pool = NULL;
     st_dict_node_t *work;
+    st_dict_id_t num;
+    st_dict_id_t did;
+    st_dict_id_t i;
 
-    ST_CHECK_PARAM(pnode == NULL 
-            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+    ST_CHECK_PARAM(wd == NULL, -1);
 
-    hash_key = wd->hash_func(wd, pnode);
-    work = wd->first_level_node + hash_key;
-    if(wd->node_eq_func(work, pnode, node_eq_arg))
+    if(st_dict_check_writable(wd) < 0)
     {
-        if(update_data(work, pnode->float1) < 0)
-        {
-            ST_WARNING("Failed to update_data.");
-            return -1;
-        }
-        return 0;
+        return -1;
     }
 
-    while(work->next != ST_DICT_BAD_NODE)
+    if(wd->sync != NULL)
     {
-        if(work->next >= wd->cur_index)
+        ST_WARNING("Can not compact in concurrent mode.");
+        return -1;
+    }
+
+    if(st_dict_rehash_finish(wd) < 0)
+    {
+        ST_WARNING("Failed to st_dict_rehash_finish.");
+        return -1;
+    }
+
+    /* older st_dict_clear left next of emptied heads behind. */
+    num = 0;
+    for(i = 0; i < wd->hash_num; i++)
+    {
+        if(st_dict_node_empty(wd->first_level_node + i))
         {
-            ST_WARNING("illegal next");
-            return -1;
+            wd->first_level_node[i].next = ST_DICT_BAD_NODE;
+            continue;
         }
-        work = wd->node_pool + work->next;
-        if(wd->node_eq_func(work, pnode, node_eq_arg))
+        did = wd->first_level_node[i].next;
+        while(did != ST_DICT_BAD_NODE)
         {
-            if(update_data(work, pnode->float1) < 0)
+            if(did >= wd->cur_index)
             {
-                ST_WARNING("Failed to update_data.");
+                ST_WARNING("illegal next");
                 return -1;
             }
-            return 0;
+            num++;
+            did = wd->node_pool[did].next;
         }
     }
-    
-    work = wd->first_level_node + hash_key;
-    if(work->sign1 == 0 && work->sign2 == 0)
-    {
-        work->sign1 = pnode->sign1;
-        work->sign2 = pnode->sign2;
-        work->uint1 = pnode->uint1;
-        work->next = ST_DICT_BAD_NODE;
 
-        if(wd->clear_nodes != NULL)
-        {
-            wd->clear_nodes[wd->clear_node_num++] = hash_key;
-        }
+    node_pool = (st_dict_node_t *)malloc(sizeof(st_dict_node_t)
+            * max(num, 1));
+    if(node_pool == NULL)
+    {
+        ST_WARNING("Failed to alloc mem for node_pool.");
+        return -1;
     }
-    else
+    bzero(node_pool, sizeof(st_dict_node_t));
+
+    /* copy chains in bucket order, which also keeps each chain close. */
+    num = 0;
+    for(i = 0; i < wd->hash_num; i++)
     {
-        ret = st_dict_add_in(wd, pnode);
-        if(ret == ST_DICT_BAD_NODE)
+        work = wd->first_level_node + i;
+        while(work->next != ST_DICT_BAD_NODE)
         {
-            ST_WARNING("Failed to add in node");
-            return -1;
+            node_pool[num] = wd->node_pool[work->next];
+            work->next = num;
+            work = node_pool + num;
+            num++;
         }
-        wd->node_pool[ret].next = work->next;
-        work->next = ret;
     }
-    wd->node_num++;
+
+    st_dict_free_array(wd, wd->node_pool);
+    wd->node_pool = node_pool;
+    st_dict_unmap_unused(wd);
+    wd->cur_index = num;
+    wd->max_pool_num = max(num, 1);
+    wd->free_index = ST_DICT_BAD_NODE;
+
     return 0;
 }
 
-st_dict_t* st_dict_dup(st_dict_t *d)
+
+static st_dict_t* st_dict_dup_locked(st_dict_t *d)
 {
     st_dict_t *dict = NULL;
 
-    ST_CHECK_PARAM(d == NULL, NULL);
+    if(st_dict_rehash_finish(d) < 0) {
+        ST_WARNING("Failed to st_dict_rehash_finish.");
+        return NULL;
+    }
 
     dict = (st_dict_t *)malloc(sizeof(st_dict_t));
     if(dict == NULL) {
@@ -704,6 +3815,10 @@ st_dict_t* st_dict_dup(st_dict_t *d)
     dict->max_pool_num = d->max_pool_num;
     dict->node_num = d->node_num;
     dict->clear_node_num = d->clear_node_num;
+    dict->free_index = d->free_index;
+    dict->max_load_factor = d->max_load_factor;
+    dict->rehash_step = d->rehash_step;
+    dict->hash_sample_num = d->hash_sample_num;
 
     dict->hash_func = d->hash_func;
     dict->node_eq_func = d->node_eq_func;
@@ -717,6 +3832,9 @@ st_dict_t* st_dict_dup(st_dict_t *d)
     memcpy(dict->first_level_node, d->first_level_node,
             sizeof(st_dict_node_t)*dict->hash_num);
 
+    if(dict->max_pool_num == 0) {
+        dict->max_pool_num = 1;
+    }
     dict->node_pool = (st_dict_node_t *)
         malloc(sizeof(st_dict_node_t)*dict->max_pool_num);
     if(dict->node_pool == NULL) {
@@ -725,7 +3843,7 @@ st_dict_t* st_dict_dup(st_dict_t *d)
     }
 
     memcpy(dict->node_pool, d->node_pool,
-            sizeof(st_dict_node_t)*dict->max_pool_num);
+            sizeof(st_dict_node_t)*d->max_pool_num);
 
     if(d->clear_nodes != NULL) {
         dict->clear_nodes = (st_dict_id_t *)
@@ -744,3 +3862,215 @@ ERR:
     safe_st_dict_destroy(dict);
     return NULL;
 }
+
+st_dict_t* st_dict_dup(st_dict_t *d)
+{
+    st_dict_t *dict;
+
+    ST_CHECK_PARAM(d == NULL, NULL);
+
+    st_dict_write_lock(d);
+    dict = st_dict_dup_locked(d);
+    st_dict_write_unlock(d);
+
+    return dict;
+}
+
+/* an anonymous file, living as long as it is mapped or open. */
+static int st_dict_anon_file()
+{
+    int fd;
+#ifdef MFD_CLOEXEC
+    fd = memfd_create("st_dict", MFD_CLOEXEC);
+#else
+    char fname[] = "/tmp/st-dict-XXXXXX";
+
+    fd = mkstemp(fname);
+    if(fd >= 0)
+    {
+        unlink(fname);
+    }
+#endif
+
+    return fd;
+}
+
+/* move the arrays of wd into a private mapping of an anonymous file. */
+static int st_dict_seal(st_dict_t *wd)
+{
+    st_dict_node_t *first_level_node;
+    st_dict_node_t *node_pool;
+    size_t first_level_size;
+    size_t pool_size;
+    size_t len;
+    char *addr = MAP_FAILED;
+    char *shared = MAP_FAILED;
+    long page_size;
+    int fd = -1;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    first_level_size = sizeof(st_dict_node_t) * wd->hash_num;
+    pool_size = sizeof(st_dict_node_t) * max(wd->max_pool_num, 1);
+    /* page aligned, so that writing one array never copies the other. */
+    first_level_size = (first_level_size + page_size - 1)
+        & ~((size_t)page_size - 1);
+    len = first_level_size + pool_size;
+
+    fd = st_dict_anon_file();
+    if(fd < 0)
+    {
+        ST_WARNING("Failed to create anonymous file[%m].");
+        return -1;
+    }
+    if(ftruncate(fd, len) != 0)
+    {
+        ST_WARNING("Failed to ftruncate[%m].");
+        goto ERR;
+    }
+
+    shared = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(shared == MAP_FAILED)
+    {
+        ST_WARNING("Failed to mmap[%m].");
+        goto ERR;
+    }
+    memcpy(shared, wd->first_level_node,
+            sizeof(st_dict_node_t) * wd->hash_num);
+    memcpy(shared + first_level_size, wd->node_pool,
+            sizeof(st_dict_node_t) * wd->max_pool_num);
+    munmap(shared, len);
+
+    addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(addr == MAP_FAILED)
+    {
+        ST_WARNING("Failed to mmap[%m].");
+        goto ERR;
+    }
+
+    first_level_node = wd->first_level_node;
+    node_pool = wd->node_pool;
+    wd->first_level_node = (st_dict_node_t *)addr;
+    wd->node_pool = (st_dict_node_t *)(addr + first_level_size);
+    st_dict_free_array(wd, first_level_node);
+    st_dict_free_array(wd, node_pool);
+    st_dict_unmap_unused(wd);
+
+    wd->map_addr = addr;
+    wd->map_len = len;
+    wd->map_fd = fd;
+    wd->map_offset = 0;
+    wd->map_dirty = false;
+
+    return 0;
+
+ERR:
+    if(fd >= 0)
+    {
+        close(fd);
+    }
+    return -1;
+}
+
+static st_dict_t* st_dict_snapshot_locked(st_dict_t *d)
+{
+    st_dict_t *dict = NULL;
+    char *addr;
+
+    if(st_dict_rehash_finish(d) < 0)
+    {
+        ST_WARNING("Failed to st_dict_rehash_finish.");
+        return NULL;
+    }
+
+    if(d->map_addr == NULL || d->map_dirty
+            || st_dict_mapped(d, d->first_level_node) == false
+            || st_dict_mapped(d, d->node_pool) == false)
+    {
+        if(d->sync != NULL)
+        {
+            /* readers hold the arrays, which can not be moved. */
+            return st_dict_dup_locked(d);
+        }
+        if(st_dict_seal(d) < 0)
+        {
+            ST_WARNING("Failed to st_dict_seal.");
+            return NULL;
+        }
+    }
+
+    if((dict = st_dict_alloc()) == NULL)
+    {
+        ST_WARNING("Failed to st_dict_alloc.");
+        return NULL;
+    }
+
+    dict->hash_num = d->hash_num;
+    dict->realloc_node_num = d->realloc_node_num;
+    dict->addr_mask = d->addr_mask;
+    dict->cur_index = d->cur_index;
+    dict->max_pool_num = d->max_pool_num;
+    dict->node_num = d->node_num;
+    dict->clear_node_num = d->clear_node_num;
+    dict->free_index = d->free_index;
+    dict->max_load_factor = d->max_load_factor;
+    dict->rehash_step = d->rehash_step;
+    dict->hash_sample_num = d->hash_sample_num;
+
+    dict->hash_func = d->hash_func;
+    dict->node_eq_func = d->node_eq_func;
+
+    dict->map_fd = dup(d->map_fd);
+    if(dict->map_fd < 0)
+    {
+        ST_WARNING("Failed to dup fd[%m].");
+        goto ERR;
+    }
+    addr = mmap(NULL, d->map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+            d->map_fd, d->map_offset);
+    if(addr == MAP_FAILED)
+    {
+        ST_WARNING("Failed to mmap[%m].");
+        close(dict->map_fd);
+        goto ERR;
+    }
+    dict->map_addr = addr;
+    dict->map_len = d->map_len;
+    dict->map_offset = d->map_offset;
+
+    dict->first_level_node = (st_dict_node_t *)(addr
+            + ((char *)d->first_level_node - (char *)d->map_addr));
+    dict->node_pool = (st_dict_node_t *)(addr
+            + ((char *)d->node_pool - (char *)d->map_addr));
+
+    if(d->clear_nodes != NULL)
+    {
+        dict->clear_nodes = (st_dict_id_t *)
+            malloc(sizeof(st_dict_id_t)*dict->hash_num);
+        if(dict->clear_nodes == NULL)
+        {
+            ST_WARNING("Failed to alloc mem for clear_nodes.");
+            goto ERR;
+        }
+        memcpy(dict->clear_nodes, d->clear_nodes,
+                sizeof(st_dict_id_t)*dict->hash_num);
+    }
+
+    return dict;
+
+ERR:
+    safe_st_dict_destroy(dict);
+    return NULL;
+}
+
+st_dict_t* st_dict_snapshot(st_dict_t *d)
+{
+    st_dict_t *dict;
+
+    ST_CHECK_PARAM(d == NULL, NULL);
+
+    st_dict_write_lock(d);
+    dict = st_dict_snapshot_locked(d);
+    st_dict_write_unlock(d);
+
+    return dict;
+}
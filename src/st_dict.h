@@ -30,13 +30,23 @@ extern "C" {
 #endif
 
 #include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 #include <stutils/st_macro.h>
 
 #define ST_DICT_REALLOC_NUM 1000000
+#define ST_DICT_REHASH_STEP 16
+#define ST_DICT_HASH_SAMPLE_NUM 65536
 
 typedef unsigned int st_dict_sign_t;
 
+/*
+ * Ids are 32 bits, limiting a dict to 2^32 - 1 buckets and nodes, and
+ * keeping st_dict_node_t at 16 bytes. st_dict64 shards larger key sets
+ * over several such dicts. Saved dicts record their id size, see
+ * st_dict_save_as.
+ */
 typedef unsigned int st_dict_id_t;
 #define ST_DICT_BAD_NODE            (st_dict_id_t)-1
 
@@ -52,7 +62,19 @@ typedef struct _st_dict_node_t
     st_dict_id_t   next;
 } st_dict_node_t;
 
+/*
+ * Seek counters, only updated when the library is built with
+ * -D_ST_DICT_STATS_. Reset by zeroing st_dict_t.counter.
+ */
+typedef struct _st_dict_counter_t
+{
+    unsigned long seek_num;
+    unsigned long hit_num;
+    unsigned long probe_num; /* nodes compared. */
+} st_dict_counter_t;
+
 struct _st_dict_t;
+struct _st_dict_sync_t;
 typedef st_dict_id_t (*st_dict_hash_fun_t)(struct _st_dict_t *,
     st_dict_node_t *);
 
@@ -60,6 +82,8 @@ typedef bool (*st_dict_node_eq_fun_t)(st_dict_node_t *node1,
     st_dict_node_t *node2, void *args);
 typedef int (*st_dict_update_func_t)(st_dict_node_t *node, float data);
 typedef int (*st_dict_trav_func_t)(st_dict_node_t *p, void *arg);
+typedef int (*st_dict_merge_func_t)(st_dict_node_t *dst,
+    st_dict_node_t *src);
 
 typedef struct _st_dict_t
 {
@@ -79,6 +103,31 @@ typedef struct _st_dict_t
 
     st_dict_id_t       *clear_nodes;
     st_dict_id_t       clear_node_num;
+
+    st_dict_id_t       free_index;
+
+    float              max_load_factor;
+    st_dict_id_t       rehash_step;
+    st_dict_node_t     *old_first_level_node;
+    st_dict_id_t       old_hash_num;
+    st_dict_id_t       rehash_index;
+
+    st_dict_id_t       hash_sample_num;
+
+    void               *map_addr;
+    size_t             map_len;
+    int                map_fd; /* valid iff map_addr != NULL. */
+    off_t              map_offset;
+    bool               map_dirty; /* arrays differ from map_fd. */
+    bool               readonly;
+
+    void               *pool_addr; /* node_pool is reserved here if set. */
+    size_t             pool_len;
+    int                pool_fd; /* -1 if anonymous, valid iff pool_addr. */
+
+    struct _st_dict_sync_t *sync;
+
+    st_dict_counter_t  counter;
 } st_dict_t;
 
 st_dict_t* st_dict_create(st_dict_id_t hash_num,
@@ -94,26 +143,316 @@ st_dict_t* st_dict_create(st_dict_id_t hash_num,
     } while(0)
 void st_dict_destroy(st_dict_t *wd);
 
+/*
+ * Let the hash table grow automatically.
+ *
+ * When node_num exceeds max_load_factor * hash_num, a table with twice
+ * the buckets is allocated and the old buckets are migrated, rehash_step
+ * buckets at a time, on the following add/update/remove calls. Seeks
+ * never modify the dict, so they can share it between threads.
+ * The hash_func of wd must reduce its result with wd->addr_mask, as all
+ * the st_dict_hash_* functions do.
+ *
+ * @param[in] wd the dict.
+ * @param[in] max_load_factor load factor to start rehash, 0 to disable.
+ * @param[in] rehash_step buckets migrated per call, 0 for default.
+ * @return non-zero value if any error.
+ */
+int st_dict_set_rehash(st_dict_t *wd, float max_load_factor,
+        st_dict_id_t rehash_step);
+
+/*
+ * Migrate all remaining buckets of an in-progress rehash.
+ *
+ * @param[in] wd the dict.
+ * @return non-zero value if any error.
+ */
+int st_dict_rehash_finish(st_dict_t *wd);
+
+/*
+ * Let readers run concurrently with a writer.
+ *
+ * In concurrent mode, st_dict_seek and st_dict_traverse take no lock and
+ * may run in any number of threads, while st_dict_add, st_dict_add_no_seek,
+ * st_dict_update, st_dict_save and st_dict_dup are serialized by a writer
+ * mutex. New nodes are published only after they are fully written, and
+ * a grown node_pool is freed once no reader can still see the old one.
+ * Values changed by st_dict_update are written in place, so a reader
+ * sees either the old or the new value of a node.
+ * Incremental rehash is not available in this mode, and st_dict_clear
+ * must not run while readers are active.
+ *
+ * @param[in] wd the dict, must not be used by other threads during
+ *               this call.
+ * @param[in] concurrent true to turn on the mode, false to turn off.
+ * @return non-zero value if any error.
+ */
+int st_dict_set_concurrent(st_dict_t *wd, bool concurrent);
+
 int st_dict_add(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg);
 int st_dict_add_no_seek(st_dict_t *wd, st_dict_node_t *pnode);
+
+/*
+ * Add an array of nodes, without seeking, using several threads.
+ *
+ * Nodes are partitioned by bucket range across threads, every thread
+ * fills the heads of its range and a disjoint segment of node_pool. The
+ * dict ends up identical to adding the nodes one by one with
+ * st_dict_add_no_seek. Falls back to that serial loop when the free list
+ * is not empty, rehash is enabled or in concurrent mode.
+ *
+ * @param[in] wd the dict.
+ * @param[in] nodes nodes to add.
+ * @param[in] n number of nodes.
+ * @param[in] num_thread number of threads.
+ * @return non-zero value if any error.
+ */
+int st_dict_add_bulk(st_dict_t *wd, st_dict_node_t *nodes, st_dict_id_t n,
+        int num_thread);
 int st_dict_seek(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg);
 
+/*
+ * Seek a batch of nodes.
+ *
+ * Buckets of the whole batch are hashed and prefetched first, then the
+ * first chain nodes, and the lookups are resolved afterwards, so the
+ * cache misses of different nodes overlap. node_eq_func is called with
+ * NULL as its args.
+ *
+ * @param[in] wd the dict.
+ * @param[in, out] nodes nodes to seek, uint1 is filled for found ones.
+ * @param[in] n number of nodes.
+ * @param[out] found_mask (n+7)/8 bytes, bit i%8 of byte i/8 is set
+ *                        if nodes[i] is found.
+ * @return number of found nodes, -1 if any error.
+ */
+int st_dict_seek_batch(st_dict_t *wd, st_dict_node_t *nodes, int n,
+        unsigned char *found_mask);
+
 int st_dict_traverse(st_dict_t *wd, st_dict_trav_func_t trav, void *args);
+
+/*
+ * Traverse the dict with several threads.
+ *
+ * The buckets are split into num_thread contiguous ranges, thread i
+ * calls trav with args[i] on its range. Concatenating the nodes visited
+ * by thread 0, 1, ... gives the order of st_dict_traverse.
+ *
+ * @param[in] wd the dict.
+ * @param[in] trav function called for every node.
+ * @param[in] args num_thread args, one per thread.
+ * @param[in] num_thread number of threads.
+ * @return non-zero value if any error.
+ */
+int st_dict_traverse_parallel(st_dict_t *wd, st_dict_trav_func_t trav,
+        void **args, int num_thread);
+
+/*
+ * Merge dicts into a new one, with several threads.
+ *
+ * srcs must share hash_num and hash_func, so that a key falls into the
+ * same bucket of every src. The buckets are split into num_thread
+ * slices and every thread merges its slice of all srcs on its own, no
+ * lock is taken. A node found in several srcs is kept once, merge_func
+ * folding the later ones into it.
+ *
+ * @param[in] srcs dicts to merge, unchanged, can be read-only mappings.
+ * @param[in] n number of srcs.
+ * @param[in] merge_func fold src into dst for equal nodes.
+ * @param[in] num_thread number of threads.
+ * @return the merged dict, NULL if any error.
+ */
+st_dict_t* st_dict_merge(st_dict_t **srcs, int n,
+        st_dict_merge_func_t merge_func, int num_thread);
 int st_dict_clear(st_dict_t *wd, st_dict_trav_func_t trav, void *args);
 
 int st_dict_update(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg,
         st_dict_update_func_t update_data);
 
+/*
+ * Remove a node from the dict.
+ *
+ * The freed node_pool slot is pushed onto a free list and reused by
+ * later adds. Not available in concurrent mode.
+ *
+ * @param[in] wd the dict.
+ * @param[in, out] pnode node to remove, uint1 is filled with the removed
+ *                       value.
+ * @param[in] node_eq_arg args for node_eq_func.
+ * @return 0 if removed, -1 if not found or any error.
+ */
+int st_dict_remove(st_dict_t *wd, st_dict_node_t *pnode, void *node_eq_arg);
+
+/*
+ * Shrink node_pool to the nodes in use.
+ *
+ * Chains are rewritten in bucket order into a new pool, which drops the
+ * free list. Not available in concurrent mode.
+ *
+ * @param[in] wd the dict.
+ * @return non-zero value if any error.
+ */
+int st_dict_compact(st_dict_t *wd);
+
+/*
+ * Move node_pool into a reservation of max_pool_num nodes.
+ *
+ * The reservation is mapped with MAP_NORESERVE, so pages are only
+ * backed once nodes are written to them, and node_pool then grows in
+ * place instead of being reallocated. Adds fail once it is full.
+ * st_dict_compact and st_dict_snapshot move node_pool out of it again.
+ * Not available in concurrent mode.
+ *
+ * @param[in] wd the dict.
+ * @param[in] max_pool_num nodes to reserve, at least wd->max_pool_num.
+ * @param[in] fd file to back the reservation with, which is resized to
+ *               fit and used from offset 0; -1 for anonymous memory.
+ * @return non-zero value if any error.
+ */
+int st_dict_reserve_pool(st_dict_t *wd, st_dict_id_t max_pool_num, int fd);
+
 int st_dict_save(st_dict_t *wd, FILE *fp);
 
+/*
+ * Save a dict with ids of the given size.
+ *
+ * st_dict_save uses sizeof(st_dict_id_t). Files with either id size are
+ * loaded by st_dict_load_from_bin as long as the ids fit; st_dict_mmap
+ * needs 4.
+ *
+ * @param[in] wd the dict.
+ * @param[in] fp the file.
+ * @param[in] id_size 4 or 8, bytes of ids in the file.
+ * @return non-zero value if any error, e.g. too many nodes for 4.
+ */
+int st_dict_save_as(st_dict_t *wd, FILE *fp, size_t id_size);
+
 st_dict_t* st_dict_load_from_bin(FILE *fp);
 
+/*
+ * Map a dict saved by st_dict_save into memory.
+ *
+ * Arrays are served straight from a read-only shared mapping of the
+ * file, so loading costs O(1) and the page cache is shared by all
+ * processes mapping the same file. The returned dict supports seek and
+ * traverse only; st_dict_snapshot gives a writable copy.
+ *
+ * @param[in] fd file descriptor, can be closed after return.
+ * @param[in] offset file offset where st_dict_save started writing.
+ * @return the dict, NULL if any error.
+ */
+st_dict_t* st_dict_mmap(int fd, off_t offset);
+
+/*
+ * Map a file containing a single dict saved by st_dict_save.
+ *
+ * @param[in] filename the file.
+ * @return the dict, NULL if any error.
+ */
+st_dict_t* st_dict_open_readonly(const char *filename);
+
+#define ST_DICT_STATS_MAX_CHAIN 16
+
+typedef struct _st_dict_stats_t
+{
+    st_dict_id_t  hash_num;
+    st_dict_id_t  node_num;
+    float         load_factor; /* node_num / hash_num. */
+
+    st_dict_id_t  empty_num; /* buckets without any node. */
+    float         empty_ratio;
+    st_dict_id_t  max_chain_len;
+    float         avg_chain_len; /* nodes per non-empty bucket. */
+    /* buckets holding i nodes, the last one counts longer chains too. */
+    st_dict_id_t  chain_hist[ST_DICT_STATS_MAX_CHAIN + 1];
+
+    st_dict_id_t  cur_index;
+    st_dict_id_t  max_pool_num;
+    st_dict_id_t  free_num; /* slots on the free list. */
+    float         pool_util; /* (cur_index - free_num) / max_pool_num. */
+    size_t        bytes; /* memory of the struct and all arrays. */
+
+    st_dict_counter_t counter;
+    float         hit_ratio;
+    float         probes_per_seek;
+} st_dict_stats_t;
+
+/*
+ * Collect occupancy statistics of the dict, O(hash_num + node_num).
+ * Not to be called concurrently with writers.
+ *
+ * @param[in] wd the dict.
+ * @param[out] stats the statistics.
+ * @return non-zero value if any error.
+ */
+int st_dict_stats(st_dict_t *wd, st_dict_stats_t *stats);
+
+/*
+ * Print statistics in a human readable form.
+ *
+ * @param[in] stats the statistics.
+ * @param[in] fp the stream.
+ * @return non-zero value if any error.
+ */
+int st_dict_stats_print(st_dict_stats_t *stats, FILE *fp);
+
 st_dict_id_t st_dict_hash_simple(st_dict_t *wd, st_dict_node_t *pnode);
 st_dict_id_t st_dict_hash_sign1l16(st_dict_t *wd, st_dict_node_t *pnode);
 st_dict_id_t st_dict_hash_sign1(st_dict_t *wd, st_dict_node_t *pnode);
 
+/*
+ * Well mixing hash functions on the 64-bit key sign1 << 32 | sign2: the
+ * fmix64 finalizer of MurmurHash3, the wyhash mixer and the XXH3 8-byte
+ * avalanche. Slower than the ones above by a few cycles, but without
+ * their clustering on structured signs.
+ */
+st_dict_id_t st_dict_hash_murmur(st_dict_t *wd, st_dict_node_t *pnode);
+st_dict_id_t st_dict_hash_wy(st_dict_t *wd, st_dict_node_t *pnode);
+st_dict_id_t st_dict_hash_xxh3(st_dict_t *wd, st_dict_node_t *pnode);
+
+/*
+ * Passed as hash_func to st_dict_create to choose the hash function from
+ * data: the dict hashes with st_dict_hash_murmur until
+ * ST_DICT_HASH_SAMPLE_NUM nodes are added, then every st_dict_hash_*
+ * function is scored by the chain lengths it gives on those nodes, and
+ * the table is rebuilt with the best one.
+ */
+st_dict_id_t st_dict_hash_auto(st_dict_t *wd, st_dict_node_t *pnode);
+
+/*
+ * Choose the hash function after sample_num nodes are added.
+ *
+ * See st_dict_hash_auto. Selection runs at once if the dict already
+ * holds sample_num nodes. Not available in concurrent mode.
+ *
+ * @param[in] wd the dict.
+ * @param[in] sample_num number of nodes to sample, 0 to disable.
+ * @return non-zero value if any error.
+ */
+int st_dict_set_hash_sample(st_dict_t *wd, st_dict_id_t sample_num);
+
 st_dict_t* st_dict_dup(st_dict_t *d);
 
+/*
+ * Copy-on-write copy of a dict.
+ *
+ * The arrays of the copy are a private mapping of the same file as the
+ * arrays of d, so no node is copied up front and pages are duplicated
+ * by the kernel only when either side writes to them. Seeks on the copy
+ * run on plain arrays, as fast as on d.
+ *
+ * A dict loaded by st_dict_mmap is shared straight from its file. Other
+ * dicts are moved into an anonymous memory file on the first snapshot,
+ * and again on the next snapshot after any change (including
+ * st_dict_traverse, whose trav may change nodes), which costs one copy
+ * of the arrays but no extra memory. In concurrent mode, d is never
+ * moved and a deep copy is returned as st_dict_dup does.
+ *
+ * @param[in] d the dict.
+ * @return the copy, NULL if any error.
+ */
+st_dict_t* st_dict_snapshot(st_dict_t *d);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,331 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <stutils/st_macro.h>
+#include "st_log.h"
+#include "st_dict64.h"
+#include "st_dict_inl.h"
+
+#define ST_DICT64_MAGIC   0x34364453
+
+/* shards keep below this many buckets and expected nodes. */
+#define ST_DICT64_SHARD_NUM_MAX ((uint64_t)1 << 31)
+
+st_dict_t* st_dict64_shard(st_dict64_t *d, st_dict_node_t *pnode)
+{
+    if(d->shard_bits == 0) {
+        return d->shards[0];
+    }
+
+    /* the top bits, while the shard hashes reduce the low ones. */
+    return d->shards[st_dict_fmix64(pnode->sign1, pnode->sign2)
+        >> (64 - d->shard_bits)];
+}
+
+static st_dict64_t* dict64_alloc(int shard_bits)
+{
+    st_dict64_t *d;
+
+    d = (st_dict64_t *)malloc(sizeof(st_dict64_t));
+    if(d == NULL) {
+        ST_WARNING("Failed to alloc mem for st_dict64.");
+        return NULL;
+    }
+    memset(d, 0, sizeof(st_dict64_t));
+
+    d->shards = (st_dict_t **)calloc(1 << shard_bits, sizeof(st_dict_t *));
+    if(d->shards == NULL) {
+        ST_WARNING("Failed to alloc mem for shards.");
+        safe_free(d);
+        return NULL;
+    }
+    d->shard_bits = shard_bits;
+    d->shard_num = 1 << shard_bits;
+
+    return d;
+}
+
+void st_dict64_destroy(st_dict64_t *d)
+{
+    int s;
+
+    if(d == NULL) {
+        return;
+    }
+
+    if(d->shards != NULL) {
+        for(s = 0; s < d->shard_num; s++) {
+            safe_st_dict_destroy(d->shards[s]);
+        }
+        safe_free(d->shards);
+    }
+    d->shard_num = 0;
+}
+
+st_dict64_t* st_dict64_create(uint64_t hash_num, uint64_t max_node_num,
+        st_dict_id_t realloc_node_num, st_dict_hash_fun_t hash_func,
+        st_dict_node_eq_fun_t node_eq_func)
+{
+    st_dict64_t *d = NULL;
+    uint64_t shard_hash_num;
+    int shard_bits;
+    int s;
+
+    shard_bits = 0;
+    while((hash_num >> shard_bits) >= ST_DICT64_SHARD_NUM_MAX
+            || (max_node_num >> shard_bits) >= ST_DICT64_SHARD_NUM_MAX) {
+        shard_bits++;
+    }
+    ST_CHECK_PARAM(shard_bits > ST_DICT64_MAX_SHARD_BITS
+            || realloc_node_num == ST_DICT_BAD_NODE, NULL);
+
+    d = dict64_alloc(shard_bits);
+    if(d == NULL) {
+        ST_WARNING("Failed to dict64_alloc.");
+        return NULL;
+    }
+
+    shard_hash_num = hash_num >> shard_bits;
+    if(shard_hash_num == 0) {
+        shard_hash_num = 1;
+    }
+    for(s = 0; s < d->shard_num; s++) {
+        d->shards[s] = st_dict_create((st_dict_id_t)shard_hash_num,
+                realloc_node_num, hash_func, node_eq_func, false);
+        if(d->shards[s] == NULL) {
+            ST_WARNING("Failed to st_dict_create shard[%d].", s);
+            goto ERR;
+        }
+    }
+
+    return d;
+
+ERR:
+    safe_st_dict64_destroy(d);
+    return NULL;
+}
+
+int st_dict64_reserve(st_dict64_t *d, const char *dir)
+{
+    char fname[MAX_DIR_LEN + MAX_NAME_LEN];
+    int fd = -1;
+    int s;
+
+    ST_CHECK_PARAM(d == NULL, -1);
+
+    for(s = 0; s < d->shard_num; s++) {
+        if(dir != NULL) {
+            snprintf(fname, sizeof(fname), "%s/st_dict64.XXXXXX", dir);
+            fd = mkstemp(fname);
+            if(fd < 0) {
+                ST_WARNING("Failed to mkstemp[%s].", fname);
+                return -1;
+            }
+            (void)unlink(fname);
+        }
+
+        /* ids stop below ST_DICT_BAD_NODE. */
+        if(st_dict_reserve_pool(d->shards[s], ST_DICT_BAD_NODE, fd) < 0) {
+            ST_WARNING("Failed to st_dict_reserve_pool shard[%d].", s);
+            if(fd >= 0) {
+                close(fd);
+            }
+            return -1;
+        }
+        if(fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    return 0;
+}
+
+int st_dict64_add(st_dict64_t *d, st_dict_node_t *pnode, void *node_eq_arg)
+{
+    ST_CHECK_PARAM(d == NULL || pnode == NULL, -1);
+
+    return st_dict_add(st_dict64_shard(d, pnode), pnode, node_eq_arg);
+}
+
+int st_dict64_add_no_seek(st_dict64_t *d, st_dict_node_t *pnode)
+{
+    ST_CHECK_PARAM(d == NULL || pnode == NULL, -1);
+
+    return st_dict_add_no_seek(st_dict64_shard(d, pnode), pnode);
+}
+
+int st_dict64_seek(st_dict64_t *d, st_dict_node_t *pnode, void *node_eq_arg)
+{
+    ST_CHECK_PARAM(d == NULL || pnode == NULL, -1);
+
+    return st_dict_seek(st_dict64_shard(d, pnode), pnode, node_eq_arg);
+}
+
+int st_dict64_update(st_dict64_t *d, st_dict_node_t *pnode,
+        void *node_eq_arg, st_dict_update_func_t update_data)
+{
+    ST_CHECK_PARAM(d == NULL || pnode == NULL, -1);
+
+    return st_dict_update(st_dict64_shard(d, pnode), pnode, node_eq_arg,
+            update_data);
+}
+
+int st_dict64_remove(st_dict64_t *d, st_dict_node_t *pnode,
+        void *node_eq_arg)
+{
+    ST_CHECK_PARAM(d == NULL || pnode == NULL, -1);
+
+    return st_dict_remove(st_dict64_shard(d, pnode), pnode, node_eq_arg);
+}
+
+int st_dict64_traverse(st_dict64_t *d, st_dict_trav_func_t trav,
+        void *args)
+{
+    int s;
+
+    ST_CHECK_PARAM(d == NULL, -1);
+
+    for(s = 0; s < d->shard_num; s++) {
+        if(st_dict_traverse(d->shards[s], trav, args) < 0) {
+            ST_WARNING("Failed to st_dict_traverse shard[%d].", s);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int st_dict64_set_rehash(st_dict64_t *d, float max_load_factor,
+        st_dict_id_t rehash_step)
+{
+    int s;
+
+    ST_CHECK_PARAM(d == NULL, -1);
+
+    for(s = 0; s < d->shard_num; s++) {
+        if(st_dict_set_rehash(d->shards[s], max_load_factor,
+                    rehash_step) < 0) {
+            ST_WARNING("Failed to st_dict_set_rehash shard[%d].", s);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+uint64_t st_dict64_node_num(st_dict64_t *d)
+{
+    uint64_t num;
+    int s;
+
+    if(d == NULL) {
+        return 0;
+    }
+
+    num = 0;
+    for(s = 0; s < d->shard_num; s++) {
+        num += d->shards[s]->node_num;
+    }
+
+    return num;
+}
+
+int st_dict64_save(st_dict64_t *d, FILE *fp)
+{
+    uint32_t head[2];
+    int s;
+
+    ST_CHECK_PARAM(d == NULL || fp == NULL, -1);
+
+    head[0] = ST_DICT64_MAGIC;
+    head[1] = (uint32_t)d->shard_bits;
+    if(fwrite(head, sizeof(uint32_t), 2, fp) != 2) {
+        ST_WARNING("Failed to write header.");
+        return -1;
+    }
+
+    for(s = 0; s < d->shard_num; s++) {
+        if(st_dict_save(d->shards[s], fp) < 0) {
+            ST_WARNING("Failed to st_dict_save shard[%d].", s);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+st_dict64_t* st_dict64_load_from_bin(FILE *fp)
+{
+    st_dict64_t *d = NULL;
+    uint32_t head[2];
+    int s;
+
+    ST_CHECK_PARAM(fp == NULL, NULL);
+
+    if(fread(head, sizeof(uint32_t), 1, fp) != 1) {
+        ST_WARNING("Failed to read magic num.");
+        return NULL;
+    }
+
+    if(head[0] != ST_DICT64_MAGIC) {
+        /* a st_dict file, loaded as the only shard. */
+        if(fseeko(fp, -(off_t)sizeof(uint32_t), SEEK_CUR) != 0) {
+            ST_WARNING("Failed to fseeko[%m].");
+            return NULL;
+        }
+        head[1] = 0;
+    } else if(fread(head + 1, sizeof(uint32_t), 1, fp) != 1) {
+        ST_WARNING("Failed to read shard_bits.");
+        return NULL;
+    }
+
+    if(head[1] > ST_DICT64_MAX_SHARD_BITS) {
+        ST_WARNING("Corrupted header, shard_bits[%u].", head[1]);
+        return NULL;
+    }
+
+    d = dict64_alloc((int)head[1]);
+    if(d == NULL) {
+        ST_WARNING("Failed to dict64_alloc.");
+        return NULL;
+    }
+
+    for(s = 0; s < d->shard_num; s++) {
+        d->shards[s] = st_dict_load_from_bin(fp);
+        if(d->shards[s] == NULL) {
+            ST_WARNING("Failed to st_dict_load_from_bin shard[%d].", s);
+            goto ERR;
+        }
+    }
+
+    return d;
+
+ERR:
+    safe_st_dict64_destroy(d);
+    return NULL;
+}
@@ -0,0 +1,134 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _ST_DICT64_H_
+#define _ST_DICT64_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <stutils/st_macro.h>
+#include "st_dict.h"
+
+/*
+ * Dict for more than 2^32 - 1 nodes.
+ *
+ * Nodes are spread over shards by the top bits of a 64-bit mix of their
+ * signs, and every shard is a plain st_dict, so nodes keep the compact
+ * 16-byte layout of 32-bit ids. A dict that fits one st_dict has a
+ * single shard and costs nothing over it.
+ *
+ * st_dict64_reserve moves the node_pool of every shard into a sparse
+ * reservation of 2^32 - 1 nodes, optionally backed by a file, so that
+ * the shards grow without reallocating and hold more nodes than RAM.
+ */
+
+#define ST_DICT64_MAX_SHARD_BITS 16
+
+typedef struct _st_dict64_t {
+    st_dict_t **shards;
+    int shard_bits;
+    int shard_num;
+} st_dict64_t;
+
+/*
+ * Create a dict.
+ *
+ * @param[in] hash_num buckets in total.
+ * @param[in] max_node_num nodes expected in total, used to pick the
+ *                         number of shards.
+ * @param[in] realloc_node_num, hash_func, node_eq_func see
+ *            st_dict_create, used for every shard. hash_func must
+ *            reduce its result with the addr_mask of the shard.
+ * @return the dict, NULL if any error.
+ */
+st_dict64_t* st_dict64_create(uint64_t hash_num, uint64_t max_node_num,
+        st_dict_id_t realloc_node_num, st_dict_hash_fun_t hash_func,
+        st_dict_node_eq_fun_t node_eq_func);
+
+#define safe_st_dict64_destroy(ptr) do {\
+    if((ptr) != NULL) {\
+        st_dict64_destroy(ptr);\
+        safe_free(ptr);\
+        (ptr) = NULL;\
+    }\
+    } while(0)
+void st_dict64_destroy(st_dict64_t *d);
+
+/*
+ * Reserve the node_pool of every shard, see st_dict_reserve_pool.
+ *
+ * @param[in] d the dict.
+ * @param[in] dir directory for the backing files, which are unlinked
+ *                at once; NULL for anonymous memory.
+ * @return non-zero value if any error.
+ */
+int st_dict64_reserve(st_dict64_t *d, const char *dir);
+
+/* the shard pnode belongs to. */
+st_dict_t* st_dict64_shard(st_dict64_t *d, st_dict_node_t *pnode);
+
+/* see st_dict_add, st_dict_add_no_seek, st_dict_seek and so on. */
+int st_dict64_add(st_dict64_t *d, st_dict_node_t *pnode, void *node_eq_arg);
+int st_dict64_add_no_seek(st_dict64_t *d, st_dict_node_t *pnode);
+int st_dict64_seek(st_dict64_t *d, st_dict_node_t *pnode, void *node_eq_arg);
+int st_dict64_update(st_dict64_t *d, st_dict_node_t *pnode,
+        void *node_eq_arg, st_dict_update_func_t update_data);
+int st_dict64_remove(st_dict64_t *d, st_dict_node_t *pnode,
+        void *node_eq_arg);
+/* shards are visited one after another. */
+int st_dict64_traverse(st_dict64_t *d, st_dict_trav_func_t trav,
+        void *args);
+int st_dict64_set_rehash(st_dict64_t *d, float max_load_factor,
+        st_dict_id_t rehash_step);
+
+uint64_t st_dict64_node_num(st_dict64_t *d);
+
+/*
+ * Save a dict, as a small header followed by every shard in st_dict
+ * format.
+ *
+ * @param[in] d the dict.
+ * @param[in] fp the file.
+ * @return non-zero value if any error.
+ */
+int st_dict64_save(st_dict64_t *d, FILE *fp);
+
+/*
+ * Load a dict saved by st_dict64_save, or a st_dict file as a single
+ * shard. fp must be seekable.
+ *
+ * @param[in] fp the file.
+ * @return the dict, NULL if any error.
+ */
+st_dict64_t* st_dict64_load_from_bin(FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,330 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <stutils/st_macro.h>
+#include "st_log.h"
+#include "st_dict_acc.h"
+
+static st_dict_t* acc_dict_create(st_dict_acc_t *acc)
+{
+    return st_dict_create(acc->hash_num, acc->realloc_node_num,
+            acc->hash_func, NULL, false);
+}
+
+/* bytes taken by the tables of a thread dict. */
+static size_t acc_dict_bytes(st_dict_t *dict)
+{
+    size_t num;
+
+    num = (size_t)dict->hash_num + dict->max_pool_num;
+    if(dict->old_first_level_node != NULL) {
+        num += dict->old_hash_num;
+    }
+
+    return sizeof(st_dict_node_t) * num;
+}
+
+static void acc_local_clear_spill(st_dict_acc_local_t *local)
+{
+    int i;
+
+    for(i = 0; i < local->spill_num; i++) {
+        (void)unlink(local->spill_files[i]);
+        safe_free(local->spill_files[i]);
+    }
+    safe_free(local->spill_files);
+    local->spill_num = 0;
+}
+
+void st_dict_acc_destroy(st_dict_acc_t *acc)
+{
+    int t;
+
+    if(acc == NULL) {
+        return;
+    }
+
+    if(acc->locals != NULL) {
+        for(t = 0; t < acc->num_thread; t++) {
+            safe_st_dict_destroy(acc->locals[t].dict);
+            acc_local_clear_spill(acc->locals + t);
+        }
+        safe_free(acc->locals);
+    }
+    acc->num_thread = 0;
+}
+
+st_dict_acc_t* st_dict_acc_create(int num_thread, st_dict_id_t hash_num,
+        st_dict_id_t realloc_node_num, st_dict_hash_fun_t hash_func,
+        st_dict_update_func_t update_func, st_dict_merge_func_t merge_func)
+{
+    st_dict_acc_t *acc = NULL;
+    int t;
+
+    ST_CHECK_PARAM(num_thread <= 0 || update_func == NULL
+            || merge_func == NULL, NULL);
+
+    acc = (st_dict_acc_t *)malloc(sizeof(st_dict_acc_t));
+    if(acc == NULL) {
+        ST_WARNING("Failed to alloc mem for st_dict_acc.");
+        return NULL;
+    }
+    memset(acc, 0, sizeof(st_dict_acc_t));
+
+    acc->hash_num = hash_num;
+    acc->realloc_node_num = realloc_node_num;
+    if(hash_func == st_dict_hash_auto) {
+        /* thread dicts sampling apart may choose different hashes. */
+        acc->hash_func = st_dict_hash_murmur;
+    } else {
+        acc->hash_func = hash_func;
+    }
+    acc->update_func = update_func;
+    acc->merge_func = merge_func;
+
+    acc->locals = (st_dict_acc_local_t *)calloc(num_thread,
+            sizeof(st_dict_acc_local_t));
+    if(acc->locals == NULL) {
+        ST_WARNING("Failed to alloc mem for locals.");
+        goto ERR;
+    }
+    acc->num_thread = num_thread;
+
+    for(t = 0; t < num_thread; t++) {
+        acc->locals[t].dict = acc_dict_create(acc);
+        if(acc->locals[t].dict == NULL) {
+            ST_WARNING("Failed to acc_dict_create.");
+            goto ERR;
+        }
+    }
+
+    return acc;
+
+ERR:
+    safe_st_dict_acc_destroy(acc);
+    return NULL;
+}
+
+int st_dict_acc_set_spill(st_dict_acc_t *acc, size_t spill_bytes,
+        const char *spill_dir)
+{
+    ST_CHECK_PARAM(acc == NULL || (spill_bytes > 0
+                && (spill_dir == NULL || spill_dir[0] == '\0')), -1);
+
+    acc->spill_bytes = spill_bytes;
+    if(spill_dir != NULL) {
+        strncpy(acc->spill_dir, spill_dir, MAX_DIR_LEN);
+        acc->spill_dir[MAX_DIR_LEN - 1] = '\0';
+    }
+
+    return 0;
+}
+
+static int acc_spill(st_dict_acc_t *acc, st_dict_acc_local_t *local)
+{
+    char fname[MAX_DIR_LEN + MAX_NAME_LEN];
+    char **spill_files;
+    st_dict_t *dict = NULL;
+    FILE *fp = NULL;
+    int fd;
+
+    snprintf(fname, sizeof(fname), "%s/st_dict_acc.XXXXXX", acc->spill_dir);
+    fd = mkstemp(fname);
+    if(fd < 0) {
+        ST_WARNING("Failed to mkstemp[%s].", fname);
+        return -1;
+    }
+    fp = fdopen(fd, "wb");
+    if(fp == NULL) {
+        ST_WARNING("Failed to fdopen[%s].", fname);
+        safe_close(fd);
+        goto ERR;
+    }
+
+    /* start afresh, giving the memory back. */
+    dict = acc_dict_create(acc);
+    if(dict == NULL) {
+        ST_WARNING("Failed to acc_dict_create.");
+        goto ERR;
+    }
+
+    if(st_dict_save(local->dict, fp) < 0) {
+        ST_WARNING("Failed to st_dict_save.");
+        goto ERR;
+    }
+    if(fclose(fp) != 0) {
+        fp = NULL;
+        ST_WARNING("Failed to fclose[%s].", fname);
+        goto ERR;
+    }
+    fp = NULL;
+
+    spill_files = (char **)realloc(local->spill_files,
+            sizeof(char *) * (local->spill_num + 1));
+    if(spill_files == NULL) {
+        ST_WARNING("Failed to alloc mem for spill_files.");
+        goto ERR;
+    }
+    local->spill_files = spill_files;
+    local->spill_files[local->spill_num] = strdup(fname);
+    if(local->spill_files[local->spill_num] == NULL) {
+        ST_WARNING("Failed to strdup.");
+        goto ERR;
+    }
+    local->spill_num++;
+
+    safe_st_dict_destroy(local->dict);
+    local->dict = dict;
+
+    return 0;
+
+ERR:
+    safe_st_dict_destroy(dict);
+    safe_fclose(fp);
+    (void)unlink(fname);
+    return -1;
+}
+
+int st_dict_acc_update(st_dict_acc_t *acc, int tid, st_dict_node_t *pnode)
+{
+    st_dict_acc_local_t *local;
+
+    ST_CHECK_PARAM(acc == NULL || tid < 0 || tid >= acc->num_thread
+            || pnode == NULL, -1);
+
+    local = acc->locals + tid;
+    if(st_dict_update(local->dict, pnode, NULL, acc->update_func) < 0) {
+        ST_WARNING("Failed to st_dict_update.");
+        return -1;
+    }
+
+    if(acc->spill_bytes > 0 && acc_dict_bytes(local->dict) > acc->spill_bytes) {
+        if(acc_spill(acc, local) < 0) {
+            ST_WARNING("Failed to acc_spill.");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+st_dict_t* st_dict_acc_merge(st_dict_acc_t *acc, int num_thread)
+{
+    st_dict_t **srcs = NULL;
+    st_dict_t **fresh = NULL;
+    st_dict_t *dict = NULL;
+    int n;
+    int i;
+    int t;
+
+    ST_CHECK_PARAM(acc == NULL || num_thread <= 0, NULL);
+
+    n = acc->num_thread;
+    for(t = 0; t < acc->num_thread; t++) {
+        n += acc->locals[t].spill_num;
+    }
+    if(n <= 0) {
+        ST_WARNING("Too many spill files.");
+        return NULL;
+    }
+    srcs = (st_dict_t **)calloc(n, sizeof(st_dict_t *));
+    if(srcs == NULL) {
+        ST_WARNING("Failed to alloc mem for srcs.");
+        return NULL;
+    }
+
+    /* the thread dicts to start afresh with, made before anything is
+     * consumed so that a failure leaves the accumulator untouched. */
+    fresh = (st_dict_t **)calloc(acc->num_thread, sizeof(st_dict_t *));
+    if(fresh == NULL) {
+        ST_WARNING("Failed to alloc mem for fresh.");
+        goto ERR;
+    }
+    for(t = 0; t < acc->num_thread; t++) {
+        fresh[t] = acc_dict_create(acc);
+        if(fresh[t] == NULL) {
+            ST_WARNING("Failed to acc_dict_create.");
+            goto ERR;
+        }
+    }
+
+    n = 0;
+    for(t = 0; t < acc->num_thread; t++) {
+        srcs[n++] = acc->locals[t].dict;
+        for(i = 0; i < acc->locals[t].spill_num; i++) {
+            srcs[n] = st_dict_open_readonly(acc->locals[t].spill_files[i]);
+            if(srcs[n] == NULL) {
+                ST_WARNING("Failed to st_dict_open_readonly[%s].",
+                        acc->locals[t].spill_files[i]);
+                goto ERR;
+            }
+            /* a custom hash_func is not recorded in the file. */
+            srcs[n]->hash_func = acc->hash_func != NULL
+                ? acc->hash_func : st_dict_hash_simple;
+            n++;
+        }
+    }
+
+    dict = st_dict_merge(srcs, n, acc->merge_func, num_thread);
+    if(dict == NULL) {
+        ST_WARNING("Failed to st_dict_merge.");
+        goto ERR;
+    }
+
+    for(i = 0; i < n; i++) {
+        if(srcs[i]->readonly) {
+            safe_st_dict_destroy(srcs[i]);
+        }
+    }
+    safe_free(srcs);
+
+    for(t = 0; t < acc->num_thread; t++) {
+        acc_local_clear_spill(acc->locals + t);
+        safe_st_dict_destroy(acc->locals[t].dict);
+        acc->locals[t].dict = fresh[t];
+    }
+    safe_free(fresh);
+
+    return dict;
+
+ERR:
+    if(fresh != NULL) {
+        for(t = 0; t < acc->num_thread; t++) {
+            safe_st_dict_destroy(fresh[t]);
+        }
+    }
+    safe_free(fresh);
+    if(srcs != NULL) {
+        for(i = 0; i < n; i++) {
+            if(srcs[i] != NULL && srcs[i]->readonly) {
+                safe_st_dict_destroy(srcs[i]);
+            }
+        }
+    }
+    safe_free(srcs);
+    return NULL;
+}
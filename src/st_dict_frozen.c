@@ -0,0 +1,531 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include <stutils/st_macro.h>
+#include "st_log.h"
+#include "st_dict_frozen.h"
+
+#define FROZEN_MAGIC       0x5a464453
+#define FROZEN_VERSION     1
+
+/* pilots with this bit set hold the slot of a single-key bucket. */
+#define FROZEN_DIRECT      0x80000000U
+#define FROZEN_MAX_PILOT   0x00FFFFFFU
+#define FROZEN_MAX_TRIAL   8
+
+typedef struct _frozen_header_t
+{
+    uint32_t     magic;
+    uint32_t     version;
+    uint32_t     node_num;
+    uint32_t     bucket_num;
+    uint64_t     seed;
+} frozen_header_t;
+
+static inline uint64_t frozen_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+static inline uint64_t frozen_hash(uint64_t seed, st_dict_sign_t sign1,
+        st_dict_sign_t sign2)
+{
+    return frozen_mix(((((uint64_t)sign1) << 32) | sign2) ^ seed);
+}
+
+/* maps x uniformly onto [0, n) without a division. */
+static inline st_dict_id_t frozen_range(uint64_t x, st_dict_id_t n)
+{
+    return (st_dict_id_t)(((unsigned __int128)x * n) >> 64);
+}
+
+static inline st_dict_id_t frozen_bucket(st_dict_frozen_t *fd, uint64_t h)
+{
+    return (st_dict_id_t)(((h >> 32) * fd->bucket_num) >> 32);
+}
+
+static inline st_dict_id_t frozen_slot(uint64_t h, uint32_t pilot,
+        st_dict_id_t node_num)
+{
+    if (pilot & FROZEN_DIRECT) {
+        return pilot & ~FROZEN_DIRECT;
+    }
+
+    return frozen_range(frozen_mix(h ^ ((pilot + 1)
+                    * 0x9E3779B97F4A7C15ULL)), node_num);
+}
+
+void st_dict_frozen_destroy(st_dict_frozen_t *fd)
+{
+    if (fd == NULL) {
+        return;
+    }
+
+    safe_free(fd->pilots);
+    safe_free(fd->nodes);
+    fd->bucket_num = 0;
+    fd->node_num = 0;
+}
+
+static st_dict_frozen_t* st_dict_frozen_alloc(st_dict_id_t node_num,
+        st_dict_id_t bucket_num)
+{
+    st_dict_frozen_t *fd = NULL;
+
+    fd = (st_dict_frozen_t *)malloc(sizeof(st_dict_frozen_t));
+    if (fd == NULL) {
+        ST_WARNING("Failed to alloc mem for st_dict_frozen.");
+        return NULL;
+    }
+    memset(fd, 0, sizeof(st_dict_frozen_t));
+
+    fd->node_num = node_num;
+    fd->bucket_num = bucket_num;
+
+    fd->pilots = (uint32_t *)malloc(sizeof(uint32_t) * bucket_num);
+    if (fd->pilots == NULL) {
+        ST_WARNING("Failed to alloc mem for pilots.");
+        goto ERR;
+    }
+    memset(fd->pilots, 0, sizeof(uint32_t) * bucket_num);
+
+    if (node_num > 0) {
+        fd->nodes = (st_dict_frozen_node_t *)malloc(
+                sizeof(st_dict_frozen_node_t) * node_num);
+        if (fd->nodes == NULL) {
+            ST_WARNING("Failed to alloc mem for nodes.");
+            goto ERR;
+        }
+    }
+
+    return fd;
+
+ERR:
+    safe_st_dict_frozen_destroy(fd);
+    return NULL;
+}
+
+typedef struct _frozen_key_t
+{
+    uint64_t     hash;
+    st_dict_id_t bucket;
+    st_dict_id_t node;
+} frozen_key_t;
+
+typedef struct _frozen_collect_args_t
+{
+    st_dict_node_t *nodes;
+    st_dict_id_t   num;
+    st_dict_id_t   cap;
+} frozen_collect_args_t;
+
+static int frozen_collect(st_dict_node_t *p, void *args)
+{
+    frozen_collect_args_t *c = (frozen_collect_args_t *)args;
+
+    if (c->num >= c->cap) {
+        ST_WARNING("node_num of dict not match.");
+        return -1;
+    }
+    c->nodes[c->num++] = *p;
+
+    return 0;
+}
+
+/*
+ * Try to place every key with the given seed.
+ * Returns 1 if a retry with another seed is needed.
+ */
+static int frozen_place(st_dict_frozen_t *fd, st_dict_node_t *nodes,
+        frozen_key_t *keys, st_dict_id_t *order, st_dict_id_t *bucket_start,
+        uint8_t *taken, st_dict_id_t *slots)
+{
+    st_dict_frozen_node_t *fnode;
+    st_dict_id_t n = fd->node_num;
+    st_dict_id_t i, j, k, b;
+    st_dict_id_t size;
+    st_dict_id_t free_slot;
+    uint32_t pilot;
+
+    memset(taken, 0, n);
+    memset(fd->pilots, 0, sizeof(uint32_t) * fd->bucket_num);
+
+    /* order holds buckets by decreasing size. */
+    free_slot = 0;
+    for (i = 0; i < fd->bucket_num; i++) {
+        b = order[i];
+        size = bucket_start[b + 1] - bucket_start[b];
+        if (size == 0) {
+            break;
+        }
+
+        if (size == 1) {
+            while (taken[free_slot]) {
+                free_slot++;
+            }
+            slots[0] = free_slot;
+            fd->pilots[b] = FROZEN_DIRECT | free_slot;
+        } else {
+            for (pilot = 0; pilot <= FROZEN_MAX_PILOT; pilot++) {
+                for (j = 0; j < size; j++) {
+                    slots[j] = frozen_slot(keys[bucket_start[b] + j].hash,
+                            pilot, n);
+                    if (taken[slots[j]]) {
+                        break;
+                    }
+                    for (k = 0; k < j; k++) {
+                        if (slots[k] == slots[j]) {
+                            break;
+                        }
+                    }
+                    if (k < j) {
+                        break;
+                    }
+                }
+                if (j >= size) {
+                    break;
+                }
+            }
+            if (pilot > FROZEN_MAX_PILOT) {
+                return 1;
+            }
+            fd->pilots[b] = pilot;
+        }
+
+        for (j = 0; j < size; j++) {
+            k = bucket_start[b] + j;
+            taken[slots[j]] = 1;
+            fnode = fd->nodes + slots[j];
+            fnode->sign1 = nodes[keys[k].node].sign1;
+            fnode->sign2 = nodes[keys[k].node].sign2;
+            fnode->uint1 = nodes[keys[k].node].uint1;
+        }
+    }
+
+    return 0;
+}
+
+st_dict_frozen_t* st_dict_freeze(st_dict_t *wd)
+{
+    st_dict_frozen_t *fd = NULL;
+    frozen_collect_args_t c;
+    frozen_key_t *keys = NULL;
+    frozen_key_t *sorted = NULL;
+    st_dict_id_t *bucket_start = NULL;
+    st_dict_id_t *order = NULL;
+    st_dict_id_t *size_start = NULL;
+    uint8_t *taken = NULL;
+    st_dict_id_t slots[256];
+    st_dict_id_t n, b, i, j, k;
+    st_dict_id_t size, max_size;
+    int trial;
+    int ret;
+
+    ST_CHECK_PARAM(wd == NULL, NULL);
+
+    /* a pilot with FROZEN_DIRECT keeps 31 bits for the slot. */
+    if ((uint64_t)wd->node_num > ST_DICT_FROZEN_MAX_NODE_NUM) {
+        ST_WARNING("Too many nodes[%lu] to freeze.",
+                (unsigned long)wd->node_num);
+        return NULL;
+    }
+
+    memset(&c, 0, sizeof(c));
+    n = wd->node_num;
+    fd = st_dict_frozen_alloc(n, n / ST_DICT_FROZEN_BUCKET_SIZE + 1);
+    if (fd == NULL) {
+        ST_WARNING("Failed to st_dict_frozen_alloc.");
+        return NULL;
+    }
+    if (n == 0) {
+        return fd;
+    }
+
+    c.cap = n;
+    c.nodes = (st_dict_node_t *)malloc(sizeof(st_dict_node_t) * n);
+    keys = (frozen_key_t *)malloc(sizeof(frozen_key_t) * n);
+    sorted = (frozen_key_t *)malloc(sizeof(frozen_key_t) * n);
+    bucket_start = (st_dict_id_t *)malloc(sizeof(st_dict_id_t)
+            * (fd->bucket_num + 1));
+    order = (st_dict_id_t *)malloc(sizeof(st_dict_id_t) * fd->bucket_num);
+    taken = (uint8_t *)malloc(n);
+    if (c.nodes == NULL || keys == NULL || sorted == NULL
+            || bucket_start == NULL || order == NULL || taken == NULL) {
+        ST_WARNING("Failed to alloc mem for building.");
+        goto ERR;
+    }
+
+    if (st_dict_traverse(wd, frozen_collect, &c) < 0 || c.num != n) {
+        ST_WARNING("Failed to collect nodes.");
+        goto ERR;
+    }
+
+    for (trial = 0; trial < FROZEN_MAX_TRIAL; trial++) {
+        fd->seed = frozen_mix(0x5354444943540000ULL + trial);
+
+        /* counting sort keys by bucket. */
+        memset(bucket_start, 0, sizeof(st_dict_id_t) * (fd->bucket_num + 1));
+        for (i = 0; i < n; i++) {
+            keys[i].hash = frozen_hash(fd->seed, c.nodes[i].sign1,
+                    c.nodes[i].sign2);
+            keys[i].bucket = frozen_bucket(fd, keys[i].hash);
+            keys[i].node = i;
+            bucket_start[keys[i].bucket + 1]++;
+        }
+        max_size = 0;
+        for (b = 0; b < fd->bucket_num; b++) {
+            max_size = max(max_size, bucket_start[b + 1]);
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        if (max_size > sizeof(slots) / sizeof(slots[0])) {
+            continue;
+        }
+        for (i = 0; i < n; i++) {
+            sorted[bucket_start[keys[i].bucket]++] = keys[i];
+        }
+        for (b = fd->bucket_num; b > 0; b--) {
+            bucket_start[b] = bucket_start[b - 1];
+        }
+        bucket_start[0] = 0;
+
+        /* same signs always collide, whatever the pilot is. */
+        for (b = 0; b < fd->bucket_num; b++) {
+            for (j = bucket_start[b]; j < bucket_start[b + 1]; j++) {
+                for (k = bucket_start[b]; k < j; k++) {
+                    if (sorted[k].hash == sorted[j].hash) {
+                        ST_WARNING("Duplicated node[%u/%u].",
+                                c.nodes[sorted[j].node].sign1,
+                                c.nodes[sorted[j].node].sign2);
+                        goto ERR;
+                    }
+                }
+            }
+        }
+
+        /* counting sort buckets by decreasing size. */
+        size_start = (st_dict_id_t *)malloc(sizeof(st_dict_id_t)
+                * (max_size + 2));
+        if (size_start == NULL) {
+            ST_WARNING("Failed to alloc mem for size_start.");
+            goto ERR;
+        }
+        memset(size_start, 0, sizeof(st_dict_id_t) * (max_size + 2));
+        for (b = 0; b < fd->bucket_num; b++) {
+            size = bucket_start[b + 1] - bucket_start[b];
+            size_start[max_size - size + 1]++;
+        }
+        for (i = 0; i <= max_size; i++) {
+            size_start[i + 1] += size_start[i];
+        }
+        for (b = 0; b < fd->bucket_num; b++) {
+            size = bucket_start[b + 1] - bucket_start[b];
+            order[size_start[max_size - size]++] = b;
+        }
+        safe_free(size_start);
+
+        ret = frozen_place(fd, c.nodes, sorted, order, bucket_start,
+                taken, slots);
+        if (ret == 0) {
+            break;
+        }
+    }
+
+    if (trial >= FROZEN_MAX_TRIAL) {
+        ST_WARNING("Failed to build perfect hash.");
+        goto ERR;
+    }
+
+    safe_free(c.nodes);
+    safe_free(keys);
+    safe_free(sorted);
+    safe_free(bucket_start);
+    safe_free(order);
+    safe_free(taken);
+
+    return fd;
+
+ERR:
+    safe_free(c.nodes);
+    safe_free(keys);
+    safe_free(sorted);
+    safe_free(bucket_start);
+    safe_free(order);
+    safe_free(size_start);
+    safe_free(taken);
+    safe_st_dict_frozen_destroy(fd);
+    return NULL;
+}
+
+int st_dict_frozen_seek(st_dict_frozen_t *fd, st_dict_node_t *pnode)
+{
+    st_dict_frozen_node_t *fnode;
+    uint64_t h;
+    st_dict_id_t slot;
+
+    ST_CHECK_PARAM(fd == NULL || pnode == NULL
+            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+
+    if (fd->node_num == 0) {
+        return -1;
+    }
+
+    h = frozen_hash(fd->seed, pnode->sign1, pnode->sign2);
+    slot = frozen_slot(h, fd->pilots[frozen_bucket(fd, h)], fd->node_num);
+    if (slot >= fd->node_num) {
+        return -1;
+    }
+
+    fnode = fd->nodes + slot;
+    if (fnode->sign1 != pnode->sign1 || fnode->sign2 != pnode->sign2) {
+        return -1;
+    }
+    pnode->uint1 = fnode->uint1;
+
+    return 0;
+}
+
+int st_dict_frozen_traverse(st_dict_frozen_t *fd, st_dict_trav_func_t trav,
+        void *args)
+{
+    st_dict_node_t node;
+    st_dict_id_t i;
+
+    ST_CHECK_PARAM(fd == NULL, -1);
+
+    if (trav == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < fd->node_num; i++) {
+        node.sign1 = fd->nodes[i].sign1;
+        node.sign2 = fd->nodes[i].sign2;
+        node.uint1 = fd->nodes[i].uint1;
+        node.next = ST_DICT_BAD_NODE;
+
+        if (trav(&node, args) < 0) {
+            ST_WARNING("Failed to trav.");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int st_dict_frozen_save(st_dict_frozen_t *fd, FILE *fp)
+{
+    frozen_header_t header;
+
+    ST_CHECK_PARAM(fd == NULL || fp == NULL, -1);
+
+    memset(&header, 0, sizeof(header));
+    header.magic = FROZEN_MAGIC;
+    header.version = FROZEN_VERSION;
+    header.node_num = fd->node_num;
+    header.bucket_num = fd->bucket_num;
+    header.seed = fd->seed;
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        ST_WARNING("Failed to write header.");
+        return -1;
+    }
+
+    if (fwrite(fd->pilots, sizeof(uint32_t), fd->bucket_num, fp)
+            != fd->bucket_num) {
+        ST_WARNING("Failed to write pilots.");
+        return -1;
+    }
+
+    if (fwrite(fd->nodes, sizeof(st_dict_frozen_node_t), fd->node_num, fp)
+            != fd->node_num) {
+        ST_WARNING("Failed to write nodes.");
+        return -1;
+    }
+
+    fflush(fp);
+
+    return 0;
+}
+
+st_dict_frozen_t* st_dict_frozen_load_from_bin(FILE *fp)
+{
+    st_dict_frozen_t *fd = NULL;
+    frozen_header_t header;
+
+    ST_CHECK_PARAM(fp == NULL, NULL);
+
+    if (fread(&header, sizeof(header), 1, fp) != 1) {
+        ST_WARNING("Failed to read header.");
+        return NULL;
+    }
+
+    if (header.magic != FROZEN_MAGIC) {
+        ST_WARNING("Magic num not match.");
+        return NULL;
+    }
+
+    if (header.version > FROZEN_VERSION) {
+        ST_WARNING("Too high version[%u/%u].", header.version,
+                FROZEN_VERSION);
+        return NULL;
+    }
+
+    if (header.bucket_num == 0
+            || header.node_num > ST_DICT_FROZEN_MAX_NODE_NUM) {
+        ST_WARNING("Corrupted header.");
+        return NULL;
+    }
+
+    fd = st_dict_frozen_alloc(header.node_num, header.bucket_num);
+    if (fd == NULL) {
+        ST_WARNING("Failed to st_dict_frozen_alloc.");
+        return NULL;
+    }
+    fd->seed = header.seed;
+
+    if (fread(fd->pilots, sizeof(uint32_t), fd->bucket_num, fp)
+            != fd->bucket_num) {
+        ST_WARNING("Failed to read pilots.");
+        goto ERR;
+    }
+
+    if (fread(fd->nodes, sizeof(st_dict_frozen_node_t), fd->node_num, fp)
+            != fd->node_num) {
+        ST_WARNING("Failed to read nodes.");
+        goto ERR;
+    }
+
+    return fd;
+
+ERR:
+    safe_st_dict_frozen_destroy(fd);
+    return NULL;
+}
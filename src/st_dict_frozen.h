@@ -0,0 +1,108 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _ST_DICT_FROZEN_H_
+#define _ST_DICT_FROZEN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <stutils/st_macro.h>
+#include "st_dict.h"
+
+/*
+ * Immutable dict built on a minimal perfect hash (hash and displace).
+ *
+ * Keys are split into buckets of about ST_DICT_FROZEN_BUCKET_SIZE keys.
+ * Every bucket stores a 32-bit pilot, which places all its keys into
+ * distinct slots of a node array with exactly node_num entries. A seek
+ * reads one pilot and one node, then checks sign1/sign2 of the node to
+ * reject keys not in the dict.
+ */
+
+#define ST_DICT_FROZEN_BUCKET_SIZE 4
+
+/* a frozen dict holds at most this many nodes. */
+#define ST_DICT_FROZEN_MAX_NODE_NUM 0x7FFFFFFFU
+
+typedef struct _st_dict_frozen_node_t
+{
+    st_dict_sign_t sign1;
+    st_dict_sign_t sign2;
+    union
+    {
+        unsigned int uint1;
+        float        float1;
+    };
+} st_dict_frozen_node_t;
+
+typedef struct _st_dict_frozen_t
+{
+    uint32_t              *pilots;
+    st_dict_id_t          bucket_num;
+
+    st_dict_frozen_node_t *nodes;
+    st_dict_id_t          node_num;
+
+    uint64_t              seed;
+} st_dict_frozen_t;
+
+/*
+ * Build a frozen dict holding all nodes of wd.
+ *
+ * Nodes are matched by sign1 and sign2 only, so wd must not contain two
+ * nodes with the same signs. Dicts with more than
+ * ST_DICT_FROZEN_MAX_NODE_NUM nodes are refused.
+ *
+ * @param[in] wd the dict, unchanged.
+ * @return the frozen dict, NULL if any error or wd is too large.
+ */
+st_dict_frozen_t* st_dict_freeze(st_dict_t *wd);
+
+#define safe_st_dict_frozen_destroy(ptr) do {\
+    if((ptr) != NULL) {\
+        st_dict_frozen_destroy(ptr);\
+        safe_free(ptr);\
+        (ptr) = NULL;\
+    }\
+    } while(0)
+void st_dict_frozen_destroy(st_dict_frozen_t *fd);
+
+int st_dict_frozen_seek(st_dict_frozen_t *fd, st_dict_node_t *pnode);
+
+int st_dict_frozen_traverse(st_dict_frozen_t *fd, st_dict_trav_func_t trav,
+        void *args);
+
+int st_dict_frozen_save(st_dict_frozen_t *fd, FILE *fp);
+st_dict_frozen_t* st_dict_frozen_load_from_bin(FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _ST_DICT_INL_H_
+#define _ST_DICT_INL_H_
+
+/*
+ * Inline helpers shared by the st_dict variants. Private to the library,
+ * this header is not installed.
+ */
+
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "st_dict_oa.h"
+
+/* fmix64 from MurmurHash3, over the signs of a key. */
+static inline uint64_t st_dict_fmix64(st_dict_sign_t sign1,
+        st_dict_sign_t sign2)
+{
+    uint64_t h;
+
+    h = (((uint64_t)sign1) << 32) | sign2;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+/* bitmask of slots in group whose control byte equals tag. */
+static inline unsigned int st_dict_group_match(const uint8_t *ctrl,
+        uint8_t tag)
+{
+#ifdef __SSE2__
+    __m128i group = _mm_load_si128((const __m128i *)ctrl);
+
+    return (unsigned int)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#else
+    unsigned int mask = 0;
+    int i;
+
+    for (i = 0; i < ST_DICT_OA_GROUP; i++) {
+        if (ctrl[i] == tag) {
+            mask |= 1U << i;
+        }
+    }
+
+    return mask;
+#endif
+}
+
+/* bitmask of empty slots in group. */
+static inline unsigned int st_dict_group_match_empty(const uint8_t *ctrl)
+{
+#ifdef __SSE2__
+    __m128i group = _mm_load_si128((const __m128i *)ctrl);
+
+    return (unsigned int)_mm_movemask_epi8(group);
+#else
+    return st_dict_group_match(ctrl, ST_DICT_OA_EMPTY);
+#endif
+}
+
+#endif
@@ -0,0 +1,333 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <assert.h>
+
+#include <stutils/st_macro.h>
+#include "st_log.h"
+#include "st_mem.h"
+#include "st_dict_oa.h"
+#include "st_dict_inl.h"
+
+/* grow when more than 7/8 of the slots are used. */
+#define OA_MAX_LOAD(cap) ((cap) - (cap) / 8)
+
+static inline bool oa_node_eq(st_dict_oa_t *wd, st_dict_node_t *node,
+        st_dict_node_t *pnode, void *node_eq_arg)
+{
+    if (wd->node_eq_func != NULL) {
+        return wd->node_eq_func(node, pnode, node_eq_arg);
+    }
+
+    return node->sign1 == pnode->sign1 && node->sign2 == pnode->sign2;
+}
+
+void st_dict_oa_destroy(st_dict_oa_t *wd)
+{
+    if (wd == NULL) {
+        return;
+    }
+
+    safe_st_aligned_free(wd->ctrl);
+    safe_free(wd->slots);
+    wd->capacity = 0;
+    wd->node_num = 0;
+}
+
+static int oa_alloc_table(st_dict_oa_t *wd, st_dict_id_t capacity)
+{
+    wd->ctrl = (uint8_t *)st_aligned_malloc(capacity, ST_DICT_OA_GROUP);
+    if (wd->ctrl == NULL) {
+        ST_WARNING("Failed to st_aligned_malloc ctrl.");
+        return -1;
+    }
+    memset(wd->ctrl, ST_DICT_OA_EMPTY, capacity);
+
+    wd->slots = (st_dict_node_t *)malloc(sizeof(st_dict_node_t) * capacity);
+    if (wd->slots == NULL) {
+        ST_WARNING("Failed to alloc mem for slots.");
+        safe_st_aligned_free(wd->ctrl);
+        return -1;
+    }
+
+    wd->capacity = capacity;
+    wd->group_mask = capacity / ST_DICT_OA_GROUP - 1;
+    wd->max_node_num = OA_MAX_LOAD(capacity);
+
+    return 0;
+}
+
+st_dict_oa_t* st_dict_oa_create(st_dict_id_t node_num,
+    st_dict_node_eq_fun_t node_eq_func)
+{
+    st_dict_oa_t *wd = NULL;
+    st_dict_id_t capacity;
+
+    ST_CHECK_PARAM(node_num == ST_DICT_BAD_NODE, NULL);
+
+    wd = (st_dict_oa_t *)malloc(sizeof(st_dict_oa_t));
+    if (wd == NULL) {
+        ST_WARNING("Failed to alloc mem for st_dict_oa.");
+        return NULL;
+    }
+    memset(wd, 0, sizeof(st_dict_oa_t));
+    wd->node_eq_func = node_eq_func;
+
+    capacity = ST_DICT_OA_GROUP;
+    while (OA_MAX_LOAD(capacity) < node_num) {
+        if (capacity >= (((st_dict_id_t)1) << 31)) {
+            ST_WARNING("Too many nodes[%u].", node_num);
+            goto ERR;
+        }
+        capacity <<= 1;
+    }
+
+    if (oa_alloc_table(wd, capacity) < 0) {
+        ST_WARNING("Failed to oa_alloc_table.");
+        goto ERR;
+    }
+
+    return wd;
+
+ERR:
+    safe_st_dict_oa_destroy(wd);
+    return NULL;
+}
+
+/* returns the slot of node, or ST_DICT_BAD_NODE if not found. */
+static inline st_dict_id_t oa_find(st_dict_oa_t *wd, st_dict_node_t *pnode,
+        void *node_eq_arg)
+{
+    const uint8_t *ctrl;
+    uint64_t h;
+    st_dict_id_t g;
+    st_dict_id_t step;
+    st_dict_id_t slot;
+    unsigned int mask;
+    uint8_t tag;
+
+    h = st_dict_fmix64(pnode->sign1, pnode->sign2);
+    tag = (uint8_t)(h & 0x7F);
+    g = (st_dict_id_t)(h >> 7) & wd->group_mask;
+    step = 0;
+
+    while (true) {
+        ctrl = wd->ctrl + (size_t)g * ST_DICT_OA_GROUP;
+        mask = st_dict_group_match(ctrl, tag);
+        while (mask != 0) {
+            slot = g * ST_DICT_OA_GROUP + __builtin_ctz(mask);
+            if (oa_node_eq(wd, wd->slots + slot, pnode, node_eq_arg)) {
+                return slot;
+            }
+            mask &= mask - 1;
+        }
+
+        if (st_dict_group_match_empty(ctrl) != 0) {
+            return ST_DICT_BAD_NODE;
+        }
+
+        /* triangular probing visits every group once. */
+        step++;
+        if (step > wd->group_mask) {
+            return ST_DICT_BAD_NODE;
+        }
+        g = (g + step) & wd->group_mask;
+    }
+}
+
+/* put node into the first empty slot of its probe sequence. */
+static void oa_insert(st_dict_oa_t *wd, st_dict_node_t *pnode)
+{
+    st_dict_node_t *node;
+    uint64_t h;
+    st_dict_id_t g;
+    st_dict_id_t step;
+    st_dict_id_t slot;
+    unsigned int mask;
+
+    h = st_dict_fmix64(pnode->sign1, pnode->sign2);
+    g = (st_dict_id_t)(h >> 7) & wd->group_mask;
+    step = 0;
+
+    while ((mask = st_dict_group_match_empty(wd->ctrl
+                    + (size_t)g * ST_DICT_OA_GROUP)) == 0) {
+        step++;
+        g = (g + step) & wd->group_mask;
+    }
+
+    slot = g * ST_DICT_OA_GROUP + __builtin_ctz(mask);
+    wd->ctrl[slot] = (uint8_t)(h & 0x7F);
+    node = wd->slots + slot;
+    node->sign1 = pnode->sign1;
+    node->sign2 = pnode->sign2;
+    node->uint1 = pnode->uint1;
+    node->next = ST_DICT_BAD_NODE;
+
+    wd->node_num++;
+}
+
+static int oa_grow(st_dict_oa_t *wd)
+{
+    uint8_t *old_ctrl;
+    st_dict_node_t *old_slots;
+    st_dict_id_t old_capacity;
+    st_dict_id_t i;
+
+    if (wd->capacity >= (((st_dict_id_t)1) << 31)) {
+        ST_WARNING("st_dict_oa overflow[%u].", wd->capacity);
+        return -1;
+    }
+
+    old_ctrl = wd->ctrl;
+    old_slots = wd->slots;
+    old_capacity = wd->capacity;
+
+    if (oa_alloc_table(wd, old_capacity * 2) < 0) {
+        ST_WARNING("Failed to oa_alloc_table.");
+        wd->ctrl = old_ctrl;
+        wd->slots = old_slots;
+        return -1;
+    }
+
+    wd->node_num = 0;
+    for (i = 0; i < old_capacity; i++) {
+        if (old_ctrl[i] != ST_DICT_OA_EMPTY) {
+            oa_insert(wd, old_slots + i);
+        }
+    }
+
+    safe_st_aligned_free(old_ctrl);
+    safe_free(old_slots);
+
+    return 0;
+}
+
+int st_dict_oa_add_no_seek(st_dict_oa_t *wd, st_dict_node_t *pnode)
+{
+    ST_CHECK_PARAM(wd == NULL || pnode == NULL
+            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+
+    if (wd->node_num >= wd->max_node_num) {
+        if (oa_grow(wd) < 0) {
+            ST_WARNING("Failed to oa_grow.");
+            return -1;
+        }
+    }
+
+    oa_insert(wd, pnode);
+
+    return 0;
+}
+
+int st_dict_oa_add(st_dict_oa_t *wd, st_dict_node_t *pnode, void *node_eq_arg)
+{
+    ST_CHECK_PARAM(wd == NULL || pnode == NULL
+            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+
+    if (oa_find(wd, pnode, node_eq_arg) != ST_DICT_BAD_NODE) {
+        ST_WARNING("node already exists");
+        return -1;
+    }
+
+    return st_dict_oa_add_no_seek(wd, pnode);
+}
+
+int st_dict_oa_seek(st_dict_oa_t *wd, st_dict_node_t *pnode,
+        void *node_eq_arg)
+{
+    st_dict_id_t slot;
+
+    ST_CHECK_PARAM(wd == NULL || pnode == NULL
+            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+
+    slot = oa_find(wd, pnode, node_eq_arg);
+    if (slot == ST_DICT_BAD_NODE) {
+        return -1;
+    }
+
+    pnode->uint1 = wd->slots[slot].uint1;
+
+    return 0;
+}
+
+int st_dict_oa_update(st_dict_oa_t *wd, st_dict_node_t *pnode,
+        void *node_eq_arg, st_dict_update_func_t update_data)
+{
+    st_dict_id_t slot;
+
+    ST_CHECK_PARAM(wd == NULL || pnode == NULL || update_data == NULL
+            || (pnode->sign1 == 0 && pnode->sign2 == 0), -1);
+
+    slot = oa_find(wd, pnode, node_eq_arg);
+    if (slot != ST_DICT_BAD_NODE) {
+        if (update_data(wd->slots + slot, pnode->float1) < 0) {
+            ST_WARNING("Failed to update_data.");
+            return -1;
+        }
+        return 0;
+    }
+
+    return st_dict_oa_add_no_seek(wd, pnode);
+}
+
+int st_dict_oa_traverse(st_dict_oa_t *wd, st_dict_trav_func_t trav,
+        void *args)
+{
+    st_dict_id_t i;
+
+    ST_CHECK_PARAM(wd == NULL, -1);
+
+    if (trav == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < wd->capacity; i++) {
+        if (wd->ctrl[i] == ST_DICT_OA_EMPTY) {
+            continue;
+        }
+
+        if (trav(wd->slots + i, args) < 0) {
+            ST_WARNING("Failed to trav.");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int st_dict_oa_clear(st_dict_oa_t *wd, st_dict_trav_func_t trav, void *args)
+{
+    ST_CHECK_PARAM(wd == NULL, -1);
+
+    if (st_dict_oa_traverse(wd, trav, args) < 0) {
+        ST_WARNING("Failed to st_dict_oa_traverse.");
+        return -1;
+    }
+
+    memset(wd->ctrl, ST_DICT_OA_EMPTY, wd->capacity);
+    wd->node_num = 0;
+
+    return 0;
+}
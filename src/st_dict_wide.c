@@ -0,0 +1,504 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <assert.h>
+
+#include <stutils/st_macro.h>
+#include "st_log.h"
+#include "st_mem.h"
+#include "st_dict_wide.h"
+#include "st_dict_inl.h"
+
+#define WIDE_MAGIC   0x57464453
+#define WIDE_VERSION 1
+
+/* grow when more than 7/8 of the slots are used. */
+#define WIDE_MAX_LOAD(cap) ((cap) - (cap) / 8)
+
+/* keys and values are saved in chunks of this size. */
+#define WIDE_IO_NODES 4096
+
+typedef struct _wide_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t value_size;
+    uint32_t reserved;
+    uint64_t node_num;
+} wide_header_t;
+
+static inline void* wide_value(st_dict_wide_t *wd, st_dict_id_t slot)
+{
+    return wd->values + (size_t)slot * wd->value_size;
+}
+
+void st_dict_wide_destroy(st_dict_wide_t *wd)
+{
+    if (wd == NULL) {
+        return;
+    }
+
+    safe_st_aligned_free(wd->ctrl);
+    safe_free(wd->keys);
+    safe_st_aligned_free(wd->values);
+    wd->capacity = 0;
+    wd->node_num = 0;
+}
+
+static int wide_alloc_table(st_dict_wide_t *wd, st_dict_id_t capacity)
+{
+    wd->ctrl = (uint8_t *)st_aligned_malloc(capacity, ST_DICT_OA_GROUP);
+    if (wd->ctrl == NULL) {
+        ST_WARNING("Failed to st_aligned_malloc ctrl.");
+        goto ERR;
+    }
+    memset(wd->ctrl, ST_DICT_OA_EMPTY, capacity);
+
+    wd->keys = (st_dict_wide_key_t *)malloc(sizeof(st_dict_wide_key_t)
+            * capacity);
+    if (wd->keys == NULL) {
+        ST_WARNING("Failed to alloc mem for keys.");
+        goto ERR;
+    }
+
+    wd->values = (char *)st_aligned_malloc(wd->value_size * capacity,
+            ST_DICT_WIDE_ALIGN);
+    if (wd->values == NULL) {
+        ST_WARNING("Failed to st_aligned_malloc values.");
+        goto ERR;
+    }
+
+    wd->capacity = capacity;
+    wd->group_mask = capacity / ST_DICT_OA_GROUP - 1;
+    wd->max_node_num = WIDE_MAX_LOAD(capacity);
+
+    return 0;
+
+ERR:
+    safe_st_aligned_free(wd->ctrl);
+    safe_free(wd->keys);
+    safe_st_aligned_free(wd->values);
+    return -1;
+}
+
+st_dict_wide_t* st_dict_wide_create(st_dict_id_t node_num,
+        size_t value_size)
+{
+    st_dict_wide_t *wd = NULL;
+    st_dict_id_t capacity;
+
+    ST_CHECK_PARAM(node_num == ST_DICT_BAD_NODE || value_size == 0
+            || value_size > UINT32_MAX, NULL);
+
+    wd = (st_dict_wide_t *)malloc(sizeof(st_dict_wide_t));
+    if (wd == NULL) {
+        ST_WARNING("Failed to alloc mem for st_dict_wide.");
+        return NULL;
+    }
+    memset(wd, 0, sizeof(st_dict_wide_t));
+    wd->value_size = value_size;
+
+    capacity = ST_DICT_OA_GROUP;
+    while (WIDE_MAX_LOAD(capacity) < node_num) {
+        if (capacity >= (((st_dict_id_t)1) << 31)) {
+            ST_WARNING("Too many nodes[%lu].", (unsigned long)node_num);
+            goto ERR;
+        }
+        capacity <<= 1;
+    }
+
+    if (wide_alloc_table(wd, capacity) < 0) {
+        ST_WARNING("Failed to wide_alloc_table.");
+        goto ERR;
+    }
+
+    return wd;
+
+ERR:
+    safe_st_dict_wide_destroy(wd);
+    return NULL;
+}
+
+/* returns the slot of key, or ST_DICT_BAD_NODE if not found. */
+static inline st_dict_id_t wide_find(st_dict_wide_t *wd,
+        st_dict_wide_key_t *key)
+{
+    const uint8_t *ctrl;
+    uint64_t h;
+    st_dict_id_t g;
+    st_dict_id_t step;
+    st_dict_id_t slot;
+    unsigned int mask;
+    uint8_t tag;
+
+    h = st_dict_fmix64(key->sign1, key->sign2);
+    tag = (uint8_t)(h & 0x7F);
+    g = (st_dict_id_t)(h >> 7) & wd->group_mask;
+    step = 0;
+
+    while (true) {
+        ctrl = wd->ctrl + (size_t)g * ST_DICT_OA_GROUP;
+        mask = st_dict_group_match(ctrl, tag);
+        while (mask != 0) {
+            slot = g * ST_DICT_OA_GROUP + __builtin_ctz(mask);
+            if (wd->keys[slot].sign1 == key->sign1
+                    && wd->keys[slot].sign2 == key->sign2) {
+                return slot;
+            }
+            mask &= mask - 1;
+        }
+
+        if (st_dict_group_match_empty(ctrl) != 0) {
+            return ST_DICT_BAD_NODE;
+        }
+
+        /* triangular probing visits every group once. */
+        step++;
+        if (step > wd->group_mask) {
+            return ST_DICT_BAD_NODE;
+        }
+        g = (g + step) & wd->group_mask;
+    }
+}
+
+/* put key into the first empty slot of its probe sequence. */
+static st_dict_id_t wide_insert(st_dict_wide_t *wd,
+        st_dict_wide_key_t *key, const void *value)
+{
+    uint64_t h;
+    st_dict_id_t g;
+    st_dict_id_t step;
+    st_dict_id_t slot;
+    unsigned int mask;
+
+    h = st_dict_fmix64(key->sign1, key->sign2);
+    g = (st_dict_id_t)(h >> 7) & wd->group_mask;
+    step = 0;
+
+    while ((mask = st_dict_group_match_empty(wd->ctrl
+                    + (size_t)g * ST_DICT_OA_GROUP)) == 0) {
+        step++;
+        g = (g + step) & wd->group_mask;
+    }
+
+    slot = g * ST_DICT_OA_GROUP + __builtin_ctz(mask);
+    wd->ctrl[slot] = (uint8_t)(h & 0x7F);
+    wd->keys[slot] = *key;
+    memcpy(wide_value(wd, slot), value, wd->value_size);
+
+    wd->node_num++;
+
+    return slot;
+}
+
+static int wide_grow(st_dict_wide_t *wd)
+{
+    uint8_t *old_ctrl;
+    st_dict_wide_key_t *old_keys;
+    char *old_values;
+    st_dict_id_t old_capacity;
+    st_dict_id_t i;
+
+    if (wd->capacity >= (((st_dict_id_t)1) << 31)) {
+        ST_WARNING("st_dict_wide overflow[%lu].",
+                (unsigned long)wd->capacity);
+        return -1;
+    }
+
+    old_ctrl = wd->ctrl;
+    old_keys = wd->keys;
+    old_values = wd->values;
+    old_capacity = wd->capacity;
+
+    if (wide_alloc_table(wd, old_capacity * 2) < 0) {
+        ST_WARNING("Failed to wide_alloc_table.");
+        wd->ctrl = old_ctrl;
+        wd->keys = old_keys;
+        wd->values = old_values;
+        return -1;
+    }
+
+    wd->node_num = 0;
+    for (i = 0; i < old_capacity; i++) {
+        if (old_ctrl[i] != ST_DICT_OA_EMPTY) {
+            (void)wide_insert(wd, old_keys + i,
+                    old_values + (size_t)i * wd->value_size);
+        }
+    }
+
+    safe_st_aligned_free(old_ctrl);
+    safe_free(old_keys);
+    safe_st_aligned_free(old_values);
+
+    return 0;
+}
+
+static int wide_add_no_seek(st_dict_wide_t *wd, st_dict_wide_key_t *key,
+        const void *value)
+{
+    if (wd->node_num >= wd->max_node_num) {
+        if (wide_grow(wd) < 0) {
+            ST_WARNING("Failed to wide_grow.");
+            return -1;
+        }
+    }
+
+    (void)wide_insert(wd, key, value);
+
+    return 0;
+}
+
+int st_dict_wide_add(st_dict_wide_t *wd, st_dict_wide_key_t *key,
+        const void *value)
+{
+    ST_CHECK_PARAM(wd == NULL || key == NULL || value == NULL
+            || (key->sign1 == 0 && key->sign2 == 0), -1);
+
+    if (wide_find(wd, key) != ST_DICT_BAD_NODE) {
+        ST_WARNING("node already exists");
+        return -1;
+    }
+
+    return wide_add_no_seek(wd, key, value);
+}
+
+void* st_dict_wide_seek(st_dict_wide_t *wd, st_dict_wide_key_t *key)
+{
+    st_dict_id_t slot;
+
+    ST_CHECK_PARAM(wd == NULL || key == NULL
+            || (key->sign1 == 0 && key->sign2 == 0), NULL);
+
+    slot = wide_find(wd, key);
+    if (slot == ST_DICT_BAD_NODE) {
+        return NULL;
+    }
+
+    return wide_value(wd, slot);
+}
+
+int st_dict_wide_update(st_dict_wide_t *wd, st_dict_wide_key_t *key,
+        const void *data, st_dict_wide_update_func_t update_data)
+{
+    st_dict_id_t slot;
+
+    ST_CHECK_PARAM(wd == NULL || key == NULL || data == NULL
+            || update_data == NULL
+            || (key->sign1 == 0 && key->sign2 == 0), -1);
+
+    slot = wide_find(wd, key);
+    if (slot != ST_DICT_BAD_NODE) {
+        if (update_data(wide_value(wd, slot), data) < 0) {
+            ST_WARNING("Failed to update_data.");
+            return -1;
+        }
+        return 0;
+    }
+
+    return wide_add_no_seek(wd, key, data);
+}
+
+int st_dict_wide_traverse(st_dict_wide_t *wd, st_dict_wide_trav_func_t trav,
+        void *args)
+{
+    st_dict_id_t i;
+
+    ST_CHECK_PARAM(wd == NULL, -1);
+
+    if (trav == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < wd->capacity; i++) {
+        if (wd->ctrl[i] == ST_DICT_OA_EMPTY) {
+            continue;
+        }
+
+        if (trav(wd->keys + i, wide_value(wd, i), args) < 0) {
+            ST_WARNING("Failed to trav.");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int st_dict_wide_clear(st_dict_wide_t *wd)
+{
+    ST_CHECK_PARAM(wd == NULL, -1);
+
+    memset(wd->ctrl, ST_DICT_OA_EMPTY, wd->capacity);
+    wd->node_num = 0;
+
+    return 0;
+}
+
+/*
+ * Binary layout:
+ *
+ *   wide_header_t
+ *   keys[node_num]
+ *   values[node_num]
+ *
+ * Keys and values are written in chunks of WIDE_IO_NODES, all keys of a
+ * chunk before its values, in slot order.
+ */
+int st_dict_wide_save(st_dict_wide_t *wd, FILE *fp)
+{
+    wide_header_t header;
+    st_dict_wide_key_t *keys = NULL;
+    char *values = NULL;
+    st_dict_id_t i;
+    st_dict_id_t n;
+
+    ST_CHECK_PARAM(wd == NULL || fp == NULL, -1);
+
+    memset(&header, 0, sizeof(header));
+    header.magic = WIDE_MAGIC;
+    header.version = WIDE_VERSION;
+    header.value_size = (uint32_t)wd->value_size;
+    header.node_num = wd->node_num;
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        ST_WARNING("Failed to write header.");
+        return -1;
+    }
+
+    keys = (st_dict_wide_key_t *)malloc(sizeof(st_dict_wide_key_t)
+            * WIDE_IO_NODES);
+    values = (char *)malloc(wd->value_size * WIDE_IO_NODES);
+    if (keys == NULL || values == NULL) {
+        ST_WARNING("Failed to alloc mem for chunk.");
+        goto ERR;
+    }
+
+    n = 0;
+    for (i = 0; i <= wd->capacity; i++) {
+        if (n == WIDE_IO_NODES || (i == wd->capacity && n > 0)) {
+            if (fwrite(keys, sizeof(st_dict_wide_key_t), n, fp) != n
+                    || fwrite(values, wd->value_size, n, fp) != n) {
+                ST_WARNING("Failed to write chunk.");
+                goto ERR;
+            }
+            n = 0;
+        }
+        if (i == wd->capacity || wd->ctrl[i] == ST_DICT_OA_EMPTY) {
+            continue;
+        }
+        keys[n] = wd->keys[i];
+        memcpy(values + (size_t)n * wd->value_size, wide_value(wd, i),
+                wd->value_size);
+        n++;
+    }
+
+    safe_free(keys);
+    safe_free(values);
+    fflush(fp);
+
+    return 0;
+
+ERR:
+    safe_free(keys);
+    safe_free(values);
+    return -1;
+}
+
+st_dict_wide_t* st_dict_wide_load_from_bin(FILE *fp)
+{
+    st_dict_wide_t *wd = NULL;
+    wide_header_t header;
+    st_dict_wide_key_t *keys = NULL;
+    char *values = NULL;
+    uint64_t i;
+    st_dict_id_t j;
+    st_dict_id_t n;
+
+    ST_CHECK_PARAM(fp == NULL, NULL);
+
+    if (fread(&header, sizeof(header), 1, fp) != 1) {
+        ST_WARNING("Failed to read header.");
+        return NULL;
+    }
+
+    if (header.magic != WIDE_MAGIC) {
+        ST_WARNING("Magic num not match.");
+        return NULL;
+    }
+
+    if (header.version > WIDE_VERSION) {
+        ST_WARNING("Too high version[%u/%u].", header.version,
+                WIDE_VERSION);
+        return NULL;
+    }
+
+    if (header.value_size == 0 || header.node_num >= ST_DICT_BAD_NODE) {
+        ST_WARNING("Corrupted header.");
+        return NULL;
+    }
+
+    wd = st_dict_wide_create((st_dict_id_t)header.node_num,
+            header.value_size);
+    if (wd == NULL) {
+        ST_WARNING("Failed to st_dict_wide_create.");
+        return NULL;
+    }
+
+    keys = (st_dict_wide_key_t *)malloc(sizeof(st_dict_wide_key_t)
+            * WIDE_IO_NODES);
+    values = (char *)malloc(wd->value_size * WIDE_IO_NODES);
+    if (keys == NULL || values == NULL) {
+        ST_WARNING("Failed to alloc mem for chunk.");
+        goto ERR;
+    }
+
+    for (i = 0; i < header.node_num; i += n) {
+        n = (st_dict_id_t)min(header.node_num - i, WIDE_IO_NODES);
+        if (fread(keys, sizeof(st_dict_wide_key_t), n, fp) != n
+                || fread(values, wd->value_size, n, fp) != n) {
+            ST_WARNING("Failed to read chunk.");
+            goto ERR;
+        }
+        for (j = 0; j < n; j++) {
+            if (keys[j].sign1 == 0 && keys[j].sign2 == 0) {
+                ST_WARNING("Corrupted key.");
+                goto ERR;
+            }
+            /* sized by create, no grow. */
+            (void)wide_insert(wd, keys + j,
+                    values + (size_t)j * wd->value_size);
+        }
+    }
+
+    safe_free(keys);
+    safe_free(values);
+
+    return wd;
+
+ERR:
+    safe_free(keys);
+    safe_free(values);
+    safe_st_dict_wide_destroy(wd);
+    return NULL;
+}
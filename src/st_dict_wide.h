@@ -0,0 +1,142 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _ST_DICT_WIDE_H_
+#define _ST_DICT_WIDE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <stutils/st_macro.h>
+#include "st_dict.h"
+#include "st_dict_oa.h"
+
+/*
+ * Dict with values of any width, fixed at creation.
+ *
+ * Probing is the same as st_dict_oa, but the table is split into three
+ * arrays indexed by slot: control bytes, keys (sign1, sign2) and values.
+ * A probe only reads control bytes and keys, the value of a slot is
+ * touched once on a hit. The value array is aligned to
+ * ST_DICT_WIDE_ALIGN, so values never straddle cache lines when
+ * value_size is a power of two not above it.
+ */
+
+#define ST_DICT_WIDE_ALIGN 64
+
+typedef struct _st_dict_wide_key_t
+{
+    st_dict_sign_t sign1;
+    st_dict_sign_t sign2;
+} st_dict_wide_key_t;
+
+typedef struct _st_dict_wide_t
+{
+    uint8_t            *ctrl;
+    st_dict_wide_key_t *keys;
+    char               *values;
+    size_t             value_size;
+
+    st_dict_id_t       capacity;
+    st_dict_id_t       group_mask;
+
+    st_dict_id_t       node_num;
+    st_dict_id_t       max_node_num;
+} st_dict_wide_t;
+
+/* update the value in dict with data, see st_dict_wide_update. */
+typedef int (*st_dict_wide_update_func_t)(void *value, const void *data);
+typedef int (*st_dict_wide_trav_func_t)(st_dict_wide_key_t *key,
+        void *value, void *args);
+
+/*
+ * Create a wide dict.
+ *
+ * @param[in] node_num expected number of nodes, the table grows when
+ *                     it is exceeded.
+ * @param[in] value_size bytes of every value.
+ * @return the dict, NULL if any error.
+ */
+st_dict_wide_t* st_dict_wide_create(st_dict_id_t node_num,
+        size_t value_size);
+
+#define safe_st_dict_wide_destroy(ptr) do {\
+    if((ptr) != NULL) {\
+        st_dict_wide_destroy(ptr);\
+        safe_free(ptr);\
+        (ptr) = NULL;\
+    }\
+    } while(0)
+void st_dict_wide_destroy(st_dict_wide_t *wd);
+
+/*
+ * Add a key, which must not be in the dict.
+ *
+ * @param[in] wd the dict.
+ * @param[in] key the key, sign1 == sign2 == 0 is reserved.
+ * @param[in] value value_size bytes copied into the dict.
+ * @return non-zero value if any error.
+ */
+int st_dict_wide_add(st_dict_wide_t *wd, st_dict_wide_key_t *key,
+        const void *value);
+
+/*
+ * Find the value of a key.
+ *
+ * @param[in] wd the dict.
+ * @param[in] key the key.
+ * @return the value inside the dict, valid until the next add or update;
+ *         NULL if not found.
+ */
+void* st_dict_wide_seek(st_dict_wide_t *wd, st_dict_wide_key_t *key);
+
+/*
+ * Call update_data on the value of key, or add key with value data if
+ * it is not in the dict.
+ *
+ * @param[in] wd the dict.
+ * @param[in] key the key.
+ * @param[in] data value_size bytes.
+ * @param[in] update_data the update function.
+ * @return non-zero value if any error.
+ */
+int st_dict_wide_update(st_dict_wide_t *wd, st_dict_wide_key_t *key,
+        const void *data, st_dict_wide_update_func_t update_data);
+
+int st_dict_wide_traverse(st_dict_wide_t *wd, st_dict_wide_trav_func_t trav,
+        void *args);
+int st_dict_wide_clear(st_dict_wide_t *wd);
+
+int st_dict_wide_save(st_dict_wide_t *wd, FILE *fp);
+st_dict_wide_t* st_dict_wide_load_from_bin(FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -140,6 +140,54 @@ uint32_t MurmurHash2 ( const void * key, int len, uint32_t seed )
   return h;
 }
 
+//-----------------------------------------------------------------------------
+// MurmurHash64A, 64-bit hash for 64-bit platforms, from the same source.
+// Same assumptions as MurmurHash2, reading 8-byte values instead.
+
+uint64_t MurmurHash64A ( const void * key, int len, uint64_t seed )
+{
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+
+  uint64_t h = seed ^ (len * m);
+
+  const unsigned char * data = (const unsigned char *)key;
+  const unsigned char * end = data + (len / 8) * 8;
+
+  while(data != end)
+  {
+    uint64_t k;
+
+    memcpy(&k, data, sizeof(k));
+    data += 8;
+
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+
+    h ^= k;
+    h *= m;
+  }
+
+  switch(len & 7)
+  {
+  case 7: h ^= (uint64_t)data[6] << 48;
+  case 6: h ^= (uint64_t)data[5] << 40;
+  case 5: h ^= (uint64_t)data[4] << 32;
+  case 4: h ^= (uint64_t)data[3] << 24;
+  case 3: h ^= (uint64_t)data[2] << 16;
+  case 2: h ^= (uint64_t)data[1] << 8;
+  case 1: h ^= (uint64_t)data[0];
+      h *= m;
+  };
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+
+  return h;
+}
+
 /* qsort.c from GNU Libc. http://code.metager.de/source/xref/gnu/glibc/stdlib/qsort.c */
 /* Copyright (C) 1991-2015 Free Software Foundation, Inc.
    This file is part of the GNU C Library.
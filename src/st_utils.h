@@ -43,6 +43,7 @@ void split_long(long l, unsigned int *a, unsigned int *b);
 unsigned int highest_bit_mask(unsigned int num, int overflow);
 
 uint32_t MurmurHash2 ( const void * key, int len, uint32_t seed );
+uint64_t MurmurHash64A ( const void * key, int len, uint64_t seed );
 
 int st_permutation(void *base, size_t n, size_t sz,
         int (*callback)(void *base, size_t n, void *args), void *args);
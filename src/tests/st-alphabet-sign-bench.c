@@ -0,0 +1,382 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "st_utils.h"
+#include "st_dict.h"
+
+/*
+ * Compares the signatures of st_alphabet labels: two MurmurHash2 calls,
+ * one per half, with strcmp on a sign match, against one MurmurHash64A
+ * pass with a length compare, which needs no memcmp for labels of at
+ * most 8 bytes. Both index the vocabulary in a st_dict, as st_alphabet
+ * does, and then look up every token of the text a few times.
+ *
+ * The text is read from vocab_file, split on white space; without it,
+ * tokens of 1 to 20 letters are generated, drawn Zipf-like from a
+ * vocabulary of 200k.
+ *
+ * Usage: st-alphabet-sign-bench [vocab_file]
+ */
+
+#define INLINE_LEN 8
+#define SIGN_SEED  0x5f3759df
+#define GEN_VOCAB  200000
+#define GEN_TOKENS 4000000
+#define PASSES     3
+
+typedef struct _label_t {
+    size_t offset;
+    size_t len;
+} label_t;
+
+typedef struct _text_t {
+    char *buf; /* NUL-terminated tokens. */
+    size_t buf_len;
+    size_t buf_cap;
+    label_t *tokens;
+    size_t num;
+    size_t cap;
+} text_t;
+
+typedef struct _eq_args_t {
+    text_t *vocab;
+    const char *label;
+    size_t len;
+} eq_args_t;
+
+typedef void (*sign_func_t)(const char *psrc, size_t slen,
+        st_dict_sign_t *sign1, st_dict_sign_t *sign2);
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sign_two_pass(const char *psrc, size_t slen,
+        st_dict_sign_t *sign1, st_dict_sign_t *sign2)
+{
+    *sign1 = 0;
+    *sign2 = 0;
+    if (slen <= 4) {
+        memcpy(sign1, psrc, slen);
+    } else if (slen <= 8) {
+        memcpy(sign1, psrc, 4);
+        memcpy(sign2, psrc + 4, slen - 4);
+    } else {
+        *sign1 = MurmurHash2(psrc, slen / 2, 1);
+        *sign2 = MurmurHash2(psrc + slen / 2, slen - slen / 2, 2);
+    }
+}
+
+static void sign_one_pass(const char *psrc, size_t slen,
+        st_dict_sign_t *sign1, st_dict_sign_t *sign2)
+{
+    uint64_t key = 0;
+
+    if (slen <= INLINE_LEN) {
+        memcpy(&key, psrc, slen);
+    } else {
+        key = MurmurHash64A(psrc, (int)slen, SIGN_SEED);
+    }
+
+    *sign1 = (st_dict_sign_t)(key & 0xFFFFFFFF);
+    *sign2 = (st_dict_sign_t)(key >> 32);
+}
+
+static bool eq_strcmp(st_dict_node_t *node1, st_dict_node_t *node2,
+        void *args)
+{
+    eq_args_t *arg = (eq_args_t *)args;
+
+    if (node1->sign1 != node2->sign1 || node1->sign2 != node2->sign2) {
+        return false;
+    }
+    if (arg == NULL) {
+        return true;
+    }
+
+    return strcmp(arg->vocab->buf + arg->vocab->tokens[node1->uint1].offset,
+            arg->label) == 0;
+}
+
+static bool eq_len(st_dict_node_t *node1, st_dict_node_t *node2,
+        void *args)
+{
+    eq_args_t *arg = (eq_args_t *)args;
+    label_t *l;
+
+    if (node1->sign1 != node2->sign1 || node1->sign2 != node2->sign2) {
+        return false;
+    }
+    if (arg == NULL) {
+        return true;
+    }
+
+    l = arg->vocab->tokens + node1->uint1;
+    if (l->len != arg->len) {
+        return false;
+    }
+    if (arg->len <= INLINE_LEN) {
+        return true;
+    }
+
+    return memcmp(arg->vocab->buf + l->offset, arg->label, arg->len) == 0;
+}
+
+static int text_add(text_t *text, const char *token, size_t len)
+{
+    void *p;
+
+    if (text->num >= text->cap) {
+        text->cap = text->cap * 2 + 1024;
+        p = realloc(text->tokens, sizeof(label_t) * text->cap);
+        if (p == NULL) {
+            return -1;
+        }
+        text->tokens = (label_t *)p;
+    }
+    if (text->buf_len + len + 1 > text->buf_cap) {
+        text->buf_cap = (text->buf_len + len + 1) * 2;
+        p = realloc(text->buf, text->buf_cap);
+        if (p == NULL) {
+            return -1;
+        }
+        text->buf = (char *)p;
+    }
+
+    memcpy(text->buf + text->buf_len, token, len);
+    text->buf[text->buf_len + len] = '\0';
+    text->tokens[text->num].offset = text->buf_len;
+    text->tokens[text->num].len = len;
+    text->buf_len += len + 1;
+    text->num++;
+
+    return 0;
+}
+
+static void text_destroy(text_t *text)
+{
+    safe_free(text->buf);
+    safe_free(text->tokens);
+    memset(text, 0, sizeof(text_t));
+}
+
+static int read_text(text_t *text, const char *fname)
+{
+    char token[4096];
+    size_t len;
+    FILE *fp;
+    int c;
+
+    fp = fopen(fname, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open[%s].\n", fname);
+        return -1;
+    }
+
+    len = 0;
+    while ((c = fgetc(fp)) != EOF) {
+        if (!isspace(c) && len < sizeof(token)) {
+            token[len++] = (char)c;
+            continue;
+        }
+        if (len > 0 && text_add(text, token, len) < 0) {
+            fclose(fp);
+            return -1;
+        }
+        len = 0;
+    }
+    if (len > 0 && text_add(text, token, len) < 0) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    return 0;
+}
+
+static int gen_text(text_t *text)
+{
+    text_t vocab;
+    char token[32];
+    unsigned int seed = 1;
+    double u;
+    size_t len;
+    size_t i;
+    size_t j;
+
+    memset(&vocab, 0, sizeof(text_t));
+    for (i = 0; i < GEN_VOCAB; i++) {
+        /* short words are the frequent ones, as in text. */
+        len = 1 + (size_t)(i * 19 / GEN_VOCAB) + rand_r(&seed) % 3;
+        for (j = 0; j < len; j++) {
+            token[j] = 'a' + rand_r(&seed) % 26;
+        }
+        if (text_add(&vocab, token, len) < 0) {
+            text_destroy(&vocab);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < GEN_TOKENS; i++) {
+        u = (double)rand_r(&seed) / RAND_MAX;
+        j = (size_t)(GEN_VOCAB * u * u * u);
+        if (j >= GEN_VOCAB) {
+            j = GEN_VOCAB - 1;
+        }
+        if (text_add(text, vocab.buf + vocab.tokens[j].offset,
+                    vocab.tokens[j].len) < 0) {
+            text_destroy(&vocab);
+            return -1;
+        }
+    }
+    text_destroy(&vocab);
+
+    return 0;
+}
+
+/* build the vocabulary of text in dict, then look its tokens up. */
+static int run(const char *name, text_t *text, sign_func_t sign,
+        st_dict_node_eq_fun_t node_eq)
+{
+    st_dict_t *dict = NULL;
+    st_dict_node_t node;
+    text_t vocab;
+    eq_args_t arg;
+    label_t *l;
+    double t_build;
+    double t;
+    size_t found;
+    size_t i;
+    int p;
+
+    memset(&vocab, 0, sizeof(text_t));
+    dict = st_dict_create(text->num / 8 + 1, ST_DICT_REALLOC_NUM,
+            st_dict_hash_murmur, node_eq, false);
+    if (dict == NULL || st_dict_set_rehash(dict, 1.0, 0) < 0) {
+        fprintf(stderr, "Failed to st_dict_create.\n");
+        goto ERR;
+    }
+
+    arg.vocab = &vocab;
+    t = now();
+    for (i = 0; i < text->num; i++) {
+        l = text->tokens + i;
+        arg.label = text->buf + l->offset;
+        arg.len = l->len;
+        sign(arg.label, arg.len, &node.sign1, &node.sign2);
+        if (st_dict_seek(dict, &node, &arg) == 0) {
+            continue;
+        }
+        node.uint1 = (unsigned int)vocab.num;
+        if (text_add(&vocab, arg.label, arg.len) < 0
+                || st_dict_add_no_seek(dict, &node) < 0) {
+            fprintf(stderr, "Failed to add label.\n");
+            goto ERR;
+        }
+    }
+    t_build = now() - t;
+
+    found = 0;
+    t = now();
+    for (p = 0; p < PASSES; p++) {
+        for (i = 0; i < text->num; i++) {
+            l = text->tokens + i;
+            arg.label = text->buf + l->offset;
+            arg.len = l->len;
+            sign(arg.label, arg.len, &node.sign1, &node.sign2);
+            if (st_dict_seek(dict, &node, &arg) == 0) {
+                found++;
+            }
+        }
+    }
+    t = now() - t;
+    if (found != text->num * PASSES) {
+        fprintf(stderr, "Wrong number of found labels[%zu].\n", found);
+        goto ERR;
+    }
+
+    printf("  %-24s %8zu labels  build %6.3fs  %7.1f ns/lookup\n", name,
+            vocab.num, t_build, t * 1e9 / (text->num * PASSES));
+
+    safe_st_dict_destroy(dict);
+    text_destroy(&vocab);
+    return 0;
+
+ERR:
+    safe_st_dict_destroy(dict);
+    text_destroy(&vocab);
+    return -1;
+}
+
+int main(int argc, const char *argv[])
+{
+    text_t text;
+    size_t short_num;
+    size_t i;
+
+    memset(&text, 0, sizeof(text_t));
+    if (argc > 1) {
+        if (read_text(&text, argv[1]) < 0) {
+            goto ERR;
+        }
+    } else if (gen_text(&text) < 0) {
+        fprintf(stderr, "Failed to gen_text.\n");
+        goto ERR;
+    }
+    if (text.num == 0) {
+        fprintf(stderr, "No tokens.\n");
+        goto ERR;
+    }
+
+    short_num = 0;
+    for (i = 0; i < text.num; i++) {
+        short_num += text.tokens[i].len <= INLINE_LEN;
+    }
+    printf("%zu tokens from %s, %.1f%% of at most %d bytes\n", text.num,
+            argc > 1 ? argv[1] : "generated text",
+            100.0 * short_num / text.num, INLINE_LEN);
+
+    if (run("MurmurHash2 x2 + strcmp", &text, sign_two_pass,
+                eq_strcmp) < 0
+            || run("MurmurHash64A + len", &text, sign_one_pass,
+                eq_len) < 0) {
+        goto ERR;
+    }
+
+    text_destroy(&text);
+    return 0;
+
+ERR:
+    text_destroy(&text);
+    return -1;
+}
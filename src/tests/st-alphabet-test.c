@@ -0,0 +1,1383 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "st_utils.h"
+#include "st_string.h"
+#include "st_alphabet.h"
+
+#define NUM_LABELS 1000
+#define LONG_LABEL_LEN 1000
+
+static void gen_label(char *buf, int i)
+{
+    sprintf(buf, "w%d", i);
+}
+
+static int check_labels(st_alphabet_t *alphabet, const char *long_label)
+{
+    char buf[32];
+    char *label;
+    int i;
+
+    if (st_alphabet_get_label_num(alphabet) != NUM_LABELS + 1) {
+        return -1;
+    }
+
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        if (st_alphabet_get_index(alphabet, buf) != i) {
+            return -1;
+        }
+        label = st_alphabet_get_label(alphabet, i);
+        if (label == NULL || strcmp(label, buf) != 0) {
+            return -1;
+        }
+    }
+
+    if (st_alphabet_get_index(alphabet, long_label) != NUM_LABELS) {
+        return -1;
+    }
+    label = st_alphabet_get_label(alphabet, NUM_LABELS);
+    if (label == NULL || strcmp(label, long_label) != 0) {
+        return -1;
+    }
+
+    if (st_alphabet_get_index(alphabet, "not-exist") >= 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int unit_test_st_alphabet()
+{
+    st_alphabet_t *alphabet = NULL;
+    st_alphabet_t *alphabet2 = NULL;
+    st_alphabet_t *alphabet3 = NULL;
+    st_arena_t *arena = NULL;
+    FILE *fp = NULL;
+    char long_label[LONG_LABEL_LEN + 1];
+    char buf[32];
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_alphabet...\n");
+
+    memset(long_label, 'a', LONG_LABEL_LEN);
+    long_label[LONG_LABEL_LEN] = '\0';
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    alphabet = st_alphabet_create(0);
+    if (alphabet == NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        if (st_alphabet_add_label(alphabet, buf) != i) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (st_alphabet_add_label(alphabet, long_label) != NUM_LABELS) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    if (st_alphabet_add_label(alphabet, "w0") != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    if (check_labels(alphabet, long_label) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = tmpfile();
+    assert(fp != NULL);
+    if (st_alphabet_save_bin(alphabet, fp) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    rewind(fp);
+    alphabet2 = st_alphabet_load_from_bin(fp);
+    if (alphabet2 == NULL || check_labels(alphabet2, long_label) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_fclose(fp);
+    safe_st_alphabet_destroy(alphabet2);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = tmpfile();
+    assert(fp != NULL);
+    if (st_alphabet_save_txt(alphabet, fp) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    rewind(fp);
+    alphabet2 = st_alphabet_load_from_txt(fp);
+    if (alphabet2 == NULL || check_labels(alphabet2, long_label) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_fclose(fp);
+    safe_st_alphabet_destroy(alphabet2);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    alphabet2 = st_alphabet_create(NUM_LABELS);
+    if (alphabet2 == NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* labels around the inline length, sharing prefixes. */
+    for (i = 1; i <= 17; i++) {
+        if (st_alphabet_add_label(alphabet2, long_label + LONG_LABEL_LEN - i)
+                != i - 1) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    for (i = 1; i <= 17; i++) {
+        if (st_alphabet_get_index(alphabet2, long_label + LONG_LABEL_LEN - i)
+                != i - 1) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    safe_st_alphabet_destroy(alphabet2);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = tmpfile();
+    assert(fp != NULL);
+    alphabet2 = st_alphabet_create(1);
+    if (alphabet2 == NULL || st_alphabet_add_label(alphabet2, "w0") != 0
+            || st_alphabet_save_bin(alphabet2, fp) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_alphabet_destroy(alphabet2);
+    rewind(fp);
+    alphabet2 = st_alphabet_load_from_bin(fp);
+    if (alphabet2 == NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_fclose(fp);
+    /* a loaded alphabet keeps growing. */
+    for (i = 1; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        if (st_alphabet_add_label(alphabet2, buf) != i) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (st_alphabet_add_label(alphabet2, long_label) != NUM_LABELS
+            || check_labels(alphabet2, long_label) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_alphabet_destroy(alphabet2);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    alphabet2 = st_alphabet_dup(alphabet);
+    if (alphabet2 == NULL || check_labels(alphabet2, long_label) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_alphabet_destroy(alphabet2);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    arena = st_arena_create(4096, 0);
+    assert(arena != NULL);
+    alphabet2 = st_alphabet_create_in(1, arena);
+    if (alphabet2 == NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        if (st_alphabet_add_label(alphabet2, buf) != i) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (st_alphabet_add_label(alphabet2, long_label) != NUM_LABELS
+            || check_labels(alphabet2, long_label) != 0
+            || st_arena_used(arena) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* the shared base stays in mem_arena. */
+    alphabet3 = st_alphabet_dup(alphabet2);
+    if (alphabet3 == NULL || check_labels(alphabet3, long_label) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_alphabet_destroy(alphabet2);
+    safe_st_alphabet_destroy(alphabet3);
+    safe_st_arena_destroy(arena);
+    fprintf(stderr, "Passed\n");
+
+    safe_st_alphabet_destroy(alphabet);
+    return 0;
+
+FAILED:
+    safe_fclose(fp);
+    safe_st_alphabet_destroy(alphabet2);
+    safe_st_alphabet_destroy(alphabet3);
+    safe_st_alphabet_destroy(alphabet);
+    safe_st_arena_destroy(arena);
+    return -1;
+}
+
+static int check_same(st_alphabet_t *a, st_alphabet_t *b)
+{
+    char *label;
+    int i;
+
+    if (a->label_num != b->label_num || a->aux_num != b->aux_num
+            || a->label_buf_len != b->label_buf_len) {
+        return -1;
+    }
+    if (memcmp(a->labels, b->labels, sizeof(st_label_t) * a->label_num) != 0
+            || memcmp(a->label_buf, b->label_buf, a->label_buf_len) != 0
+            || memcmp(a->is_aux, b->is_aux, sizeof(bool) * a->label_num) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < a->label_num; i++) {
+        label = st_alphabet_get_label(a, i);
+        if (st_alphabet_get_index(a, label) != st_alphabet_get_index(b, label)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* load fname with both txt loaders and compare. */
+/* a loaded index is within its load factor and left alone by seeks. */
+static int check_index_loaded(st_alphabet_t *alphabet)
+{
+    st_dict_id_t hash_num;
+    int i;
+
+    hash_num = alphabet->index_dict->hash_num;
+    if (alphabet->index_dict->old_first_level_node != NULL
+            || alphabet->index_dict->node_num > hash_num) {
+        return -1;
+    }
+    for (i = 0; i < alphabet->label_num; i++) {
+        (void)st_alphabet_get_index(alphabet,
+                st_alphabet_get_label(alphabet, i));
+    }
+    if (alphabet->index_dict->hash_num != hash_num
+            || alphabet->index_dict->old_first_level_node != NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int check_load_txt_file(const char *fname, bool expect_ok)
+{
+    st_alphabet_t *alphabet = NULL;
+    st_alphabet_t *alphabet2 = NULL;
+    FILE *fp;
+    int num_threads[] = {1, 3, 8};
+    int t;
+
+    fp = fopen(fname, "r");
+    assert(fp != NULL);
+    alphabet = st_alphabet_load_from_txt(fp);
+    safe_fclose(fp);
+    if ((alphabet != NULL) != expect_ok
+            || (alphabet != NULL && check_index_loaded(alphabet) != 0)) {
+        goto FAILED;
+    }
+
+    for (t = 0; t < sizeof(num_threads) / sizeof(num_threads[0]); t++) {
+        alphabet2 = st_alphabet_load_from_txt_file(fname, num_threads[t]);
+        if (!expect_ok) {
+            if (alphabet2 != NULL) {
+                goto FAILED;
+            }
+            continue;
+        }
+        if (alphabet2 == NULL || check_same(alphabet, alphabet2) != 0
+                || check_index_loaded(alphabet2) != 0) {
+            goto FAILED;
+        }
+        safe_st_alphabet_destroy(alphabet2);
+    }
+
+    safe_st_alphabet_destroy(alphabet);
+    return 0;
+
+FAILED:
+    safe_st_alphabet_destroy(alphabet2);
+    safe_st_alphabet_destroy(alphabet);
+    return -1;
+}
+
+/* overwrite the saved record of label id in fname with bad. */
+static int corrupt_label(const char *fname, st_alphabet_t *alphabet, int id,
+        st_label_t *bad)
+{
+    FILE *fp;
+    char *data;
+    long size;
+    long pos;
+    int ret = -1;
+
+    fp = fopen(fname, "r+");
+    assert(fp != NULL);
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    data = (char *)malloc(size);
+    assert(data != NULL);
+    fseek(fp, 0, SEEK_SET);
+    assert(fread(data, 1, size, fp) == size);
+
+    for (pos = 0; pos + (long)sizeof(st_label_t) <= size; pos++) {
+        if (memcmp(data + pos, alphabet->labels + id,
+                    sizeof(st_label_t)) == 0) {
+            fseek(fp, pos, SEEK_SET);
+            assert(fwrite(bad, sizeof(st_label_t), 1, fp) == 1);
+            ret = 0;
+            break;
+        }
+    }
+
+    safe_free(data);
+    safe_fclose(fp);
+    return ret;
+}
+
+static int unit_test_st_alphabet_mmap()
+{
+    char fname[] = "/tmp/st-alphabet-XXXXXX";
+    st_alphabet_t *alphabet = NULL;
+    st_alphabet_t *mapped = NULL;
+    st_alphabet_t *copy = NULL;
+    st_label_t bad;
+    FILE *fp = NULL;
+    char long_label[LONG_LABEL_LEN + 1];
+    char buf[32];
+    long offset;
+    int fd;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_alphabet_mmap...\n");
+
+    memset(long_label, 'b', LONG_LABEL_LEN);
+    long_label[LONG_LABEL_LEN] = '\0';
+
+    alphabet = st_alphabet_create(0);
+    assert(alphabet != NULL);
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        assert(st_alphabet_add_label(alphabet, buf) == i);
+    }
+    assert(st_alphabet_add_label(alphabet, long_label) == NUM_LABELS);
+
+    fd = mkstemp(fname);
+    assert(fd >= 0);
+    close(fd);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = fopen(fname, "w");
+    assert(fp != NULL);
+    assert(st_alphabet_save_bin(alphabet, fp) == 0);
+    safe_fclose(fp);
+    mapped = st_alphabet_open_readonly(fname);
+    if (mapped == NULL || mapped->map_addr == NULL
+            || check_labels(mapped, long_label) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    if (st_alphabet_add_label(mapped, "w0") != 0
+            || st_alphabet_add_label(mapped, "new") >= 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    copy = st_alphabet_dup(mapped);
+    safe_st_alphabet_destroy(mapped);
+    if (copy == NULL || check_labels(copy, long_label) != 0
+            || st_alphabet_add_label(copy, "new") != NUM_LABELS + 1) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_alphabet_destroy(copy);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = fopen(fname, "w+");
+    assert(fp != NULL);
+    fprintf(fp, "header");
+    offset = ftell(fp);
+    assert(st_alphabet_save_bin(alphabet, fp) == 0);
+    fflush(fp);
+    mapped = st_alphabet_mmap(fileno(fp), offset);
+    if (mapped == NULL || check_labels(mapped, long_label) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_alphabet_destroy(mapped);
+    fseek(fp, offset, SEEK_SET);
+    mapped = st_alphabet_load_from_bin(fp);
+    if (mapped == NULL || mapped->map_addr != NULL
+            || check_labels(mapped, long_label) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_alphabet_destroy(mapped);
+    safe_fclose(fp);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* a label running into the next one, then one past label_buf. */
+    for (i = 0; i < 2; i++) {
+        fp = fopen(fname, "w");
+        assert(fp != NULL);
+        assert(st_alphabet_save_bin(alphabet, fp) == 0);
+        safe_fclose(fp);
+        if (i == 0) {
+            bad = alphabet->labels[5];
+            bad.len++;
+            assert(corrupt_label(fname, alphabet, 5, &bad) == 0);
+        } else {
+            bad = alphabet->labels[NUM_LABELS];
+            bad.offset = alphabet->label_buf_len;
+            assert(corrupt_label(fname, alphabet, NUM_LABELS, &bad) == 0);
+        }
+        mapped = st_alphabet_open_readonly(fname);
+        if (mapped != NULL) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        fp = fopen(fname, "r");
+        assert(fp != NULL);
+        mapped = st_alphabet_load_from_bin(fp);
+        safe_fclose(fp);
+        if (mapped != NULL) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    fprintf(stderr, "Passed\n");
+
+    unlink(fname);
+    safe_st_alphabet_destroy(alphabet);
+    return 0;
+
+FAILED:
+    safe_fclose(fp);
+    unlink(fname);
+    safe_st_alphabet_destroy(copy);
+    safe_st_alphabet_destroy(mapped);
+    safe_st_alphabet_destroy(alphabet);
+    return -1;
+}
+
+/* ids of line with get_next_token and st_alphabet_get_index. */
+static int line_to_ids_ref(st_alphabet_t *alphabet, const char *line,
+        int *ids, int cap, int unk_id)
+{
+    char token[MAX_LINE_LEN];
+    int n = 0;
+
+    while (line != NULL) {
+        line = get_next_token(line, token);
+        if (token[0] == '\0') {
+            continue;
+        }
+        if (n < cap) {
+            ids[n] = st_alphabet_get_index(alphabet, token);
+            if (ids[n] < 0) {
+                ids[n] = unk_id;
+            }
+        }
+        n++;
+    }
+
+    return n;
+}
+
+static int check_line_to_ids(st_alphabet_t *alphabet, const char *line,
+        int cap, int unk_id)
+{
+    int ids[2 * NUM_LABELS];
+    int ref[2 * NUM_LABELS];
+    int n;
+
+    assert(cap <= 2 * NUM_LABELS);
+    n = st_alphabet_line_to_ids(alphabet, line, ids, cap);
+    if (n != line_to_ids_ref(alphabet, line, ref, cap, unk_id)) {
+        return -1;
+    }
+    if (memcmp(ids, ref, sizeof(int) * min(n, cap)) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int unit_test_st_alphabet_line_to_ids()
+{
+    st_alphabet_t *alphabet = NULL;
+    char line[MAX_LINE_LEN];
+    char buf[32];
+    char *p;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_alphabet_line_to_ids...\n");
+
+    alphabet = st_alphabet_create(0);
+    assert(alphabet != NULL);
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        assert(st_alphabet_add_label(alphabet, buf) == i);
+    }
+    assert(st_alphabet_add_label(alphabet, "exactly8") == NUM_LABELS);
+    assert(st_alphabet_add_label(alphabet, "a-label-of-seventeen")
+            == NUM_LABELS + 1);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (check_line_to_ids(alphabet, "", 10, -1) != 0
+            || check_line_to_ids(alphabet, " \t\r\n ", 10, -1) != 0
+            || check_line_to_ids(alphabet, "w1", 10, -1) != 0
+            || check_line_to_ids(alphabet, "  w1 \tunknown w22\r\n", 10, -1) != 0
+            || check_line_to_ids(alphabet,
+                "exactly8 exactly8x a-label-of-seventeen a-label-of-seventee",
+                10, -1) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* every alignment of tokens in 16-byte blocks, and many batches. */
+    p = line;
+    for (i = 0; i < 200; i++) {
+        gen_label(buf, (i * 37) % (NUM_LABELS + 100));
+        p += sprintf(p, "%s%.*s", buf, i % 9 + 1, "  \t \t  \t \t  \t \t  \t \t");
+    }
+    if (check_line_to_ids(alphabet, line, 2 * NUM_LABELS, -1) != 0
+            || check_line_to_ids(alphabet, line + 3, 2 * NUM_LABELS, -1) != 0
+            || check_line_to_ids(alphabet, line, 100, -1) != 0
+            || check_line_to_ids(alphabet, line, 0, -1) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (st_alphabet_set_unk_id(alphabet, NUM_LABELS + 2) < 0
+            || check_line_to_ids(alphabet, line, 2 * NUM_LABELS,
+                NUM_LABELS + 2) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_alphabet_destroy(alphabet);
+    return 0;
+
+FAILED:
+    safe_st_alphabet_destroy(alphabet);
+    return -1;
+}
+
+static int unit_test_st_alphabet_load_txt_file()
+{
+    char fname[] = "/tmp/st-alphabet-XXXXXX";
+    FILE *fp = NULL;
+    char buf[32];
+    int fd;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_alphabet_load_from_txt_file...\n");
+
+    fd = mkstemp(fname);
+    assert(fd >= 0);
+    close(fd);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = fopen(fname, "w");
+    assert(fp != NULL);
+    fprintf(fp, "symbols = %d\n", NUM_LABELS);
+    for (i = NUM_LABELS - 1; i >= 0; i--) {
+        gen_label(buf, i);
+        if (i % 10 == 0) {
+            fprintf(fp, "#%s\t%d\n", buf, i);
+        } else {
+            fprintf(fp, "  %s %d\n", buf, i);
+        }
+        if (i % 97 == 0) {
+            fprintf(fp, "\nno-id\n");
+        }
+    }
+    /* ignored after label_num symbols. */
+    fprintf(fp, "extra 0\nlast 1");
+    safe_fclose(fp);
+    if (check_load_txt_file(fname, true) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = fopen(fname, "w");
+    assert(fp != NULL);
+    fprintf(fp, "symbols = %d\n", NUM_LABELS);
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i % (NUM_LABELS / 2));
+        fprintf(fp, "%s\t%d\n", buf, i);
+    }
+    safe_fclose(fp);
+    if (check_load_txt_file(fname, true) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = fopen(fname, "w");
+    assert(fp != NULL);
+    fprintf(fp, "symbols = %d\n", NUM_LABELS + 1);
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        fprintf(fp, "%s\t%d\n", buf, i);
+    }
+    safe_fclose(fp);
+    if (check_load_txt_file(fname, false) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* one label past a power of two. */
+    fp = fopen(fname, "w");
+    assert(fp != NULL);
+    fprintf(fp, "symbols = %d\n", 1025);
+    for (i = 0; i < 1025; i++) {
+        gen_label(buf, i);
+        fprintf(fp, "%s\t%d\n", buf, i);
+    }
+    safe_fclose(fp);
+    if (check_load_txt_file(fname, true) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    unlink(fname);
+    return 0;
+
+FAILED:
+    unlink(fname);
+    return -1;
+}
+
+static int unit_test_st_alphabet_dup()
+{
+    st_alphabet_t *alphabet = NULL;
+    st_alphabet_t *copy = NULL;
+    st_alphabet_t *copy2 = NULL;
+    st_alphabet_t *loaded = NULL;
+    FILE *fp = NULL;
+    char long_label[LONG_LABEL_LEN + 1];
+    char buf[32];
+    char *label;
+    st_dict_id_t hash_num;
+    uint64_t counts[NUM_LABELS + 4];
+    int ids[4];
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_alphabet_dup...\n");
+
+    memset(long_label, 'b', LONG_LABEL_LEN);
+    long_label[LONG_LABEL_LEN] = '\0';
+
+    alphabet = st_alphabet_create(0);
+    assert(alphabet != NULL);
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        assert(st_alphabet_add_label(alphabet, buf) == i);
+    }
+    assert(st_alphabet_add_label(alphabet, long_label) == NUM_LABELS);
+    assert(st_alphabet_set_unk_id(alphabet, 7) == 0);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    copy = st_alphabet_dup(alphabet);
+    /* a keeps its fields, its storage becomes the base of the copy. */
+    if (copy == NULL || alphabet->base != NULL || alphabet->shared == NULL
+            || copy->base != alphabet->shared || copy->base->ref != 2
+            || copy->label_num != 0
+            || alphabet->label_num != NUM_LABELS + 1
+            || alphabet->labels != alphabet->shared->labels
+            || alphabet->is_aux == NULL
+            || check_labels(alphabet, long_label) != 0
+            || check_labels(copy, long_label) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* labels added after the dup stay private. */
+    hash_num = alphabet->index_dict->hash_num;
+    label = st_alphabet_get_label(alphabet, 0);
+    if (st_alphabet_add_label(alphabet, "only-a") != NUM_LABELS + 1
+            || st_alphabet_add_label(copy, "#only-b") != NUM_LABELS + 1
+            || st_alphabet_get_index(alphabet, "#only-b") >= 0
+            || st_alphabet_get_index(copy, "only-a") >= 0
+            || strcmp(st_alphabet_get_label(copy, NUM_LABELS + 1),
+                "#only-b") != 0
+            || alphabet->shared != NULL || copy->base->ref != 2
+            || !st_alphabet_is_aux(copy, NUM_LABELS + 1)
+            || st_alphabet_is_aux(copy, 5)
+            || st_alphabet_get_aux_num(copy) != 1
+            || st_alphabet_get_aux_num(alphabet) != 0
+            || st_alphabet_add_label(copy, "w5") != 5) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* a became an overlay on the shared storage, copying nothing. */
+    if (alphabet->base != copy->base || alphabet->label_num != 1
+            || alphabet->label_buf_len != strlen("only-a") + 1
+            || alphabet->index_dict->node_num != 1
+            || alphabet->index_dict->hash_num >= hash_num
+            || st_alphabet_get_label(alphabet, 0) != label
+            || st_alphabet_get_index(alphabet, "w7") != 7
+            || st_alphabet_get_index(alphabet, long_label) != NUM_LABELS) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    copy2 = st_alphabet_dup(copy);
+    safe_st_alphabet_destroy(alphabet);
+    safe_st_alphabet_destroy(copy);
+    if (copy2 == NULL || copy2->base == NULL || copy2->base->base == NULL
+            || st_alphabet_add_label(copy2, "c2") != NUM_LABELS + 2
+            || st_alphabet_line_to_ids(copy2, "w3 #only-b c2 only-a",
+                ids, 4) != 4 || ids[0] != 3 || ids[1] != NUM_LABELS + 1
+            || ids[2] != NUM_LABELS + 2 || ids[3] != 7
+            || st_alphabet_get_index(copy2, long_label) != NUM_LABELS) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = tmpfile();
+    assert(fp != NULL);
+    if (st_alphabet_save_bin(copy2, fp) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    rewind(fp);
+    loaded = st_alphabet_load_from_bin(fp);
+    if (loaded == NULL || loaded->base != NULL
+            || st_alphabet_get_label_num(loaded) != NUM_LABELS + 3
+            || loaded->aux_num != 1) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_LABELS + 3; i++) {
+        if (strcmp(st_alphabet_get_label(loaded, i),
+                    st_alphabet_get_label(copy2, i)) != 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    safe_st_alphabet_destroy(loaded);
+    safe_fclose(fp);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    assert(st_alphabet_set_concurrent(copy2, true, 0, 0) == 0);
+    if (st_alphabet_add_label(copy2, "w9") != 9
+            || st_alphabet_add_label(copy2, "c3") != NUM_LABELS + 3
+            || st_alphabet_get_index(copy2, "#only-b") != NUM_LABELS + 1
+            || st_alphabet_set_concurrent(copy2, false, 0, 0) != 0
+            || st_alphabet_get_index(copy2, "c3") != NUM_LABELS + 3) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* renumbering takes a private copy of the base. */
+    for (i = 0; i < NUM_LABELS + 4; i++) {
+        counts[i] = i;
+    }
+    if (st_alphabet_sort_by_count(copy2, counts, NULL) != 0
+            || copy2->base != NULL
+            || st_alphabet_get_index(copy2, "c3") != 0
+            || st_alphabet_get_index(copy2, "w0") != NUM_LABELS + 3) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_alphabet_destroy(copy2);
+    return 0;
+
+FAILED:
+    safe_fclose(fp);
+    safe_st_alphabet_destroy(loaded);
+    safe_st_alphabet_destroy(copy2);
+    safe_st_alphabet_destroy(copy);
+    safe_st_alphabet_destroy(alphabet);
+    return -1;
+}
+
+static int unit_test_st_alphabet_sort_by_count()
+{
+    st_alphabet_t *alphabet = NULL;
+    uint64_t counts[NUM_LABELS + 1];
+    int old2new[NUM_LABELS + 1];
+    int new2old[NUM_LABELS + 1];
+    char buf[32];
+    char *label;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_alphabet_sort_by_count...\n");
+
+    alphabet = st_alphabet_create(0);
+    assert(alphabet != NULL);
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        assert(st_alphabet_add_label(alphabet, buf) == i);
+        counts[i] = (i * 7919) % 13;
+    }
+    assert(st_alphabet_add_label(alphabet, "#aux") == NUM_LABELS);
+    counts[NUM_LABELS] = 100;
+    assert(st_alphabet_set_unk_id(alphabet, 5) == 0);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (st_alphabet_sort_by_count(alphabet, counts, old2new) != 0
+            || old2new[NUM_LABELS] != 0 || !alphabet->is_aux[0]
+            || alphabet->aux_num != 1 || alphabet->unk_id != old2new[5]) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i <= NUM_LABELS; i++) {
+        new2old[i] = -1;
+    }
+    for (i = 0; i <= NUM_LABELS; i++) {
+        if (old2new[i] < 0 || old2new[i] > NUM_LABELS
+                || new2old[old2new[i]] >= 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        new2old[old2new[i]] = i;
+    }
+    for (i = 1; i <= NUM_LABELS; i++) {
+        if (counts[new2old[i - 1]] < counts[new2old[i]]
+                || (counts[new2old[i - 1]] == counts[new2old[i]]
+                    && new2old[i - 1] > new2old[i])) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        label = st_alphabet_get_label(alphabet, old2new[i]);
+        if (st_alphabet_get_index(alphabet, buf) != old2new[i]
+                || label == NULL || strcmp(label, buf) != 0
+                || alphabet->is_aux[old2new[i]]) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (st_alphabet_add_label(alphabet, "new") != NUM_LABELS + 1
+            || st_alphabet_get_index(alphabet, "#aux") != 0
+            || st_alphabet_get_index(alphabet, "not-exist") >= 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_alphabet_destroy(alphabet);
+    return 0;
+
+FAILED:
+    safe_st_alphabet_destroy(alphabet);
+    return -1;
+}
+
+static int check_trie(st_alphabet_t *alphabet, st_datrie_t *trie)
+{
+    const char *line = "w123x";
+    char buf[32];
+    size_t lens[4];
+    size_t mlen;
+    int ids[4];
+    int i;
+
+    for (i = 0; i < st_alphabet_get_label_num(alphabet); i++) {
+        if (st_datrie_seek(trie, st_alphabet_get_label(alphabet, i),
+                    strlen(st_alphabet_get_label(alphabet, i))) != i) {
+            return -1;
+        }
+    }
+    gen_label(buf, NUM_LABELS);
+    if (st_datrie_seek(trie, buf, strlen(buf)) >= 0
+            || st_datrie_seek(trie, "w", 1) >= 0) {
+        return -1;
+    }
+
+    if (st_datrie_longest_prefix(trie, line, strlen(line), &mlen)
+            != st_alphabet_get_index(alphabet, "w123") || mlen != 4
+            || st_datrie_longest_prefix(trie, line, 2, &mlen)
+            != st_alphabet_get_index(alphabet, "w1") || mlen != 2
+            || st_datrie_longest_prefix(trie, "x", 1, &mlen) >= 0) {
+        return -1;
+    }
+
+    if (st_datrie_common_prefix(trie, line, strlen(line), ids, lens, 4) != 3
+            || ids[0] != st_alphabet_get_index(alphabet, "w1")
+            || ids[1] != st_alphabet_get_index(alphabet, "w12")
+            || ids[2] != st_alphabet_get_index(alphabet, "w123")
+            || lens[0] != 2 || lens[1] != 3 || lens[2] != 4
+            || st_datrie_common_prefix(trie, line, strlen(line),
+                ids, NULL, 1) != 3
+            || ids[0] != st_alphabet_get_index(alphabet, "w1")) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int unit_test_st_alphabet_trie()
+{
+    const char *text = "\xe4\xb8\xad\xe5\x9b\xbd\xe4\xba\xba\xe6\xb0\x91";
+    const char *cjk[] = {
+        "\xe4\xb8\xad",                         /* zhong */
+        "\xe4\xb8\xad\xe5\x9b\xbd",             /* zhong guo */
+        "\xe4\xb8\xad\xe5\x9b\xbd\xe4\xba\xba", /* zhong guo ren */
+        "\xe4\xba\xba",                         /* ren */
+    };
+    char fname[] = "/tmp/st-alphabet-XXXXXX";
+    st_alphabet_t *alphabet = NULL;
+    st_alphabet_t *copy = NULL;
+    st_datrie_t *trie = NULL;
+    FILE *fp = NULL;
+    char buf[32];
+    size_t mlen;
+    long offset;
+    int fd;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_alphabet trie...\n");
+
+    alphabet = st_alphabet_create(0);
+    assert(alphabet != NULL);
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        assert(st_alphabet_add_label(alphabet, buf) == i);
+    }
+    for (i = 0; i < sizeof(cjk) / sizeof(cjk[0]); i++) {
+        assert(st_alphabet_add_label(alphabet, cjk[i]) == NUM_LABELS + i);
+    }
+
+    fd = mkstemp(fname);
+    assert(fd >= 0);
+    close(fd);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (st_alphabet_longest_match(alphabet, text, strlen(text), &mlen) >= 0
+            || st_alphabet_build_trie(alphabet) != 0
+            || check_trie(alphabet, alphabet->trie) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* greedy segmentation stops at the unknown last character. */
+    if (st_alphabet_longest_match(alphabet, text, strlen(text), &mlen)
+            != NUM_LABELS + 2 || mlen != 9
+            || st_alphabet_longest_match(alphabet, text + 9,
+                strlen(text) - 9, &mlen) >= 0
+            || st_alphabet_prefix_matches(alphabet, text, strlen(text),
+                NULL, NULL, 0) != 3) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = fopen(fname, "w+");
+    assert(fp != NULL);
+    fprintf(fp, "header");
+    offset = ftell(fp);
+    assert(st_datrie_save(alphabet->trie, fp) == 0);
+    trie = st_datrie_mmap(fileno(fp), offset);
+    if (trie == NULL || trie->map_addr == NULL
+            || check_trie(alphabet, trie) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_datrie_destroy(trie);
+    fseek(fp, offset, SEEK_SET);
+    trie = st_datrie_load_from_bin(fp);
+    if (trie == NULL || trie->map_addr != NULL
+            || check_trie(alphabet, trie) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_datrie_destroy(trie);
+    safe_fclose(fp);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    copy = st_alphabet_dup(alphabet);
+    if (copy == NULL || copy->trie != alphabet->trie
+            || check_trie(copy, copy->trie) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* a new label drops the trie. */
+    if (st_alphabet_add_label(copy, "w1234") < 0 || copy->trie != NULL
+            || st_alphabet_build_trie(copy) != 0
+            || st_alphabet_longest_match(copy, "w12345", 6, &mlen)
+            != st_alphabet_get_index(copy, "w1234") || mlen != 5) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+    safe_st_alphabet_destroy(copy);
+    safe_st_alphabet_destroy(alphabet);
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* txt files may list a label under several ids. */
+    fp = tmpfile();
+    assert(fp != NULL);
+    fprintf(fp, "symbols = 3\nfoo 0\nbar 1\nfoo 2\n");
+    rewind(fp);
+    alphabet = st_alphabet_load_from_txt(fp);
+    safe_fclose(fp);
+    if (alphabet == NULL || st_alphabet_build_trie(alphabet) != 0
+            || st_alphabet_longest_match(alphabet, "foox", 4, &mlen)
+            != st_alphabet_get_index(alphabet, "foo") || mlen != 3
+            || st_alphabet_longest_match(alphabet, "bar", 3, &mlen) != 1) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_alphabet_destroy(alphabet);
+    unlink(fname);
+    return 0;
+
+FAILED:
+    safe_fclose(fp);
+    safe_st_datrie_destroy(trie);
+    safe_st_alphabet_destroy(copy);
+    safe_st_alphabet_destroy(alphabet);
+    unlink(fname);
+    return -1;
+}
+
+#define NUM_THREADS 4
+
+typedef struct _conc_args_t {
+    st_alphabet_t *alphabet;
+    int start;
+    int ids[NUM_LABELS];
+    int ret;
+} conc_args_t;
+
+/* add every label once, from start onwards, and look each one up. */
+static void* conc_thread(void *args)
+{
+    conc_args_t *ca = (conc_args_t *)args;
+    char buf[32];
+    int i;
+    int k;
+
+    ca->ret = 0;
+    for (k = 0; k < NUM_LABELS; k++) {
+        i = (ca->start + k) % NUM_LABELS;
+        gen_label(buf, i);
+        ca->ids[i] = st_alphabet_add_label(ca->alphabet, buf);
+        if (ca->ids[i] < 0
+                || st_alphabet_get_index(ca->alphabet, buf) != ca->ids[i]
+                || strcmp(st_alphabet_get_label(ca->alphabet, ca->ids[i]),
+                    buf) != 0) {
+            ca->ret = -1;
+        }
+    }
+
+    return NULL;
+}
+
+/* the space of labels that failed to be added is zeroed. */
+static int check_buf_tail(st_alphabet_t *alphabet)
+{
+    st_label_t *l;
+    size_t i;
+
+    l = alphabet->labels + alphabet->label_num - 1;
+    for (i = l->offset + l->len + 1; i < alphabet->label_buf_len; i++) {
+        if (alphabet->label_buf[i] != '\0') {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int unit_test_st_alphabet_concurrent()
+{
+    st_alphabet_t *alphabet = NULL;
+    conc_args_t *cas = NULL;
+    pthread_t pts[NUM_THREADS];
+    bool seen[NUM_LABELS];
+    char buf[32];
+    int ids[4];
+    int base;
+    int i;
+    int t;
+    int ncase;
+
+    fprintf(stderr, " Testing st_alphabet concurrent mode...\n");
+
+    cas = (conc_args_t *)malloc(sizeof(conc_args_t) * NUM_THREADS);
+    assert(cas != NULL);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    alphabet = st_alphabet_create(0);
+    assert(alphabet != NULL);
+    /* some labels before the mode is on. */
+    base = NUM_LABELS / 10;
+    for (i = 0; i < base; i++) {
+        gen_label(buf, i);
+        assert(st_alphabet_add_label(alphabet, buf) == i);
+    }
+    assert(st_alphabet_set_concurrent(alphabet, true, 0, 0) == 0);
+
+    for (t = 0; t < NUM_THREADS; t++) {
+        cas[t].alphabet = alphabet;
+        cas[t].start = t * NUM_LABELS / NUM_THREADS;
+        assert(pthread_create(pts + t, NULL, conc_thread, cas + t) == 0);
+    }
+    for (t = 0; t < NUM_THREADS; t++) {
+        pthread_join(pts[t], NULL);
+    }
+
+    memset(seen, 0, sizeof(seen));
+    for (t = 0; t < NUM_THREADS; t++) {
+        if (cas[t].ret != 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        for (i = 0; i < NUM_LABELS; i++) {
+            if (cas[t].ids[i] != cas[0].ids[i]) {
+                fprintf(stderr, "Failed\n");
+                goto FAILED;
+            }
+        }
+    }
+    for (i = 0; i < NUM_LABELS; i++) {
+        if ((i < base && cas[0].ids[i] != i) || cas[0].ids[i] >= NUM_LABELS
+                || seen[cas[0].ids[i]]) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        seen[cas[0].ids[i]] = true;
+    }
+    if (st_alphabet_get_label_num(alphabet) != NUM_LABELS
+            || st_alphabet_get_index(alphabet, "not-exist") >= 0
+            || st_alphabet_line_to_ids(alphabet, "w1 not-exist w2",
+                ids, 4) != 3 || ids[0] != cas[0].ids[1] || ids[1] != -1
+            || ids[2] != cas[0].ids[2]
+            || st_alphabet_save_bin(alphabet, stderr) >= 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    assert(st_alphabet_set_concurrent(alphabet, false, 0, 0) == 0);
+    /* the default capacity is given back. */
+    if (alphabet->max_label_num != NUM_LABELS) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_LABELS; i++) {
+        gen_label(buf, i);
+        if (st_alphabet_get_index(alphabet, buf) != cas[0].ids[i]) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (st_alphabet_add_label(alphabet, "new") != NUM_LABELS) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    assert(st_alphabet_set_concurrent(alphabet, true,
+                NUM_LABELS + 2, 0) == 0);
+    if (st_alphabet_add_label(alphabet, "new2") != NUM_LABELS + 1
+            || st_alphabet_add_label(alphabet, "new3") >= 0
+            || st_alphabet_add_label(alphabet, "new2") != NUM_LABELS + 1
+            || st_alphabet_set_concurrent(alphabet, false, 0, 0) != 0
+            || st_alphabet_get_label_num(alphabet) != NUM_LABELS + 2
+            || st_alphabet_get_index(alphabet, "new3") >= 0
+            || check_buf_tail(alphabet) != 0
+            || st_alphabet_add_label(alphabet, "new3") != NUM_LABELS + 2) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_alphabet_destroy(alphabet);
+    safe_free(cas);
+    return 0;
+
+FAILED:
+    safe_st_alphabet_destroy(alphabet);
+    safe_free(cas);
+    return -1;
+}
+
+static int run_all_tests()
+{
+    int ret = 0;
+
+    if (unit_test_st_alphabet() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_alphabet_line_to_ids() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_alphabet_mmap() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_alphabet_load_txt_file() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_alphabet_dup() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_alphabet_trie() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_alphabet_sort_by_count() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_alphabet_concurrent() != 0) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int main(int argc, const char *argv[])
+{
+    int ret;
+
+    fprintf(stderr, "Start testing...\n");
+    ret = run_all_tests();
+    if (ret != 0) {
+        fprintf(stderr, "Tests failed.\n");
+    } else {
+        fprintf(stderr, "Tests succeeded.\n");
+    }
+
+    return ret;
+}
@@ -0,0 +1,321 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "st_arena.h"
+
+static int unit_test_st_arena_alloc()
+{
+#define N 12
+    st_arena_t *arena = NULL;
+    char *ptr;
+    char *prev;
+    size_t alignment;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_arena_alloc...\n");
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    arena = st_arena_create(1024, 0);
+    assert(arena != NULL);
+    for (i = 0; i <= N; i++) {
+        alignment = (size_t)1 << i;
+        ptr = st_arena_aligned_alloc(arena, 123, alignment);
+        if (ptr == NULL || ((uintptr_t)ptr & (alignment - 1)) != 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        memset(ptr, i, 123);
+    }
+    if (st_arena_aligned_alloc(arena, 123, 3) != NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_arena_destroy(arena);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    arena = st_arena_create(1024, 0);
+    assert(arena != NULL);
+    prev = st_arena_alloc(arena, 100);
+    for (i = 0; i < 100; i++) {
+        ptr = st_arena_alloc(arena, 100);
+        if (ptr == NULL || ((uintptr_t)ptr & (ST_ARENA_ALIGNMENT - 1)) != 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        /* blocks of a chunk follow one another. */
+        if (arena->chunk->used > 112 && ptr != prev + 112) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        prev = ptr;
+    }
+    /* larger than a chunk. */
+    ptr = st_arena_alloc(arena, 10000);
+    if (ptr == NULL || arena->chunk->cap < 10000) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    memset(ptr, 0, 10000);
+    safe_st_arena_destroy(arena);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    arena = st_arena_create(1024 * 1024, ST_ARENA_HUGE_PAGE);
+    assert(arena != NULL);
+    for (i = 0; i < 10; i++) {
+        ptr = st_arena_alloc(arena, 300 * 1024);
+        if (ptr == NULL) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        memset(ptr, i, 300 * 1024);
+    }
+    st_arena_reset(arena);
+    if (st_arena_used(arena) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_arena_destroy(arena);
+    fprintf(stderr, "Passed\n");
+
+    return 0;
+
+FAILED:
+    safe_st_arena_destroy(arena);
+    return -1;
+#undef N
+}
+
+static int unit_test_st_arena_realloc()
+{
+    st_arena_t *arena = NULL;
+    char *ptr;
+    char *ptr2;
+    char *q;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_arena_realloc...\n");
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    arena = st_arena_create(1024, 0);
+    assert(arena != NULL);
+    ptr = st_arena_realloc(arena, NULL, 0, 10);
+    assert(ptr != NULL);
+    for (i = 0; i < 10; i++) {
+        ptr[i] = (char)i;
+    }
+    /* the latest block grows in place. */
+    ptr2 = st_arena_realloc(arena, ptr, 10, 500);
+    if (ptr2 != ptr) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    q = st_arena_alloc(arena, 10);
+    assert(q != NULL);
+    ptr2 = st_arena_realloc(arena, ptr, 500, 600);
+    if (ptr2 == NULL || ptr2 == ptr) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < 10; i++) {
+        if (ptr2[i] != (char)i) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    /* no room left in the chunk. */
+    ptr = st_arena_realloc(arena, ptr2, 600, 2000);
+    if (ptr == NULL || ptr == ptr2) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < 10; i++) {
+        if (ptr[i] != (char)i) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    safe_st_arena_destroy(arena);
+    fprintf(stderr, "Passed\n");
+
+    return 0;
+
+FAILED:
+    safe_st_arena_destroy(arena);
+    return -1;
+}
+
+static int unit_test_st_arena_rewind()
+{
+    st_arena_t *arena = NULL;
+    st_arena_mark_t mark;
+    st_arena_mark_t mark2;
+    st_arena_chunk_t *chunk;
+    char *ptr;
+    char *ptr2;
+    size_t used;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_arena_rewind...\n");
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    arena = st_arena_create(1024, 0);
+    assert(arena != NULL);
+    assert(st_arena_alloc(arena, 100) != NULL);
+    used = st_arena_used(arena);
+    mark = st_arena_mark(arena);
+    ptr = st_arena_alloc(arena, 100);
+    assert(ptr != NULL);
+    for (i = 0; i < 100; i++) {
+        assert(st_arena_alloc(arena, 100) != NULL);
+    }
+    if (st_arena_rewind(arena, mark) < 0 || st_arena_used(arena) != used) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* the space after the mark is given out again. */
+    ptr2 = st_arena_alloc(arena, 100);
+    if (ptr2 != ptr) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    mark2 = st_arena_mark(arena);
+    if (st_arena_rewind(arena, mark) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* mark2 is after the current position now. */
+    if (st_arena_rewind(arena, mark2) >= 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    for (i = 0; i < 100; i++) {
+        assert(st_arena_alloc(arena, 100) != NULL);
+    }
+    st_arena_reset(arena);
+    if (st_arena_used(arena) != 0 || arena->chunk != NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* chunks are reused after reset. */
+    chunk = arena->spare;
+    if (chunk == NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    assert(st_arena_alloc(arena, 100) != NULL);
+    if (arena->chunk != chunk) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    st_arena_reset(arena);
+    mark = st_arena_mark(arena);
+    chunk = arena->spare;
+    assert(st_arena_alloc(arena, 100000) != NULL);
+    if (st_arena_rewind(arena, mark) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* chunks of large blocks are not kept. */
+    if (arena->spare != chunk) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_arena_destroy(arena);
+    fprintf(stderr, "Passed\n");
+
+    return 0;
+
+FAILED:
+    safe_st_arena_destroy(arena);
+    return -1;
+}
+
+static int run_all_tests()
+{
+    int ret = 0;
+
+    if (unit_test_st_arena_alloc() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_arena_realloc() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_arena_rewind() != 0) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int main(int argc, const char *argv[])
+{
+    int ret;
+
+    fprintf(stderr, "Start testing...\n");
+    ret = run_all_tests();
+    if (ret != 0) {
+        fprintf(stderr, "Tests failed.\n");
+    } else {
+        fprintf(stderr, "Tests succeeded.\n");
+    }
+
+    return ret;
+}
@@ -190,6 +190,7 @@ static int check_conf(st_conf_t *conf, ref_t *ref)
 static int unit_test_load()
 {
     st_conf_t *conf = NULL;
+    st_arena_t *arena = NULL;
     const char *file;
     int ncase;
     ref_t ref;
@@ -252,11 +253,35 @@ static int unit_test_load()
     clean_conf_files();
     safe_st_conf_destroy(conf);
     fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    ref = std_ref;
+    file = mk_conf_files(&ref);
+    assert(file != NULL);
+    arena = st_arena_create(4096, 0);
+    assert(arena != NULL);
+    conf = st_conf_create_in(arena);
+    assert (conf != NULL);
+    if (st_conf_load(conf, file) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+
+    if (check_conf(conf, &ref) != 0 || st_arena_used(arena) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    clean_conf_files();
+    safe_st_conf_destroy(conf);
+    safe_st_arena_destroy(arena);
+    fprintf(stderr, "Passed\n");
     return 0;
 
 FAILED:
     clean_conf_files();
     safe_st_conf_destroy(conf);
+    safe_st_arena_destroy(arena);
     return -1;
 }
 
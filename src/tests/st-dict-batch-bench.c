@@ -0,0 +1,145 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "st_dict.h"
+
+/*
+ * Compares st_dict_seek one key at a time with st_dict_seek_batch on a
+ * dict much larger than the cache, seeking in random order.
+ *
+ * Usage: st-dict-batch-bench [num_keys [batch_size]]
+ */
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, const char *argv[])
+{
+    st_dict_t *dict = NULL;
+    st_dict_node_t *keys = NULL;
+    st_dict_node_t *nodes = NULL;
+    unsigned char *mask = NULL;
+    st_dict_node_t node;
+    double t;
+    long found;
+    int batch;
+    int num;
+    int ret;
+    int n;
+    int i;
+    int j;
+
+    n = argc > 1 ? atoi(argv[1]) : 4000000;
+    batch = argc > 2 ? atoi(argv[2]) : 64;
+    if (n <= 0 || batch <= 0) {
+        fprintf(stderr, "Usage: %s [num_keys [batch_size]]\n", argv[0]);
+        return -1;
+    }
+
+    keys = (st_dict_node_t *)malloc(sizeof(st_dict_node_t) * n);
+    nodes = (st_dict_node_t *)malloc(sizeof(st_dict_node_t) * batch);
+    mask = (unsigned char *)malloc((batch + 7) / 8);
+    if (keys == NULL || nodes == NULL || mask == NULL) {
+        fprintf(stderr, "Failed to alloc.\n");
+        goto ERR;
+    }
+    srand(1);
+    for (i = 0; i < n; i++) {
+        keys[i].sign1 = (unsigned int)(rand() % 50000) + 1;
+        keys[i].sign2 = (unsigned int)i;
+        keys[i].uint1 = i;
+    }
+
+    dict = st_dict_create(n, n, NULL, NULL, false);
+    if (dict == NULL) {
+        fprintf(stderr, "Failed to st_dict_create.\n");
+        goto ERR;
+    }
+    for (i = 0; i < n; i++) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed to st_dict_add.\n");
+            goto ERR;
+        }
+    }
+    for (i = n - 1; i > 0; i--) {
+        j = rand() % (i + 1);
+        node = keys[i];
+        keys[i] = keys[j];
+        keys[j] = node;
+    }
+
+    printf("%d keys, batch %d\n", n, batch);
+
+    found = 0;
+    t = now();
+    for (i = 0; i < n; i++) {
+        node = keys[i];
+        found += st_dict_seek(dict, &node, NULL) == 0;
+    }
+    t = now() - t;
+    printf("  %-16s %8.3fs %8.2f Mops/s\n", "st_dict_seek", t, n / t / 1e6);
+
+    t = now();
+    for (i = 0; i < n; i += batch) {
+        num = min(batch, n - i);
+        for (j = 0; j < num; j++) {
+            nodes[j] = keys[i + j];
+        }
+        ret = st_dict_seek_batch(dict, nodes, num, mask);
+        if (ret < 0) {
+            fprintf(stderr, "Failed to st_dict_seek_batch.\n");
+            goto ERR;
+        }
+        found += ret;
+    }
+    t = now() - t;
+    printf("  %-16s %8.3fs %8.2f Mops/s\n", "seek_batch", t, n / t / 1e6);
+
+    if (found != 2L * n) {
+        fprintf(stderr, "Wrong number of found keys[%ld].\n", found);
+        goto ERR;
+    }
+
+    safe_st_dict_destroy(dict);
+    safe_free(keys);
+    safe_free(nodes);
+    safe_free(mask);
+    return 0;
+
+ERR:
+    safe_st_dict_destroy(dict);
+    safe_free(keys);
+    safe_free(nodes);
+    safe_free(mask);
+    return -1;
+}
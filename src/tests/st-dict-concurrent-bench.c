@@ -0,0 +1,217 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "st_dict.h"
+
+/*
+ * Readers seek while one writer adds new keys, with the dict in
+ * concurrent mode and, as the baseline, with every call under a
+ * pthread_rwlock. Reports reader throughput and writer time.
+ *
+ * Usage: st-dict-concurrent-bench [num_keys [num_readers]]
+ */
+
+typedef struct _bench_arg_t {
+    st_dict_t *dict;
+    pthread_rwlock_t *lock; /* NULL in concurrent mode. */
+    st_dict_node_t *keys;
+    int n;
+    int found;
+} bench_arg_t;
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void* reader(void *args)
+{
+    bench_arg_t *arg = (bench_arg_t *)args;
+    st_dict_node_t node;
+    int i;
+
+    arg->found = 0;
+    for (i = 0; i < arg->n; i++) {
+        node = arg->keys[i];
+        if (arg->lock != NULL) {
+            pthread_rwlock_rdlock(arg->lock);
+        }
+        arg->found += st_dict_seek(arg->dict, &node, NULL) == 0;
+        if (arg->lock != NULL) {
+            pthread_rwlock_unlock(arg->lock);
+        }
+    }
+
+    return NULL;
+}
+
+static void* writer(void *args)
+{
+    bench_arg_t *arg = (bench_arg_t *)args;
+    int i;
+
+    for (i = 0; i < arg->n; i++) {
+        if (arg->lock != NULL) {
+            pthread_rwlock_wrlock(arg->lock);
+        }
+        if (st_dict_add(arg->dict, arg->keys + i, NULL) < 0) {
+            arg->found = -1;
+        }
+        if (arg->lock != NULL) {
+            pthread_rwlock_unlock(arg->lock);
+        }
+    }
+
+    return NULL;
+}
+
+static int run(const char *name, st_dict_node_t *keys, int n,
+        int num_reader, bool concurrent)
+{
+    st_dict_t *dict = NULL;
+    pthread_rwlock_t lock;
+    pthread_t *pts = NULL;
+    bench_arg_t *args = NULL;
+    double t;
+    double t_write = 0.0;
+    int i;
+
+    pts = (pthread_t *)malloc(sizeof(pthread_t) * (num_reader + 1));
+    args = (bench_arg_t *)malloc(sizeof(bench_arg_t) * (num_reader + 1));
+    if (pts == NULL || args == NULL) {
+        fprintf(stderr, "Failed to alloc threads.\n");
+        goto ERR;
+    }
+
+    dict = st_dict_create(n, n, NULL, NULL, false);
+    if (dict == NULL) {
+        fprintf(stderr, "Failed to st_dict_create.\n");
+        goto ERR;
+    }
+    /* readers look up the first half, the writer adds the second. */
+    for (i = 0; i < n / 2; i++) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed to st_dict_add.\n");
+            goto ERR;
+        }
+    }
+    if (concurrent && st_dict_set_concurrent(dict, true) < 0) {
+        fprintf(stderr, "Failed to st_dict_set_concurrent.\n");
+        goto ERR;
+    }
+    pthread_rwlock_init(&lock, NULL);
+
+    for (i = 0; i <= num_reader; i++) {
+        args[i].dict = dict;
+        args[i].lock = concurrent ? NULL : &lock;
+        args[i].keys = i < num_reader ? keys : keys + n / 2;
+        args[i].n = n / 2;
+        args[i].found = 0;
+    }
+
+    t = now();
+    for (i = 0; i < num_reader; i++) {
+        pthread_create(pts + i, NULL, reader, args + i);
+    }
+    pthread_create(pts + num_reader, NULL, writer, args + num_reader);
+    for (i = 0; i <= num_reader; i++) {
+        pthread_join(pts[i], NULL);
+        if (i == num_reader) {
+            t_write = now() - t;
+        }
+    }
+    t = now() - t;
+    pthread_rwlock_destroy(&lock);
+
+    for (i = 0; i < num_reader; i++) {
+        if (args[i].found != n / 2) {
+            fprintf(stderr, "Wrong number of found keys[%d].\n",
+                    args[i].found);
+            goto ERR;
+        }
+    }
+    if (args[num_reader].found < 0) {
+        fprintf(stderr, "Failed to add.\n");
+        goto ERR;
+    }
+
+    printf("  %-10s reads %8.2f Mops/s, writer %.3fs\n", name,
+            (double)num_reader * (n / 2) / t / 1e6, t_write);
+
+    safe_st_dict_destroy(dict);
+    safe_free(pts);
+    safe_free(args);
+    return 0;
+
+ERR:
+    safe_st_dict_destroy(dict);
+    safe_free(pts);
+    safe_free(args);
+    return -1;
+}
+
+int main(int argc, const char *argv[])
+{
+    st_dict_node_t *keys = NULL;
+    int num_reader;
+    int n;
+    int i;
+
+    n = argc > 1 ? atoi(argv[1]) : 2000000;
+    num_reader = argc > 2 ? atoi(argv[2]) : 4;
+    if (n <= 1 || num_reader <= 0) {
+        fprintf(stderr, "Usage: %s [num_keys [num_readers]]\n", argv[0]);
+        return -1;
+    }
+
+    keys = (st_dict_node_t *)malloc(sizeof(st_dict_node_t) * n);
+    if (keys == NULL) {
+        fprintf(stderr, "Failed to alloc keys.\n");
+        return -1;
+    }
+    srand(1);
+    for (i = 0; i < n; i++) {
+        keys[i].sign1 = (unsigned int)(rand() % 50000) + 1;
+        keys[i].sign2 = (unsigned int)i;
+        keys[i].uint1 = i;
+    }
+
+    printf("%d keys, %d readers\n", n, num_reader);
+    if (run("rwlock", keys, n, num_reader, false) < 0
+            || run("concurrent", keys, n, num_reader, true) < 0) {
+        safe_free(keys);
+        return -1;
+    }
+
+    safe_free(keys);
+    return 0;
+}
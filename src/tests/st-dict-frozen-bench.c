@@ -0,0 +1,142 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "st_dict.h"
+#include "st_dict_frozen.h"
+
+/*
+ * Compares seeks on a st_dict and on the frozen dict built from it,
+ * plus the build time and memory of the frozen dict.
+ *
+ * Usage: st-dict-frozen-bench [num_keys]
+ */
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, int n, double t)
+{
+    printf("  %-16s %8.3fs %8.2f Mops/s\n", name, t, n / t / 1e6);
+}
+
+int main(int argc, const char *argv[])
+{
+    st_dict_t *dict = NULL;
+    st_dict_frozen_t *fd = NULL;
+    st_dict_node_t *keys = NULL;
+    st_dict_node_t node;
+    double t;
+    int found;
+    int n;
+    int i;
+    int j;
+
+    n = argc > 1 ? atoi(argv[1]) : 2000000;
+    if (n <= 0) {
+        fprintf(stderr, "Usage: %s [num_keys]\n", argv[0]);
+        return -1;
+    }
+
+    keys = (st_dict_node_t *)malloc(sizeof(st_dict_node_t) * n);
+    if (keys == NULL) {
+        fprintf(stderr, "Failed to alloc keys.\n");
+        goto ERR;
+    }
+    srand(1);
+    for (i = 0; i < n; i++) {
+        keys[i].sign1 = (unsigned int)(rand() % 50000) + 1;
+        keys[i].sign2 = (unsigned int)i;
+        keys[i].uint1 = i;
+    }
+    /* seek in random order, as real lookups do. */
+    for (i = n - 1; i > 0; i--) {
+        j = rand() % (i + 1);
+        node = keys[i];
+        keys[i] = keys[j];
+        keys[j] = node;
+    }
+
+    dict = st_dict_create(n, n, NULL, NULL, false);
+    if (dict == NULL) {
+        fprintf(stderr, "Failed to st_dict_create.\n");
+        goto ERR;
+    }
+    for (i = 0; i < n; i++) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed to st_dict_add.\n");
+            goto ERR;
+        }
+    }
+
+    t = now();
+    fd = st_dict_freeze(dict);
+    if (fd == NULL) {
+        fprintf(stderr, "Failed to st_dict_freeze.\n");
+        goto ERR;
+    }
+    printf("%d keys, freeze %.3fs\n", n, now() - t);
+    printf("  memory: st_dict %zuMB, frozen %zuMB\n",
+            ((size_t)dict->hash_num + dict->max_pool_num)
+                * sizeof(st_dict_node_t) >> 20,
+            ((size_t)fd->bucket_num * sizeof(uint32_t)
+                + (size_t)fd->node_num * sizeof(st_dict_frozen_node_t)) >> 20);
+
+    found = 0;
+    t = now();
+    for (i = 0; i < n; i++) {
+        node = keys[i];
+        found += st_dict_seek(dict, &node, NULL) == 0;
+    }
+    report("st_dict seek", n, now() - t);
+    t = now();
+    for (i = 0; i < n; i++) {
+        node = keys[i];
+        found += st_dict_frozen_seek(fd, &node) == 0;
+    }
+    report("frozen seek", n, now() - t);
+    if (found != 2 * n) {
+        fprintf(stderr, "Wrong number of found keys[%d].\n", found);
+        goto ERR;
+    }
+
+    safe_st_dict_destroy(dict);
+    safe_st_dict_frozen_destroy(fd);
+    safe_free(keys);
+    return 0;
+
+ERR:
+    safe_st_dict_destroy(dict);
+    safe_st_dict_frozen_destroy(fd);
+    safe_free(keys);
+    return -1;
+}
@@ -0,0 +1,240 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "st_dict.h"
+
+/*
+ * Compares the st_dict_hash_* functions on n-gram key sets: empty
+ * buckets, longest chain, probes per hit and seek throughput, all at
+ * load factor 1. Seeks stop after a second, so that hash functions with
+ * very long chains do not take forever.
+ *
+ * Key sets, with word ids drawn from a Zipf-like distribution over a
+ * 50k vocabulary:
+ *   bigram:  sign1 = w1, sign2 = w2
+ *   packed:  word ids in the high 16 bits, sign1 = w1 << 16, sign2 = w2 << 16
+ *   trigram: sign1 = w1 * 50000 + w2, the history id, sign2 = w3
+ *
+ * Usage: st-dict-hash-bench [num_keys]
+ */
+
+#define VOCAB_SIZE 50000
+
+typedef struct _hash_entry_t {
+    const char *name;
+    st_dict_hash_fun_t func;
+} hash_entry_t;
+
+static hash_entry_t g_hashes[] = {
+    {"simple", st_dict_hash_simple},
+    {"sign1l16", st_dict_hash_sign1l16},
+    {"sign1", st_dict_hash_sign1},
+    {"murmur", st_dict_hash_murmur},
+    {"wy", st_dict_hash_wy},
+    {"xxh3", st_dict_hash_xxh3},
+    {"auto", st_dict_hash_auto},
+};
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned int zipf_word()
+{
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return (unsigned int)(VOCAB_SIZE * pow(u, 2.0));
+}
+
+/* distinct keys of one kind, made with a scratch dict. */
+static int make_keys(st_dict_node_t *keys, int n, int kind)
+{
+    st_dict_t *seen;
+    st_dict_node_t node;
+    unsigned int w1, w2, w3;
+    int num;
+
+    seen = st_dict_create(n, n, st_dict_hash_murmur, NULL, false);
+    if (seen == NULL) {
+        return -1;
+    }
+
+    srand(kind + 1);
+    num = 0;
+    while (num < n) {
+        w1 = zipf_word();
+        w2 = zipf_word();
+        w3 = zipf_word();
+        switch (kind) {
+            case 0:
+                node.sign1 = w1 + 1;
+                node.sign2 = w2;
+                break;
+            case 1:
+                node.sign1 = (w1 + 1) << 16;
+                node.sign2 = w2 << 16;
+                break;
+            default:
+                node.sign1 = w1 * VOCAB_SIZE + w2 + 1;
+                node.sign2 = w3;
+                break;
+        }
+        node.uint1 = num;
+        if (st_dict_seek(seen, &node, NULL) == 0) {
+            continue;
+        }
+        if (st_dict_add(seen, &node, NULL) < 0) {
+            safe_st_dict_destroy(seen);
+            return -1;
+        }
+        keys[num++] = node;
+    }
+
+    safe_st_dict_destroy(seen);
+    return 0;
+}
+
+static int run(st_dict_node_t *keys, int n, hash_entry_t *hash)
+{
+    st_dict_t *dict = NULL;
+    st_dict_stats_t stats;
+    st_dict_node_t node;
+    st_dict_id_t b;
+    st_dict_id_t id;
+    double len;
+    double t;
+    double probes;
+    int found;
+    int num;
+    int i;
+
+    dict = st_dict_create(n, n, hash->func, NULL, false);
+    if (dict == NULL) {
+        fprintf(stderr, "Failed to st_dict_create.\n");
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        if (st_dict_add_no_seek(dict, keys + i) < 0) {
+            fprintf(stderr, "Failed to st_dict_add_no_seek.\n");
+            goto ERR;
+        }
+    }
+
+    found = 0;
+    num = 0;
+    t = now();
+    while (num < n && now() - t < 1.0) {
+        for (i = num; i < min(num + 1024, n); i++) {
+            node = keys[i];
+            found += st_dict_seek(dict, &node, NULL) == 0;
+        }
+        num = i;
+    }
+    t = now() - t;
+    if (found != num) {
+        fprintf(stderr, "Wrong number of found keys[%d].\n", found);
+        goto ERR;
+    }
+
+    if (st_dict_stats(dict, &stats) < 0) {
+        fprintf(stderr, "Failed to st_dict_stats.\n");
+        goto ERR;
+    }
+    /* a hit on the i-th node of a chain takes i probes. */
+    probes = 0.0;
+    for (b = 0; b < dict->hash_num; b++) {
+        len = 0;
+        if (dict->first_level_node[b].sign1 != 0
+                || dict->first_level_node[b].sign2 != 0) {
+            len = 1;
+            id = dict->first_level_node[b].next;
+            while (id != ST_DICT_BAD_NODE) {
+                len++;
+                id = dict->node_pool[id].next;
+            }
+        }
+        probes += len * (len + 1) / 2;
+    }
+    printf("  %-10s empty %5.1f%%  max chain %6lu  probes/hit %6.2f"
+            "  %6.2f Mops/s\n", hash->name, stats.empty_ratio * 100,
+            (unsigned long)stats.max_chain_len, probes / n, num / t / 1e6);
+
+    safe_st_dict_destroy(dict);
+    return 0;
+
+ERR:
+    safe_st_dict_destroy(dict);
+    return -1;
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *kinds[] = {"bigram", "packed", "trigram"};
+    st_dict_node_t *keys = NULL;
+    int kind;
+    int n;
+    int h;
+
+    n = argc > 1 ? atoi(argv[1]) : 500000;
+    if (n <= 0) {
+        fprintf(stderr, "Usage: %s [num_keys]\n", argv[0]);
+        return -1;
+    }
+
+    keys = (st_dict_node_t *)malloc(sizeof(st_dict_node_t) * n);
+    if (keys == NULL) {
+        fprintf(stderr, "Failed to alloc keys.\n");
+        return -1;
+    }
+
+    for (kind = 0; kind < 3; kind++) {
+        if (make_keys(keys, n, kind) < 0) {
+            fprintf(stderr, "Failed to make_keys.\n");
+            goto ERR;
+        }
+        printf("%s, %d keys:\n", kinds[kind], n);
+        for (h = 0; h < sizeof(g_hashes) / sizeof(g_hashes[0]); h++) {
+            if (run(keys, n, g_hashes + h) < 0) {
+                goto ERR;
+            }
+        }
+    }
+
+    safe_free(keys);
+    return 0;
+
+ERR:
+    safe_free(keys);
+    return -1;
+}
@@ -0,0 +1,173 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "st_dict.h"
+#include "st_dict_oa.h"
+
+/*
+ * Compares st_dict and st_dict_oa on bigram-like keys: add, seek of
+ * present keys and seek of absent keys, in million operations per second.
+ *
+ * Usage: st-dict-oa-bench [num_keys]
+ */
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* word ids of a zipf-ish vocabulary packed into the signs. */
+static void make_keys(st_dict_node_t *keys, int n, unsigned int seed)
+{
+    int i;
+
+    srand(seed);
+    for (i = 0; i < n; i++) {
+        keys[i].sign1 = (unsigned int)(rand() % 50000) + 1;
+        keys[i].sign2 = (unsigned int)i;
+        keys[i].uint1 = i;
+    }
+}
+
+static void report(const char *name, int n, double t)
+{
+    printf("  %-16s %8.3fs %8.2f Mops/s\n", name, t, n / t / 1e6);
+}
+
+int main(int argc, const char *argv[])
+{
+    st_dict_t *dict = NULL;
+    st_dict_oa_t *oa = NULL;
+    st_dict_node_t *keys = NULL;
+    st_dict_node_t *misses = NULL;
+    st_dict_node_t node;
+    double t;
+    int found;
+    int n;
+    int i;
+
+    n = argc > 1 ? atoi(argv[1]) : 2000000;
+    if (n <= 0) {
+        fprintf(stderr, "Usage: %s [num_keys]\n", argv[0]);
+        return -1;
+    }
+
+    keys = (st_dict_node_t *)malloc(sizeof(st_dict_node_t) * n);
+    misses = (st_dict_node_t *)malloc(sizeof(st_dict_node_t) * n);
+    if (keys == NULL || misses == NULL) {
+        fprintf(stderr, "Failed to alloc keys.\n");
+        goto ERR;
+    }
+    make_keys(keys, n, 1);
+    make_keys(misses, n, 2);
+    for (i = 0; i < n; i++) {
+        misses[i].sign2 += n;
+    }
+
+    printf("%d keys\n", n);
+
+    printf("st_dict:\n");
+    dict = st_dict_create(n, n, NULL, NULL, false);
+    if (dict == NULL) {
+        fprintf(stderr, "Failed to st_dict_create.\n");
+        goto ERR;
+    }
+    t = now();
+    for (i = 0; i < n; i++) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed to st_dict_add.\n");
+            goto ERR;
+        }
+    }
+    report("add", n, now() - t);
+    found = 0;
+    t = now();
+    for (i = 0; i < n; i++) {
+        node = keys[i];
+        found += st_dict_seek(dict, &node, NULL) == 0;
+    }
+    report("seek hit", n, now() - t);
+    t = now();
+    for (i = 0; i < n; i++) {
+        node = misses[i];
+        found += st_dict_seek(dict, &node, NULL) == 0;
+    }
+    report("seek miss", n, now() - t);
+    if (found != n) {
+        fprintf(stderr, "Wrong number of found keys[%d].\n", found);
+        goto ERR;
+    }
+
+    printf("st_dict_oa:\n");
+    oa = st_dict_oa_create(n, NULL);
+    if (oa == NULL) {
+        fprintf(stderr, "Failed to st_dict_oa_create.\n");
+        goto ERR;
+    }
+    t = now();
+    for (i = 0; i < n; i++) {
+        if (st_dict_oa_add(oa, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed to st_dict_oa_add.\n");
+            goto ERR;
+        }
+    }
+    report("add", n, now() - t);
+    found = 0;
+    t = now();
+    for (i = 0; i < n; i++) {
+        node = keys[i];
+        found += st_dict_oa_seek(oa, &node, NULL) == 0;
+    }
+    report("seek hit", n, now() - t);
+    t = now();
+    for (i = 0; i < n; i++) {
+        node = misses[i];
+        found += st_dict_oa_seek(oa, &node, NULL) == 0;
+    }
+    report("seek miss", n, now() - t);
+    if (found != n) {
+        fprintf(stderr, "Wrong number of found keys[%d].\n", found);
+        goto ERR;
+    }
+
+    safe_st_dict_destroy(dict);
+    safe_st_dict_oa_destroy(oa);
+    safe_free(keys);
+    safe_free(misses);
+    return 0;
+
+ERR:
+    safe_st_dict_destroy(dict);
+    safe_st_dict_oa_destroy(oa);
+    safe_free(keys);
+    safe_free(misses);
+    return -1;
+}
@@ -0,0 +1,149 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+/*
+ * The seek counters are compiled in only with _ST_DICT_STATS_, so this
+ * test builds its own copy of st_dict with the flag on.
+ */
+#ifndef _ST_DICT_STATS_
+#define _ST_DICT_STATS_
+#endif
+#include "st_dict.c"
+
+#define NUM_KEYS 3
+
+/* puts every node in one chain, so probes are known in advance. */
+static st_dict_id_t one_bucket_hash(st_dict_t *wd, st_dict_node_t *pnode)
+{
+    return 0;
+}
+
+static int unit_test_st_dict_counter()
+{
+    st_dict_t *dict = NULL;
+    st_dict_stats_t stats;
+    st_dict_node_t node;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict counters...\n");
+
+    dict = st_dict_create(1, NUM_KEYS, one_bucket_hash, NULL, false);
+    assert(dict != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        node.sign1 = i + 1;
+        node.sign2 = i + 1;
+        node.uint1 = i;
+        assert(st_dict_add(dict, &node, NULL) == 0);
+    }
+    memset(&dict->counter, 0, sizeof(dict->counter));
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* the i-th node of the chain takes i probes, whatever the order. */
+    for (i = 0; i < NUM_KEYS; i++) {
+        node.sign1 = i + 1;
+        node.sign2 = i + 1;
+        if (st_dict_seek(dict, &node, NULL) < 0 || node.uint1 != i) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (dict->counter.seek_num != NUM_KEYS
+            || dict->counter.hit_num != NUM_KEYS
+            || dict->counter.probe_num != NUM_KEYS * (NUM_KEYS + 1) / 2) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* a miss walks the whole chain. */
+    node.sign1 = NUM_KEYS + 1;
+    node.sign2 = NUM_KEYS + 1;
+    if (st_dict_seek(dict, &node, NULL) >= 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    if (dict->counter.seek_num != NUM_KEYS + 1
+            || dict->counter.hit_num != NUM_KEYS
+            || dict->counter.probe_num != NUM_KEYS * (NUM_KEYS + 3) / 2) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (st_dict_stats(dict, &stats) < 0
+            || stats.counter.seek_num != NUM_KEYS + 1
+            || stats.hit_ratio != (float)NUM_KEYS / (NUM_KEYS + 1)
+            || stats.probes_per_seek != (float)(NUM_KEYS * (NUM_KEYS + 3) / 2)
+                / (NUM_KEYS + 1)
+            || stats.max_chain_len != NUM_KEYS
+            || stats.chain_hist[NUM_KEYS] != 1) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_destroy(dict);
+    return 0;
+
+FAILED:
+    safe_st_dict_destroy(dict);
+    return -1;
+}
+
+static int run_all_tests()
+{
+    int ret = 0;
+
+    if (unit_test_st_dict_counter() != 0) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int main(int argc, const char *argv[])
+{
+    int ret;
+
+    fprintf(stderr, "Start testing...\n");
+    ret = run_all_tests();
+    if (ret != 0) {
+        fprintf(stderr, "Tests failed.\n");
+    } else {
+        fprintf(stderr, "Tests succeeded.\n");
+    }
+
+    return ret;
+}
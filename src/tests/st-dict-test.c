@@ -0,0 +1,2085 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "st_rand.h"
+#include "st_dict.h"
+#include "st_dict_oa.h"
+#include "st_dict_frozen.h"
+#include "st_dict_acc.h"
+#include "st_dict_wide.h"
+#include "st_dict64.h"
+
+#define NUM_KEYS 100000
+
+static st_dict_node_t keys[NUM_KEYS];
+
+/* n-gram like keys: sign1 is a history id, sign2 a word id. */
+static void make_keys(unsigned int seed)
+{
+    int i;
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        keys[i].sign1 = i / 64 + 1;
+        keys[i].sign2 = (i % 64) * 7919 + st_rand_r(&seed) % 7919;
+        keys[i].uint1 = i;
+        keys[i].next = ST_DICT_BAD_NODE;
+    }
+}
+
+static int sum_trav(st_dict_node_t *p, void *arg)
+{
+    *((unsigned long *)arg) += p->uint1;
+    return 0;
+}
+
+static int add_trav(st_dict_node_t *p, void *arg)
+{
+    if (st_dict_add((st_dict_t *)arg, p, NULL) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int inc_update(st_dict_node_t *node, float data)
+{
+    node->uint1++;
+    return 0;
+}
+
+static int check_dict(st_dict_t *dict)
+{
+    st_dict_node_t node;
+    int i;
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        node.uint1 = -1;
+        if (st_dict_seek(dict, &node, NULL) < 0) {
+            return -1;
+        }
+        if (node.uint1 != keys[i].uint1) {
+            return -1;
+        }
+    }
+
+    node.sign1 = NUM_KEYS;
+    node.sign2 = 7919 * 64;
+    if (st_dict_seek(dict, &node, NULL) == 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int remove_even(st_dict_t *dict)
+{
+    st_dict_node_t node;
+    int i;
+
+    for (i = 0; i < NUM_KEYS; i += 2) {
+        node = keys[i];
+        node.uint1 = -1;
+        if (st_dict_remove(dict, &node, NULL) < 0) {
+            return -1;
+        }
+        if (node.uint1 != keys[i].uint1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#define BATCH_SIZE 1000
+
+static int unit_test_st_dict()
+{
+    st_dict_t *dict = NULL;
+    st_dict_t *dup = NULL;
+    st_dict_node_t node;
+    st_dict_node_t batch[BATCH_SIZE];
+    unsigned char mask[(BATCH_SIZE + 7) / 8];
+    st_dict_id_t cur_index;
+    st_dict_stats_t stats;
+    unsigned long sum;
+    unsigned long ref_sum;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict...\n");
+
+    make_keys(1);
+    ref_sum = 0;
+    for (i = 0; i < NUM_KEYS; i++) {
+        ref_sum += keys[i].uint1;
+    }
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    dict = st_dict_create(NUM_KEYS / 4, NUM_KEYS / 4, NULL, NULL, true);
+    assert(dict != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (dict->node_num != NUM_KEYS || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    if (st_dict_add(dict, keys, NULL) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    sum = 0;
+    if (st_dict_traverse(dict, sum_trav, &sum) < 0 || sum != ref_sum) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (st_dict_stats(dict, &stats) < 0 || stats.node_num != NUM_KEYS
+            || stats.chain_hist[0] != stats.empty_num
+            || stats.cur_index != NUM_KEYS - (dict->hash_num - stats.empty_num)
+            || stats.free_num != 0 || stats.max_chain_len == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    sum = 0;
+    for (i = 0; i <= ST_DICT_STATS_MAX_CHAIN; i++) {
+        sum += stats.chain_hist[i];
+    }
+    if (sum != dict->hash_num) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+#ifdef _ST_TEST_DEBUG_
+    st_dict_stats_print(&stats, stderr);
+#endif
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    dup = st_dict_dup(dict);
+    if (dup == NULL || check_dict(dup) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict_destroy(dup);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* odd entries are missing keys. */
+    for (i = 0; i < BATCH_SIZE; i++) {
+        batch[i] = keys[i * 97];
+        batch[i].uint1 = -1;
+        if (i % 2 == 1) {
+            batch[i].sign2 = 7919 * 64 + i;
+        }
+    }
+    if (st_dict_seek_batch(dict, batch, BATCH_SIZE, mask) != BATCH_SIZE / 2) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < BATCH_SIZE; i++) {
+        if (((mask[i / 8] >> (i % 8)) & 1) != (i % 2 == 0)) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        if (i % 2 == 0 && batch[i].uint1 != keys[i * 97].uint1) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (remove_even(dict) < 0 || dict->node_num != NUM_KEYS / 2) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    node = keys[0];
+    if (st_dict_remove(dict, &node, NULL) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        if ((st_dict_seek(dict, &node, NULL) == 0) != (i % 2 == 1)) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    /* freed slots are reused. */
+    cur_index = dict->cur_index;
+    for (i = 0; i < NUM_KEYS; i += 2) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (dict->cur_index != cur_index || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (remove_even(dict) < 0 || st_dict_compact(dict) < 0
+            || dict->cur_index >= cur_index
+            || dict->free_index != ST_DICT_BAD_NODE) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i += 2) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (dict->node_num != NUM_KEYS || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        if (st_dict_update(dict, &node, NULL, inc_update) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    sum = 0;
+    if (st_dict_traverse(dict, sum_trav, &sum) < 0
+            || sum != ref_sum + NUM_KEYS) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    sum = 0;
+    if (st_dict_clear(dict, sum_trav, &sum) < 0
+            || sum != ref_sum + NUM_KEYS || dict->node_num != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    node = keys[0];
+    if (st_dict_seek(dict, &node, NULL) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_destroy(dict);
+    return 0;
+
+FAILED:
+    safe_st_dict_destroy(dup);
+    safe_st_dict_destroy(dict);
+    return -1;
+}
+
+static int unit_test_st_dict_rehash()
+{
+    st_dict_t *dict = NULL;
+    st_dict_t *loaded = NULL;
+    st_dict_node_t node;
+    st_dict_node_t *head;
+    st_dict_id_t key;
+    st_dict_id_t prev;
+    FILE *fp = NULL;
+    unsigned long sum;
+    unsigned long ref_sum;
+    bool full;
+    int i;
+    int j;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict rehash...\n");
+
+    make_keys(3);
+    ref_sum = 0;
+    for (i = 0; i < NUM_KEYS; i++) {
+        ref_sum += keys[i].uint1;
+    }
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    dict = st_dict_create(16, 1024, NULL, NULL, true);
+    assert(dict != NULL);
+    if (st_dict_set_rehash(dict, 1.0, 0) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (dict->hash_num < NUM_KEYS / 2 || dict->node_num != NUM_KEYS
+            || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* force a migration to be in progress. */
+    while (dict->old_first_level_node == NULL) {
+        keys[0].sign1 = NUM_KEYS + dict->node_num;
+        if (st_dict_add_no_seek(dict, keys) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        ref_sum += keys[0].uint1;
+    }
+    sum = 0;
+    if (st_dict_traverse(dict, sum_trav, &sum) < 0 || sum != ref_sum) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fp = tmpfile();
+    assert(fp != NULL);
+    if (st_dict_save(dict, fp) < 0 || dict->old_first_level_node != NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    rewind(fp);
+    loaded = st_dict_load_from_bin(fp);
+    if (loaded == NULL || loaded->node_num != dict->node_num) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    sum = 0;
+    if (st_dict_traverse(loaded, sum_trav, &sum) < 0 || sum != ref_sum) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_fclose(fp);
+    safe_st_dict_destroy(loaded);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    while (dict->old_first_level_node == NULL) {
+        keys[0].sign1 = NUM_KEYS + dict->node_num;
+        if (st_dict_add_no_seek(dict, keys) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        ref_sum += keys[0].uint1;
+    }
+    sum = 0;
+    if (st_dict_clear(dict, sum_trav, &sum) < 0 || sum != ref_sum
+            || dict->node_num != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /*
+     * Heads migrated from a crowded old table fill most of clear_nodes,
+     * and a head emptied and refilled is listed again on every re-add.
+     */
+    safe_st_dict_destroy(dict);
+    dict = st_dict_create(16, 1024, st_dict_hash_murmur, NULL, true);
+    assert(dict != NULL);
+    if (st_dict_set_rehash(dict, 8.0, 1) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        assert(st_dict_add(dict, keys + i, NULL) == 0);
+    }
+    node = keys[0];
+    j = 0;
+    while (dict->old_first_level_node == NULL) {
+        node.sign1 = NUM_KEYS + j++;
+        assert(st_dict_add_no_seek(dict, &node) == 0);
+    }
+    full = false;
+    while (dict->old_first_level_node != NULL) {
+        /* look for a key alone in an already migrated bucket. */
+        node.sign1 = NUM_KEYS + j++;
+        key = dict->hash_func(dict, &node);
+        head = dict->first_level_node + key;
+        if ((key & (dict->old_hash_num - 1)) >= dict->rehash_index
+                || head->sign1 != 0 || head->sign2 != 0) {
+            /* adding it moves the migration on. */
+            assert(st_dict_add_no_seek(dict, &node) == 0);
+            continue;
+        }
+        assert(st_dict_add_no_seek(dict, &node) == 0);
+        while (dict->old_first_level_node != NULL) {
+            prev = dict->clear_node_num;
+            if (st_dict_remove(dict, &node, NULL) < 0
+                    || st_dict_add_no_seek(dict, &node) < 0
+                    || dict->clear_node_num > dict->hash_num) {
+                fprintf(stderr, "Failed\n");
+                goto FAILED;
+            }
+            /* only a rebuild of a full list makes it shrink. */
+            if (dict->clear_node_num < prev) {
+                full = true;
+            }
+        }
+    }
+    if (!full || check_dict(dict) < 0
+            || st_dict_clear(dict, NULL, NULL) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < dict->hash_num; i++) {
+        if (dict->first_level_node[i].sign1 != 0
+                || dict->first_level_node[i].sign2 != 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_destroy(dict);
+    return 0;
+
+FAILED:
+    safe_fclose(fp);
+    safe_st_dict_destroy(loaded);
+    safe_st_dict_destroy(dict);
+    return -1;
+}
+
+/* writes the layout used before st_dict_save was versioned. */
+/* the legacy format always stored 32-bit ids. */
+static void save_legacy_id(st_dict_id_t id, FILE *fp)
+{
+    uint32_t v = (uint32_t)id;
+
+    fwrite(&v, sizeof(uint32_t), 1, fp);
+}
+
+static void save_legacy_nodes(st_dict_node_t *nodes, st_dict_id_t n,
+        FILE *fp)
+{
+    st_dict_id_t i;
+
+    for (i = 0; i < n; i++) {
+        fwrite(&nodes[i].sign1, sizeof(uint32_t), 1, fp);
+        fwrite(&nodes[i].sign2, sizeof(uint32_t), 1, fp);
+        fwrite(&nodes[i].uint1, sizeof(uint32_t), 1, fp);
+        save_legacy_id(nodes[i].next, fp);
+    }
+}
+
+static void save_legacy(st_dict_t *dict, FILE *fp)
+{
+    save_legacy_id(dict->hash_num, fp);
+    save_legacy_id(dict->realloc_node_num, fp);
+    save_legacy_id(dict->cur_index, fp);
+    save_legacy_id(dict->max_pool_num, fp);
+    save_legacy_id(dict->node_num, fp);
+    save_legacy_id(dict->addr_mask, fp);
+    save_legacy_nodes(dict->first_level_node, dict->hash_num, fp);
+    save_legacy_nodes(dict->node_pool, dict->max_pool_num, fp);
+    fflush(fp);
+}
+
+static int unit_test_st_dict_mmap()
+{
+    st_dict_t *dict = NULL;
+    st_dict_t *loaded = NULL;
+    st_dict_t *dup = NULL;
+    FILE *fp = NULL;
+    char fname[] = "/tmp/st-dict-XXXXXX";
+    int fd = -1;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict mmap...\n");
+
+    make_keys(4);
+
+    dict = st_dict_create(NUM_KEYS / 2, NUM_KEYS, st_dict_hash_sign1l16,
+            NULL, false);
+    assert(dict != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        assert(st_dict_add(dict, keys + i, NULL) == 0);
+    }
+
+    fd = mkstemp(fname);
+    assert(fd >= 0);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = fdopen(fd, "w+");
+    assert(fp != NULL);
+    fd = -1;
+    /* dict does not start at a page boundary. */
+    fwrite("st_dict", 1, 7, fp);
+    if (st_dict_save(dict, fp) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    loaded = st_dict_mmap(fileno(fp), 7);
+    if (loaded == NULL || !loaded->readonly
+            || loaded->hash_func != st_dict_hash_sign1l16
+            || loaded->node_num != NUM_KEYS || check_dict(loaded) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    if (st_dict_add(loaded, &dict->first_level_node[0], NULL) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    dup = st_dict_dup(loaded);
+    if (dup == NULL || dup->readonly || check_dict(dup) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict_destroy(dup);
+    safe_st_dict_destroy(loaded);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fseek(fp, 7, SEEK_SET);
+    loaded = st_dict_load_from_bin(fp);
+    if (loaded == NULL || loaded->readonly || check_dict(loaded) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict_destroy(loaded);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    safe_fclose(fp);
+    fp = fopen(fname, "w+");
+    assert(fp != NULL);
+    /* legacy files always used st_dict_hash_simple. */
+    safe_st_dict_destroy(dict);
+    dict = st_dict_create(NUM_KEYS / 2, NUM_KEYS, NULL, NULL, false);
+    assert(dict != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        assert(st_dict_add(dict, keys + i, NULL) == 0);
+    }
+    save_legacy(dict, fp);
+    rewind(fp);
+    loaded = st_dict_load_from_bin(fp);
+    if (loaded == NULL || check_dict(loaded) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict_destroy(loaded);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* ids of the other size are converted on load, but not mapped. */
+    rewind(fp);
+    if (st_dict_save_as(dict, fp, 12 - sizeof(st_dict_id_t)) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    loaded = st_dict_mmap(fileno(fp), 0);
+    if (loaded != NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    rewind(fp);
+    loaded = st_dict_load_from_bin(fp);
+    if (loaded == NULL || loaded->node_num != NUM_KEYS
+            || check_dict(loaded) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict_destroy(loaded);
+    if (st_dict_save_as(dict, fp, 2) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_fclose(fp);
+    unlink(fname);
+    safe_st_dict_destroy(dict);
+    return 0;
+
+FAILED:
+    safe_fclose(fp);
+    unlink(fname);
+    safe_st_dict_destroy(dup);
+    safe_st_dict_destroy(loaded);
+    safe_st_dict_destroy(dict);
+    return -1;
+}
+
+/* every key of dict holds its uint1 plus inc. */
+static int check_inc(st_dict_t *dict, unsigned int inc)
+{
+    st_dict_node_t node;
+    int i;
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        if (st_dict_seek(dict, &node, NULL) < 0
+                || node.uint1 != keys[i].uint1 + inc) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int unit_test_st_dict_snapshot()
+{
+    st_dict_t *dict = NULL;
+    st_dict_t *loaded = NULL;
+    st_dict_t *snap1 = NULL;
+    st_dict_t *snap2 = NULL;
+    st_dict_t *snap3 = NULL;
+    st_dict_node_t node;
+    FILE *fp = NULL;
+    void *map_addr;
+    unsigned long sums[3];
+    void *sum_args[2] = {sums + 1, sums + 2};
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict snapshot...\n");
+
+    make_keys(9);
+
+    dict = st_dict_create(NUM_KEYS / 2, NUM_KEYS / 4, st_dict_hash_murmur,
+            NULL, true);
+    assert(dict != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        assert(st_dict_add(dict, keys + i, NULL) == 0);
+    }
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    snap1 = st_dict_snapshot(dict);
+    if (snap1 == NULL || snap1->map_addr == NULL
+            || check_dict(snap1) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        if (st_dict_update(snap1, &node, NULL, inc_update) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (check_inc(snap1, 1) < 0 || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* unchanged dict is shared again, changed one is sealed afresh. */
+    map_addr = dict->map_addr;
+    snap2 = st_dict_snapshot(dict);
+    if (snap2 == NULL || dict->map_addr != map_addr) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        if (st_dict_update(dict, &node, NULL, inc_update) < 0
+                || st_dict_update(dict, &node, NULL, inc_update) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    snap3 = st_dict_snapshot(dict);
+    if (snap3 == NULL || check_inc(snap3, 2) < 0
+            || check_dict(snap2) < 0 || check_inc(snap1, 1) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (remove_even(snap2) < 0 || st_dict_compact(snap2) < 0
+            || snap2->node_num != NUM_KEYS / 2
+            || st_dict_clear(snap3, NULL, NULL) < 0
+            || snap3->node_num != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 1; i < NUM_KEYS; i += 2) {
+        node = keys[i];
+        if (st_dict_seek(snap2, &node, NULL) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (check_inc(dict, 2) < 0 || check_inc(snap1, 1) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict_destroy(snap1);
+    safe_st_dict_destroy(snap2);
+    safe_st_dict_destroy(snap3);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = tmpfile();
+    assert(fp != NULL);
+    if (st_dict_save(dict, fp) < 0 || fflush(fp) != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    loaded = st_dict_mmap(fileno(fp), 0);
+    safe_fclose(fp);
+    if (loaded == NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* traversing the read-only mapping keeps it shared. */
+    map_addr = loaded->map_addr;
+    sums[0] = sums[1] = sums[2] = 0;
+    if (st_dict_traverse(loaded, sum_trav, sums) < 0
+            || st_dict_traverse_parallel(loaded, sum_trav, sum_args, 2) < 0
+            || sums[0] != sums[1] + sums[2] || loaded->map_dirty) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    snap1 = st_dict_snapshot(loaded);
+    if (snap1 == NULL || snap1->readonly || loaded->map_addr != map_addr) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    /* grows node_pool out of the mapping. */
+    node.sign1 = NUM_KEYS;
+    node.sign2 = 7919 * 64;
+    node.uint1 = NUM_KEYS;
+    if (st_dict_add(snap1, &node, NULL) < 0
+            || check_inc(snap1, 2) < 0
+            || st_dict_seek(snap1, &node, NULL) < 0
+            || st_dict_seek(loaded, &node, NULL) == 0
+            || check_inc(loaded, 2) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict_destroy(snap1);
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_destroy(loaded);
+    safe_st_dict_destroy(dict);
+    return 0;
+
+FAILED:
+    safe_fclose(fp);
+    safe_st_dict_destroy(snap1);
+    safe_st_dict_destroy(snap2);
+    safe_st_dict_destroy(snap3);
+    safe_st_dict_destroy(loaded);
+    safe_st_dict_destroy(dict);
+    return -1;
+}
+
+static int unit_test_st_dict_frozen()
+{
+    st_dict_t *dict = NULL;
+    st_dict_frozen_t *fd = NULL;
+    st_dict_frozen_t *loaded = NULL;
+    st_dict_node_t node;
+    FILE *fp = NULL;
+    unsigned long sum;
+    unsigned long ref_sum;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict_frozen...\n");
+
+    make_keys(5);
+    ref_sum = 0;
+    for (i = 0; i < NUM_KEYS; i++) {
+        ref_sum += keys[i].uint1;
+    }
+
+    dict = st_dict_create(NUM_KEYS, NUM_KEYS, NULL, NULL, false);
+    assert(dict != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        assert(st_dict_add(dict, keys + i, NULL) == 0);
+    }
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fd = st_dict_freeze(dict);
+    if (fd == NULL || fd->node_num != NUM_KEYS) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        node.uint1 = -1;
+        if (st_dict_frozen_seek(fd, &node) < 0
+                || node.uint1 != keys[i].uint1) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        node.sign1 = keys[i].sign1 + NUM_KEYS;
+        node.sign2 = keys[i].sign2;
+        if (st_dict_frozen_seek(fd, &node) == 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    sum = 0;
+    if (st_dict_frozen_traverse(fd, sum_trav, &sum) < 0 || sum != ref_sum) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = tmpfile();
+    assert(fp != NULL);
+    if (st_dict_frozen_save(fd, fp) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    rewind(fp);
+    loaded = st_dict_frozen_load_from_bin(fp);
+    if (loaded == NULL || loaded->node_num != NUM_KEYS) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        if (st_dict_frozen_seek(loaded, &node) < 0
+                || node.uint1 != keys[i].uint1) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    safe_fclose(fp);
+    safe_st_dict_frozen_destroy(loaded);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    assert(st_dict_add_no_seek(dict, keys) == 0);
+    loaded = st_dict_freeze(dict);
+    if (loaded != NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* refused before any node is read, so the count alone is enough. */
+    safe_st_dict_destroy(dict);
+    dict = st_dict_create(1, 1, NULL, NULL, false);
+    assert(dict != NULL);
+    dict->node_num = (st_dict_id_t)ST_DICT_FROZEN_MAX_NODE_NUM + 1;
+    loaded = st_dict_freeze(dict);
+    dict->node_num = 0;
+    if (loaded != NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_frozen_destroy(fd);
+    safe_st_dict_destroy(dict);
+    return 0;
+
+FAILED:
+    safe_fclose(fp);
+    safe_st_dict_frozen_destroy(loaded);
+    safe_st_dict_frozen_destroy(fd);
+    safe_st_dict_destroy(dict);
+    return -1;
+}
+
+static int unit_test_st_dict_oa()
+{
+    st_dict_oa_t *oa = NULL;
+    st_dict_t *dict = NULL;
+    st_dict_node_t node;
+    unsigned long sum;
+    unsigned long ref_sum;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict_oa...\n");
+
+    make_keys(2);
+    ref_sum = 0;
+    for (i = 0; i < NUM_KEYS; i++) {
+        ref_sum += keys[i].uint1;
+    }
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* start small to exercise growing. */
+    oa = st_dict_oa_create(100, NULL);
+    assert(oa != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        if (st_dict_oa_add(oa, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (oa->node_num != NUM_KEYS) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        node.uint1 = -1;
+        if (st_dict_oa_seek(oa, &node, NULL) < 0
+                || node.uint1 != keys[i].uint1) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (st_dict_oa_add(oa, keys + 10, NULL) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    node.sign1 = NUM_KEYS;
+    node.sign2 = 7919 * 64;
+    if (st_dict_oa_seek(oa, &node, NULL) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    dict = st_dict_create(NUM_KEYS, NUM_KEYS, NULL, NULL, false);
+    assert(dict != NULL);
+    if (st_dict_oa_traverse(oa, add_trav, dict) < 0
+            || dict->node_num != NUM_KEYS || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict_destroy(dict);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        if (st_dict_oa_update(oa, &node, NULL, inc_update) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    sum = 0;
+    if (st_dict_oa_clear(oa, sum_trav, &sum) < 0
+            || sum != ref_sum + NUM_KEYS || oa->node_num != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    node = keys[0];
+    if (st_dict_oa_seek(oa, &node, NULL) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_oa_destroy(oa);
+    return 0;
+
+FAILED:
+    safe_st_dict_destroy(dict);
+    safe_st_dict_oa_destroy(oa);
+    return -1;
+}
+
+#define NUM_READERS 4
+
+typedef struct _reader_args_t {
+    st_dict_t *dict;
+    int *stop;
+    int err;
+} reader_args_t;
+
+/* keys in the first half exist from start, the others may appear. */
+static void* reader_thread(void *arg)
+{
+    reader_args_t *ra = (reader_args_t *)arg;
+    st_dict_node_t node;
+    unsigned int seed = 3;
+    int i;
+
+    while (!__atomic_load_n(ra->stop, __ATOMIC_RELAXED)) {
+        i = st_rand_r(&seed) % NUM_KEYS;
+        node = keys[i];
+        node.uint1 = -1;
+        if (st_dict_seek(ra->dict, &node, NULL) < 0) {
+            if (i < NUM_KEYS / 2) {
+                ra->err = 1;
+            }
+        } else if (node.uint1 != keys[i].uint1) {
+            ra->err = 1;
+        }
+    }
+
+    return NULL;
+}
+
+typedef struct _wide_value_t {
+    float prob;
+    float backoff;
+    uint64_t offset;
+} wide_value_t;
+
+static void wide_key(int i, st_dict_wide_key_t *key, wide_value_t *value)
+{
+    key->sign1 = keys[i].sign1;
+    key->sign2 = keys[i].sign2;
+    value->prob = (float)i;
+    value->backoff = -(float)i;
+    value->offset = ((uint64_t)i) << 32;
+}
+
+static int wide_add_update(void *value, const void *data)
+{
+    ((wide_value_t *)value)->offset += ((const wide_value_t *)data)->offset;
+    return 0;
+}
+
+static int wide_sum_trav(st_dict_wide_key_t *key, void *value, void *args)
+{
+    *((uint64_t *)args) += ((wide_value_t *)value)->offset >> 32;
+    return 0;
+}
+
+/* every key holds its value, with offset increased by inc. */
+static int check_wide(st_dict_wide_t *wd, uint64_t inc)
+{
+    st_dict_wide_key_t key;
+    wide_value_t value;
+    wide_value_t *p;
+    int i;
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        wide_key(i, &key, &value);
+        p = (wide_value_t *)st_dict_wide_seek(wd, &key);
+        if (p == NULL || p->prob != value.prob
+                || p->backoff != value.backoff
+                || p->offset != value.offset + inc) {
+            return -1;
+        }
+    }
+
+    key.sign1 = NUM_KEYS;
+    key.sign2 = 7919 * 64;
+    if (st_dict_wide_seek(wd, &key) != NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int unit_test_st_dict_wide()
+{
+    st_dict_wide_t *wd = NULL;
+    st_dict_wide_t *loaded = NULL;
+    st_dict_wide_key_t key;
+    wide_value_t value;
+    FILE *fp = NULL;
+    uint64_t sum;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict_wide...\n");
+
+    make_keys(10);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* starts small to grow several times. */
+    wd = st_dict_wide_create(100, sizeof(wide_value_t));
+    assert(wd != NULL);
+    if ((uintptr_t)wd->values % ST_DICT_WIDE_ALIGN != 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        wide_key(i, &key, &value);
+        if (st_dict_wide_add(wd, &key, &value) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    wide_key(0, &key, &value);
+    if (wd->node_num != NUM_KEYS || st_dict_wide_add(wd, &key, &value) == 0
+            || check_wide(wd, 0) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    for (i = 0; i < NUM_KEYS; i++) {
+        wide_key(i, &key, &value);
+        value.offset = 1;
+        if (st_dict_wide_update(wd, &key, &value, wide_add_update) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (check_wide(wd, 1) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    sum = 0;
+    if (st_dict_wide_traverse(wd, wide_sum_trav, &sum) < 0
+            || sum != (uint64_t)NUM_KEYS * (NUM_KEYS - 1) / 2) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    fp = tmpfile();
+    assert(fp != NULL);
+    if (st_dict_wide_save(wd, fp) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    rewind(fp);
+    loaded = st_dict_wide_load_from_bin(fp);
+    if (loaded == NULL || loaded->value_size != sizeof(wide_value_t)
+            || loaded->node_num != NUM_KEYS || check_wide(loaded, 1) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_fclose(fp);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    wide_key(0, &key, &value);
+    if (st_dict_wide_clear(wd) < 0 || wd->node_num != 0
+            || st_dict_wide_seek(wd, &key) != NULL
+            || st_dict_wide_add(wd, &key, &value) < 0
+            || st_dict_wide_seek(wd, &key) == NULL) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_wide_destroy(loaded);
+    safe_st_dict_wide_destroy(wd);
+    return 0;
+
+FAILED:
+    safe_fclose(fp);
+    safe_st_dict_wide_destroy(loaded);
+    safe_st_dict_wide_destroy(wd);
+    return -1;
+}
+
+static int unit_test_st_dict_concurrent()
+{
+    st_dict_t *dict = NULL;
+    pthread_t pts[NUM_READERS];
+    reader_args_t ras[NUM_READERS];
+    int stop = 0;
+    int n = 0;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict concurrent...\n");
+
+    make_keys(5);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* small realloc_node_num, so that node_pool grows under readers. */
+    dict = st_dict_create(NUM_KEYS / 4, 1000, NULL, NULL, true);
+    assert(dict != NULL);
+    if (st_dict_set_rehash(dict, 1.0, 0) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS / 2; i++) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (st_dict_set_concurrent(dict, true) < 0
+            || dict->old_first_level_node != NULL
+            || st_dict_set_rehash(dict, 1.0, 0) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    for (n = 0; n < NUM_READERS; n++) {
+        ras[n].dict = dict;
+        ras[n].stop = &stop;
+        ras[n].err = 0;
+        if (pthread_create(pts + n, NULL, reader_thread, ras + n) != 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    for (i = NUM_KEYS / 2; i < NUM_KEYS; i++) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < n; i++) {
+        pthread_join(pts[i], NULL);
+        if (ras[i].err) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    n = 0;
+    if (dict->node_num != NUM_KEYS || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (st_dict_set_concurrent(dict, false) < 0 || dict->sync != NULL
+            || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_destroy(dict);
+    return 0;
+
+FAILED:
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < n; i++) {
+        pthread_join(pts[i], NULL);
+    }
+    safe_st_dict_destroy(dict);
+    return -1;
+}
+
+#define NUM_THREADS 4
+
+typedef struct _visit_t {
+    st_dict_node_t *nodes;
+    int n;
+} visit_t;
+
+static int visit_trav(st_dict_node_t *p, void *arg)
+{
+    visit_t *v = (visit_t *)arg;
+
+    v->nodes[v->n++] = *p;
+    return 0;
+}
+
+/* parallel traversal visits nodes in the order of the serial one. */
+static int check_traverse_parallel(st_dict_t *dict)
+{
+    visit_t serial;
+    visit_t vs[NUM_THREADS];
+    void *args[NUM_THREADS];
+    int ret = -1;
+    int i;
+    int k;
+
+    memset(vs, 0, sizeof(vs));
+    serial.n = 0;
+    serial.nodes = (st_dict_node_t *)malloc(sizeof(st_dict_node_t)
+            * NUM_KEYS);
+    assert(serial.nodes != NULL);
+    for (i = 0; i < NUM_THREADS; i++) {
+        vs[i].nodes = (st_dict_node_t *)malloc(sizeof(st_dict_node_t)
+                * NUM_KEYS);
+        assert(vs[i].nodes != NULL);
+        args[i] = vs + i;
+    }
+
+    if (st_dict_traverse(dict, visit_trav, &serial) < 0
+            || st_dict_traverse_parallel(dict, visit_trav, args,
+                NUM_THREADS) < 0) {
+        goto RET;
+    }
+
+    k = 0;
+    for (i = 0; i < NUM_THREADS; i++) {
+        if (k + vs[i].n > serial.n || memcmp(serial.nodes + k, vs[i].nodes,
+                    sizeof(st_dict_node_t) * vs[i].n) != 0) {
+            goto RET;
+        }
+        k += vs[i].n;
+    }
+    if (k != serial.n) {
+        goto RET;
+    }
+    ret = 0;
+
+RET:
+    for (i = 0; i < NUM_THREADS; i++) {
+        safe_free(vs[i].nodes);
+    }
+    safe_free(serial.nodes);
+    return ret;
+}
+
+static int unit_test_st_dict_bulk()
+{
+    st_dict_t *serial = NULL;
+    st_dict_t *dict = NULL;
+    int i;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict bulk...\n");
+
+    make_keys(6);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    serial = st_dict_create(NUM_KEYS / 4, 1000, NULL, NULL, true);
+    dict = st_dict_create(NUM_KEYS / 4, 1000, NULL, NULL, true);
+    assert(serial != NULL && dict != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        if (st_dict_add_no_seek(serial, keys + i) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    for (i = 0; i < 1000; i++) {
+        if (st_dict_add_no_seek(dict, keys + i) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (st_dict_add_bulk(dict, keys + 1000, NUM_KEYS - 1000,
+                NUM_THREADS) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    if (dict->node_num != serial->node_num
+            || dict->cur_index != serial->cur_index
+            || dict->max_pool_num != serial->max_pool_num
+            || dict->clear_node_num != serial->clear_node_num
+            || memcmp(dict->first_level_node, serial->first_level_node,
+                sizeof(st_dict_node_t) * dict->hash_num) != 0
+            || memcmp(dict->node_pool, serial->node_pool,
+                sizeof(st_dict_node_t) * dict->cur_index) != 0
+            || memcmp(dict->clear_nodes, serial->clear_nodes,
+                sizeof(st_dict_id_t) * dict->clear_node_num) != 0
+            || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    if (check_traverse_parallel(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict_destroy(dict);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* falls back to the serial path, and stops in the middle of rehash. */
+    dict = st_dict_create(1024, 1000, NULL, NULL, false);
+    assert(dict != NULL);
+    if (st_dict_set_rehash(dict, 1.0, 1) < 0
+            || st_dict_add_bulk(dict, keys, NUM_KEYS, NUM_THREADS) < 0
+            || dict->old_first_level_node == NULL
+            || check_traverse_parallel(dict) < 0
+            || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_destroy(dict);
+    safe_st_dict_destroy(serial);
+    return 0;
+
+FAILED:
+    safe_st_dict_destroy(dict);
+    safe_st_dict_destroy(serial);
+    return -1;
+}
+
+static int unit_test_st_dict_hash()
+{
+    st_dict_hash_fun_t funcs[] = {
+        st_dict_hash_simple,
+        st_dict_hash_sign1l16,
+        st_dict_hash_sign1,
+        st_dict_hash_murmur,
+        st_dict_hash_wy,
+        st_dict_hash_xxh3,
+    };
+    st_dict_t *dict = NULL;
+    st_dict_stats_t stats;
+    st_dict_id_t simple_max_chain;
+    int i;
+    int f;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict hash...\n");
+
+    /* word ids packed into sign1/sign2, which st_dict_hash_simple
+     * folds onto a few buckets. */
+    make_keys(7);
+    for (i = 0; i < NUM_KEYS; i++) {
+        keys[i].sign1 = (i >> 8) + 1;
+        keys[i].sign2 = (i & 0xff) << 16;
+    }
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    simple_max_chain = 0;
+    for (f = 0; f < sizeof(funcs) / sizeof(funcs[0]); f++) {
+        dict = st_dict_create(NUM_KEYS, NUM_KEYS, funcs[f], NULL, false);
+        assert(dict != NULL);
+        for (i = 0; i < NUM_KEYS; i++) {
+            if (st_dict_add_no_seek(dict, keys + i) < 0) {
+                fprintf(stderr, "Failed\n");
+                goto FAILED;
+            }
+        }
+        if (check_dict(dict) < 0 || st_dict_stats(dict, &stats) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        if (f == 0) {
+            simple_max_chain = stats.max_chain_len;
+        } else if (f >= 3 && stats.max_chain_len * 4 > simple_max_chain) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        safe_st_dict_destroy(dict);
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    dict = st_dict_create(NUM_KEYS, NUM_KEYS, st_dict_hash_auto, NULL, true);
+    assert(dict != NULL);
+    if (dict->hash_sample_num != ST_DICT_HASH_SAMPLE_NUM
+            || st_dict_set_hash_sample(dict, NUM_KEYS / 2) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        if (st_dict_add(dict, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (dict->hash_sample_num != 0 || dict->hash_func == st_dict_hash_simple
+            || dict->hash_func == st_dict_hash_sign1
+            || dict->node_num != NUM_KEYS || check_dict(dict) < 0
+            || st_dict_stats(dict, &stats) < 0
+            || stats.max_chain_len * 4 > simple_max_chain) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_destroy(dict);
+    return 0;
+
+FAILED:
+    safe_st_dict_destroy(dict);
+    return -1;
+}
+
+#define CORPUS_REPEAT 3
+
+static int count_update(st_dict_node_t *node, float data)
+{
+    node->float1 += data;
+    return 0;
+}
+
+static int count_merge(st_dict_node_t *dst, st_dict_node_t *src)
+{
+    dst->float1 += src->float1;
+    return 0;
+}
+
+typedef struct _counter_args_t {
+    st_dict_acc_t *acc;
+    int tid;
+    int err;
+} counter_args_t;
+
+/* thread tid counts every NUM_THREADS-th token of the corpus. */
+static void* counter_thread(void *arg)
+{
+    counter_args_t *ca = (counter_args_t *)arg;
+    st_dict_node_t node;
+    int i;
+
+    for (i = ca->tid; i < NUM_KEYS * CORPUS_REPEAT; i += NUM_THREADS) {
+        node = keys[i % NUM_KEYS];
+        node.float1 = 1.0;
+        if (st_dict_acc_update(ca->acc, ca->tid, &node) < 0) {
+            ca->err = 1;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static int check_counts(st_dict_acc_t *acc)
+{
+    pthread_t pts[NUM_THREADS];
+    counter_args_t cas[NUM_THREADS];
+    st_dict_t *dict = NULL;
+    st_dict_node_t node;
+    int ret = -1;
+    int n;
+    int i;
+
+    for (n = 0; n < NUM_THREADS; n++) {
+        cas[n].acc = acc;
+        cas[n].tid = n;
+        cas[n].err = 0;
+        if (pthread_create(pts + n, NULL, counter_thread, cas + n) != 0) {
+            break;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        pthread_join(pts[i], NULL);
+        if (cas[i].err) {
+            n = -1;
+        }
+    }
+    if (n != NUM_THREADS) {
+        return -1;
+    }
+
+    dict = st_dict_acc_merge(acc, NUM_THREADS);
+    if (dict == NULL || dict->node_num != NUM_KEYS) {
+        goto RET;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        if (st_dict_seek(dict, &node, NULL) < 0
+                || node.float1 != CORPUS_REPEAT) {
+            goto RET;
+        }
+    }
+    ret = 0;
+
+RET:
+    safe_st_dict_destroy(dict);
+    return ret;
+}
+
+static int unit_test_st_dict_acc()
+{
+    st_dict_acc_t *acc = NULL;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict_acc...\n");
+
+    make_keys(8);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    acc = st_dict_acc_create(NUM_THREADS, NUM_KEYS / 16, NUM_KEYS / 16,
+            st_dict_hash_murmur, count_update, count_merge);
+    assert(acc != NULL);
+    if (check_counts(acc) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* the accumulator is reusable, this time spilling to disk. */
+    if (st_dict_acc_set_spill(acc, sizeof(st_dict_node_t) * NUM_KEYS / 8,
+                "/tmp") < 0 || check_counts(acc) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+    safe_st_dict_acc_destroy(acc);
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* thread dicts and spill files must all hash alike. */
+    acc = st_dict_acc_create(NUM_THREADS, NUM_KEYS / 16, NUM_KEYS / 16,
+            st_dict_hash_auto, count_update, count_merge);
+    assert(acc != NULL);
+    if (acc->hash_func != st_dict_hash_murmur
+            || st_dict_acc_set_spill(acc,
+                sizeof(st_dict_node_t) * NUM_KEYS / 8, "/tmp") < 0
+            || check_counts(acc) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_st_dict_acc_destroy(acc);
+    return 0;
+
+FAILED:
+    safe_st_dict_acc_destroy(acc);
+    return -1;
+}
+
+static int check_dict64(st_dict64_t *d, int step, unsigned int inc)
+{
+    st_dict_node_t node;
+    int i;
+
+    for (i = 0; i < NUM_KEYS; i += step) {
+        node = keys[i];
+        node.uint1 = -1;
+        if (st_dict64_seek(d, &node, NULL) < 0
+                || node.uint1 != keys[i].uint1 + inc) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int unit_test_st_dict64()
+{
+    st_dict64_t *d = NULL;
+    st_dict64_t *loaded = NULL;
+    st_dict_t *dict = NULL;
+    st_dict_t *shard;
+    st_dict_node_t node;
+    FILE *fp = NULL;
+    char fname[] = "/tmp/st-dict64-XXXXXX";
+    unsigned long sum;
+    unsigned long expected;
+    int fd = -1;
+    int full;
+    int i;
+    int s;
+    int ncase;
+
+    fprintf(stderr, " Testing st_dict64...\n");
+
+    make_keys(9);
+    expected = 0;
+    for (i = 0; i < NUM_KEYS; i++) {
+        expected += keys[i].uint1;
+    }
+
+    fd = mkstemp(fname);
+    assert(fd >= 0);
+    fp = fdopen(fd, "w+");
+    assert(fp != NULL);
+
+    ncase = 1;
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* 2^33 nodes do not fit one st_dict, so they get shards. */
+    d = st_dict64_create(NUM_KEYS / 2, (uint64_t)1 << 33, NUM_KEYS / 16,
+            st_dict_hash_murmur, NULL);
+    assert(d != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        assert(st_dict64_add(d, keys + i, NULL) == 0);
+    }
+    if (d->shard_num < 4 || st_dict64_node_num(d) != NUM_KEYS
+            || check_dict64(d, 1, 0) < 0
+            || st_dict64_add(d, keys, NULL) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (s = 0; s < d->shard_num; s++) {
+        if (d->shards[s]->node_num == 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    sum = 0;
+    if (st_dict64_traverse(d, sum_trav, &sum) < 0 || sum != expected) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        assert(st_dict64_update(d, &node, NULL, inc_update) == 0);
+    }
+    if (check_dict64(d, 1, 1) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i += 2) {
+        node = keys[i];
+        assert(st_dict64_remove(d, &node, NULL) == 0);
+    }
+    if (st_dict64_node_num(d) != NUM_KEYS / 2
+            || check_dict64(d, 2, 0) == 0
+            || check_dict64(d, 1, 1) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 1; i < NUM_KEYS; i += 2) {
+        node = keys[i];
+        if (st_dict64_seek(d, &node, NULL) < 0
+                || node.uint1 != keys[i].uint1 + 1) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    safe_st_dict64_destroy(d);
+    d = st_dict64_create(NUM_KEYS / 2, (uint64_t)1 << 33, NUM_KEYS / 16,
+            st_dict_hash_murmur, NULL);
+    assert(d != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        assert(st_dict64_add_no_seek(d, keys + i) == 0);
+    }
+    if (st_dict64_save(d, fp) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    rewind(fp);
+    loaded = st_dict64_load_from_bin(fp);
+    if (loaded == NULL || loaded->shard_num != d->shard_num
+            || st_dict64_node_num(loaded) != NUM_KEYS
+            || check_dict64(loaded, 1, 0) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict64_destroy(loaded);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* a dict that fits is a single shard, and st_dict files load. */
+    dict = st_dict_create(NUM_KEYS / 2, NUM_KEYS / 16, st_dict_hash_murmur,
+            NULL, false);
+    assert(dict != NULL);
+    for (i = 0; i < NUM_KEYS; i++) {
+        assert(st_dict_add(dict, keys + i, NULL) == 0);
+    }
+    rewind(fp);
+    assert(st_dict_save(dict, fp) == 0);
+    rewind(fp);
+    loaded = st_dict64_load_from_bin(fp);
+    if (loaded == NULL || loaded->shard_num != 1
+            || check_dict64(loaded, 1, 0) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict64_destroy(loaded);
+    loaded = st_dict64_create(NUM_KEYS, NUM_KEYS, NUM_KEYS / 16,
+            st_dict_hash_murmur, NULL);
+    if (loaded == NULL || loaded->shard_num != 1) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    safe_st_dict64_destroy(loaded);
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* a reserved node_pool grows in place, until it is full. */
+    safe_st_dict_destroy(dict);
+    dict = st_dict_create(NUM_KEYS / 2, NUM_KEYS / 16, st_dict_hash_murmur,
+            NULL, false);
+    assert(dict != NULL);
+    for (i = 0; i < NUM_KEYS / 2; i++) {
+        assert(st_dict_add(dict, keys + i, NULL) == 0);
+    }
+    if (st_dict_reserve_pool(dict, NUM_KEYS / 4, -1) == 0
+            || st_dict_reserve_pool(dict, NUM_KEYS, -1) < 0
+            || dict->node_pool != dict->pool_addr
+            || st_dict_reserve_pool(dict, NUM_KEYS, -1) == 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = NUM_KEYS / 2; i < NUM_KEYS; i++) {
+        assert(st_dict_add(dict, keys + i, NULL) == 0);
+    }
+    node.sign2 = 1;
+    node.uint1 = 0;
+    for (i = 0; i < NUM_KEYS; i++) {
+        node.sign1 = NUM_KEYS + i;
+        if (st_dict_add(dict, &node, NULL) < 0) {
+            break;
+        }
+    }
+    if (dict->node_pool != dict->pool_addr
+            || dict->max_pool_num != NUM_KEYS
+            || dict->cur_index != NUM_KEYS
+            || dict->node_num != NUM_KEYS + i
+            || check_dict(dict) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    if (st_dict_compact(dict) < 0 || dict->pool_addr != NULL
+            || check_dict(dict) < 0
+            || st_dict_add(dict, &node, NULL) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /* shards backed by files. */
+    safe_st_dict64_destroy(d);
+    d = st_dict64_create(NUM_KEYS / 2, (uint64_t)1 << 33, NUM_KEYS / 16,
+            st_dict_hash_murmur, NULL);
+    assert(d != NULL);
+    if (st_dict64_reserve(d, "/tmp") < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        assert(st_dict64_add(d, keys + i, NULL) == 0);
+    }
+    for (s = 0; s < d->shard_num; s++) {
+        if (d->shards[s]->pool_fd < 0
+                || d->shards[s]->node_pool != d->shards[s]->pool_addr) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+    }
+    if (check_dict64(d, 1, 0) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    /*****************************************/
+    fprintf(stderr, "    Case %d...", ncase++);
+    /*
+     * Ids past 2^32 in total: every shard skips to the top of its
+     * sparse reservation, which is never touched below, and is filled
+     * up to the last id before ST_DICT_BAD_NODE. With one bucket per
+     * shard, that is a head and 16 nodes in the pool.
+     */
+    safe_st_dict64_destroy(d);
+    d = st_dict64_create(8, (uint64_t)1 << 33, 8,
+            st_dict_hash_murmur, NULL);
+    assert(d != NULL);
+    if (st_dict64_reserve(d, NULL) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    for (s = 0; s < d->shard_num; s++) {
+        d->shards[s]->cur_index = ST_DICT_BAD_NODE - 16;
+        d->shards[s]->max_pool_num = ST_DICT_BAD_NODE - 16;
+    }
+    full = 0;
+    for (i = 0; i < NUM_KEYS && full < d->shard_num; i++) {
+        shard = st_dict64_shard(d, keys + i);
+        if (shard->node_num == 17) {
+            if (st_dict64_add(d, keys + i, NULL) == 0
+                    || shard->cur_index != ST_DICT_BAD_NODE) {
+                fprintf(stderr, "Failed\n");
+                goto FAILED;
+            }
+            continue;
+        }
+        if (st_dict64_add(d, keys + i, NULL) < 0) {
+            fprintf(stderr, "Failed\n");
+            goto FAILED;
+        }
+        if (shard->node_num == 17) {
+            full++;
+        }
+    }
+    if (full != d->shard_num
+            || st_dict64_node_num(d) != 17 * (uint64_t)d->shard_num) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    if (d->shard_num != 8 || st_dict64_traverse(d, NULL, NULL) < 0) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    sum = 0;
+    for (i = 0; i < NUM_KEYS; i++) {
+        node = keys[i];
+        if (st_dict64_seek(d, &node, NULL) == 0) {
+            if (node.uint1 != keys[i].uint1) {
+                fprintf(stderr, "Failed\n");
+                goto FAILED;
+            }
+            sum++;
+        }
+    }
+    if (sum != 17 * (unsigned long)d->shard_num) {
+        fprintf(stderr, "Failed\n");
+        goto FAILED;
+    }
+    fprintf(stderr, "Passed\n");
+
+    safe_fclose(fp);
+    unlink(fname);
+    safe_st_dict_destroy(dict);
+    safe_st_dict64_destroy(d);
+    return 0;
+
+FAILED:
+    safe_fclose(fp);
+    unlink(fname);
+    safe_st_dict_destroy(dict);
+    safe_st_dict64_destroy(loaded);
+    safe_st_dict64_destroy(d);
+    return -1;
+}
+
+static int run_all_tests()
+{
+    int ret = 0;
+
+    if (unit_test_st_dict() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict_rehash() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict_mmap() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict_snapshot() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict_frozen() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict_oa() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict_wide() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict_concurrent() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict_bulk() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict_hash() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict_acc() != 0) {
+        ret = -1;
+    }
+
+    if (unit_test_st_dict64() != 0) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int main(int argc, const char *argv[])
+{
+    int ret;
+
+    fprintf(stderr, "Start testing...\n");
+    ret = run_all_tests();
+    if (ret != 0) {
+        fprintf(stderr, "Tests failed.\n");
+    } else {
+        fprintf(stderr, "Tests succeeded.\n");
+    }
+
+    return ret;
+}
@@ -0,0 +1,155 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Wang Jian
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "st_dict.h"
+#include "st_dict64.h"
+
+/*
+ * Adds num_keys keys to a st_dict64 with reserved node pools, then
+ * seeks a sample of present and absent keys, in million operations per
+ * second. Keys are generated from their index, so more than 2^32 of
+ * them need no key array; give dir to back the pools with sparse files
+ * there, which then need 16 bytes of disk per key. Seeks into pools
+ * larger than RAM read the disk, so sample_num may be lowered.
+ *
+ * Usage: st-dict64-bench [num_keys] [dir] [sample_num]
+ */
+
+#define MAX_HASH_NUM ((uint64_t)1 << 26)
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void make_key(st_dict_node_t *node, uint64_t i)
+{
+    node->sign1 = (unsigned int)(i >> 32) + 1;
+    node->sign2 = (unsigned int)i;
+    node->uint1 = (unsigned int)(i * 2654435761U);
+}
+
+static uint64_t rand64(uint64_t n)
+{
+    return ((((uint64_t)rand()) << 31) ^ (uint64_t)rand()) % n;
+}
+
+static void report(const char *name, uint64_t n, double t)
+{
+    printf("  %-16s %8.3fs %8.2f Mops/s\n", name, t, n / t / 1e6);
+}
+
+int main(int argc, const char *argv[])
+{
+    st_dict64_t *d = NULL;
+    st_dict_node_t node;
+    uint64_t hash_num;
+    uint64_t found;
+    uint64_t n;
+    uint64_t i;
+    uint64_t k;
+    uint64_t sample_num;
+    const char *dir;
+    double t;
+
+    n = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000000;
+    dir = argc > 2 && argv[2][0] != '\0' ? argv[2] : NULL;
+    sample_num = argc > 3 ? strtoull(argv[3], NULL, 10) : 1000000;
+    if (n == 0 || sample_num == 0) {
+        fprintf(stderr, "Usage: %s [num_keys] [dir] [sample_num]\n",
+                argv[0]);
+        return -1;
+    }
+
+    hash_num = n / 2 < MAX_HASH_NUM ? n / 2 : MAX_HASH_NUM;
+    d = st_dict64_create(hash_num, n, ST_DICT_REALLOC_NUM,
+            st_dict_hash_murmur, NULL);
+    if (d == NULL) {
+        fprintf(stderr, "Failed to st_dict64_create.\n");
+        goto ERR;
+    }
+    if (st_dict64_reserve(d, dir) < 0) {
+        fprintf(stderr, "Failed to st_dict64_reserve.\n");
+        goto ERR;
+    }
+
+    printf("%llu keys, %d shards, %llu buckets, %zu bytes per node, "
+            "pools in %s\n", (unsigned long long)n, d->shard_num,
+            (unsigned long long)hash_num, sizeof(st_dict_node_t),
+            dir != NULL ? dir : "anonymous memory");
+
+    t = now();
+    for (i = 0; i < n; i++) {
+        make_key(&node, i);
+        if (st_dict64_add_no_seek(d, &node) < 0) {
+            fprintf(stderr, "Failed to st_dict64_add_no_seek[%llu].\n",
+                    (unsigned long long)i);
+            goto ERR;
+        }
+    }
+    report("add", n, now() - t);
+    if (st_dict64_node_num(d) != n) {
+        fprintf(stderr, "Wrong number of nodes[%llu].\n",
+                (unsigned long long)st_dict64_node_num(d));
+        goto ERR;
+    }
+
+    srand(1);
+    found = 0;
+    t = now();
+    for (i = 0; i < sample_num; i++) {
+        k = rand64(n);
+        make_key(&node, k);
+        if (st_dict64_seek(d, &node, NULL) == 0
+                && node.uint1 == (unsigned int)(k * 2654435761U)) {
+            found++;
+        }
+    }
+    report("seek hit", sample_num, now() - t);
+    t = now();
+    for (i = 0; i < sample_num; i++) {
+        make_key(&node, n + rand64(n));
+        found += st_dict64_seek(d, &node, NULL) == 0;
+    }
+    report("seek miss", sample_num, now() - t);
+    if (found != sample_num) {
+        fprintf(stderr, "Wrong number of found keys[%llu].\n",
+                (unsigned long long)found);
+        goto ERR;
+    }
+
+    safe_st_dict64_destroy(d);
+    return 0;
+
+ERR:
+    safe_st_dict64_destroy(d);
+    return -1;
+}